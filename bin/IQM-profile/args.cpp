@@ -32,6 +32,8 @@ IQM::ProfileArgs::ProfileArgs(const unsigned argc, const char *argv[]) {
                 this->method = Method::PSNR;
             } else if (strcmp(argv[i + 1], "LPIPS") == 0) {
                 this->method = Method::LPIPS;
+            } else if (strcmp(argv[i + 1], "MS_SSIM") == 0) {
+                this->method = Method::MS_SSIM;
             } else {
                 throw std::runtime_error("Unknown method");
             }
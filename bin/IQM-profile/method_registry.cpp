@@ -0,0 +1,78 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "method_registry.h"
+#include "../shared/io.h"
+
+IQM::Profile::MethodRegistry::MethodRegistry(const IQM::VulkanInstance &instance) : instance(instance) {}
+
+#ifdef COMPILE_SSIM
+IQM::SSIM& IQM::Profile::MethodRegistry::ssim(const bool halfPrecision) {
+    auto &method = halfPrecision ? this->ssimHalfMethod : this->ssimMethod;
+    if (!method.has_value()) {
+        method.emplace(*this->instance.device(), this->instance.pipelineCache(), halfPrecision);
+    }
+    return method.value();
+}
+
+IQM::MSSSIM& IQM::Profile::MethodRegistry::msssim() {
+    if (!this->msssimMethod.has_value()) {
+        this->msssimMethod.emplace(*this->instance.device(), this->instance.pipelineCache());
+    }
+    return this->msssimMethod.value();
+}
+#endif
+
+#ifdef COMPILE_SVD
+IQM::SVD& IQM::Profile::MethodRegistry::svd() {
+    if (!this->svdMethod.has_value()) {
+        this->svdMethod.emplace(*this->instance.device(), this->instance.pipelineCache());
+    }
+    return this->svdMethod.value();
+}
+#endif
+
+#ifdef COMPILE_FSIM
+IQM::FSIM& IQM::Profile::MethodRegistry::fsim() {
+    if (!this->fsimMethod.has_value()) {
+        this->fsimMethod.emplace(*this->instance.device(), this->instance.pipelineCache());
+    }
+    return this->fsimMethod.value();
+}
+#endif
+
+#ifdef COMPILE_FLIP
+IQM::FLIP& IQM::Profile::MethodRegistry::flip() {
+    if (!this->flipMethod.has_value()) {
+        this->flipMethod.emplace(*this->instance.device(), this->instance.pipelineCache());
+    }
+    return this->flipMethod.value();
+}
+#endif
+
+#ifdef COMPILE_PSNR
+IQM::PSNR& IQM::Profile::MethodRegistry::psnr() {
+    if (!this->psnrMethod.has_value()) {
+        this->psnrMethod.emplace(*this->instance.device(), this->instance.pipelineCache());
+    }
+    return this->psnrMethod.value();
+}
+#endif
+
+#ifdef COMPILE_LPIPS
+IQM::LPIPS& IQM::Profile::MethodRegistry::lpips() {
+    if (!this->lpipsMethod.has_value()) {
+        this->lpipsMethod.emplace(*this->instance.device(), this->instance.pipelineCache());
+    }
+    return this->lpipsMethod.value();
+}
+
+const std::vector<float>& IQM::Profile::MethodRegistry::lpipsModel() {
+    if (!this->lpipsModelData.has_value()) {
+        this->lpipsModelData = IQM::Bin::load_model("lpips.dat");
+    }
+    return this->lpipsModelData.value();
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_PROFILE_METHOD_REGISTRY_H
+#define IQM_PROFILE_METHOD_REGISTRY_H
+
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+#include "../shared/vulkan.h"
+
+#if COMPILE_SSIM
+#include <IQM/ssim.h>
+#include <IQM/msssim.h>
+#endif
+
+#if COMPILE_SVD
+#include <IQM/svd.h>
+#endif
+
+#if COMPILE_FSIM
+#include <IQM/fsim.h>
+#endif
+
+#if COMPILE_FLIP
+#include <IQM/flip.h>
+#endif
+
+#if COMPILE_PSNR
+#include <IQM/psnr.h>
+#endif
+
+#if COMPILE_LPIPS
+#include <IQM/lpips.h>
+#endif
+
+namespace IQM::Profile {
+    /**
+     * Creates method objects with their pipelines on first use,
+     * so startup only pays for methods that are actually profiled.
+     */
+    class MethodRegistry {
+    public:
+        explicit MethodRegistry(const IQM::VulkanInstance& instance);
+
+#ifdef COMPILE_SSIM
+        // separate instance is kept for each precision of the map
+        IQM::SSIM& ssim(bool halfPrecision);
+        IQM::MSSSIM& msssim();
+#endif
+#ifdef COMPILE_SVD
+        IQM::SVD& svd();
+#endif
+#ifdef COMPILE_FSIM
+        IQM::FSIM& fsim();
+#endif
+#ifdef COMPILE_FLIP
+        IQM::FLIP& flip();
+#endif
+#ifdef COMPILE_PSNR
+        IQM::PSNR& psnr();
+#endif
+#ifdef COMPILE_LPIPS
+        IQM::LPIPS& lpips();
+        // weights read from `lpips.dat`
+        const std::vector<float>& lpipsModel();
+#endif
+    private:
+        const IQM::VulkanInstance& instance;
+
+#ifdef COMPILE_SSIM
+        std::optional<IQM::SSIM> ssimMethod;
+        std::optional<IQM::SSIM> ssimHalfMethod;
+        std::optional<IQM::MSSSIM> msssimMethod;
+#endif
+#ifdef COMPILE_SVD
+        std::optional<IQM::SVD> svdMethod;
+#endif
+#ifdef COMPILE_FSIM
+        std::optional<IQM::FSIM> fsimMethod;
+#endif
+#ifdef COMPILE_FLIP
+        std::optional<IQM::FLIP> flipMethod;
+#endif
+#ifdef COMPILE_PSNR
+        std::optional<IQM::PSNR> psnrMethod;
+#endif
+#ifdef COMPILE_LPIPS
+        std::optional<IQM::LPIPS> lpipsMethod;
+        std::optional<std::vector<float>> lpipsModelData;
+#endif
+    };
+}
+
+#endif //IQM_PROFILE_METHOD_REGISTRY_H
@@ -15,9 +15,11 @@
 
 #include <GLFW/glfw3.h>
 #include "vulkan_instance.h"
+#include "method_registry.h"
 
 #if COMPILE_SSIM
 #include "../shared/wrappers/ssim.h"
+#include "../shared/wrappers/msssim.h"
 #endif
 
 #if COMPILE_SVD
@@ -48,7 +50,7 @@ void printHelp() {
     std::cout << "IQM-profile - Application for profiling methods in IQM.\n"
     << "Usage: IQM-profile --method METHOD --input INPUT --ref REF [--iterations I]\n\n"
     << "Arguments:\n"
-    << "    --method <METHOD>    : selects method to compute, one of SSIM, FSIM, FLIP, PSNR, LPIPS\n"
+    << "    --method <METHOD>    : selects method to compute, one of SSIM, MS_SSIM, FSIM, FLIP, PSNR, LPIPS\n"
     << "    --input <INPUT>      : path to tested image\n"
     << "    --ref <REF>          : path to reference image\n"
     << "    -i, --iterations <I> : number of iterations to compute, unlimited if not set\n"
@@ -56,6 +58,8 @@ void printHelp() {
     << "    -c, --colorize       : colorize final output\n"
     << "    -h, --help           : prints help\n\n"
     << "Method specific arguments:\n"
+    << "SSIM:\n"
+    << "    --ssim-precision <PREC>    : `fp32` (default) or `fp16` storage of the output map, fp16 also reports error against fp32\n"
     << "FLIP:\n"
     << "    --flip-width <WIDTH>       : Width of display in meters\n"
     << "    --flip-res <RES>           : Resolution of display in pixels\n"
@@ -110,25 +114,9 @@ int main(int argc, const char **argv) {
 
         unsigned frameIndex = 0;
 
-#ifdef COMPILE_SSIM
-        IQM::SSIM ssim(*instance.device());
-#endif
-#ifdef COMPILE_SVD
-        IQM::SVD svd(*instance.device());
-#endif
-#ifdef COMPILE_FSIM
-        IQM::FSIM fsim(*instance.device());
-#endif
-#ifdef COMPILE_FLIP
-        IQM::FLIP flip(*instance.device());
-#endif
-#ifdef COMPILE_PSNR
-        IQM::PSNR psnr(*instance.device());
-#endif
-#ifdef COMPILE_LPIPS
-        IQM::LPIPS lpips(*instance.device());
-        auto modelData = IQM::Bin::load_model("lpips.dat");
-#endif
+        IQM::Profile::MethodRegistry methods(instance);
+        // resources of each frame are transient, so they are bump allocated and the memory is reused next frame
+        IQM::Bin::LinearArena arena;
 
         std::vector<std::chrono::microseconds> times;
 
@@ -138,10 +126,11 @@ int main(int argc, const char **argv) {
 
                 auto start = std::chrono::high_resolution_clock::now();
 
+                IQM::Bin::ArenaScope arenaScope(arena);
                 switch (args->method) {
                     case IQM::Method::SSIM:
 #ifdef COMPILE_SSIM
-                        IQM::Bin::ssim_run_single(args.value(), instance, ssim, input, reference);
+                        IQM::Bin::ssim_run_single(args.value(), instance, methods.ssim(IQM::Bin::ssim_half_precision(args->options, instance)), input, reference);
 #else
                         throw std::runtime_error("SSIM support is not compiled");
 #endif
@@ -150,37 +139,44 @@ int main(int argc, const char **argv) {
                         throw std::runtime_error("CW-SSIM is not implemented");
                     case IQM::Method::SVD:
 #ifdef COMPILE_SVD
-                        IQM::Bin::svd_run_single(args.value(), instance, svd, input, reference);
+                        IQM::Bin::svd_run_single(args.value(), instance, methods.svd(), input, reference);
 #else
                         throw std::runtime_error("M-SVD support is not compiled");
 #endif
                     break;
                     case IQM::Method::FSIM:
 #ifdef COMPILE_FSIM
-                        IQM::Bin::fsim_run_single(args.value(), instance, fsim, input, reference);
+                        IQM::Bin::fsim_run_single(args.value(), instance, methods.fsim(), input, reference);
 #else
                         throw std::runtime_error("FSIM support is not compiled");
 #endif
                     break;
                     case IQM::Method::FLIP:
 #ifdef COMPILE_FLIP
-                        IQM::Bin::flip_run_single(args.value(), instance, flip, input, reference);
+                        IQM::Bin::flip_run_single(args.value(), instance, methods.flip(), input, reference);
 #else
                         throw std::runtime_error("FLIP support is not compiled");
 #endif
                     break;
                     case IQM::Method::PSNR:
 #ifdef COMPILE_PSNR
-                        IQM::Bin::psnr_run_single(args.value(), instance, psnr, input, reference);
+                        IQM::Bin::psnr_run_single(args.value(), instance, methods.psnr(), input, reference);
 #else
                         throw std::runtime_error("PSNR support is not compiled");
 #endif
                     break;
                     case IQM::Method::LPIPS:
 #ifdef COMPILE_LPIPS
-                        IQM::Bin::lpips_run_single(args.value(), instance, lpips, input, reference, modelData);
+                        IQM::Bin::lpips_run_single(args.value(), instance, methods.lpips(), input, reference, methods.lpipsModel());
 #else
                         throw std::runtime_error("LPIPS support is not compiled");
+#endif
+                    break;
+                    case IQM::Method::MS_SSIM:
+#ifdef COMPILE_SSIM
+                        IQM::Bin::msssim_run_single(args.value(), instance, methods.msssim(), input, reference);
+#else
+                        throw std::runtime_error("SSIM support is not compiled");
 #endif
                     break;
                 }
@@ -211,6 +207,16 @@ int main(int argc, const char **argv) {
         auto median = times[times.size() / 2];
 
         std::cout << "Median run time: " << median << std::endl;
+        std::cout << "Frame arena: " << static_cast<double>(arena.reservedSize()) / 1024 / 1024 << " MB reserved, "
+        << static_cast<double>(arena.peakSize()) / 1024 / 1024 << " MB peak" << std::endl;
+
+#ifdef COMPILE_SSIM
+        // fp16 map is only worth it, if the error stays small for given images
+        if (args->method == IQM::Method::SSIM && IQM::Bin::ssim_half_precision(args->options, instance)) {
+            IQM::Bin::ArenaScope arenaScope(arena);
+            IQM::Bin::ssim_compare_precision(instance, methods.ssim(false), methods.ssim(true), input, reference);
+        }
+#endif
     }
     glfwDestroyWindow(window);
     glfwTerminate();
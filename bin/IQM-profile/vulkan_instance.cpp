@@ -6,6 +6,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include "vulkan_instance.h"
+#include "../shared/vulkan_res.h"
 
 #include <iostream>
 
@@ -46,6 +47,7 @@ IQM::Profile::VulkanInstance::VulkanInstance(GLFWwindow * window) {
     this->instance = vk::raii::Instance{this->context, instanceCreateInfo};
 
     this->initQueues();
+    IQM::Bin::VulkanResource::useHeap(&this->memoryHeap);
 
     VkSurfaceKHR surface;
 
@@ -57,6 +59,10 @@ IQM::Profile::VulkanInstance::VulkanInstance(GLFWwindow * window) {
     this->createSwapchain();
 }
 
+IQM::Profile::VulkanInstance::~VulkanInstance() {
+    IQM::Bin::VulkanResource::useHeap(nullptr);
+}
+
 void IQM::Profile::VulkanInstance::createSwapchain() {
     uint32_t queues[1] = {this->queueFamilyIndex};
 
@@ -255,11 +261,18 @@ void IQM::Profile::VulkanInstance::initQueues() {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
+    // R f16 maps of `--ssim-precision fp16` are written as storage images, without the feature SSIM falls back to f32
+    this->halfStorage = this->_physicalDevice.getFeatures().shaderStorageImageExtendedFormats;
+    const vk::PhysicalDeviceFeatures features{
+        .shaderStorageImageExtendedFormats = this->halfStorage,
+    };
+
     const vk::DeviceCreateInfo deviceCreateInfo{
         .queueCreateInfoCount = static_cast<uint32_t>(queues.size()),
         .pQueueCreateInfos = queues.data(),
         .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
         .ppEnabledExtensionNames = deviceExtensions.data(),
+        .pEnabledFeatures = &features,
     };
 
     this->_device = vk::raii::Device{this->_physicalDevice, deviceCreateInfo};
@@ -11,6 +11,7 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_raii.hpp>
 
+#include "../shared/device_memory.h"
 #include "../shared/vulkan.h"
 
 namespace IQM::Profile {
@@ -19,6 +20,7 @@ namespace IQM::Profile {
     class VulkanInstance : public IQM::VulkanInstance  {
     public:
         VulkanInstance(GLFWwindow*);
+        ~VulkanInstance() override;
 
         std::string selectedDevice;
 
@@ -26,10 +28,13 @@ namespace IQM::Profile {
         vk::raii::Instance instance = VK_NULL_HANDLE;
         vk::raii::PhysicalDevice _physicalDevice = VK_NULL_HANDLE;
         vk::raii::Device _device = VK_NULL_HANDLE;
+        // declared after the device, so it's destroyed before it
+        IQM::Bin::DeviceMemoryHeap memoryHeap;
         std::shared_ptr<vk::raii::Queue> _queue = VK_NULL_HANDLE;
         uint32_t queueFamilyIndex;
         std::shared_ptr<vk::raii::Queue> transferQueue = VK_NULL_HANDLE;
         uint32_t transferQueueFamilyIndex;
+        bool halfStorage = false;
         std::shared_ptr<vk::raii::CommandPool> commandPool = VK_NULL_HANDLE;
         std::shared_ptr<vk::raii::CommandPool> commandPoolTransfer = VK_NULL_HANDLE;
         std::shared_ptr<vk::raii::CommandBuffer> cmd_buffer = VK_NULL_HANDLE;
@@ -48,6 +53,12 @@ namespace IQM::Profile {
         const std::shared_ptr<const vk::raii::CommandBuffer> cmdBufTransfer() const override {return cmd_bufferTransfer;}
         const std::shared_ptr<const vk::raii::Queue> queue() const override {return _queue;}
         const std::shared_ptr<const vk::raii::Queue> queueTransfer() const override {return transferQueue;}
+        uint32_t queueFamily() const override {return queueFamilyIndex;}
+        uint32_t queueFamilyTransfer() const override {return transferQueueFamilyIndex;}
+        bool halfStorageImages() const override {return halfStorage;}
+        // profiling always measures cold pipeline creation
+        const vk::raii::PipelineCache* pipelineCache() const override {return nullptr;}
+        void savePipelineCache() const override {}
 
         void createSwapchain();
         unsigned acquire();
@@ -4,9 +4,41 @@
  */
 
 #include "args.h"
+#include "file_matcher.h"
+
+#include <algorithm>
 #include <cstring>
+#include <sstream>
 #include <stdexcept>
 
+static IQM::Method parse_method(const std::string &name) {
+    if (name == "SSIM") {
+        return IQM::Method::SSIM;
+    }
+    if (name == "CW_SSIM_CPU") {
+        return IQM::Method::CW_SSIM_CPU;
+    }
+    if (name == "SVD") {
+        return IQM::Method::SVD;
+    }
+    if (name == "FSIM") {
+        return IQM::Method::FSIM;
+    }
+    if (name == "FLIP") {
+        return IQM::Method::FLIP;
+    }
+    if (name == "PSNR") {
+        return IQM::Method::PSNR;
+    }
+    if (name == "LPIPS") {
+        return IQM::Method::LPIPS;
+    }
+    if (name == "MS_SSIM") {
+        return IQM::Method::MS_SSIM;
+    }
+    throw std::runtime_error("Unknown method");
+}
+
 IQM::Bin::Args::Args(const unsigned argc, const char *argv[]) {
     bool parsedMethod = false;
     bool parsedInput = false;
@@ -18,23 +50,21 @@ IQM::Bin::Args::Args(const unsigned argc, const char *argv[]) {
             if (i + 1 >= argc) {
                 throw std::runtime_error("Missing method argument");
             }
-            if (strcmp(argv[i + 1], "SSIM") == 0) {
-                this->method = Method::SSIM;
-            } else if (strcmp(argv[i + 1], "CW_SSIM_CPU") == 0) {
-                this->method = Method::CW_SSIM_CPU;
-            } else if (strcmp(argv[i + 1], "SVD") == 0) {
-                this->method = Method::SVD;
-            } else if (strcmp(argv[i + 1], "FSIM") == 0) {
-                this->method = Method::FSIM;
-            } else if (strcmp(argv[i + 1], "FLIP") == 0) {
-                this->method = Method::FLIP;
-            } else if (strcmp(argv[i + 1], "PSNR") == 0) {
-                this->method = Method::PSNR;
-            } else if (strcmp(argv[i + 1], "LPIPS") == 0) {
-                this->method = Method::LPIPS;
-            } else {
-                throw std::runtime_error("Unknown method");
+            // comma separated list computes several methods on the same upload
+            std::stringstream list(argv[i + 1]);
+            std::string name;
+            this->methods.clear();
+            while (std::getline(list, name, ',')) {
+                const auto method = parse_method(name);
+                if (std::ranges::find(this->methods, method) != this->methods.end()) {
+                    throw std::runtime_error("Method selected more than once");
+                }
+                this->methods.push_back(method);
             }
+            if (this->methods.empty()) {
+                throw std::runtime_error("Missing method argument");
+            }
+            this->method = this->methods.front();
             parsedMethod = true;
             i+=2;
             continue;
@@ -72,6 +102,16 @@ IQM::Bin::Args::Args(const unsigned argc, const char *argv[]) {
             continue;
         }
 
+        if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing serve argument");
+            }
+
+            this->servePath = std::string(argv[i + 1]);
+            i+=2;
+            continue;
+        }
+
         if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
             this->verbose = true;
             i += 1;
@@ -86,6 +126,16 @@ IQM::Bin::Args::Args(const unsigned argc, const char *argv[]) {
             i += 1;
             continue;
         }
+        if (strcmp(argv[i], "--no-pipeline-cache") == 0) {
+            this->pipelineCache = false;
+            i += 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--incremental") == 0) {
+            this->incremental = true;
+            i += 1;
+            continue;
+        }
 
         if (i + 1 >= argc) {
             throw std::runtime_error("Missing value argument");
@@ -97,10 +147,14 @@ IQM::Bin::Args::Args(const unsigned argc, const char *argv[]) {
     if (!parsedMethod) {
         throw std::runtime_error("missing method");
     }
+    if (this->servePath.has_value()) {
+        return;
+    }
     if (!parsedInput) {
         throw std::runtime_error("missing input");
     }
-    if (!parsedReference) {
+    // manifest can list references itself
+    if (!parsedReference && !FileMatcher::isManifest(this->inputPath)) {
         throw std::runtime_error("missing reference");
     }
 }
@@ -9,18 +9,26 @@
 #include "../shared/methods.h"
 #include <optional>
 #include <unordered_map>
+#include <vector>
 
 namespace IQM::Bin {
     class Args {
     public:
         Args(unsigned argc, const char* argv[]);
+        // first of selected methods
         Method method;
+        std::vector<Method> methods;
         std::string inputPath;
         std::string refPath;
         std::optional<std::string> outputPath;
+        // unix socket path, or `-` for stdin/stdout, inputs then come with requests
+        std::optional<std::string> servePath;
         std::unordered_map<std::string, std::string> options;
         bool colorize = false;
         bool verbose = false;
+        bool pipelineCache = true;
+        // consecutive pairs only recompute regions that changed since the previous one
+        bool incremental = false;
         bool printHelp = false;
     };
 }
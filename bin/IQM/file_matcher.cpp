@@ -5,7 +5,391 @@
 
 #include "file_matcher.h"
 
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+// formats loadable by stb_image
+static const std::vector<std::string> IMAGE_EXTENSIONS = {
+    ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".psd", ".gif", ".hdr", ".pic", ".pnm", ".ppm", ".pgm"
+};
+
+static bool isImage(const fs::path& path) {
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](const unsigned char c) { return std::tolower(c); });
+    return std::find(IMAGE_EXTENSIONS.begin(), IMAGE_EXTENSIONS.end(), ext) != IMAGE_EXTENSIONS.end();
+}
+
+static std::optional<std::string> outputFor(const IQM::Bin::Args& args, const fs::path& testPath) {
+    if (!args.outputPath.has_value()) {
+        return std::nullopt;
+    }
+
+    // in batch mode output is a directory, one map per tested image, created when the first map is saved
+    const fs::path outDir(args.outputPath.value());
+    return (outDir / testPath.stem()).string() + ".png";
+}
+
+// tested images differing only in extension would silently overwrite each other's map
+static void requireDistinctOutputs(const std::vector<IQM::Bin::Match>& matches) {
+    std::unordered_map<std::string, const IQM::Bin::Match*> outputs;
+    for (const auto& match : matches) {
+        if (!match.outPath.has_value()) {
+            continue;
+        }
+        const auto key = fs::path(match.outPath.value()).lexically_normal().string();
+        const auto [it, inserted] = outputs.emplace(key, &match);
+        if (!inserted) {
+            throw std::runtime_error("Outputs of '" + it->second->testPath + "' and '" + match.testPath + "' would both be written to '" + key + "'");
+        }
+    }
+}
+
 std::vector<IQM::Bin::Match> IQM::Bin::FileMatcher::match(const IQM::Bin::Args& args) {
-    // add batch support after
-    return {IQM::Bin::Match{.testPath = args.inputPath, .refPath = args.refPath, .outPath = args.outputPath}};
+    if (isManifest(args.inputPath)) {
+        return matchManifest(args);
+    }
+
+    const bool singleInput = !isPattern(args.inputPath) && !fs::is_directory(args.inputPath);
+    const bool singleRef = !isPattern(args.refPath) && !fs::is_directory(args.refPath);
+
+    // original single pair invocation, output is a file path
+    if (singleInput && singleRef) {
+        return {IQM::Bin::Match{.testPath = args.inputPath, .refPath = args.refPath, .outPath = args.outputPath}};
+    }
+
+    PairBy pairBy = PairBy::Stem;
+    if (args.options.contains("--pair-by")) {
+        const auto& opt = args.options.at("--pair-by");
+        if (opt == "stem") {
+            pairBy = PairBy::Stem;
+        } else if (opt == "name") {
+            pairBy = PairBy::Name;
+        } else {
+            throw std::runtime_error("Unknown pairing mode '" + opt + "'");
+        }
+    }
+
+    const auto tests = expand(args.inputPath);
+    std::vector<Match> matches;
+    matches.reserve(tests.size());
+
+    if (singleRef) {
+        if (!fs::is_regular_file(args.refPath)) {
+            throw std::runtime_error("Reference '" + args.refPath + "' does not exist");
+        }
+        for (const auto& test : tests) {
+            matches.push_back(Match{.testPath = test.string(), .refPath = args.refPath, .outPath = outputFor(args, test)});
+        }
+        requireDistinctOutputs(matches);
+        return matches;
+    }
+
+    std::map<std::string, fs::path> refs;
+    for (const auto& ref : expand(args.refPath)) {
+        const auto key = pairKey(ref, pairBy);
+        if (refs.contains(key)) {
+            throw std::runtime_error("Ambiguous reference for '" + key + "': '" + refs.at(key).string() + "' and '" + ref.string() + "'");
+        }
+        refs.emplace(key, ref);
+    }
+
+    for (const auto& test : tests) {
+        const auto key = pairKey(test, pairBy);
+        if (!refs.contains(key)) {
+            std::cerr << "No reference found for '" << test.string() << "', skipping" << std::endl;
+            continue;
+        }
+        matches.push_back(Match{.testPath = test.string(), .refPath = refs.at(key).string(), .outPath = outputFor(args, test)});
+    }
+
+    if (matches.empty()) {
+        throw std::runtime_error("No matching image pairs found");
+    }
+
+    requireDistinctOutputs(matches);
+    return matches;
+}
+
+bool IQM::Bin::FileMatcher::isManifest(const std::string &path) {
+    const auto ext = fs::path(path).extension();
+    return ext == ".csv" || ext == ".jsonl";
+}
+
+bool IQM::Bin::FileMatcher::isPattern(const std::string &path) {
+    return path.find_first_of("*?[") != std::string::npos;
+}
+
+std::string IQM::Bin::FileMatcher::pairKey(const fs::path &path, const PairBy pairBy) {
+    if (pairBy == PairBy::Name) {
+        return path.filename().string();
+    }
+    return path.stem().string();
+}
+
+std::vector<fs::path> IQM::Bin::FileMatcher::expand(const std::string &path) {
+    std::vector<fs::path> files;
+
+    if (fs::is_directory(path)) {
+        for (const auto& entry : fs::directory_iterator(path)) {
+            if (entry.is_regular_file() && isImage(entry.path())) {
+                files.push_back(entry.path());
+            }
+        }
+    } else if (isPattern(path)) {
+        const fs::path pattern(path);
+        const auto dir = pattern.has_parent_path() ? pattern.parent_path() : fs::path(".");
+        if (isPattern(dir.string())) {
+            throw std::runtime_error("Wildcards are only supported in file names: '" + path + "'");
+        }
+        if (!fs::is_directory(dir)) {
+            throw std::runtime_error("Directory '" + dir.string() + "' does not exist");
+        }
+
+        const auto filePattern = pattern.filename().string();
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            if (entry.is_regular_file() && fnmatch(filePattern.c_str(), entry.path().filename().c_str(), 0) == 0) {
+                files.push_back(entry.path());
+            }
+        }
+    } else if (fs::is_regular_file(path)) {
+        files.emplace_back(path);
+    } else {
+        throw std::runtime_error("Path '" + path + "' does not exist");
+    }
+
+    if (files.empty()) {
+        throw std::runtime_error("No images found in '" + path + "'");
+    }
+
+    // directory iteration order is unspecified, keep output stable between runs
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::vector<IQM::Bin::Match> IQM::Bin::FileMatcher::matchManifest(const Args &args) {
+    std::ifstream file(args.inputPath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open manifest '" + args.inputPath + "'");
+    }
+
+    const auto rows = fs::path(args.inputPath).extension() == ".csv" ? parseCsv(file) : parseJsonLines(file);
+
+    const auto testCol = args.options.contains("--manifest-test") ? args.options.at("--manifest-test") : "test";
+    const auto refCol = args.options.contains("--manifest-ref") ? args.options.at("--manifest-ref") : "ref";
+    const auto outCol = args.options.contains("--manifest-out") ? args.options.at("--manifest-out") : "out";
+    const auto dirtyCol = args.options.contains("--manifest-dirty") ? args.options.at("--manifest-dirty") : "dirty";
+
+    // relative paths in manifest are relative to the manifest itself
+    const auto baseDir = fs::path(args.inputPath).parent_path();
+    const auto resolve = [&](const fs::path& dir, const std::string& value) {
+        const fs::path p(value);
+        return p.is_absolute() ? p : dir / p;
+    };
+
+    std::vector<Match> matches;
+    matches.reserve(rows.size());
+
+    for (unsigned i = 0; i < rows.size(); i++) {
+        const auto& row = rows[i];
+        if (!row.contains(testCol)) {
+            throw std::runtime_error("Manifest row " + std::to_string(i + 1) + " is missing column '" + testCol + "'");
+        }
+        const auto testPath = resolve(baseDir, row.at(testCol));
+
+        fs::path refPath;
+        if (row.contains(refCol)) {
+            refPath = resolve(baseDir, row.at(refCol));
+        } else if (!args.refPath.empty()) {
+            // shared reference for whole manifest
+            refPath = args.refPath;
+        } else {
+            throw std::runtime_error("Manifest row " + std::to_string(i + 1) + " is missing column '" + refCol + "'");
+        }
+
+        std::optional<std::string> outPath;
+        if (row.contains(outCol) && !row.at(outCol).empty()) {
+            const auto outDir = args.outputPath.has_value() ? fs::path(args.outputPath.value()) : baseDir;
+            outPath = resolve(outDir, row.at(outCol)).string();
+        } else {
+            outPath = outputFor(args, testPath);
+        }
+
+        std::optional<std::string> dirty;
+        if (row.contains(dirtyCol) && !row.at(dirtyCol).empty()) {
+            dirty = row.at(dirtyCol);
+        }
+
+        matches.push_back(Match{.testPath = testPath.string(), .refPath = refPath.string(), .outPath = outPath, .dirty = dirty});
+    }
+
+    if (matches.empty()) {
+        throw std::runtime_error("Manifest '" + args.inputPath + "' is empty");
+    }
+
+    requireDistinctOutputs(matches);
+    return matches;
+}
+
+static std::vector<std::string> splitCsvLine(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+
+    for (unsigned i = 0; i < line.size(); i++) {
+        const char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                field += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else if (c != '\r') {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+
+    return fields;
+}
+
+std::vector<std::unordered_map<std::string, std::string>> IQM::Bin::FileMatcher::parseCsv(std::ifstream &file) {
+    std::vector<std::unordered_map<std::string, std::string>> rows;
+
+    std::string line;
+    if (!std::getline(file, line)) {
+        return rows;
+    }
+    const auto header = splitCsvLine(line);
+
+    while (std::getline(file, line)) {
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+
+        const auto fields = splitCsvLine(line);
+        std::unordered_map<std::string, std::string> row;
+        for (unsigned i = 0; i < std::min(header.size(), fields.size()); i++) {
+            row.emplace(header[i], fields[i]);
+        }
+        rows.push_back(std::move(row));
+    }
+
+    return rows;
+}
+
+static std::string parseJsonString(const std::string& line, unsigned& pos) {
+    // expects pos at opening quote
+    std::string value;
+    pos++;
+    while (pos < line.size() && line[pos] != '"') {
+        if (line[pos] == '\\' && pos + 1 < line.size()) {
+            pos++;
+            switch (line[pos]) {
+                case 'n': value += '\n'; break;
+                case 't': value += '\t'; break;
+                case 'r': value += '\r'; break;
+                default: value += line[pos]; break;
+            }
+        } else {
+            value += line[pos];
+        }
+        pos++;
+    }
+    if (pos >= line.size()) {
+        throw std::runtime_error("unterminated string");
+    }
+    pos++;
+    return value;
+}
+
+std::unordered_map<std::string, std::string> IQM::Bin::FileMatcher::parseJsonObject(const std::string &line) {
+    // only flat objects with string or scalar values are supported, that's all a manifest or a request needs
+    unsigned pos = 0;
+    const auto skipWs = [&] {
+        while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos]))) {
+            pos++;
+        }
+    };
+
+    skipWs();
+    if (pos >= line.size() || line[pos] != '{') {
+        throw std::runtime_error("not a JSON object");
+    }
+    pos++;
+
+    std::unordered_map<std::string, std::string> row;
+    while (true) {
+        skipWs();
+        if (pos < line.size() && line[pos] == '}') {
+            break;
+        }
+        if (pos >= line.size() || line[pos] != '"') {
+            throw std::runtime_error("malformed JSON");
+        }
+        auto key = parseJsonString(line, pos);
+
+        skipWs();
+        if (pos >= line.size() || line[pos] != ':') {
+            throw std::runtime_error("malformed JSON");
+        }
+        pos++;
+        skipWs();
+
+        std::string value;
+        if (pos < line.size() && line[pos] == '"') {
+            value = parseJsonString(line, pos);
+        } else {
+            const auto end = line.find_first_of(",}", pos);
+            if (end == std::string::npos) {
+                throw std::runtime_error("malformed JSON");
+            }
+            value = line.substr(pos, end - pos);
+            while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+                value.pop_back();
+            }
+            pos = end;
+        }
+        row.emplace(std::move(key), std::move(value));
+
+        skipWs();
+        if (pos < line.size() && line[pos] == ',') {
+            pos++;
+        }
+    }
+
+    return row;
+}
+
+std::vector<std::unordered_map<std::string, std::string>> IQM::Bin::FileMatcher::parseJsonLines(std::ifstream &file) {
+    std::vector<std::unordered_map<std::string, std::string>> rows;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (std::ranges::all_of(line, [](const unsigned char c) { return std::isspace(c); })) {
+            continue;
+        }
+
+        try {
+            rows.push_back(parseJsonObject(line));
+        } catch (const std::exception &e) {
+            throw std::runtime_error("Manifest line " + std::to_string(rows.size() + 1) + ": " + e.what());
+        }
+    }
+
+    return rows;
 }
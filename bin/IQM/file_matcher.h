@@ -9,12 +9,36 @@
 #include "args.h"
 #include "../shared/io.h"
 
+#include <filesystem>
+#include <unordered_map>
 #include <vector>
 
 namespace IQM::Bin {
+    enum class PairBy {
+        Stem,
+        Name,
+    };
+
+    /**
+     * Expands `--input` and `--ref` into list of image pairs.
+     *
+     * Both arguments can be a single file, a directory or a glob pattern (wildcards only in file name).
+     * Files are paired by file stem (or full file name with `--pair-by name`),
+     * single reference file is paired with every tested image.
+     * `--input` can also be a CSV or JSONL manifest with explicit columns for each pair.
+     */
     class FileMatcher {
     public:
         std::vector<Match> match(const Args& args);
+        static bool isManifest(const std::string& path);
+        static std::unordered_map<std::string, std::string> parseJsonObject(const std::string& line);
+    private:
+        static std::vector<std::filesystem::path> expand(const std::string& path);
+        static bool isPattern(const std::string& path);
+        static std::string pairKey(const std::filesystem::path& path, PairBy pairBy);
+        static std::vector<Match> matchManifest(const Args& args);
+        static std::vector<std::unordered_map<std::string, std::string>> parseCsv(std::ifstream& file);
+        static std::vector<std::unordered_map<std::string, std::string>> parseJsonLines(std::ifstream& file);
     };
 }
 
@@ -12,44 +12,49 @@
 
 #include "args.h"
 #include "file_matcher.h"
+#include "server.h"
 #include "vulkan_instance.h"
-
-#if COMPILE_SSIM
-#include "../shared/wrappers/ssim.h"
-#endif
-
-#if COMPILE_SVD
-#include "../shared/wrappers/svd.h"
-#endif
-
-#if COMPILE_FSIM
-#include "../shared/wrappers/fsim.h"
-#endif
-
-#if COMPILE_FLIP
-#include "../shared/wrappers/flip.h"
-#endif
-
-#if COMPILE_PSNR
-#include "../shared/wrappers/psnr.h"
-#endif
-
-#if COMPILE_LPIPS
-#include "../shared/wrappers/lpips.h"
-#endif
+#include "../shared/wrappers/multi.h"
 
 void printHelp() {
     std::cout << "IQM - Application for computing image quality metrics.\n"
-    << "Usage: IQM --method METHOD --input INPUT --ref REF [--output OUTPUT]\n\n"
+    << "Usage: IQM --method METHOD --input INPUT --ref REF [--output OUTPUT]\n"
+    << "       IQM --method METHOD --serve PATH [--output ROOT]\n\n"
     << "Arguments:\n"
-    << "    --method <METHOD> : selects method to compute, one of SSIM, FSIM, FLIP, PSNR, LPIPS\n"
-    << "    --input <INPUT>   : path to tested image\n"
-    << "    --ref <REF>       : path to reference image\n"
-    << "    --output <OUTPUT> : path to output image, optional\n\n"
+    << "    --method <METHOD> : selects method to compute, one of SSIM, MS_SSIM, FSIM, FLIP, PSNR, LPIPS\n"
+    << "                        or comma separated list of them, e.g. SSIM,PSNR,FLIP\n"
+    << "    --input <INPUT>   : path to tested image, directory, glob pattern or CSV/JSONL manifest\n"
+    << "    --ref <REF>       : path to reference image, directory or glob pattern, optional with manifest\n"
+    << "    --output <OUTPUT> : path to output image, optional; output directory in batch mode\n"
+    << "    --serve <PATH>    : serve compare requests on unix socket, or JSON lines on stdin/stdout with `-`,\n"
+    << "                        request outputs must be inside --output directory\n\n"
     << "    -v, --verbose     : enables more detailed output\n"
     << "    -c, --colorize    : colorize final output\n"
+    << "    --roi <RECTS>     : compute final values only over rectangles `x,y,w,h` separated by `;`\n"
+    << "    --mask <IMAGE>    : weight final values by red channel of an image of the same size\n"
+    << "    --grid <FORMAT>   : save scores of 64x64 cells as `csv` or `npy` instead of the output image\n"
+    << "    --threshold <LIM> : print PASS or FAIL against a limit, `VALUE` for one method or `NAME=VALUE,...`,\n"
+    << "                        exits with 1 if any image fails\n"
+    << "    --no-pipeline-cache : don't load or save compiled pipelines in $XDG_CACHE_HOME/IQM\n"
     << "    -h, --help        : prints help\n\n"
+    << "Batch arguments:\n"
+    << "    --pair-by <MODE>        : pair images by `stem` (default) or full file `name`\n"
+    << "    --manifest-test <COL>   : manifest column with tested image, default `test`\n"
+    << "    --manifest-ref <COL>    : manifest column with reference image, default `ref`\n"
+    << "    --manifest-out <COL>    : manifest column with output image, default `out`\n"
+    << "    --manifest-dirty <COL>  : manifest column with rectangles changed since the previous row, default `dirty`\n"
+    << "    --incremental           : SSIM, PSNR and FLIP only recompute cells that changed since the previous pair,\n"
+    << "                              pairs are computed one at a time, --inflight is ignored\n"
+    << "    --vram-budget <MB>      : VRAM for all resources of the batch, default 90% of the device budget\n"
+    << "    --pool-vram <MB>        : VRAM cap for resources cached between images of same size, default 2048 or half of the budget\n"
+    << "    --inflight <N>          : number of image pairs processed on GPU at once, default 2\n"
+    << "    --decode-threads <N>    : number of threads decoding images ahead of GPU, default up to 4\n"
+    << "    --tile-vram <MB>        : compute SSIM, PSNR and FLIP in tiles fitting into given VRAM\n"
+    << "    --preview <LEVEL>       : compute a single method on mip level LEVEL of the inputs, with a calibrated error band\n"
+    << "    --preview-refine <N>    : also compute every Nth pair at full resolution to calibrate the band\n\n"
     << "Method specific arguments:\n"
+    << "SSIM:\n"
+    << "    --ssim-precision <PREC> : `fp32` (default) or `fp16` storage of the output map\n"
     << "PSNR:\n"
     << "    --psnr-variant <VAR> : One of `rgb`, `luma` or `yuv`\n"
     << "FLIP:\n"
@@ -75,70 +80,43 @@ int main(const int argc, const char **argv) {
         return 0;
     }
 
+    // stdout carries responses when serving on stdin/stdout
+    std::ostream &log = args->servePath == "-" ? std::cerr : std::cout;
+
     if (args->verbose) {
-        std::cout << "Selected method: " << IQM::method_name(args->method) << std::endl;
+        log << "Selected method: ";
+        for (unsigned i = 0; i < args->methods.size(); i++) {
+            log << (i != 0 ? ", " : "") << IQM::method_name(args->methods[i]);
+        }
+        log << std::endl;
     }
 
-    IQM::Bin::FileMatcher matcher;
-    const auto matches = matcher.match(args.value());
+    std::vector<IQM::Bin::Match> matches;
+    if (!args->servePath.has_value()) {
+        IQM::Bin::FileMatcher matcher;
+        matches = matcher.match(args.value());
+    }
 
-    const IQM::Bin::VulkanInstance vulkan;
+    const IQM::Bin::VulkanInstance vulkan(args->pipelineCache);
 
     if (args->verbose) {
-        std::cout << "Selected device: "<< vulkan.selectedDevice << std::endl;
+        log << "Selected device: "<< vulkan.selectedDevice << std::endl;
+        if (vulkan.pipelineCacheFile.has_value() && !vulkan.pipelineCacheFile->path.empty()) {
+            log << "Pipeline cache: " << vulkan.pipelineCacheFile->path.string() << " (" << vulkan.pipelineCacheFile->loadedSize / 1024 << " KB loaded)" << std::endl;
+        }
     }
 
     try {
-        switch (args->method) {
-            case IQM::Method::SSIM:
-#ifdef COMPILE_SSIM
-                IQM::Bin::ssim_run(args.value(), vulkan, matches);
-#else
-                throw std::runtime_error("SSIM support is not compiled");
-#endif
-                break;
-            case IQM::Method::CW_SSIM_CPU:
-                throw std::runtime_error("CW-SSIM is not implemented");
-            case IQM::Method::SVD:
-#ifdef COMPILE_SVD
-                IQM::Bin::svd_run(args.value(), vulkan, matches);
-#else
-                throw std::runtime_error("M-SVD support is not compiled");
-#endif
-                break;
-            case IQM::Method::FSIM:
-#ifdef COMPILE_FSIM
-                fsim_run(args.value(), vulkan, matches);
-#else
-                throw std::runtime_error("FSIM support is not compiled");
-#endif
-                break;
-            case IQM::Method::FLIP:
-#ifdef COMPILE_FLIP
-                flip_run(args.value(), vulkan, matches);
-#else
-                throw std::runtime_error("FLIP support is not compiled");
-#endif
-                break;
-            case IQM::Method::PSNR:
-#ifdef COMPILE_PSNR
-                psnr_run(args.value(), vulkan, matches);
-#else
-                throw std::runtime_error("PSNR support is not compiled");
-#endif
-            break;
-            case IQM::Method::LPIPS:
-#ifdef COMPILE_LPIPS
-                lpips_run(args.value(), vulkan, matches);
-#else
-                throw std::runtime_error("LPIPS support is not compiled");
-#endif
-            break;
+        if (args->servePath.has_value()) {
+            IQM::Bin::Server server(args.value(), vulkan);
+            server.serve(args->servePath.value());
+            return 0;
         }
+
+        // single methods go through the same factory, so their pipelines are shared by all slots as well
+        return IQM::Bin::multi_run(args.value(), vulkan, matches) ? 0 : 1;
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return -1;
     }
-
-    return 0;
 }
@@ -0,0 +1,22 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "output_root.h"
+
+#include <algorithm>
+
+std::filesystem::path IQM::Bin::output_root(const std::string &path) {
+    auto root = std::filesystem::weakly_canonical(path);
+    // trailing separator leaves an empty last element
+    if (!root.has_filename()) {
+        root = root.parent_path();
+    }
+    return root;
+}
+
+bool IQM::Bin::inside_output_root(const std::filesystem::path &root, const std::string &path) {
+    const auto resolved = std::filesystem::weakly_canonical(path);
+    return std::mismatch(root.begin(), root.end(), resolved.begin(), resolved.end()).first == root.end();
+}
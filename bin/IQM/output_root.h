@@ -0,0 +1,19 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_OUTPUT_ROOT_H
+#define IQM_BIN_OUTPUT_ROOT_H
+
+#include <filesystem>
+#include <string>
+
+namespace IQM::Bin {
+    // canonical `--output` directory of the server, which request outputs must stay under
+    std::filesystem::path output_root(const std::string &path);
+    // `..` and symlinks of existing parents are resolved first, so they can't lead outside of the root
+    bool inside_output_root(const std::filesystem::path &root, const std::string &path);
+}
+
+#endif //IQM_BIN_OUTPUT_ROOT_H
@@ -0,0 +1,106 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "pipeline_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+std::optional<std::filesystem::path> IQM::Bin::cache_directory() {
+    if (const char *cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome != nullptr && cacheHome[0] != '\0') {
+        return std::filesystem::path(cacheHome) / "IQM";
+    }
+    if (const char *home = std::getenv("HOME"); home != nullptr && home[0] != '\0') {
+        return std::filesystem::path(home) / ".cache" / "IQM";
+    }
+    return std::nullopt;
+}
+
+bool IQM::Bin::pipeline_cache_header_matches(const std::vector<char> &data, const vk::PhysicalDeviceProperties &properties) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == properties.vendorID
+        && header.deviceID == properties.deviceID
+        && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+IQM::Bin::PipelineCacheFile::PipelineCacheFile(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice) {
+    const auto properties = physicalDevice.getProperties();
+
+    std::vector<char> data;
+    if (const auto directory = cache_directory(); directory.has_value()) {
+        std::ostringstream name;
+        name << "pipelines-v" << PIPELINE_CACHE_VERSION << "-";
+        for (const auto byte : properties.pipelineCacheUUID) {
+            name << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned>(byte);
+        }
+        name << ".bin";
+        this->path = directory.value() / name.str();
+
+        std::ifstream file(this->path, std::ios::binary);
+        if (file.good()) {
+            data.assign(std::istreambuf_iterator(file), std::istreambuf_iterator<char>());
+        }
+
+        // drivers are not required to reject foreign data gracefully
+        if (!pipeline_cache_header_matches(data, properties)) {
+            data.clear();
+        }
+    }
+
+    this->cache = vk::raii::PipelineCache{device, vk::PipelineCacheCreateInfo{
+        .initialDataSize = data.size(),
+        .pInitialData = data.data(),
+    }};
+    this->loadedSize = data.size();
+    this->savedSize = data.size();
+}
+
+void IQM::Bin::PipelineCacheFile::save() const {
+    if (this->path.empty()) {
+        return;
+    }
+
+    const auto data = this->cache.getData();
+    if (data.size() == this->savedSize) {
+        return;
+    }
+
+    // cache only speeds up the next start, so failing to write it is not an error
+    std::error_code error;
+    std::filesystem::create_directories(this->path.parent_path(), error);
+    if (error) {
+        return;
+    }
+
+    // concurrent processes each write their own file and then atomically replace the cache
+    auto tmpPath = this->path;
+    tmpPath += ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file.good()) {
+            file.close();
+            std::filesystem::remove(tmpPath, error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, this->path, error);
+    if (error) {
+        std::filesystem::remove(tmpPath, error);
+        return;
+    }
+    this->savedSize = data.size();
+}
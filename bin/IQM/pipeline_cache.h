@@ -0,0 +1,41 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_PIPELINE_CACHE_H
+#define IQM_BIN_PIPELINE_CACHE_H
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace IQM::Bin {
+    // bump when pipelines stop being compatible with older cache files
+    constexpr unsigned PIPELINE_CACHE_VERSION = 1;
+
+    /**
+     * VkPipelineCache persisted in `$XDG_CACHE_HOME/IQM`, one file per driver build, keyed by its pipeline cache UUID.
+     * Data written by a different driver or device is discarded and the cache starts empty.
+     */
+    class PipelineCacheFile {
+    public:
+        PipelineCacheFile(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice);
+        // writes the cache back, if pipelines were added since it was loaded or last saved
+        void save() const;
+
+        vk::raii::PipelineCache cache = VK_NULL_HANDLE;
+        // empty if there is no cache directory
+        std::filesystem::path path;
+        size_t loadedSize = 0;
+    private:
+        mutable size_t savedSize = 0;
+    };
+
+    std::optional<std::filesystem::path> cache_directory();
+    // whether cache data starts with a header written by the driver and device of `properties`
+    bool pipeline_cache_header_matches(const std::vector<char> &data, const vk::PhysicalDeviceProperties &properties);
+}
+
+#endif //IQM_BIN_PIPELINE_CACHE_H
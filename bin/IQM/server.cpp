@@ -0,0 +1,403 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "server.h"
+#include "file_matcher.h"
+#include "output_root.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+// socket removed by the signal handler, kept in static storage since the handler can't allocate
+static char served_socket[sizeof(sockaddr_un::sun_path)] = {};
+
+static void unlink_served_socket(const int sig) {
+    unlink(served_socket);
+    // default action then terminates the process as usual
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
+static std::string json_string(const std::string &value) {
+    std::string out = "\"";
+    for (const char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+static std::string json_number(const float value) {
+    // JSON has no infinity, PSNR of identical images is reported as null
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+
+    std::ostringstream out;
+    out << std::setprecision(std::numeric_limits<float>::max_digits10) << value;
+    return out.str();
+}
+
+IQM::Bin::Server::Client::Client(const int inFd, const int outFd, const bool owned) : inFd(inFd), outFd(outFd), owned(owned) {}
+
+IQM::Bin::Server::Client::~Client() {
+    if (this->owned) {
+        close(this->inFd);
+    }
+}
+
+void IQM::Bin::Server::Client::send(const std::string &line) {
+    std::lock_guard lock(this->mutex);
+    if (this->broken) {
+        return;
+    }
+
+    const auto data = line + "\n";
+    size_t written = 0;
+    while (written < data.size()) {
+        const auto count = write(this->outFd, data.data() + written, data.size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            // client went away, rest of its results is dropped
+            this->broken = true;
+            return;
+        }
+        written += count;
+    }
+}
+
+IQM::Bin::Server::Server(const Args &args, const VulkanInstance &instance) :
+    args(args),
+    instance(instance),
+    factory(args, instance),
+    executor(args, instance) {
+    if (args.outputPath.has_value()) {
+        this->outputRoot = output_root(args.outputPath.value());
+    }
+}
+
+void IQM::Bin::Server::serve(const std::string &path) {
+    // writes to disconnected clients must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::thread gpu(&Server::work, this);
+
+    std::exception_ptr error;
+    try {
+        if (path == "-") {
+            this->readClient(std::make_shared<Client>(STDIN_FILENO, STDOUT_FILENO, false));
+        } else {
+            this->listenSocket(path);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    {
+        std::unique_lock lock(this->mutex);
+        this->stopping = true;
+        // unblock reads of still connected clients
+        for (const auto &weak : this->clients) {
+            if (const auto client = weak.lock()) {
+                shutdown(client->inFd, SHUT_RDWR);
+            }
+        }
+        this->condition.notify_all();
+        this->condition.wait(lock, [this] { return this->readers == 0; });
+    }
+    // already accepted requests are still finished
+    gpu.join();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void IQM::Bin::Server::listenSocket(const std::string &path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path '" + path + "' is too long");
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+    }
+
+    // socket left behind by a previous run, any other file is kept and bind fails instead
+    struct stat info{};
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        const std::string reason = std::strerror(errno);
+        close(fd);
+        throw std::runtime_error("Failed to listen on '" + path + "': " + reason);
+    }
+
+    std::memcpy(served_socket, path.c_str(), path.size() + 1);
+    std::signal(SIGINT, unlink_served_socket);
+    std::signal(SIGTERM, unlink_served_socket);
+
+    if (this->args.verbose) {
+        std::cerr << "Listening on " << path << std::endl;
+    }
+
+    while (true) {
+        const int connection = accept(fd, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            const std::string reason = std::strerror(errno);
+            close(fd);
+            unlink(path.c_str());
+            throw std::runtime_error("Failed to accept connection: " + reason);
+        }
+
+        auto client = std::make_shared<Client>(connection, connection, true);
+        {
+            std::lock_guard lock(this->mutex);
+            std::erase_if(this->clients, [](const auto &weak) { return weak.expired(); });
+            this->clients.push_back(client);
+            this->readers++;
+        }
+
+        std::thread([this, client] {
+            this->readClient(client);
+
+            std::lock_guard lock(this->mutex);
+            this->readers--;
+            this->condition.notify_all();
+        }).detach();
+    }
+}
+
+void IQM::Bin::Server::readClient(const std::shared_ptr<Client> &client) {
+    std::string buffer;
+    char chunk[4096];
+
+    while (true) {
+        const auto count = read(client->inFd, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+
+        buffer.append(chunk, count);
+        size_t end;
+        while ((end = buffer.find('\n')) != std::string::npos) {
+            auto line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            this->handleRequest(client, line);
+        }
+    }
+
+    // last request doesn't need a trailing newline
+    this->handleRequest(client, buffer);
+}
+
+void IQM::Bin::Server::handleRequest(const std::shared_ptr<Client> &client, const std::string &line) {
+    if (std::ranges::all_of(line, [](const unsigned char c) { return std::isspace(c); })) {
+        return;
+    }
+
+    std::string id;
+    try {
+        const auto fields = FileMatcher::parseJsonObject(line);
+        if (fields.contains("id")) {
+            id = fields.at("id");
+        }
+        if (!fields.contains("input")) {
+            throw std::runtime_error("missing input");
+        }
+
+        // request only replaces paths, method and its options are given by the server
+        Args requestArgs = this->args;
+        requestArgs.inputPath = fields.at("input");
+        requestArgs.refPath = fields.contains("ref") ? fields.at("ref") : "";
+        requestArgs.outputPath = std::nullopt;
+        if (fields.contains("output")) {
+            if (!this->outputRoot.has_value()) {
+                throw std::runtime_error("outputs are disabled, server has no --output directory");
+            }
+            // checked before matching, so nothing is derived from an output outside of the root
+            const std::filesystem::path output(fields.at("output"));
+            if (output.is_absolute() || std::find(output.begin(), output.end(), "..") != output.end()) {
+                throw std::runtime_error("output '" + fields.at("output") + "' must be relative to the output directory without '..'");
+            }
+            requestArgs.outputPath = (this->outputRoot.value() / output).string();
+            if (!this->insideOutputRoot(requestArgs.outputPath.value())) {
+                throw std::runtime_error("output '" + fields.at("output") + "' is outside of the output directory");
+            }
+        }
+        if (!fields.contains("ref") && !FileMatcher::isManifest(requestArgs.inputPath)) {
+            throw std::runtime_error("missing reference");
+        }
+
+        FileMatcher matcher;
+        auto request = std::make_shared<Request>(Request{
+            .client = client,
+            .id = id,
+            .matches = matcher.match(requestArgs),
+        });
+        // manifests can name outputs of their own, matching has no side effects, so they are checked afterwards
+        for (const auto &match : request->matches) {
+            if (match.outPath.has_value() && !this->insideOutputRoot(match.outPath.value())) {
+                throw std::runtime_error("output '" + match.outPath.value() + "' is outside of the output directory");
+            }
+        }
+        // changed rectangles of a single pair, manifests carry them per row
+        if (fields.contains("dirty") && request->matches.size() == 1) {
+            request->matches[0].dirty = fields.at("dirty");
+        }
+
+        {
+            std::lock_guard lock(this->mutex);
+            this->pending.push_back(std::move(request));
+        }
+        this->condition.notify_all();
+    } catch (const std::exception &e) {
+        client->send("{\"id\":" + json_string(id) + ",\"error\":" + json_string(e.what()) + ",\"done\":true}");
+    }
+}
+
+bool IQM::Bin::Server::insideOutputRoot(const std::string &path) const {
+    return this->outputRoot.has_value() && inside_output_root(this->outputRoot.value(), path);
+}
+
+void IQM::Bin::Server::work() {
+    std::vector<Match> matches;
+    // request of each match
+    std::vector<Request*> owners;
+    // with the score grid, outputs are saved under its extension
+    const auto gridFormat = score_grid_format(this->args.options);
+    const auto outputPath = [&](const std::string &path) {
+        return gridFormat.has_value() ? score_grid_path(path, gridFormat.value()) : path;
+    };
+
+    this->executor.onResult = [&](const unsigned index, const DecodedPair &pair, const std::vector<MetricValue> &values, const bool partial) {
+        auto *request = owners[index];
+        // preview of a refined pair, its final line follows
+        if (!partial) {
+            request->processed++;
+        }
+
+        auto line = "{\"id\":" + json_string(request->id) + ",\"input\":" + json_string(pair.match.testPath) + ",\"ref\":" + json_string(pair.match.refPath);
+        if (pair.match.outPath.has_value()) {
+            if (this->args.methods.size() == 1) {
+                line += ",\"output\":" + json_string(outputPath(pair.match.outPath.value()));
+            } else {
+                for (const auto method : this->args.methods) {
+                    line += ",\"output_" + std::string(method_name(method)) + "\":" + json_string(outputPath(multi_output_path(pair.match.outPath, method).value()));
+                }
+            }
+        }
+        // values decided from bounds or skipped in threshold mode are null
+        std::optional<bool> passed;
+        for (const auto &value : values) {
+            line += "," + json_string(value.name) + ":" + json_number(value.value);
+            // uncalibrated band is null
+            if (value.band.has_value()) {
+                line += "," + json_string(value.name + "_band") + ":" + json_number(value.band.value());
+            }
+            if (value.pass.has_value()) {
+                line += "," + json_string(value.name + "_pass") + ":" + (value.pass.value() ? "true" : "false");
+                passed = passed.value_or(true) && value.pass.value();
+            }
+        }
+        if (passed.has_value()) {
+            line += std::string(",\"pass\":") + (passed.value() ? "true" : "false");
+        }
+        if (partial) {
+            line += ",\"partial\":true";
+        }
+        line += "}";
+
+        request->client->send(line);
+    };
+
+    this->executor.onError = [&](const unsigned index, const std::string &error) {
+        auto *request = owners[index];
+        request->client->send("{\"id\":" + json_string(request->id) + ",\"input\":" + json_string(matches[index].testPath) + ",\"error\":" + json_string(error) + "}");
+    };
+
+    while (true) {
+        std::vector<std::shared_ptr<Request>> requests;
+        {
+            std::unique_lock lock(this->mutex);
+            this->condition.wait(lock, [this] { return this->stopping || !this->pending.empty(); });
+            if (this->pending.empty()) {
+                return;
+            }
+            requests.assign(this->pending.begin(), this->pending.end());
+            this->pending.clear();
+        }
+
+        // all pending requests are computed in one run, so their pairs overlap on GPU
+        matches.clear();
+        owners.clear();
+        for (const auto &request : requests) {
+            for (const auto &match : request->matches) {
+                matches.push_back(match);
+                owners.push_back(request.get());
+            }
+        }
+
+        try {
+            this->executor.run(matches, [this] { return this->factory.create(); });
+        } catch (const std::exception &e) {
+            // part of the work could have been submitted
+            this->instance.device()->waitIdle();
+            for (const auto &request : requests) {
+                request->client->send("{\"id\":" + json_string(request->id) + ",\"error\":" + json_string(e.what()) + "}");
+            }
+        }
+
+        for (const auto &request : requests) {
+            request->client->send("{\"id\":" + json_string(request->id) + ",\"done\":true,\"processed\":" + std::to_string(request->processed) + ",\"total\":" + std::to_string(request->matches.size()) + "}");
+        }
+
+        if (this->args.verbose) {
+            std::cerr << "Computed " << matches.size() << " pairs of " << requests.size() << " requests" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_SERVER_H
+#define IQM_BIN_SERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "args.h"
+#include "../shared/executor.h"
+#include "../shared/wrappers/multi.h"
+
+namespace IQM::Bin {
+    /**
+     * Long-lived compare service, keeps Vulkan instance, method pipelines, LPIPS weights and resource pools warm.
+     *
+     * Requests are JSON lines, e.g. `{"id": "1", "input": "test.png", "ref": "ref.png", "output": "map.png"}`,
+     * `input`, `ref` and `output` accept everything their command line counterparts do.
+     * A line with metric values (or an `error`) is streamed back for each pair as soon as it's done,
+     * followed by `{"id": "1", "done": true, ...}` once the whole request is finished.
+     *
+     * Clients are read concurrently, all pending requests are then computed together on a single GPU thread.
+     *
+     * Outputs are only written under the `--output` directory of the server, relative request outputs
+     * are resolved against it and requests with outputs elsewhere are rejected. Without it, outputs are disabled.
+     */
+    class Server {
+    public:
+        Server(const Args& args, const IQM::VulkanInstance& instance);
+        // serves on stdin/stdout if path is `-`, until stdin is closed, otherwise on unix socket at path
+        void serve(const std::string& path);
+    private:
+        struct Client {
+            Client(int inFd, int outFd, bool owned);
+            ~Client();
+            void send(const std::string& line);
+
+            int inFd;
+            int outFd;
+            // socket is closed with the client, stdin/stdout are not
+            bool owned;
+            bool broken = false;
+            std::mutex mutex;
+        };
+
+        struct Request {
+            std::shared_ptr<Client> client;
+            std::string id;
+            std::vector<Match> matches;
+            unsigned processed = 0;
+        };
+
+        void listenSocket(const std::string& path);
+        void readClient(const std::shared_ptr<Client>& client);
+        void handleRequest(const std::shared_ptr<Client>& client, const std::string& line);
+        void work();
+        [[nodiscard]] bool insideOutputRoot(const std::string& path) const;
+
+        const Args& args;
+        const IQM::VulkanInstance& instance;
+        std::optional<std::filesystem::path> outputRoot;
+        // factory owns pools used by jobs of the executor, so it must be destroyed last
+        JobFactory factory;
+        BatchExecutor executor;
+
+        std::deque<std::shared_ptr<Request>> pending;
+        std::vector<std::weak_ptr<Client>> clients;
+        unsigned readers = 0;
+        bool stopping = false;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+}
+
+#endif //IQM_BIN_SERVER_H
@@ -4,8 +4,9 @@
  */
 
 #include "vulkan_instance.h"
+#include "../shared/vulkan_res.h"
 
-IQM::Bin::VulkanInstance::VulkanInstance() {
+IQM::Bin::VulkanInstance::VulkanInstance(const bool usePipelineCache) {
     this->context = vk::raii::Context{};
 
     vk::ApplicationInfo appInfo{
@@ -33,6 +34,21 @@ IQM::Bin::VulkanInstance::VulkanInstance() {
     this->instance = vk::raii::Instance{this->context, instanceCreateInfo};
 
     this->initQueues();
+    VulkanResource::useHeap(&this->memoryHeap);
+
+    if (usePipelineCache) {
+        this->pipelineCacheFile.emplace(this->_device, this->_physicalDevice);
+    }
+}
+
+IQM::Bin::VulkanInstance::~VulkanInstance() {
+    VulkanResource::useHeap(nullptr);
+}
+
+void IQM::Bin::VulkanInstance::savePipelineCache() const {
+    if (this->pipelineCacheFile.has_value()) {
+        this->pipelineCacheFile->save();
+    }
 }
 
 void IQM::Bin::VulkanInstance::waitForFence(const vk::raii::Fence &fence) const {
@@ -109,11 +125,18 @@ void IQM::Bin::VulkanInstance::initQueues() {
 
     std::vector<char*> deviceExtensions = {};
 
+    // R f16 maps of `--ssim-precision fp16` are written as storage images, without the feature SSIM falls back to f32
+    this->halfStorage = this->_physicalDevice.getFeatures().shaderStorageImageExtendedFormats;
+    const vk::PhysicalDeviceFeatures features{
+        .shaderStorageImageExtendedFormats = this->halfStorage,
+    };
+
     const vk::DeviceCreateInfo deviceCreateInfo{
         .queueCreateInfoCount = static_cast<uint32_t>(queues.size()),
         .pQueueCreateInfos = queues.data(),
         .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
         .ppEnabledExtensionNames = deviceExtensions.data(),
+        .pEnabledFeatures = &features,
     };
 
     this->_device = vk::raii::Device{this->_physicalDevice, deviceCreateInfo};
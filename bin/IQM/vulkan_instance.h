@@ -10,14 +10,17 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_raii.hpp>
 
+#include "../shared/device_memory.h"
 #include "../shared/vulkan.h"
+#include "pipeline_cache.h"
 
 namespace IQM::Bin {
     const std::string LAYER_VALIDATION = "VK_LAYER_KHRONOS_validation";
 
     class VulkanInstance : public IQM::VulkanInstance {
     public:
-        VulkanInstance();
+        explicit VulkanInstance(bool usePipelineCache);
+        ~VulkanInstance() override;
 
         std::string selectedDevice;
 
@@ -25,14 +28,18 @@ namespace IQM::Bin {
         vk::raii::Instance instance = VK_NULL_HANDLE;
         vk::raii::PhysicalDevice _physicalDevice = VK_NULL_HANDLE;
         vk::raii::Device _device = VK_NULL_HANDLE;
+        // declared after the device, so it's destroyed before it
+        DeviceMemoryHeap memoryHeap;
         std::shared_ptr<vk::raii::Queue> _queue = VK_NULL_HANDLE;
         uint32_t queueFamilyIndex;
         std::shared_ptr<vk::raii::Queue> transferQueue = VK_NULL_HANDLE;
         uint32_t transferQueueFamilyIndex;
+        bool halfStorage = false;
         std::shared_ptr<vk::raii::CommandPool> commandPool = VK_NULL_HANDLE;
         std::shared_ptr<vk::raii::CommandPool> commandPoolTransfer = VK_NULL_HANDLE;
         std::shared_ptr<vk::raii::CommandBuffer> cmd_buffer = VK_NULL_HANDLE;
         std::shared_ptr<vk::raii::CommandBuffer> cmd_bufferTransfer = VK_NULL_HANDLE;
+        std::optional<PipelineCacheFile> pipelineCacheFile;
 
         const vk::raii::Device* device() const override {return &_device;}
         const vk::raii::PhysicalDevice* physicalDevice() const override {return &_physicalDevice;}
@@ -41,6 +48,11 @@ namespace IQM::Bin {
         const std::shared_ptr<const vk::raii::CommandBuffer> cmdBufTransfer() const override {return cmd_bufferTransfer;}
         const std::shared_ptr<const vk::raii::Queue> queue() const override {return _queue;}
         const std::shared_ptr<const vk::raii::Queue> queueTransfer() const override {return transferQueue;}
+        uint32_t queueFamily() const override {return queueFamilyIndex;}
+        uint32_t queueFamilyTransfer() const override {return transferQueueFamilyIndex;}
+        bool halfStorageImages() const override {return halfStorage;}
+        const vk::raii::PipelineCache* pipelineCache() const override {return pipelineCacheFile.has_value() ? &pipelineCacheFile->cache : nullptr;}
+        void savePipelineCache() const override;
 
         void waitForFence(const vk::raii::Fence &fence) const override;
     private:
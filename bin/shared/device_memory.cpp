@@ -0,0 +1,289 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "device_memory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <ranges>
+
+static vk::DeviceSize align_up(const vk::DeviceSize value, const vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// called under the lock of the owner, counters are atomic only so they can be read without it
+static void add_used(std::atomic<unsigned long> &used, std::atomic<unsigned long> &peak, const vk::DeviceSize size) {
+    used += size;
+    peak = std::max(peak.load(), used.load());
+}
+
+static std::shared_ptr<IQM::Bin::MemoryBlock> allocate_block(const vk::raii::Device &device, const vk::DeviceSize size, const uint32_t memoryType) {
+    auto block = std::make_shared<IQM::Bin::MemoryBlock>();
+    block->memory = vk::raii::DeviceMemory{device, vk::MemoryAllocateInfo{
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType,
+    }};
+    block->size = size;
+    return block;
+}
+
+IQM::Bin::DeviceAllocation::DeviceAllocation(std::shared_ptr<MemoryBlock> block, const vk::DeviceSize offset, const vk::DeviceSize size) :
+    block(std::move(block)),
+    blockOffset(offset),
+    allocationSize(size) {}
+
+IQM::Bin::DeviceAllocation IQM::Bin::DeviceAllocation::dedicated(vk::raii::DeviceMemory memory, const vk::DeviceSize size, const bool coherent) {
+    auto block = std::make_shared<MemoryBlock>();
+    block->memory = std::move(memory);
+    block->size = size;
+    block->coherent = coherent;
+    return DeviceAllocation{std::move(block), 0, size};
+}
+
+IQM::Bin::DeviceAllocation::DeviceAllocation(DeviceAllocation &&other) noexcept :
+    block(std::move(other.block)),
+    blockOffset(other.blockOffset),
+    allocationSize(other.allocationSize) {}
+
+IQM::Bin::DeviceAllocation & IQM::Bin::DeviceAllocation::operator=(DeviceAllocation &&other) noexcept {
+    if (this != &other) {
+        this->reset();
+        this->block = std::move(other.block);
+        this->blockOffset = other.blockOffset;
+        this->allocationSize = other.allocationSize;
+    }
+    return *this;
+}
+
+IQM::Bin::DeviceAllocation::~DeviceAllocation() {
+    this->reset();
+}
+
+void IQM::Bin::DeviceAllocation::reset() {
+    if (this->block != nullptr && this->block->release) {
+        this->block->release(this->blockOffset, this->allocationSize);
+    }
+    this->block.reset();
+}
+
+void * IQM::Bin::DeviceAllocation::mapMemory(const vk::DeviceSize offset, const vk::DeviceSize size, const vk::MemoryMapFlags flags) const {
+    return this->block->memory.mapMemory(this->blockOffset + offset, size, flags);
+}
+
+void IQM::Bin::DeviceAllocation::unmapMemory() const {
+    this->block->memory.unmapMemory();
+}
+
+// mapped memory is always dedicated, so the whole allocation is covered and no atom alignment is needed
+static vk::MappedMemoryRange whole_range(const vk::raii::DeviceMemory &memory) {
+    return vk::MappedMemoryRange{
+        .memory = *memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+}
+
+void IQM::Bin::DeviceAllocation::flush() const {
+    if (this->block->coherent) {
+        return;
+    }
+    const auto &memory = this->block->memory;
+    memory.getDevice().flushMappedMemoryRanges(whole_range(memory), *memory.getDispatcher());
+}
+
+void IQM::Bin::DeviceAllocation::invalidate() const {
+    if (this->block->coherent) {
+        return;
+    }
+    const auto &memory = this->block->memory;
+    memory.getDevice().invalidateMappedMemoryRanges(whole_range(memory), *memory.getDispatcher());
+}
+
+IQM::Bin::DeviceMemoryHeap::DeviceMemoryHeap() : state(std::make_shared<State>()) {}
+
+IQM::Bin::DeviceMemoryHeap::~DeviceMemoryHeap() {
+    // memory of allocations still alive would be freed only after the device is destroyed
+    assert(this->state->used == 0);
+}
+
+IQM::Bin::DeviceAllocation IQM::Bin::DeviceMemoryHeap::allocate(const vk::raii::Device &device, const vk::MemoryRequirements &requirements, const MemoryKind kind) {
+    std::lock_guard lock(this->state->mutex);
+    const Key key{static_cast<VkDevice>(*device), kind};
+    auto &list = this->state->blocks[key];
+
+    const auto carve = [&](Block &block) -> std::optional<vk::DeviceSize> {
+        // first fit
+        for (auto it = block.free.begin(); it != block.free.end(); ++it) {
+            const auto [start, size] = *it;
+            const auto offset = align_up(start, requirements.alignment);
+            if (offset + requirements.size > start + size) {
+                continue;
+            }
+
+            block.free.erase(it);
+            if (offset > start) {
+                block.free.emplace(start, offset - start);
+            }
+            if (offset + requirements.size < start + size) {
+                block.free.emplace(offset + requirements.size, start + size - offset - requirements.size);
+            }
+            block.used += requirements.size;
+            return offset;
+        }
+        return std::nullopt;
+    };
+
+    for (const auto &block : list) {
+        if (const auto offset = carve(*block); offset.has_value()) {
+            add_used(this->state->used, this->state->peak, requirements.size);
+            return DeviceAllocation{block->memory, offset.value(), requirements.size};
+        }
+    }
+
+    // resources larger than a block get a block of their own
+    auto block = std::make_unique<Block>();
+    block->memory = allocate_block(device, std::max(BLOCK_SIZE, align_up(requirements.size, requirements.alignment)), kind.memoryType);
+    block->free.emplace(0, block->memory->size);
+    block->memory->release = [weak = std::weak_ptr(this->state), key, raw = block.get()](const vk::DeviceSize offset, const vk::DeviceSize size) {
+        if (const auto state = weak.lock()) {
+            release(*state, key, raw, offset, size);
+        }
+    };
+
+    const auto offset = carve(*block).value();
+    auto allocation = DeviceAllocation{block->memory, offset, requirements.size};
+    list.push_back(std::move(block));
+    add_used(this->state->used, this->state->peak, requirements.size);
+    return allocation;
+}
+
+void IQM::Bin::DeviceMemoryHeap::release(State &state, const Key &key, const Block *block, const vk::DeviceSize offset, const vk::DeviceSize size) {
+    std::lock_guard lock(state.mutex);
+    auto &list = state.blocks[key];
+    const auto it = std::ranges::find_if(list, [&](const auto &entry) { return entry.get() == block; });
+    auto &entry = **it;
+
+    state.used -= size;
+    entry.used -= size;
+    if (entry.used == 0) {
+        // one empty block per memory type is kept, so pools releasing and creating resources don't reallocate it
+        if (std::ranges::count_if(list, [](const auto &other) { return other->used == 0; }) > 1) {
+            // memory itself is freed with the last allocation holding it
+            list.erase(it);
+            return;
+        }
+        entry.free.clear();
+        entry.free.emplace(0, entry.memory->size);
+        return;
+    }
+
+    auto start = offset;
+    auto end = offset + size;
+    // merge with neighbouring unused ranges
+    const auto next = entry.free.lower_bound(start);
+    if (next != entry.free.end() && next->first == end) {
+        end += next->second;
+        entry.free.erase(next);
+    }
+    const auto after = entry.free.lower_bound(start);
+    if (after != entry.free.begin()) {
+        const auto previous = std::prev(after);
+        if (previous->first + previous->second == start) {
+            start = previous->first;
+            entry.free.erase(previous);
+        }
+    }
+    entry.free.emplace(start, end - start);
+}
+
+unsigned IQM::Bin::DeviceMemoryHeap::blockCount() const {
+    std::lock_guard lock(this->state->mutex);
+    unsigned count = 0;
+    for (const auto &list : this->state->blocks | std::views::values) {
+        count += list.size();
+    }
+    return count;
+}
+
+unsigned long IQM::Bin::DeviceMemoryHeap::reservedSize() const {
+    std::lock_guard lock(this->state->mutex);
+    unsigned long size = 0;
+    for (const auto &list : this->state->blocks | std::views::values) {
+        for (const auto &block : list) {
+            size += block->memory->size;
+        }
+    }
+    return size;
+}
+
+IQM::Bin::LinearArena::LinearArena() : state(std::make_shared<State>()) {}
+
+IQM::Bin::DeviceAllocation IQM::Bin::LinearArena::allocate(const vk::raii::Device &device, const vk::MemoryRequirements &requirements, const MemoryKind kind) {
+    std::lock_guard lock(this->state->mutex);
+
+    const auto release = [weak = std::weak_ptr(this->state)](vk::DeviceSize, const vk::DeviceSize size) {
+        const auto state = weak.lock();
+        if (state == nullptr) {
+            return;
+        }
+        std::lock_guard lock(state->mutex);
+        state->used -= size;
+        state->live--;
+        if (state->live == 0) {
+            for (auto &chunk : state->chunks) {
+                chunk.top = 0;
+            }
+        }
+    };
+
+    for (auto &chunk : this->state->chunks) {
+        if (chunk.device != static_cast<VkDevice>(*device) || chunk.kind != kind) {
+            continue;
+        }
+        const auto offset = align_up(chunk.top, requirements.alignment);
+        if (offset + requirements.size <= chunk.memory->size) {
+            chunk.top = offset + requirements.size;
+            this->state->live++;
+            add_used(this->state->used, this->state->peak, requirements.size);
+            return DeviceAllocation{chunk.memory, offset, requirements.size};
+        }
+    }
+
+    auto memory = allocate_block(device, std::max(DeviceMemoryHeap::BLOCK_SIZE, align_up(requirements.size, requirements.alignment)), kind.memoryType);
+    memory->release = release;
+    this->state->chunks.push_back(Chunk{
+        .memory = memory,
+        .device = static_cast<VkDevice>(*device),
+        .kind = kind,
+        .top = requirements.size,
+    });
+    this->state->live++;
+    add_used(this->state->used, this->state->peak, requirements.size);
+    return DeviceAllocation{std::move(memory), 0, requirements.size};
+}
+
+unsigned long IQM::Bin::LinearArena::reservedSize() const {
+    std::lock_guard lock(this->state->mutex);
+    unsigned long size = 0;
+    for (const auto &chunk : this->state->chunks) {
+        size += chunk.memory->size;
+    }
+    return size;
+}
+
+static thread_local IQM::Bin::LinearArena *currentArena = nullptr;
+
+IQM::Bin::ArenaScope::ArenaScope(LinearArena &arena) : previous(currentArena) {
+    currentArena = &arena;
+}
+
+IQM::Bin::ArenaScope::~ArenaScope() {
+    currentArena = this->previous;
+}
+
+IQM::Bin::LinearArena * IQM::Bin::ArenaScope::current() {
+    return currentArena;
+}
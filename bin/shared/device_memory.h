@@ -0,0 +1,166 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_DEVICE_MEMORY_H
+#define IQM_BIN_DEVICE_MEMORY_H
+
+#include <atomic>
+#include <compare>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace IQM::Bin {
+    // single VkDeviceMemory, possibly shared by several resources
+    struct MemoryBlock {
+        vk::raii::DeviceMemory memory = VK_NULL_HANDLE;
+        vk::DeviceSize size = 0;
+        // host visible memory which is not coherent has to be flushed after host writes and invalidated before host reads
+        bool coherent = true;
+        // returns a range to the allocator that handed it out, empty for dedicated allocations
+        std::function<void(vk::DeviceSize offset, vk::DeviceSize size)> release;
+    };
+
+    /**
+     * Range of device memory bound to one resource, returned to its allocator when destroyed.
+     */
+    class DeviceAllocation {
+    public:
+        DeviceAllocation() = default;
+        DeviceAllocation(std::nullptr_t) {}
+        DeviceAllocation(std::shared_ptr<MemoryBlock> block, vk::DeviceSize offset, vk::DeviceSize size);
+        // whole VkDeviceMemory owned by this allocation
+        static DeviceAllocation dedicated(vk::raii::DeviceMemory memory, vk::DeviceSize size, bool coherent = true);
+
+        DeviceAllocation(const DeviceAllocation&) = delete;
+        DeviceAllocation& operator=(const DeviceAllocation&) = delete;
+        DeviceAllocation(DeviceAllocation&& other) noexcept;
+        DeviceAllocation& operator=(DeviceAllocation&& other) noexcept;
+        ~DeviceAllocation();
+
+        [[nodiscard]] const vk::raii::DeviceMemory& memory() const { return this->block->memory; }
+        [[nodiscard]] vk::DeviceSize offset() const { return this->blockOffset; }
+        [[nodiscard]] vk::DeviceSize size() const { return this->allocationSize; }
+
+        // offset is relative to the allocation, only host visible memory is dedicated and can be mapped
+        void* mapMemory(vk::DeviceSize offset, vk::DeviceSize size, vk::MemoryMapFlags flags = {}) const;
+        void unmapMemory() const;
+        // while mapped, makes host writes visible to the device, nothing to do for coherent memory
+        void flush() const;
+        // while mapped, makes device writes visible to the host, nothing to do for coherent memory
+        void invalidate() const;
+    private:
+        void reset();
+
+        std::shared_ptr<MemoryBlock> block;
+        vk::DeviceSize blockOffset = 0;
+        vk::DeviceSize allocationSize = 0;
+    };
+
+    // memory type index and whether the resource is an optimally tiled image
+    struct MemoryKind {
+        uint32_t memoryType;
+        bool image;
+
+        auto operator<=>(const MemoryKind&) const = default;
+    };
+
+    /**
+     * Free-list suballocator for long-lived resources.
+     *
+     * Blocks are kept per memory type, images and buffers never share a block,
+     * so bufferImageGranularity doesn't have to be considered.
+     * Emptied blocks are freed, except one per memory type, which is kept for resources churned by the pools.
+     *
+     * Owned by the instance and destroyed before its device, all allocations must be released by then.
+     */
+    class DeviceMemoryHeap {
+    public:
+        DeviceMemoryHeap();
+        ~DeviceMemoryHeap();
+        DeviceMemoryHeap(const DeviceMemoryHeap&) = delete;
+        DeviceMemoryHeap& operator=(const DeviceMemoryHeap&) = delete;
+
+        DeviceAllocation allocate(const vk::raii::Device &device, const vk::MemoryRequirements &requirements, MemoryKind kind);
+        [[nodiscard]] unsigned blockCount() const;
+        // memory allocated from the driver, including unused ranges
+        [[nodiscard]] unsigned long reservedSize() const;
+        // largest sum of ranges handed out at once
+        [[nodiscard]] unsigned long peakSize() const { return this->state->peak; }
+
+        static constexpr vk::DeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+    private:
+        struct Block {
+            std::shared_ptr<MemoryBlock> memory;
+            // offset -> size of unused ranges
+            std::map<vk::DeviceSize, vk::DeviceSize> free;
+            vk::DeviceSize used = 0;
+        };
+        using Key = std::tuple<VkDevice, MemoryKind>;
+        struct State {
+            std::map<Key, std::vector<std::unique_ptr<Block>>> blocks;
+            // heap is shared by all threads, counters are read without the lock
+            std::atomic<unsigned long> used = 0;
+            std::atomic<unsigned long> peak = 0;
+            std::mutex mutex;
+        };
+
+        static void release(State &state, const Key &key, const Block *block, vk::DeviceSize offset, vk::DeviceSize size);
+
+        // released allocations only reach the heap while it exists
+        std::shared_ptr<State> state;
+    };
+
+    /**
+     * Bump allocator for transient resources, rewinds once all of its ranges are released.
+     * Its blocks are only freed with the arena, so it must be destroyed before the device.
+     */
+    class LinearArena {
+    public:
+        LinearArena();
+        DeviceAllocation allocate(const vk::raii::Device &device, const vk::MemoryRequirements &requirements, MemoryKind kind);
+        [[nodiscard]] unsigned long reservedSize() const;
+        // largest sum of ranges handed out at once
+        [[nodiscard]] unsigned long peakSize() const { return this->state->peak; }
+    private:
+        struct Chunk {
+            std::shared_ptr<MemoryBlock> memory;
+            VkDevice device;
+            MemoryKind kind;
+            vk::DeviceSize top = 0;
+        };
+        struct State {
+            std::vector<Chunk> chunks;
+            unsigned live = 0;
+            std::atomic<unsigned long> used = 0;
+            std::atomic<unsigned long> peak = 0;
+            std::mutex mutex;
+        };
+
+        std::shared_ptr<State> state;
+    };
+
+    /**
+     * While alive, device local resources created on this thread are allocated from the arena.
+     */
+    class ArenaScope {
+    public:
+        explicit ArenaScope(LinearArena &arena);
+        ~ArenaScope();
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+        // arena of the innermost scope on this thread, nullptr outside of any scope
+        static LinearArena* current();
+    private:
+        LinearArena *previous;
+    };
+}
+
+#endif //IQM_BIN_DEVICE_MEMORY_H
@@ -0,0 +1,607 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <cmath>
+#include <iostream>
+
+#include "executor.h"
+#include "debug_utils.h"
+#include "resource_pool.h"
+
+std::shared_ptr<const IQM::Bin::ReferenceHandle> IQM::Bin::pin_reference(const std::vector<Match> &matches, const std::shared_ptr<const ReferenceHandle> &current, StagingPool &staging, const bool hash) {
+    if (matches.empty()) {
+        return nullptr;
+    }
+
+    for (const auto &match : matches) {
+        if (match.refPath != matches.front().refPath) {
+            return nullptr;
+        }
+    }
+
+    try {
+        const auto modified = std::filesystem::last_write_time(matches.front().refPath);
+        // resources holding the current handle stay valid, unless the file changed
+        if (current != nullptr && current->path == matches.front().refPath && current->modified == modified) {
+            return current;
+        }
+
+        return std::make_shared<ReferenceHandle>(ReferenceHandle{
+            .path = matches.front().refPath,
+            .modified = modified,
+            .image = load_image(matches.front().refPath, staging, hash),
+        });
+    } catch (const std::exception&) {
+        // reported for each pair instead
+        return nullptr;
+    }
+}
+
+IQM::Bin::DecodedPair IQM::Bin::load_pair(const Match &match, const std::shared_ptr<const ReferenceHandle> &reference, StagingPool &staging, const bool hash) {
+    auto test = load_image(match.testPath, staging, hash);
+
+    const bool pinned = reference != nullptr && reference->path == match.refPath;
+    std::shared_ptr<const InputImage> ref;
+    if (pinned) {
+        // aliases image owned by the handle
+        ref = std::shared_ptr<const InputImage>(reference, &reference->image);
+    } else {
+        ref = std::make_shared<InputImage>(load_image(match.refPath, staging, hash));
+    }
+
+    if (test.height != ref->height || test.width != ref->width) {
+        throw std::runtime_error("Test and reference images have different sizes");
+    }
+
+    return DecodedPair{
+        .match = match,
+        .test = std::move(test),
+        .ref = std::move(ref),
+        .reference = pinned ? reference : nullptr,
+    };
+}
+
+bool IQM::Bin::hold_reference(std::shared_ptr<const ReferenceHandle> &held, const DecodedPair &pair) {
+    const bool resident = pair.reference != nullptr && held == pair.reference;
+    held = pair.reference;
+    return resident;
+}
+
+static void write_host_image(const IQM::Bin::VulkanImage &image, const IQM::Bin::InputImage &input) {
+    const auto rowSize = static_cast<size_t>(input.width) * 4;
+    for (unsigned y = 0; y < input.height; y++) {
+        memcpy(image.mapped + y * image.rowPitch, input.pixels() + y * rowSize, rowSize);
+    }
+}
+
+IQM::Bin::InputUpload IQM::Bin::stage_input(const vk::raii::Buffer &stgInput, const DeviceAllocation &stgInputMemory, const vk::raii::Buffer &stgRef, const DeviceAllocation &stgRefMemory, const VulkanImage &imageInput, const VulkanImage &imageRef, const InputImage &test, const InputImage *ref) {
+    const auto size = static_cast<size_t>(test.width) * test.height * 4;
+    InputUpload upload;
+
+    if (imageInput.mapped != nullptr) {
+        write_host_image(imageInput, test);
+    } else if (test.staging != nullptr) {
+        upload.test = &test.staging->buffer;
+    } else {
+        void * inBufData = stgInputMemory.mapMemory(0, size, {});
+        memcpy(inBufData, test.data.data(), size);
+        stgInputMemory.flush();
+        stgInputMemory.unmapMemory();
+        upload.test = &stgInput;
+    }
+
+    // resident reference is already on device
+    if (ref != nullptr && imageRef.mapped != nullptr) {
+        write_host_image(imageRef, *ref);
+    } else if (ref != nullptr && ref->staging != nullptr) {
+        upload.ref = &ref->staging->buffer;
+    } else if (ref != nullptr) {
+        void * inBufData = stgRefMemory.mapMemory(0, size, {});
+        memcpy(inBufData, ref->data.data(), size);
+        stgRefMemory.flush();
+        stgRefMemory.unmapMemory();
+        upload.ref = &stgRef;
+    }
+
+    return upload;
+}
+
+void IQM::Bin::record_input_upload(const vk::raii::CommandBuffer &cmdBuf, const InputUpload &upload, const VulkanImage &imageInput, const VulkanImage &imageRef, const SharedInput *shared, const bool refResident) {
+    if (shared != nullptr) {
+        vk::ImageCopy copyRegion{
+            .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+            .srcOffset = vk::Offset3D{0, 0, 0},
+            .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+            .dstOffset = vk::Offset3D{0, 0, 0},
+            .extent = vk::Extent3D{imageInput.width, imageInput.height, 1}
+        };
+        cmdBuf.copyImage(shared->imageInput->image, vk::ImageLayout::eGeneral, imageInput.image, vk::ImageLayout::eGeneral, copyRegion);
+        if (!refResident) {
+            cmdBuf.copyImage(shared->imageRef->image, vk::ImageLayout::eGeneral, imageRef.image, vk::ImageLayout::eGeneral, copyRegion);
+        }
+        return;
+    }
+
+    vk::BufferImageCopy copyRegion{
+        .bufferOffset = 0,
+        .bufferRowLength = imageInput.width,
+        .bufferImageHeight = imageInput.height,
+        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+        .imageOffset = vk::Offset3D{0, 0, 0},
+        .imageExtent = vk::Extent3D{imageInput.width, imageInput.height, 1}
+    };
+    if (upload.test != nullptr) {
+        cmdBuf.copyBufferToImage(*upload.test, imageInput.image,  vk::ImageLayout::eGeneral, copyRegion);
+    }
+    if (!refResident && upload.ref != nullptr) {
+        cmdBuf.copyBufferToImage(*upload.ref, imageRef.image,  vk::ImageLayout::eGeneral, copyRegion);
+    }
+}
+
+IQM::Bin::DecodePool::DecodePool(const unsigned threads, StagingPool &staging, const bool hash) : staging(staging), hash(hash) {
+    for (unsigned i = 0; i < threads; i++) {
+        this->workers.emplace_back(&DecodePool::work, this);
+    }
+}
+
+IQM::Bin::DecodePool::~DecodePool() {
+    {
+        std::lock_guard lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_all();
+
+    for (auto &worker : this->workers) {
+        worker.join();
+    }
+}
+
+std::future<IQM::Bin::DecodedPair> IQM::Bin::DecodePool::decode(const Match &match, const std::shared_ptr<const ReferenceHandle> &reference) {
+    std::packaged_task<DecodedPair()> task([this, match, reference] { return load_pair(match, reference, this->staging, this->hash); });
+    auto future = task.get_future();
+
+    {
+        std::lock_guard lock(this->mutex);
+        this->tasks.push_back(std::move(task));
+    }
+    this->condition.notify_one();
+
+    return future;
+}
+
+void IQM::Bin::DecodePool::work() {
+    while (true) {
+        std::packaged_task<DecodedPair()> task;
+        {
+            std::unique_lock lock(this->mutex);
+            this->condition.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+            if (this->tasks.empty()) {
+                return;
+            }
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+        }
+
+        // exceptions are stored in the future
+        task();
+    }
+}
+
+IQM::Bin::BatchExecutor::BatchExecutor(const Args &args, const IQM::VulkanInstance &instance) :
+    args(args),
+    instance(instance),
+    thresholds(args),
+    unified(VulkanResource::unifiedMemory(*instance.physicalDevice())),
+    staging(*instance.device(), *instance.physicalDevice()) {
+    this->inflight = 2;
+    if (args.options.contains("--inflight")) {
+        this->inflight = std::max(1ul, std::stoul(args.options.at("--inflight")));
+    }
+
+    this->decodeThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+    if (args.options.contains("--decode-threads")) {
+        this->decodeThreads = std::max(1ul, std::stoul(args.options.at("--decode-threads")));
+    }
+
+    // idle resources in the pools never exceed their cap, pool cap set above the budget leaves half of it to pairs in flight
+    const auto budget = vram_budget(args.options, *instance.physicalDevice());
+    const auto poolCap = resource_pool_cap(args.options, *instance.physicalDevice());
+    this->inflightBudget = budget > poolCap ? budget - poolCap : budget / 2;
+
+    // each pair is compared with the previous one, so they must go through the same job in order,
+    // only decoding still runs ahead
+    if (args.incremental) {
+        if (this->inflight > 1 && args.options.contains("--inflight")) {
+            std::cerr << "--inflight is ignored with --incremental, pairs are computed one at a time" << std::endl;
+        }
+        this->inflight = 1;
+    }
+
+#ifdef ENABLE_RENDERDOC
+    // one capture per pair
+    this->inflight = 1;
+#endif
+}
+
+unsigned IQM::Bin::BatchExecutor::run(const std::vector<Match> &matches, const std::function<std::unique_ptr<BatchJob>()> &createJob) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // identical pairs are only looked for in threshold mode, where their values are known
+    const bool hash = this->thresholds.enabled() && !this->args.incremental;
+
+    const auto previousReference = this->reference;
+    this->reference = pin_reference(matches, previousReference, this->staging, hash);
+    const auto &reference = this->reference;
+    if (reference != nullptr && reference != previousReference && this->args.verbose && !this->onResult) {
+        std::cout << "Reference pinned: " << reference->path << std::endl;
+    }
+
+    DecodePool decoder(this->decodeThreads, this->staging, hash);
+    std::deque<std::future<DecodedPair>> decoding;
+    unsigned nextDecode = 0;
+    const auto lookahead = this->inflight + this->decodeThreads;
+    const auto decodeAhead = [&] {
+        while (decoding.size() < lookahead && nextDecode < matches.size()) {
+            decoding.push_back(decoder.decode(matches[nextDecode], reference));
+            nextDecode++;
+        }
+    };
+
+    // slots and their jobs are kept between runs
+    std::vector<InflightSlot*> freeSlots;
+    for (const auto &slot : this->slots) {
+        freeSlots.push_back(slot.get());
+    }
+    std::deque<InflightSlot*> busySlots;
+
+    unsigned processed = 0;
+    this->failed = 0;
+    // estimated device memory of pairs in flight
+    unsigned long reserved = 0;
+    // pairs submitted with fewer pairs in flight than allowed by `inflight`
+    unsigned limited = 0;
+    std::optional<std::chrono::time_point<std::chrono::high_resolution_clock>> firstResult;
+    const auto retireOldest = [&] {
+        auto *slot = busySlots.front();
+        busySlots.pop_front();
+        reserved -= slot->estimate;
+        if (this->retire(*slot)) {
+            processed++;
+            if (!firstResult.has_value()) {
+                firstResult = std::chrono::high_resolution_clock::now();
+            }
+        }
+        freeSlots.push_back(slot);
+    };
+
+    decodeAhead();
+
+    for (unsigned i = 0; i < matches.size(); i++) {
+        std::optional<DecodedPair> pair;
+        try {
+            pair = decoding.front().get();
+        } catch (const std::exception& e) {
+            this->fail(i, matches[i], e.what());
+        }
+        decoding.pop_front();
+        decodeAhead();
+
+        if (!pair.has_value()) {
+            continue;
+        }
+
+        // values of identical images are known in threshold mode, pairs before it are retired first to keep results in order;
+        // pairs with an output still go through a job to write their maps, incremental sessions must see every pair
+        if (this->thresholds.enabled() && !pair->match.outPath.has_value() && !this->args.incremental && identical_inputs(pair.value())) {
+            while (!busySlots.empty()) {
+                retireOldest();
+            }
+            auto values = identical_values(this->args.methods);
+            this->report(i, pair.value(), values);
+            processed++;
+            continue;
+        }
+
+        if (freeSlots.empty()) {
+            if (this->slots.size() < this->inflight) {
+                this->slots.push_back(this->createSlot(createJob()));
+                freeSlots.push_back(this->slots.back().get());
+            } else {
+                retireOldest();
+            }
+        }
+
+        auto *slot = freeSlots.back();
+        freeSlots.pop_back();
+        slot->pair = std::move(pair);
+        slot->index = i;
+
+        try {
+            slot->estimate = slot->job->estimateSize(slot->pair.value());
+            // a pair larger than the budget is still submitted on its own
+            if (!busySlots.empty() && reserved + slot->estimate > this->inflightBudget) {
+                limited++;
+            }
+            while (!busySlots.empty() && reserved + slot->estimate > this->inflightBudget) {
+                retireOldest();
+            }
+
+            this->submit(*slot);
+            reserved += slot->estimate;
+            busySlots.push_back(slot);
+        } catch (const std::exception& e) {
+            // part of the work could have been submitted
+            this->instance.device()->waitIdle();
+            this->fail(i, slot->pair->match, e.what());
+            slot->pair.reset();
+            freeSlots.push_back(slot);
+        }
+    }
+
+    while (!busySlots.empty()) {
+        retireOldest();
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const auto seconds = std::chrono::duration<double>(end - start).count();
+
+    // pipelines are also created lazily by existing jobs, e.g. for a new kernel size, unchanged cache isn't written
+    this->instance.savePipelineCache();
+
+    if (!this->onResult) {
+        std::cout << "Processed " << processed << "/" << matches.size() <<" images" << std::endl;
+        std::cout << "Throughput: " << static_cast<double>(processed) / seconds << " images/s (" << seconds << " s, " << this->inflight << " in flight)" << std::endl;
+        if (this->args.verbose && firstResult.has_value()) {
+            // includes pipeline creation of the first job
+            std::cout << "Time to first result: " << std::chrono::duration<double, std::milli>(firstResult.value() - start).count() << " ms" << std::endl;
+        }
+        if (this->args.verbose && limited > 0) {
+            std::cout << "Pairs waiting for VRAM budget: " << limited << " (" << static_cast<double>(this->inflightBudget) / 1024 / 1024 << " MB for pairs in flight)" << std::endl;
+        }
+        if (this->thresholds.enabled()) {
+            std::cout << "Failed thresholds: " << this->failed << "/" << processed << " images" << std::endl;
+        }
+        if (this->args.verbose) {
+            const auto &heap = VulkanResource::memoryHeap();
+            std::cout << "Device memory blocks: " << heap.blockCount() << " (" << static_cast<double>(heap.reservedSize()) / 1024 / 1024 << " MB, "
+            << static_cast<double>(heap.peakSize()) / 1024 / 1024 << " MB peak)" << std::endl;
+        }
+    }
+
+    return processed;
+}
+
+std::unique_ptr<IQM::Bin::BatchExecutor::InflightSlot> IQM::Bin::BatchExecutor::createSlot(std::unique_ptr<BatchJob> job) const {
+    const auto &device = *this->instance.device();
+    auto slot = std::make_unique<InflightSlot>();
+    slot->job = std::move(job);
+    slot->job->limitMemory(this->inflightBudget);
+
+    slot->commandPool = vk::raii::CommandPool{device, vk::CommandPoolCreateInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+        .queueFamilyIndex = this->instance.queueFamily(),
+    }};
+    slot->commandPoolTransfer = vk::raii::CommandPool{device, vk::CommandPoolCreateInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+        .queueFamilyIndex = this->instance.queueFamilyTransfer(),
+    }};
+
+    vk::CommandBufferAllocateInfo computeAllocateInfo{
+        .commandPool = *slot->commandPool,
+        .commandBufferCount = 1,
+    };
+    slot->cmdCompute = std::move(vk::raii::CommandBuffers{device, computeAllocateInfo}.front());
+
+    vk::CommandBufferAllocateInfo transferAllocateInfo{
+        .commandPool = *slot->commandPoolTransfer,
+        .commandBufferCount = 2,
+    };
+    auto transferBufs = vk::raii::CommandBuffers{device, transferAllocateInfo};
+    slot->cmdUpload = std::move(transferBufs[0]);
+    slot->cmdDownload = std::move(transferBufs[1]);
+
+    slot->uploadDone = device.createSemaphore(vk::SemaphoreCreateInfo{});
+    slot->computeDone = device.createSemaphore(vk::SemaphoreCreateInfo{});
+    slot->fence = device.createFence(vk::FenceCreateInfo{});
+
+    return slot;
+}
+
+void IQM::Bin::BatchExecutor::submit(InflightSlot &slot) const {
+    slot.start = std::chrono::high_resolution_clock::now();
+    slot.timestamps = Timestamps{};
+
+    initRenderDoc();
+
+    slot.job->prepare(slot.pair.value());
+    slot.timestamps.mark("resources prepared");
+
+    this->submitPass(slot);
+}
+
+void IQM::Bin::BatchExecutor::submitPass(InflightSlot &slot) const {
+    if (this->unified) {
+        this->submitPassUnified(slot);
+        return;
+    }
+
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+
+    slot.cmdUpload.begin(beginInfo);
+    slot.job->recordUpload(slot.cmdUpload);
+    slot.cmdUpload.end();
+
+    slot.cmdCompute.begin(beginInfo);
+    slot.job->recordCompute(slot.cmdCompute);
+    slot.cmdCompute.end();
+
+    slot.cmdDownload.begin(beginInfo);
+    slot.job->recordDownload(slot.cmdDownload);
+    slot.cmdDownload.end();
+
+    slot.timestamps.mark("commands recorded");
+
+    this->instance.device()->resetFences({*slot.fence});
+
+    const vk::SubmitInfo submitUpload{
+        .commandBufferCount = 1,
+        .pCommandBuffers = &*slot.cmdUpload,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &*slot.uploadDone
+    };
+    this->instance.queueTransfer()->submit(submitUpload, {});
+
+    auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
+    const vk::SubmitInfo submitCompute{
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*slot.uploadDone,
+        .pWaitDstStageMask = &mask,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &*slot.cmdCompute,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &*slot.computeDone
+    };
+    this->instance.queue()->submit(submitCompute, {});
+
+    auto maskCopy = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eTransfer};
+    const vk::SubmitInfo submitDownload{
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*slot.computeDone,
+        .pWaitDstStageMask = &maskCopy,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &*slot.cmdDownload,
+    };
+    this->instance.queueTransfer()->submit(submitDownload, *slot.fence);
+
+    slot.timestamps.mark("submit GPU work");
+}
+
+void IQM::Bin::BatchExecutor::submitPassUnified(InflightSlot &slot) const {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+
+    // compute queue supports transfers as well, barriers replace the semaphores between queues
+    slot.cmdCompute.begin(beginInfo);
+    slot.job->recordUpload(slot.cmdCompute);
+
+    const vk::MemoryBarrier uploadBarrier{
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
+    };
+    slot.cmdCompute.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, {}, uploadBarrier, nullptr, nullptr);
+
+    slot.job->recordCompute(slot.cmdCompute);
+
+    const vk::MemoryBarrier computeBarrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+    };
+    slot.cmdCompute.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, computeBarrier, nullptr, nullptr);
+
+    slot.job->recordDownload(slot.cmdCompute);
+    slot.cmdCompute.end();
+
+    slot.timestamps.mark("commands recorded");
+
+    this->instance.device()->resetFences({*slot.fence});
+
+    const vk::SubmitInfo submitInfo{
+        .commandBufferCount = 1,
+        .pCommandBuffers = &*slot.cmdCompute,
+    };
+    this->instance.queue()->submit(submitInfo, *slot.fence);
+
+    slot.timestamps.mark("submit GPU work");
+}
+
+bool IQM::Bin::BatchExecutor::retire(InflightSlot &slot) {
+    const auto &pair = slot.pair.value();
+    bool success = true;
+
+    try {
+        this->instance.waitForFence(slot.fence);
+        // remaining passes run one after another, other slots keep the GPU busy meanwhile
+        while (slot.job->nextPass()) {
+            if (auto values = slot.job->partial(); !values.empty()) {
+                this->report(slot.index, pair, values, true);
+            }
+            this->submitPass(slot);
+            this->instance.waitForFence(slot.fence);
+        }
+        slot.timestamps.mark("end GPU work");
+
+        finishRenderDoc();
+
+        auto values = slot.job->finish(pair);
+        slot.timestamps.mark("output saved");
+
+        const auto end = std::chrono::high_resolution_clock::now();
+        this->report(slot.index, pair, values);
+
+        if (this->args.verbose && !this->onResult) {
+            slot.timestamps.print(slot.start, end);
+            double mbSize = static_cast<double>(slot.job->resourceSize()) / 1024 / 1024;
+            std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        this->fail(slot.index, pair.match, e.what());
+        success = false;
+    }
+
+    slot.pair.reset();
+    return success;
+}
+
+void IQM::Bin::BatchExecutor::report(const unsigned index, const DecodedPair &pair, std::vector<MetricValue> &values, const bool partial) {
+    // only final values of a pair are judged
+    if (!partial && !this->thresholds.judge(values)) {
+        this->failed++;
+    }
+
+    if (this->onResult) {
+        this->onResult(index, pair, values, partial);
+        return;
+    }
+
+    std::cout << pair.match.testPath << ": ";
+    for (unsigned i = 0; i < values.size(); i++) {
+        if (i != 0) {
+            std::cout << " | ";
+        }
+        if (this->printNames) {
+            std::cout << values[i].name << "=";
+        }
+        if (values[i].computed) {
+            std::cout << values[i].value << values[i].unit;
+            if (values[i].band.has_value()) {
+                if (std::isnan(values[i].band.value())) {
+                    std::cout << " (preview, uncalibrated)";
+                } else {
+                    std::cout << " ±" << values[i].band.value() << " (preview)";
+                }
+            }
+            if (values[i].pass.has_value()) {
+                std::cout << (values[i].pass.value() ? " PASS" : " FAIL");
+            }
+        } else if (values[i].pass.has_value()) {
+            // decided before the whole value was computed
+            std::cout << (values[i].pass.value() ? "PASS" : "FAIL");
+        } else {
+            std::cout << "skipped";
+        }
+    }
+    std::cout << std::endl;
+}
+
+void IQM::Bin::BatchExecutor::fail(const unsigned index, const Match &match, const std::string &error) const {
+    if (this->onError) {
+        this->onError(index, error);
+    } else {
+        std::cerr << "Failed to process '" << match.testPath << "': " << error << std::endl;
+    }
+}
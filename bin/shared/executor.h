@@ -0,0 +1,228 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_EXECUTOR_H
+#define IQM_BIN_EXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "vulkan.h"
+#include "vulkan_res.h"
+#include "io.h"
+#include "staging.h"
+#include "threshold.h"
+#include "timestamps.h"
+#include "../IQM/args.h"
+
+namespace IQM::Bin {
+    /**
+     * Reference pinned for a whole batch, when all pairs are compared against the same image.
+     *
+     * The reference is decoded only once. Resources remember the handle they were last used with,
+     * so the reference upload and reference-only intermediates are kept on device between pairs.
+     * Only SSIM with intermediate images has such intermediates, see `IQM::SSIMInput::cachedReference`.
+     */
+    struct ReferenceHandle {
+        std::string path;
+        std::filesystem::file_time_type modified;
+        InputImage image;
+    };
+
+    struct DecodedPair {
+        Match match;
+        InputImage test;
+        std::shared_ptr<const InputImage> ref;
+        // set when reference is pinned, same handle is shared by all pairs of the batch
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    struct MetricValue {
+        std::string name;
+        float value;
+        std::string unit;
+        // set in threshold mode for values with a limit
+        std::optional<bool> pass = std::nullopt;
+        // false when the value was decided from its bounds or skipped, `value` is then not set
+        bool computed = true;
+        // set for preview values, largest difference from the full resolution value seen on refined pairs, NaN until calibrated
+        std::optional<float> band = std::nullopt;
+    };
+
+    /**
+     * Test and reference images uploaded once and shared by all jobs of a multi-method run.
+     */
+    struct SharedInput {
+        vk::raii::Buffer stgInput = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
+        vk::raii::Buffer stgRef = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
+
+        // RGBA u8 input images
+        std::shared_ptr<VulkanImage> imageInput;
+        std::shared_ptr<VulkanImage> imageRef;
+
+        // pinned reference currently held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    /**
+     * Work for one image pair, split into phases so the executor can own all submission and synchronization.
+     * Recording functions must not submit or wait, resources held by the job must stay alive until `finish`.
+     */
+    class BatchJob {
+    public:
+        virtual ~BatchJob() = default;
+        // allocates resources and copies decoded images into staging memory
+        virtual void prepare(const DecodedPair &pair) = 0;
+        // records copies of staging memory to device resources, recorded into transfer queue command buffer
+        virtual void recordUpload(const vk::raii::CommandBuffer &cmdBuf) = 0;
+        // records metric computation
+        virtual void recordCompute(const vk::raii::CommandBuffer &cmdBuf) = 0;
+        // records copies of results back to staging memory, recorded into transfer queue command buffer
+        virtual void recordDownload(const vk::raii::CommandBuffer &cmdBuf) = 0;
+        // called after GPU work of each pass is done, returns true if the job staged another pass of the same pair,
+        // which is then recorded and submitted again without `prepare`, used for tiled computation
+        virtual bool nextPass() { return false; }
+        // called after `nextPass` staged another pass, values reported early before the pair is finished
+        virtual std::vector<MetricValue> partial() { return {}; }
+        // called after GPU work is done, reads results and saves output images
+        virtual std::vector<MetricValue> finish(const DecodedPair &pair) = 0;
+        // device memory used by the job for current pair
+        [[nodiscard]] virtual unsigned long resourceSize() const = 0;
+        // device memory the job will use for the pair, estimated from its resource plan before anything is allocated
+        [[nodiscard]] virtual unsigned long estimateSize(const DecodedPair &pair) const = 0;
+
+        // device memory available to a single pair, jobs able to do so compute larger pairs in tiles or in lower precision
+        void limitMemory(const unsigned long budget) { this->memoryBudget = budget; }
+        // with shared input, job doesn't stage decoded images and copies inputs on device instead
+        void useSharedInput(const SharedInput *input) { this->sharedInput = input; }
+    protected:
+        const SharedInput *sharedInput = nullptr;
+        std::optional<unsigned long> memoryBudget;
+    };
+
+    // staging buffers the inputs of one pair are uploaded from
+    struct InputUpload {
+        // not set for input images written by the host directly
+        const vk::raii::Buffer *test = nullptr;
+        // not set for resident reference, or reference image written by the host directly
+        const vk::raii::Buffer *ref = nullptr;
+    };
+
+    // host mapped input images are written directly, images decoded into staging memory are uploaded from it,
+    // others are copied into the given staging buffers
+    InputUpload stage_input(const vk::raii::Buffer &stgInput, const DeviceAllocation &stgInputMemory, const vk::raii::Buffer &stgRef, const DeviceAllocation &stgRefMemory, const VulkanImage &imageInput, const VulkanImage &imageRef, const InputImage &test, const InputImage *ref);
+    // records copy of inputs from staging buffers, or from shared input images if present, resident reference is not copied
+    void record_input_upload(const vk::raii::CommandBuffer &cmdBuf, const InputUpload &upload, const VulkanImage &imageInput, const VulkanImage &imageRef, const SharedInput *shared, bool refResident);
+
+    // returns whether resources already hold the pinned reference of the pair, and marks them as holding it
+    bool hold_reference(std::shared_ptr<const ReferenceHandle> &held, const DecodedPair &pair);
+
+    // decodes reference once, if all matches share it, current handle is kept if it still matches the file
+    std::shared_ptr<const ReferenceHandle> pin_reference(const std::vector<Match> &matches, const std::shared_ptr<const ReferenceHandle> &current, StagingPool &staging, bool hash);
+    // images are hashed while decoding if `hash` is set
+    DecodedPair load_pair(const Match &match, const std::shared_ptr<const ReferenceHandle> &reference, StagingPool &staging, bool hash);
+
+    /**
+     * Fixed set of worker threads decoding image pairs ahead of the GPU, straight into staging memory.
+     */
+    class DecodePool {
+    public:
+        DecodePool(unsigned threads, StagingPool &staging, bool hash);
+        ~DecodePool();
+        std::future<DecodedPair> decode(const Match &match, const std::shared_ptr<const ReferenceHandle> &reference);
+    private:
+        void work();
+        StagingPool &staging;
+        bool hash;
+        std::vector<std::thread> workers;
+        std::deque<std::packaged_task<DecodedPair()>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+    };
+
+    /**
+     * Runs batch of pairs with N pairs in flight.
+     *
+     * Images are decoded on worker threads, each in-flight slot has its own command buffers, semaphores and job,
+     * so upload of one pair, compute of another and readback of a third one can overlap.
+     * Results are printed in input order, or passed to `onResult` if set.
+     * With `--threshold`, values are judged against their limits and pairs of identical images without an output
+     * are decided without any GPU work, images are hashed while decoding to find them.
+     * Slots with their jobs and the pinned reference are kept between runs.
+     *
+     * Pairs are only submitted while estimated memory of all pairs in flight fits into the VRAM budget,
+     * which is what remains after the cap of the resource pools, so batches of large images run with fewer pairs in flight.
+     */
+    class BatchExecutor {
+    public:
+        BatchExecutor(const Args &args, const IQM::VulkanInstance &instance);
+        // factory is called once for each in-flight slot, returns number of successfully processed pairs
+        unsigned run(const std::vector<Match> &matches, const std::function<std::unique_ptr<BatchJob>()> &createJob);
+
+        unsigned inflight;
+        unsigned decodeThreads;
+        // pairs of the last run with a value failing its threshold
+        unsigned failed = 0;
+        // prefix values with metric names, when several metrics are printed in one row
+        bool printNames = false;
+        // when set, nothing is printed and results and errors are reported with index into matches,
+        // partial results are followed by the final result of the same pair
+        std::function<void(unsigned index, const DecodedPair &pair, const std::vector<MetricValue> &values, bool partial)> onResult;
+        std::function<void(unsigned index, const std::string &error)> onError;
+    private:
+        struct InflightSlot {
+            std::unique_ptr<BatchJob> job;
+            vk::raii::CommandPool commandPool = VK_NULL_HANDLE;
+            vk::raii::CommandPool commandPoolTransfer = VK_NULL_HANDLE;
+            vk::raii::CommandBuffer cmdUpload = VK_NULL_HANDLE;
+            vk::raii::CommandBuffer cmdCompute = VK_NULL_HANDLE;
+            vk::raii::CommandBuffer cmdDownload = VK_NULL_HANDLE;
+            vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
+            vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
+            vk::raii::Fence fence = VK_NULL_HANDLE;
+
+            std::optional<DecodedPair> pair;
+            unsigned index = 0;
+            // estimated device memory of the pair
+            unsigned long estimate = 0;
+            Timestamps timestamps;
+            std::chrono::time_point<std::chrono::high_resolution_clock> start;
+        };
+
+        std::unique_ptr<InflightSlot> createSlot(std::unique_ptr<BatchJob> job) const;
+        void submit(InflightSlot &slot) const;
+        void submitPass(InflightSlot &slot) const;
+        void submitPassUnified(InflightSlot &slot) const;
+        bool retire(InflightSlot &slot);
+        void report(unsigned index, const DecodedPair &pair, std::vector<MetricValue> &values, bool partial = false);
+        void fail(unsigned index, const Match &match, const std::string &error) const;
+
+        const Args &args;
+        const IQM::VulkanInstance &instance;
+        Thresholds thresholds;
+        // device memory for pairs in flight
+        unsigned long inflightBudget;
+        // all passes are submitted to the compute queue at once, since inputs are mostly written by the host
+        bool unified;
+        // decoded images of pairs in flight and the pinned reference
+        StagingPool staging;
+        std::vector<std::unique_ptr<InflightSlot>> slots;
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+}
+
+#endif //IQM_BIN_EXECUTOR_H
@@ -0,0 +1,207 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "incremental.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <IQM/base/reduce.h>
+
+#include "roi.h"
+
+IQM::Bin::IncrementalSession::IncrementalSession(const unsigned halo, const unsigned border) :
+    halo(halo),
+    border(border) {
+}
+
+void IQM::Bin::IncrementalSession::plan(const DecodedPair &pair) {
+    // pinned reference doesn't change as long as its handle is the same
+    const bool sameReference = pair.reference != nullptr && pair.reference == this->reference;
+    const bool reuse = !this->test.empty() && pair.test.width == this->width && pair.test.height == this->height && (sameReference || !this->ref.empty());
+    // previous pair failed, its changes aren't covered by rectangles of this one
+    const bool missed = this->pending;
+
+    // halo is rounded up to whole cells, so cells of the region are also cells of the image
+    const auto haloCells = (this->halo + SCORE_GRID_CELL - 1) / SCORE_GRID_CELL;
+
+    unsigned left = 0, top = 0, right, bottom;
+    if (reuse) {
+        const auto dirty = this->dirtyCells(pair, !missed);
+        left = this->columns;
+        top = this->rows;
+        right = 0;
+        bottom = 0;
+        for (unsigned row = 0; row < this->rows; row++) {
+            for (unsigned column = 0; column < this->columns; column++) {
+                if (dirty[row * this->columns + column]) {
+                    left = std::min(left, column);
+                    top = std::min(top, row);
+                    right = std::max(right, column + 1);
+                    bottom = std::max(bottom, row + 1);
+                }
+            }
+        }
+        if (left >= right) {
+            // nothing changed, one cell is still recomputed, so every pair goes through the GPU the same way
+            left = 0;
+            top = 0;
+            right = 1;
+            bottom = 1;
+        }
+
+        // metric of pixels within the halo of a change also changes
+        left -= std::min(left, haloCells);
+        top -= std::min(top, haloCells);
+        right = std::min(right + haloCells, this->columns);
+        bottom = std::min(bottom + haloCells, this->rows);
+    } else {
+        // cells are reset, so inputs they were computed from no longer apply, even if this pair fails
+        this->test.clear();
+        this->ref.clear();
+        this->reference.reset();
+        this->width = pair.test.width;
+        this->height = pair.test.height;
+        const auto extent = IQM::Reduce::gridExtent(this->width, this->height, SCORE_GRID_CELL);
+        this->columns = extent.width;
+        this->rows = extent.height;
+        this->sums.assign(this->columns * this->rows, 0.0);
+        this->weights.resize(this->columns * this->rows);
+        for (unsigned row = 0; row < this->rows; row++) {
+            for (unsigned column = 0; column < this->columns; column++) {
+                this->weights[row * this->columns + column] = this->cellWeight(column, row);
+            }
+        }
+        right = this->columns;
+        bottom = this->rows;
+    }
+
+    // updated cells need the halo around them as well
+    const auto regionLeft = left - std::min(left, haloCells);
+    const auto regionTop = top - std::min(top, haloCells);
+    const auto regionRight = std::min(right + haloCells, this->columns);
+    const auto regionBottom = std::min(bottom + haloCells, this->rows);
+
+    const Tile tile{
+        .x = regionLeft * SCORE_GRID_CELL,
+        .y = regionTop * SCORE_GRID_CELL,
+        .coreX = left * SCORE_GRID_CELL,
+        .coreY = top * SCORE_GRID_CELL,
+        .coreWidth = std::min(right * SCORE_GRID_CELL, this->width) - left * SCORE_GRID_CELL,
+        .coreHeight = std::min(bottom * SCORE_GRID_CELL, this->height) - top * SCORE_GRID_CELL,
+    };
+    this->current.emplace(this->width, this->height, std::min(regionRight * SCORE_GRID_CELL, this->width) - tile.x, std::min(regionBottom * SCORE_GRID_CELL, this->height) - tile.y, tile);
+
+    const auto size = static_cast<size_t>(this->width) * this->height * 4;
+    this->pendingTest.assign(pair.test.pixels(), pair.test.pixels() + size);
+    if (pair.reference != nullptr) {
+        this->pendingRef.clear();
+    } else {
+        this->pendingRef.assign(pair.ref->pixels(), pair.ref->pixels() + size);
+    }
+    this->pendingReference = pair.reference;
+    this->pending = true;
+}
+
+const IQM::Bin::TileGrid &IQM::Bin::IncrementalSession::region() const {
+    return this->current.value();
+}
+
+bool IQM::Bin::IncrementalSession::whole() const {
+    const auto &region = this->current.value();
+    return region.tileWidth == this->width && region.tileHeight == this->height;
+}
+
+double IQM::Bin::IncrementalSession::update(const std::vector<float> &grid) {
+    const auto &region = this->current.value();
+    const auto &tile = region.tiles[0];
+    const auto regionColumns = IQM::Reduce::gridExtent(region.tileWidth, region.tileHeight, SCORE_GRID_CELL).width;
+
+    for (unsigned row = tile.coreY / SCORE_GRID_CELL; row * SCORE_GRID_CELL < tile.coreY + tile.coreHeight; row++) {
+        for (unsigned column = tile.coreX / SCORE_GRID_CELL; column * SCORE_GRID_CELL < tile.coreX + tile.coreWidth; column++) {
+            const auto value = grid[(row - tile.y / SCORE_GRID_CELL) * regionColumns + column - tile.x / SCORE_GRID_CELL];
+            const auto index = row * this->columns + column;
+            // cells without weight are NaN
+            this->sums[index] = std::isnan(value) ? 0.0 : value * this->weights[index];
+        }
+    }
+
+    // cells now match the planned pair, so the next one is compared with it
+    std::swap(this->test, this->pendingTest);
+    std::swap(this->ref, this->pendingRef);
+    this->reference = std::move(this->pendingReference);
+    this->pending = false;
+
+    double sum = 0.0;
+    double weight = 0.0;
+    for (size_t i = 0; i < this->sums.size(); i++) {
+        sum += this->sums[i];
+        weight += this->weights[i];
+    }
+    return sum / weight;
+}
+
+std::vector<float> IQM::Bin::IncrementalSession::grid() const {
+    std::vector<float> grid(this->sums.size());
+    for (size_t i = 0; i < grid.size(); i++) {
+        grid[i] = this->weights[i] > 0.0 ? static_cast<float>(this->sums[i] / this->weights[i]) : std::numeric_limits<float>::quiet_NaN();
+    }
+    return grid;
+}
+
+void IQM::Bin::IncrementalSession::requireUnset(const Args &args, const std::string &method) {
+    if (args.incremental) {
+        throw std::runtime_error("Incremental computation is not supported by " + method);
+    }
+}
+
+std::vector<bool> IQM::Bin::IncrementalSession::dirtyCells(const DecodedPair &pair, const bool trustRects) const {
+    std::vector<bool> dirty(this->columns * this->rows, false);
+
+    // given rectangles are trusted to cover changes of both images
+    if (trustRects && pair.match.dirty.has_value()) {
+        for (const auto &rect : parse_rects(pair.match.dirty.value())) {
+            const auto right = std::min<unsigned>(rect.offset.x + rect.extent.width, this->width);
+            const auto bottom = std::min<unsigned>(rect.offset.y + rect.extent.height, this->height);
+            for (unsigned row = rect.offset.y / SCORE_GRID_CELL; row < this->rows && row * SCORE_GRID_CELL < bottom; row++) {
+                for (unsigned column = rect.offset.x / SCORE_GRID_CELL; column < this->columns && column * SCORE_GRID_CELL < right; column++) {
+                    dirty[row * this->columns + column] = true;
+                }
+            }
+        }
+        return dirty;
+    }
+
+    // decoded images are still in host memory, so rows of each cell are compared there
+    const bool compareRef = pair.reference == nullptr || pair.reference != this->reference;
+    for (unsigned y = 0; y < this->height; y++) {
+        const auto row = y / SCORE_GRID_CELL;
+        for (unsigned column = 0; column < this->columns; column++) {
+            const auto index = row * this->columns + column;
+            if (dirty[index]) {
+                continue;
+            }
+
+            const auto start = (static_cast<size_t>(y) * this->width + column * SCORE_GRID_CELL) * 4;
+            const auto size = (std::min((column + 1) * SCORE_GRID_CELL, this->width) - column * SCORE_GRID_CELL) * 4;
+            if (std::memcmp(pair.test.pixels() + start, this->test.data() + start, size) != 0
+                || (compareRef && std::memcmp(pair.ref->pixels() + start, this->ref.data() + start, size) != 0)) {
+                dirty[index] = true;
+            }
+        }
+    }
+    return dirty;
+}
+
+double IQM::Bin::IncrementalSession::cellWeight(const unsigned column, const unsigned row) const {
+    // pixels of the cell inside of the image without its border
+    const auto left = std::max<long>(column * SCORE_GRID_CELL, this->border);
+    const auto top = std::max<long>(row * SCORE_GRID_CELL, this->border);
+    const auto right = std::min<long>(std::min((column + 1) * SCORE_GRID_CELL, this->width), static_cast<long>(this->width) - this->border);
+    const auto bottom = std::min<long>(std::min((row + 1) * SCORE_GRID_CELL, this->height), static_cast<long>(this->height) - this->border);
+    return static_cast<double>(std::max(right - left, 0l)) * std::max(bottom - top, 0l);
+}
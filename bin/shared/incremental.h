@@ -0,0 +1,71 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_INCREMENTAL_H
+#define IQM_BIN_INCREMENTAL_H
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "executor.h"
+#include "tiling.h"
+
+namespace IQM::Bin {
+    /**
+     * State of a job computing consecutive pairs incrementally, set by `--incremental`.
+     *
+     * The host keeps inputs of the previous pair and sums of the metric in each cell of the score grid.
+     * Cells where either input changed, or cells covered by the changed rectangles of the pair, along with cells
+     * within the kernel halo of them, are recomputed in a single region. The region is extended by the halo once more,
+     * rounded up to whole cells, so it starts on a cell boundary. Value of the pair is then combined from the sums of all cells.
+     * The first pair and pairs of a different size are computed whole.
+     *
+     * Inputs of a pair only replace the previous ones in `update`, once its cells are updated, so a pair failing
+     * in between leaves the session at the last computed pair. Its changed rectangles are then not trusted
+     * for the next pair, which is compared with the last computed one instead.
+     */
+    class IncrementalSession {
+    public:
+        // `halo` is the reach of the metric kernel, `border` pixels on image edges are left out of the metric value
+        IncrementalSession(unsigned halo, unsigned border);
+        // compares the pair with the previous one and selects the region computed for it
+        void plan(const DecodedPair &pair);
+        // single tile of the computed region, its core are the cells updated by the pair
+        [[nodiscard]] const TileGrid& region() const;
+        [[nodiscard]] bool whole() const;
+        // updates cells of the core from the score grid of the region, returns the mean of the whole pair
+        double update(const std::vector<float> &grid);
+        // means of all cells, cells without weight are NaN
+        [[nodiscard]] std::vector<float> grid() const;
+        // throws if `--incremental` is set for a method which can't recompute a region of the pair
+        static void requireUnset(const Args &args, const std::string &method);
+    private:
+        // changed rectangles of the pair are only used if `trustRects` is set
+        [[nodiscard]] std::vector<bool> dirtyCells(const DecodedPair &pair, bool trustRects) const;
+        [[nodiscard]] double cellWeight(unsigned column, unsigned row) const;
+
+        unsigned halo;
+        unsigned border;
+        unsigned width = 0, height = 0;
+        unsigned columns = 0, rows = 0;
+        // inputs of the last pair whose cells were updated
+        std::vector<unsigned char> test;
+        std::vector<unsigned char> ref;
+        std::shared_ptr<const ReferenceHandle> reference;
+        // inputs of the planned pair, committed by `update`
+        std::vector<unsigned char> pendingTest;
+        std::vector<unsigned char> pendingRef;
+        std::shared_ptr<const ReferenceHandle> pendingReference;
+        bool pending = false;
+        // weighted sum of the metric in each cell and the sum of its weights
+        std::vector<double> sums;
+        std::vector<double> weights;
+        std::optional<TileGrid> current;
+    };
+}
+
+#endif //IQM_BIN_INCREMENTAL_H
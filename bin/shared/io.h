@@ -12,25 +12,51 @@
 #include <stdexcept>
 #include <vector>
 #include <string>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <algorithm>
 #include <fstream>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 
 namespace IQM::Bin {
     struct Match {
         std::string testPath;
         std::string refPath;
         std::optional<std::string> outPath;
+        // rectangles changed since the previous pair, as `x,y,w,h;...`, used by incremental computation
+        std::optional<std::string> dirty;
     };
 
+    struct StagingBuffer;
+
     struct InputImage {
         unsigned width;
         unsigned height;
+        // RGBA u8 pixels, empty when the image was decoded into `staging`
         std::vector<unsigned char> data;
+        // pooled staging memory holding the pixels, which is uploaded to device directly
+        std::shared_ptr<const StagingBuffer> staging = nullptr;
+        const unsigned char *stagingData = nullptr;
+        // hash of the pixels, only computed while decoding in threshold mode to rule out identical pairs
+        std::optional<uint64_t> hash = std::nullopt;
+
+        [[nodiscard]] const unsigned char* pixels() const {
+            return this->staging != nullptr ? this->stagingData : this->data.data();
+        }
     };
 
-    inline InputImage load_image(const std::string &filename) {
+    // RGBA u8 pixels in memory allocated by stb
+    struct DecodedImage {
+        unsigned width;
+        unsigned height;
+        std::unique_ptr<unsigned char, void(*)(void*)> pixels;
+    };
+
+    inline DecodedImage decode_image(const std::string &filename) {
         // force all images to always open in RGBA format to prevent issues with separate RGB and RGBA loading
         int x, y, channels;
         unsigned char* data = stbi_load(filename.c_str(), &x, &y, &channels, 4);
@@ -40,15 +66,22 @@ namespace IQM::Bin {
             throw std::runtime_error(msg);
         }
 
-        std::vector<unsigned char> dataVec(x * y * 4);
-        memcpy(dataVec.data(), data, x * y * 4 * sizeof(char));
+        return DecodedImage{
+            .width = static_cast<unsigned>(x),
+            .height = static_cast<unsigned>(y),
+            .pixels = {data, stbi_image_free},
+        };
+    }
 
-        stbi_image_free(data);
+    // decodes into host memory, used when the image is not uploaded by the batch executor
+    inline InputImage load_image(const std::string &filename) {
+        const auto decoded = decode_image(filename);
+        const auto size = static_cast<size_t>(decoded.width) * decoded.height * 4;
 
         return InputImage{
-            .width = static_cast<unsigned>(x),
-            .height = static_cast<unsigned>(y),
-            .data = std::move(dataVec)
+            .width = decoded.width,
+            .height = decoded.height,
+            .data = std::vector(decoded.pixels.get(), decoded.pixels.get() + size),
         };
     }
 
@@ -62,7 +95,16 @@ namespace IQM::Bin {
         return result;
     }
 
+    // batch outputs go to a directory which is only created once something is saved into it
+    inline void create_output_dir(const std::string &filename) {
+        const auto dir = std::filesystem::path(filename).parent_path();
+        if (!dir.empty()) {
+            std::filesystem::create_directories(dir);
+        }
+    }
+
     inline void save_char_image(const std::string &filename, const std::vector<unsigned char> &imageData, unsigned int width, unsigned int height) {
+        create_output_dir(filename);
         auto saveResult = stbi_write_png(filename.c_str(), width, height, 1, imageData.data(), width * sizeof(unsigned char));
         if (saveResult == 0) {
             throw std::runtime_error("Failed to save output image");
@@ -70,6 +112,7 @@ namespace IQM::Bin {
     }
 
     inline void save_float_image(const std::string &filename, const std::vector<float> &imageData, unsigned int width, unsigned int height) {
+        create_output_dir(filename);
         const auto converted = convertFloatToChar(imageData);
 
         auto saveResult = stbi_write_png(filename.c_str(), width, height, 1, converted.data(), width * sizeof(unsigned char));
@@ -79,12 +122,100 @@ namespace IQM::Bin {
     }
 
     inline void save_color_image(const std::string &filename, const std::vector<unsigned char> &imageData, unsigned int width, unsigned int height) {
+        create_output_dir(filename);
         auto saveResult = stbi_write_png(filename.c_str(), width, height, 4, imageData.data(), 4 * width * sizeof(unsigned char));
         if (saveResult == 0) {
             throw std::runtime_error("Failed to save output image");
         }
     }
 
+    // side of the square of pixels summarized by one value of the score grid
+    constexpr unsigned SCORE_GRID_CELL = 64;
+
+    enum class ScoreGridFormat {
+        CSV,
+        NPY,
+    };
+
+    // set by `--grid`, the grid is then saved to the output path instead of the output image
+    inline std::optional<ScoreGridFormat> score_grid_format(const std::unordered_map<std::string, std::string> &options) {
+        if (!options.contains("--grid")) {
+            return std::nullopt;
+        }
+        const auto &opt = options.at("--grid");
+        if (opt == "csv" || opt == "CSV") {
+            return ScoreGridFormat::CSV;
+        }
+        if (opt == "npy" || opt == "NPY") {
+            return ScoreGridFormat::NPY;
+        }
+        throw std::invalid_argument("Unknown score grid format '" + opt + "', expected csv or npy");
+    }
+
+    // throws if the score grid is requested from a method which doesn't compute it
+    inline void require_no_score_grid(const std::unordered_map<std::string, std::string> &options, const std::string &method) {
+        if (options.contains("--grid")) {
+            throw std::runtime_error("Score grid is not supported by " + method);
+        }
+    }
+
+    inline std::string score_grid_path(const std::string &outPath, const ScoreGridFormat format) {
+        return std::filesystem::path(outPath).replace_extension(format == ScoreGridFormat::CSV ? ".csv" : ".npy").string();
+    }
+
+    // one row of the grid per line, cells without any weight are written as nan
+    inline void save_grid_csv(const std::string &filename, const std::vector<float> &grid, const unsigned width, const unsigned height) {
+        create_output_dir(filename);
+        std::ofstream output(filename);
+        if (!output) {
+            throw std::runtime_error("Failed to open file '" + filename + "'");
+        }
+
+        output.precision(7);
+        for (unsigned y = 0; y < height; y++) {
+            for (unsigned x = 0; x < width; x++) {
+                const auto value = grid[static_cast<size_t>(y) * width + x];
+                output << (x == 0 ? "" : ",");
+                // sign of NaN is platform specific
+                if (std::isnan(value)) {
+                    output << "nan";
+                } else {
+                    output << value;
+                }
+            }
+            output << '\n';
+        }
+    }
+
+    // little endian f32 array of shape (height, width) in NPY format version 1.0
+    inline void save_grid_npy(const std::string &filename, const std::vector<float> &grid, const unsigned width, const unsigned height) {
+        create_output_dir(filename);
+        std::ofstream output(filename, std::ios::binary);
+        if (!output) {
+            throw std::runtime_error("Failed to open file '" + filename + "'");
+        }
+
+        std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" + std::to_string(height) + ", " + std::to_string(width) + "), }";
+        // magic, version and header length take 10 bytes, data must start aligned to 64 bytes
+        header.append(63 - (10 + header.size()) % 64, ' ');
+        header.push_back('\n');
+
+        const auto headerLength = static_cast<uint16_t>(header.size());
+        const char preamble[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, static_cast<char>(headerLength & 0xff), static_cast<char>(headerLength >> 8)};
+        output.write(preamble, sizeof(preamble));
+        output.write(header.data(), static_cast<std::streamsize>(header.size()));
+        output.write(reinterpret_cast<const char*>(grid.data()), static_cast<std::streamsize>(grid.size() * sizeof(float)));
+    }
+
+    inline void save_score_grid(const std::string &outPath, const ScoreGridFormat format, const std::vector<float> &grid, const unsigned width, const unsigned height) {
+        const auto path = score_grid_path(outPath, format);
+        if (format == ScoreGridFormat::CSV) {
+            save_grid_csv(path, grid, width, height);
+        } else {
+            save_grid_npy(path, grid, width, height);
+        }
+    }
+
     inline std::vector<float> load_model(const std::string &filename) {
         std::string path = std::filesystem::canonical("/proc/self/exe");
         path = path.substr(0, path.rfind('/') + 1);
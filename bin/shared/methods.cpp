@@ -23,6 +23,8 @@ namespace IQM {
                 return "FLIP";
             case Method::LPIPS:
                 return "LPIPS";
+            case Method::MS_SSIM:
+                return "MS-SSIM";
             default:
                 throw std::runtime_error("unknown method");
         }
@@ -0,0 +1,63 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "resource_plan.h"
+
+static unsigned long image_size(const vk::ImageCreateInfo &info) {
+    return static_cast<unsigned long>(vk::blockSize(info.format)) * info.extent.width * info.extent.height * info.extent.depth * info.arrayLayers;
+}
+
+std::pair<vk::raii::Buffer, IQM::Bin::DeviceAllocation> IQM::Bin::PlannedResources::takeBuffer(const unsigned index) {
+    return std::move(this->buffers[index]);
+}
+
+std::shared_ptr<IQM::Bin::VulkanImage> IQM::Bin::PlannedResources::image(const std::optional<unsigned> index) const {
+    return index.has_value() ? this->images[index.value()] : nullptr;
+}
+
+unsigned IQM::Bin::ResourcePlan::buffer(const vk::DeviceSize size, const vk::BufferUsageFlags usage) {
+    this->buffers.push_back(Buffer{.size = size, .usage = usage});
+    return this->buffers.size() - 1;
+}
+
+unsigned IQM::Bin::ResourcePlan::image(const vk::ImageCreateInfo &info) {
+    this->images.push_back(Image{.info = info, .host = false});
+    return this->images.size() - 1;
+}
+
+unsigned IQM::Bin::ResourcePlan::hostImage(const vk::ImageCreateInfo &info) {
+    this->images.push_back(Image{.info = info, .host = true});
+    return this->images.size() - 1;
+}
+
+unsigned IQM::Bin::ResourcePlan::transientImage(const vk::ImageCreateInfo &info, const unsigned firstStep, const unsigned lastStep) {
+    return this->transient.add(info, firstStep, lastStep);
+}
+
+unsigned long IQM::Bin::ResourcePlan::estimate() const {
+    unsigned long size = this->transient.estimateSize();
+    for (const auto &buffer : this->buffers) {
+        size += buffer.size;
+    }
+    for (const auto &image : this->images) {
+        size += image_size(image.info);
+    }
+    return size;
+}
+
+IQM::Bin::PlannedResources IQM::Bin::ResourcePlan::create(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice) const {
+    PlannedResources resources;
+    for (const auto &buffer : this->buffers) {
+        resources.buffers.push_back(VulkanResource::createBuffer(device, physicalDevice, buffer.size, buffer.usage, vk::MemoryPropertyFlagBits::eDeviceLocal));
+    }
+    for (const auto &image : this->images) {
+        auto created = image.host ? VulkanResource::createHostImage(device, physicalDevice, image.info) : VulkanResource::createImage(device, physicalDevice, image.info);
+        resources.images.push_back(std::make_shared<VulkanImage>(std::move(created)));
+    }
+    if (!this->transient.empty()) {
+        resources.transientImages = this->transient.create(device, physicalDevice, resources.transientMemory);
+    }
+    return resources;
+}
@@ -0,0 +1,68 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_RESOURCE_PLAN_H
+#define IQM_BIN_RESOURCE_PLAN_H
+
+#include <memory>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+#include "vulkan_res.h"
+#include "transient_images.h"
+
+namespace IQM::Bin {
+    // resources created from a `ResourcePlan`, looked up by indices returned while planning them
+    struct PlannedResources {
+        std::vector<std::pair<vk::raii::Buffer, DeviceAllocation>> buffers;
+        std::vector<std::shared_ptr<VulkanImage>> images;
+        // backs all transient images, empty without them, declared first so it's freed after them
+        DeviceAllocation transientMemory;
+        std::vector<std::shared_ptr<VulkanImage>> transientImages;
+
+        // moves the buffer out of the list
+        std::pair<vk::raii::Buffer, DeviceAllocation> takeBuffer(unsigned index);
+        // null for images, which weren't planned
+        [[nodiscard]] std::shared_ptr<VulkanImage> image(std::optional<unsigned> index) const;
+    };
+
+    /**
+     * Device local resources of a job, listed once before they are created.
+     *
+     * Wrappers build the plan from the size of a pair, then create their resources from it,
+     * while the scheduler estimates memory of the same pair from the same plan without touching the device.
+     * The estimate assumes tightly packed images, so it ignores alignment and padding of the driver.
+     * Host visible staging buffers aren't part of the plan.
+     */
+    class ResourcePlan {
+    public:
+        // returned indices are per kind of resource
+        unsigned buffer(vk::DeviceSize size, vk::BufferUsageFlags usage);
+        unsigned image(const vk::ImageCreateInfo &info);
+        // image written by the host, see `VulkanResource::createHostImage`
+        unsigned hostImage(const vk::ImageCreateInfo &info);
+        // image sharing memory with others, see `TransientImages`
+        unsigned transientImage(const vk::ImageCreateInfo &info, unsigned firstStep, unsigned lastStep);
+
+        [[nodiscard]] unsigned long estimate() const;
+        [[nodiscard]] PlannedResources create(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice) const;
+    private:
+        struct Buffer {
+            vk::DeviceSize size;
+            vk::BufferUsageFlags usage;
+        };
+        struct Image {
+            vk::ImageCreateInfo info;
+            bool host;
+        };
+
+        std::vector<Buffer> buffers;
+        std::vector<Image> images;
+        TransientImages transient;
+    };
+}
+
+#endif //IQM_BIN_RESOURCE_PLAN_H
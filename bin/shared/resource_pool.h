@@ -0,0 +1,126 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_RESOURCE_POOL_H
+#define IQM_BIN_RESOURCE_POOL_H
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "methods.h"
+#include "vulkan_res.h"
+
+namespace IQM::Bin {
+    struct ResourceKey {
+        Method method;
+        unsigned width;
+        unsigned height;
+        // method specific options that change the allocated resources
+        std::string options;
+
+        bool operator==(const ResourceKey &other) const = default;
+    };
+
+    template<typename T>
+    struct PooledResource {
+        ResourceKey key;
+        std::unique_ptr<T> res;
+        // device local memory held by resources
+        unsigned long size = 0;
+    };
+
+    /**
+     * Cache of per-image resource bundles for batch runs.
+     *
+     * Resources are keyed by method, image size and options affecting allocation,
+     * so pairs sharing resolution reuse buffers and images instead of allocating new ones.
+     * Idle bundles are evicted in LRU order, once they together with the bundle in use exceed the VRAM cap.
+     * Bundles must only be released after the GPU has finished working with them.
+     */
+    template<typename T>
+    class ResourcePool {
+    public:
+        explicit ResourcePool(const unsigned long vramCap) : vramCap(vramCap) {}
+
+        PooledResource<T> acquire(const ResourceKey &key, const std::function<T()> &create) {
+            for (auto it = this->idle.begin(); it != this->idle.end(); ++it) {
+                if (it->key == key) {
+                    auto entry = std::move(*it);
+                    this->used -= entry.size;
+                    this->idle.erase(it);
+                    this->hits++;
+                    return entry;
+                }
+            }
+
+            const auto before = VulkanResource::memCounter();
+            auto res = std::make_unique<T>(create());
+            const auto size = VulkanResource::memCounter() - before;
+
+            this->misses++;
+            this->evict(size);
+
+            return PooledResource<T>{
+                .key = key,
+                .res = std::move(res),
+                .size = size,
+            };
+        }
+
+        void release(PooledResource<T> &&entry) {
+            this->used += entry.size;
+            this->idle.push_front(std::move(entry));
+            this->evict(0);
+        }
+
+        void clear() {
+            this->idle.clear();
+            this->used = 0;
+        }
+
+        [[nodiscard]] unsigned long idleSize() const { return this->used; }
+        [[nodiscard]] unsigned hitCount() const { return this->hits; }
+        [[nodiscard]] unsigned missCount() const { return this->misses; }
+
+    private:
+        void evict(const unsigned long inUse) {
+            while (this->used + inUse > this->vramCap && !this->idle.empty()) {
+                this->used -= this->idle.back().size;
+                this->idle.pop_back();
+            }
+        }
+
+        // most recently used at front
+        std::list<PooledResource<T>> idle;
+        unsigned long vramCap;
+        // size of idle bundles
+        unsigned long used = 0;
+        unsigned hits = 0;
+        unsigned misses = 0;
+    };
+
+    // device memory for all resources of a batch, `--vram-budget` in MB or most of the device budget
+    inline unsigned long vram_budget(const std::unordered_map<std::string, std::string> &options, const vk::raii::PhysicalDevice &physicalDevice) {
+        if (options.contains("--vram-budget")) {
+            return std::stoul(options.at("--vram-budget")) * 1024 * 1024;
+        }
+        // headroom for the driver, pipelines and memory not covered by estimates
+        return VulkanResource::deviceBudget(physicalDevice) / 10 * 9;
+    }
+
+    // `--pool-vram` in MB, by default 2048 MB or half of the VRAM budget, the other half is left to pairs in flight
+    inline unsigned long resource_pool_cap(const std::unordered_map<std::string, std::string> &options, const vk::raii::PhysicalDevice &physicalDevice) {
+        if (options.contains("--pool-vram")) {
+            return std::stoul(options.at("--pool-vram")) * 1024 * 1024;
+        }
+        return std::min(2048ul * 1024 * 1024, vram_budget(options, physicalDevice) / 2);
+    }
+}
+
+#endif //IQM_BIN_RESOURCE_POOL_H
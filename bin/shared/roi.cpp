@@ -0,0 +1,195 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "roi.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "vulkan_res.h"
+
+static vk::Rect2D parse_rect(const std::string &text) {
+    std::stringstream stream(text);
+    std::string value;
+    std::vector<long> values;
+    while (std::getline(stream, value, ',')) {
+        values.push_back(std::stol(value));
+    }
+    if (values.size() != 4 || values[0] < 0 || values[1] < 0 || values[2] <= 0 || values[3] <= 0) {
+        throw std::runtime_error("Invalid rectangle '" + text + "', expected x,y,w,h");
+    }
+
+    return vk::Rect2D{
+        .offset = vk::Offset2D{static_cast<int>(values[0]), static_cast<int>(values[1])},
+        .extent = vk::Extent2D{static_cast<unsigned>(values[2]), static_cast<unsigned>(values[3])},
+    };
+}
+
+std::vector<vk::Rect2D> IQM::Bin::parse_rects(const std::string &text) {
+    std::stringstream list(text);
+    std::string rect;
+    std::vector<vk::Rect2D> rects;
+    while (std::getline(list, rect, ';')) {
+        rects.push_back(parse_rect(rect));
+    }
+    return rects;
+}
+
+IQM::Bin::RegionOfInterest::RegionOfInterest(const std::unordered_map<std::string, std::string> &options) {
+    if (options.contains("--roi") && options.contains("--mask")) {
+        throw std::runtime_error("Only one of --roi and --mask can be set");
+    }
+
+    if (options.contains("--roi")) {
+        this->rects = parse_rects(options.at("--roi"));
+        if (this->rects.empty()) {
+            throw std::runtime_error("Missing region of interest");
+        }
+    }
+
+    if (options.contains("--mask")) {
+        this->image = load_image(options.at("--mask"));
+    }
+}
+
+bool IQM::Bin::RegionOfInterest::enabled() const {
+    return !this->rects.empty() || this->image.has_value();
+}
+
+void IQM::Bin::RegionOfInterest::requireUnset(const std::unordered_map<std::string, std::string> &options, const std::string &method) {
+    if (options.contains("--roi") || options.contains("--mask")) {
+        throw std::runtime_error("Region of interest is not supported by " + method);
+    }
+}
+
+std::vector<float> IQM::Bin::RegionOfInterest::weights(const unsigned width, const unsigned height) const {
+    std::vector<float> weights(static_cast<size_t>(width) * height, 0.0f);
+
+    if (this->image.has_value()) {
+        const auto &image = this->image.value();
+        if (image.width != width || image.height != height) {
+            throw std::runtime_error("Mask of " + std::to_string(image.width) + "x" + std::to_string(image.height) + " doesn't match images of " + std::to_string(width) + "x" + std::to_string(height));
+        }
+        for (size_t i = 0; i < weights.size(); i++) {
+            weights[i] = static_cast<float>(image.pixels()[i * 4]) / 255.0f;
+        }
+        return weights;
+    }
+
+    for (const auto &rect : this->rects) {
+        const unsigned left = rect.offset.x;
+        const auto right = std::min<unsigned>(rect.offset.x + rect.extent.width, width);
+        const auto bottom = std::min<unsigned>(rect.offset.y + rect.extent.height, height);
+        if (left >= right) {
+            continue;
+        }
+        for (unsigned y = rect.offset.y; y < bottom; y++) {
+            const auto row = weights.begin() + static_cast<size_t>(y) * width;
+            std::fill(row + left, row + right, 1.0f);
+        }
+    }
+    return weights;
+}
+
+IQM::Mask IQM::Bin::RegionOfInterest::mask(const IQM::VulkanInstance &instance, const unsigned width, const unsigned height, const unsigned factor, unsigned scaledWidth, unsigned scaledHeight) {
+    const auto key = std::make_tuple(width, height, factor);
+    if (const auto found = this->masks.find(key); found != this->masks.end()) {
+        return IQM::Mask{.buffer = &found->second.buffer, .bounds = found->second.bounds};
+    }
+
+    auto weights = this->weights(width, height);
+    if (factor > 1) {
+        // same squares as the downscaling of the metric, centered on the scaled pixel
+        std::vector<float> scaled(static_cast<size_t>(scaledWidth) * scaledHeight, 0.0f);
+        const int f = static_cast<int>(factor);
+        for (unsigned y = 0; y < scaledHeight; y++) {
+            for (unsigned x = 0; x < scaledWidth; x++) {
+                float sum = 0.0f;
+                for (int i = 0; i < f * f; i++) {
+                    const int j = static_cast<int>(x) * f - f / 2 + i % f;
+                    const int k = static_cast<int>(y) * f - f / 2 + i / f;
+                    if (j >= 0 && j < static_cast<int>(width) && k >= 0 && k < static_cast<int>(height)) {
+                        sum += weights[static_cast<size_t>(k) * width + j];
+                    }
+                }
+                scaled[static_cast<size_t>(y) * scaledWidth + x] = sum / static_cast<float>(f * f);
+            }
+        }
+        weights = std::move(scaled);
+    } else {
+        scaledWidth = width;
+        scaledHeight = height;
+    }
+
+    // bounds of nonzero weights, the metrics skip work outside of them
+    unsigned left = scaledWidth, top = scaledHeight, right = 0, bottom = 0;
+    for (unsigned y = 0; y < scaledHeight; y++) {
+        for (unsigned x = 0; x < scaledWidth; x++) {
+            if (weights[static_cast<size_t>(y) * scaledWidth + x] > 0.0f) {
+                left = std::min(left, x);
+                top = std::min(top, y);
+                right = std::max(right, x + 1);
+                bottom = std::max(bottom, y + 1);
+            }
+        }
+    }
+    if (right == 0) {
+        throw std::runtime_error("Region of interest doesn't cover any pixel of images of " + std::to_string(width) + "x" + std::to_string(height));
+    }
+
+    const auto size = weights.size() * sizeof(float);
+    auto [stgBuffer, stgMemory] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        static_cast<unsigned>(size),
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    auto [buffer, memory] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        static_cast<unsigned>(size),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal
+    );
+
+    void *data = stgMemory.mapMemory(0, size, {});
+    memcpy(data, weights.data(), size);
+    stgMemory.unmapMemory();
+
+    // every metric pass reads all weights in its bounds, so they are read from device memory instead of over PCIe
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    instance.cmdBufTransfer()->copyBuffer(stgBuffer, buffer, {vk::BufferCopy{.srcOffset = 0, .dstOffset = 0, .size = size}});
+    instance.cmdBufTransfer()->end();
+
+    const std::vector cmdBufsCopy = {
+        &**instance.cmdBufTransfer()
+    };
+
+    const vk::SubmitInfo submitInfoCopy{
+        .commandBufferCount = 1,
+        .pCommandBuffers = *cmdBufsCopy.data(),
+    };
+
+    // staging buffer is freed right after, masks are created once per pair size
+    const vk::raii::Fence fenceCopy{*instance.device(), vk::FenceCreateInfo{}};
+    instance.queueTransfer()->submit(submitInfoCopy, *fenceCopy);
+    instance.waitForFence(fenceCopy);
+
+    const auto &inserted = this->masks.emplace(key, RoiMask{
+        .buffer = std::move(buffer),
+        .memory = std::move(memory),
+        .bounds = vk::Rect2D{
+            .offset = vk::Offset2D{static_cast<int>(left), static_cast<int>(top)},
+            .extent = vk::Extent2D{right - left, bottom - top},
+        },
+    }).first->second;
+
+    return IQM::Mask{.buffer = &inserted.buffer, .bounds = inserted.bounds};
+}
@@ -0,0 +1,58 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_ROI_H
+#define IQM_BIN_ROI_H
+
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+#include <IQM/base/mask.h>
+
+#include "vulkan.h"
+#include "device_memory.h"
+#include "io.h"
+
+namespace IQM::Bin {
+    // weights of one resolution in a device local storage buffer, uploaded once and then only read by the metrics
+    struct RoiMask {
+        vk::raii::Buffer buffer = VK_NULL_HANDLE;
+        DeviceAllocation memory;
+        vk::Rect2D bounds;
+    };
+
+    // rectangles `x,y,w,h` separated by `;`
+    std::vector<vk::Rect2D> parse_rects(const std::string &text);
+
+    /**
+     * Region of interest set by `--roi` or `--mask`, applied to every pair.
+     *
+     * `--roi` takes rectangles `x,y,w,h` separated by `;`, pixels inside of them have weight 1
+     * and rectangles are clipped to each pair.
+     * `--mask` takes an image of the size of the pairs, whose red channel is the weight.
+     * Weights are uploaded once per pair size and kept for the lifetime of the job.
+     */
+    class RegionOfInterest {
+    public:
+        explicit RegionOfInterest(const std::unordered_map<std::string, std::string> &options);
+        [[nodiscard]] bool enabled() const;
+        // weights of WxH pairs, metrics evaluated on images downscaled by `factor` average them over its squares
+        IQM::Mask mask(const IQM::VulkanInstance &instance, unsigned width, unsigned height, unsigned factor = 1, unsigned scaledWidth = 0, unsigned scaledHeight = 0);
+        // throws if a region is set for a method which can't weight its result
+        static void requireUnset(const std::unordered_map<std::string, std::string> &options, const std::string &method);
+    private:
+        [[nodiscard]] std::vector<float> weights(unsigned width, unsigned height) const;
+
+        std::vector<vk::Rect2D> rects;
+        std::optional<InputImage> image;
+        // keyed by pair size and downscale factor
+        std::map<std::tuple<unsigned, unsigned, unsigned>, RoiMask> masks;
+    };
+}
+
+#endif //IQM_BIN_ROI_H
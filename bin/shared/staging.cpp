@@ -0,0 +1,104 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "staging.h"
+
+IQM::Bin::StagingPool::StagingPool(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice) :
+    device(device),
+    physicalDevice(physicalDevice),
+    state(std::make_shared<State>()) {}
+
+std::shared_ptr<IQM::Bin::StagingBuffer> IQM::Bin::StagingPool::acquire(const vk::DeviceSize size) {
+    std::unique_ptr<StagingBuffer> buffer;
+    {
+        std::lock_guard lock(this->state->mutex);
+        const auto it = this->state->free.lower_bound(size);
+        if (it != this->state->free.end() && it->first <= 2 * size) {
+            buffer = std::move(it->second);
+            this->state->free.erase(it);
+        }
+    }
+
+    if (buffer == nullptr) {
+        auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+            this->device,
+            this->physicalDevice,
+            size,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            VulkanResource::hostReadMemory(this->physicalDevice)
+        );
+        buffer = std::make_unique<StagingBuffer>(StagingBuffer{
+            .buffer = std::move(stgBuf),
+            .memory = std::move(stgMem),
+            .size = size,
+        });
+        // freeing the memory unmaps it implicitly
+        buffer->mapped = static_cast<unsigned char*>(buffer->memory.mapMemory(0, size));
+    }
+
+    const std::weak_ptr<State> pool = this->state;
+    return std::shared_ptr<StagingBuffer>(buffer.release(), [pool](StagingBuffer *released) {
+        std::unique_ptr<StagingBuffer> owned(released);
+        if (const auto state = pool.lock()) {
+            std::lock_guard lock(state->mutex);
+            if (state->free.size() < MAX_FREE) {
+                const auto bufferSize = owned->size;
+                state->free.emplace(bufferSize, std::move(owned));
+            }
+        }
+    });
+}
+
+void IQM::Bin::StagingPool::flush(const StagingBuffer &buffer) const {
+    buffer.memory.flush();
+}
+
+// 64-bit FNV-1a over whole words, only used to tell pixels apart, so equal hashes are still compared byte by byte
+static uint64_t hash_bytes(const unsigned char *data, const size_t size, uint64_t hash) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(uint64_t));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        // multiplication only carries upwards, so high bits are folded back
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+IQM::Bin::InputImage IQM::Bin::load_image(const std::string &filename, StagingPool &pool, const bool hash) {
+    auto decoded = decode_image(filename);
+    const auto size = static_cast<vk::DeviceSize>(decoded.width) * decoded.height * 4;
+
+    // stb always allocates its own output, so this is the only copy before the GPU reads the image
+    const auto staging = pool.acquire(size);
+    std::optional<uint64_t> contentHash;
+    if (hash) {
+        // each chunk is hashed right after it's copied, while it's still in cache
+        constexpr vk::DeviceSize chunkSize = 256 * 1024;
+        uint64_t value = 0xcbf29ce484222325ull;
+        for (vk::DeviceSize offset = 0; offset < size; offset += chunkSize) {
+            const auto chunk = std::min(chunkSize, size - offset);
+            memcpy(staging->mapped + offset, decoded.pixels.get() + offset, chunk);
+            value = hash_bytes(decoded.pixels.get() + offset, chunk, value);
+        }
+        contentHash = value;
+    } else {
+        memcpy(staging->mapped, decoded.pixels.get(), size);
+    }
+    pool.flush(*staging);
+
+    return InputImage{
+        .width = decoded.width,
+        .height = decoded.height,
+        .data = {},
+        .staging = staging,
+        .stagingData = staging->mapped,
+        .hash = contentHash,
+    };
+}
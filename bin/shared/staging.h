@@ -0,0 +1,62 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_STAGING_H
+#define IQM_BIN_STAGING_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vulkan/vulkan_raii.hpp>
+
+#include "io.h"
+#include "vulkan_res.h"
+
+namespace IQM::Bin {
+    // host visible buffer mapped for its whole lifetime
+    struct StagingBuffer {
+        vk::raii::Buffer buffer = VK_NULL_HANDLE;
+        DeviceAllocation memory;
+        unsigned char *mapped = nullptr;
+        vk::DeviceSize size = 0;
+    };
+
+    /**
+     * Recycles staging buffers, which decoded images are written into, so they can be uploaded without further copies.
+     *
+     * Buffers are acquired from decode threads and return to the pool once the last image using them is destroyed.
+     * A free buffer is reused for requests of at least half of its size, at most `MAX_FREE` buffers are kept.
+     *
+     * Pixels are also read on the host (identical pairs, changed cells, tiles), so host cached memory is preferred.
+     * The device only reads the buffers, so no invalidation is needed, non-coherent memory is flushed by `flush`.
+     */
+    class StagingPool {
+    public:
+        StagingPool(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice);
+        // thread safe
+        std::shared_ptr<StagingBuffer> acquire(vk::DeviceSize size);
+        // makes host writes visible to the device, nothing to do for coherent memory
+        void flush(const StagingBuffer &buffer) const;
+
+        static constexpr unsigned MAX_FREE = 8;
+    private:
+        struct State {
+            // size -> unused buffers
+            std::multimap<vk::DeviceSize, std::unique_ptr<StagingBuffer>> free;
+            std::mutex mutex;
+        };
+
+        const vk::raii::Device &device;
+        const vk::raii::PhysicalDevice &physicalDevice;
+        // shared with released buffers, which may outlive the pool
+        std::shared_ptr<State> state;
+    };
+
+    // decodes an image straight into pooled staging memory, its `data` stays empty, pixels are hashed if `hash` is set
+    InputImage load_image(const std::string &filename, StagingPool &pool, bool hash = false);
+}
+
+#endif //IQM_BIN_STAGING_H
@@ -0,0 +1,140 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "threshold.h"
+
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "executor.h"
+
+IQM::Bin::Thresholds::Thresholds(const Args &args) {
+    if (!args.options.contains("--threshold")) {
+        return;
+    }
+
+    const auto &option = args.options.at("--threshold");
+    // plain value is the limit of the only method
+    if (option.find('=') == std::string::npos) {
+        if (args.methods.size() != 1) {
+            throw std::runtime_error("Threshold of several methods must be given as NAME=VALUE pairs");
+        }
+        this->limits.emplace(value_name(args.method), std::stof(option));
+        return;
+    }
+
+    std::stringstream list(option);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        const auto separator = entry.find('=');
+        if (separator == std::string::npos) {
+            throw std::runtime_error("Invalid threshold '" + entry + "', expected NAME=VALUE");
+        }
+        const auto name = entry.substr(0, separator);
+        // throws for unknown names
+        higher_is_better(name);
+        this->limits.insert_or_assign(name, std::stof(entry.substr(separator + 1)));
+    }
+}
+
+bool IQM::Bin::Thresholds::enabled() const {
+    return !this->limits.empty();
+}
+
+bool IQM::Bin::Thresholds::has(const std::string &name) const {
+    return this->limits.contains(name);
+}
+
+bool IQM::Bin::Thresholds::passes(const std::string &name, const double value) const {
+    const auto limit = this->limits.at(name);
+    return higher_is_better(name) ? value >= limit : value <= limit;
+}
+
+std::optional<bool> IQM::Bin::Thresholds::decide(const std::string &name, const double low, const double high) const {
+    if (!this->has(name)) {
+        return std::nullopt;
+    }
+
+    const bool lowPasses = this->passes(name, low);
+    const bool highPasses = this->passes(name, high);
+    if (lowPasses != highPasses) {
+        return std::nullopt;
+    }
+    return lowPasses;
+}
+
+bool IQM::Bin::Thresholds::judge(std::vector<MetricValue> &values) const {
+    bool passed = true;
+    for (auto &value : values) {
+        if (value.computed && this->has(value.name)) {
+            value.pass = this->passes(value.name, value.value);
+        }
+        if (value.pass.has_value() && !value.pass.value()) {
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+std::string IQM::Bin::value_name(const Method method) {
+    switch (method) {
+        case Method::SVD:
+            return "MSVD";
+        case Method::MS_SSIM:
+            return "MS-SSIM";
+        default:
+            return method_name(method);
+    }
+}
+
+bool IQM::Bin::higher_is_better(const std::string &name) {
+    if (name == "SSIM" || name == "MS-SSIM" || name == "FSIM" || name == "FSIMc" || name == "PSNR") {
+        return true;
+    }
+    if (name == "FLIP" || name == "LPIPS" || name == "MSVD") {
+        return false;
+    }
+    throw std::runtime_error("Unknown threshold '" + name + "'");
+}
+
+bool IQM::Bin::identical_inputs(const DecodedPair &pair) {
+    if (pair.test.width != pair.ref->width || pair.test.height != pair.ref->height) {
+        return false;
+    }
+    // same file decodes to the same pixels
+    if (pair.match.testPath == pair.match.refPath) {
+        return true;
+    }
+    // hashes computed while decoding rule out almost every pair, images are only compared if they match
+    if (!pair.test.hash.has_value() || !pair.ref->hash.has_value() || pair.test.hash != pair.ref->hash) {
+        return false;
+    }
+
+    // pixels are in staging buffers, which are host cached, so reading them back stays cheap
+    const auto size = static_cast<size_t>(pair.test.width) * pair.test.height * 4;
+    return std::memcmp(pair.test.pixels(), pair.ref->pixels(), size) == 0;
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::identical_values(const std::vector<Method> &methods) {
+    std::vector<MetricValue> values;
+    for (const auto method : methods) {
+        switch (method) {
+            case Method::PSNR:
+                values.push_back(MetricValue{.name = "PSNR", .value = std::numeric_limits<float>::infinity(), .unit = " dB"});
+                break;
+            case Method::FSIM:
+                values.push_back(MetricValue{.name = "FSIM", .value = 1.0f, .unit = ""});
+                values.push_back(MetricValue{.name = "FSIMc", .value = 1.0f, .unit = ""});
+                break;
+            default: {
+                const auto name = value_name(method);
+                values.push_back(MetricValue{.name = name, .value = higher_is_better(name) ? 1.0f : 0.0f, .unit = ""});
+            }
+        }
+    }
+    return values;
+}
@@ -0,0 +1,53 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_THRESHOLD_H
+#define IQM_BIN_THRESHOLD_H
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "methods.h"
+#include "../IQM/args.h"
+
+namespace IQM::Bin {
+    struct MetricValue;
+    struct DecodedPair;
+
+    /**
+     * Pass/fail limits set by `--threshold`.
+     *
+     * Takes either a single limit of the only selected method, or `NAME=VALUE` pairs separated by `,`,
+     * keyed by printed value names, e.g. `SSIM=0.98,PSNR=40`.
+     * Similarities (SSIM, MS-SSIM, FSIM, FSIMc and PSNR) pass when they are at least the limit,
+     * distances (FLIP, LPIPS and MSVD) when they are at most the limit.
+     */
+    class Thresholds {
+    public:
+        explicit Thresholds(const Args &args);
+        [[nodiscard]] bool enabled() const;
+        [[nodiscard]] bool has(const std::string &name) const;
+        [[nodiscard]] bool passes(const std::string &name, double value) const;
+        // decision for a value known to lie in [low, high], empty while both outcomes are possible
+        [[nodiscard]] std::optional<bool> decide(const std::string &name, double low, double high) const;
+        // sets `pass` of computed values with a limit, returns false if any value failed
+        bool judge(std::vector<MetricValue> &values) const;
+    private:
+        std::unordered_map<std::string, float> limits;
+    };
+
+    // name of the main value printed by the method
+    std::string value_name(Method method);
+    // whether higher values mean more similar images
+    bool higher_is_better(const std::string &name);
+    // whether both images of the pair hold the same pixels, images without a hash only match if they are the same file
+    bool identical_inputs(const DecodedPair &pair);
+    // values of the methods for identical images, which are known without computing anything
+    std::vector<MetricValue> identical_values(const std::vector<Method> &methods);
+}
+
+#endif //IQM_BIN_THRESHOLD_H
@@ -0,0 +1,145 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "tiling.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// tiles are at most 65536 pixels wide, far above image size limits of devices
+static constexpr unsigned MAX_TILE_GROUPS = 4096;
+
+std::vector<IQM::Bin::AxisTile> IQM::Bin::split_axis(const unsigned length, const unsigned tileLength, const unsigned halo) {
+    if (length <= tileLength) {
+        return {AxisTile{.start = 0, .coreStart = 0, .coreEnd = length}};
+    }
+
+    // tiles on the image border don't need halo on that side, since the kernel is clamped the same way
+    const auto step = tileLength - 2 * halo;
+    const auto count = (length - 2 * halo + step - 1) / step;
+
+    std::vector<AxisTile> tiles;
+    for (unsigned i = 0; i < count; i++) {
+        const auto start = std::min(i * step, length - tileLength);
+        tiles.push_back(AxisTile{
+            .start = start,
+            .coreStart = i == 0 ? 0 : start + halo,
+            .coreEnd = length,
+        });
+        if (i != 0) {
+            tiles[i - 1].coreEnd = tiles[i].coreStart;
+        }
+    }
+    return tiles;
+}
+
+IQM::Bin::TileGrid::TileGrid(const unsigned width, const unsigned height, const unsigned tileSize, const unsigned halo) :
+    width(width),
+    height(height),
+    tileWidth(std::min(width, tileSize)),
+    tileHeight(std::min(height, tileSize)) {
+    if (tileSize <= 2 * halo) {
+        throw std::runtime_error("Tile size " + std::to_string(tileSize) + " is too small for halo of " + std::to_string(halo) + " pixels");
+    }
+
+    const auto columns = split_axis(width, this->tileWidth, halo);
+    const auto rows = split_axis(height, this->tileHeight, halo);
+    for (const auto &row : rows) {
+        for (const auto &column : columns) {
+            this->tiles.push_back(Tile{
+                .x = column.start,
+                .y = row.start,
+                .coreX = column.coreStart,
+                .coreY = row.coreStart,
+                .coreWidth = column.coreEnd - column.coreStart,
+                .coreHeight = row.coreEnd - row.coreStart,
+            });
+        }
+    }
+}
+
+IQM::Bin::TileGrid::TileGrid(const unsigned width, const unsigned height, const unsigned tileWidth, const unsigned tileHeight, const Tile &tile) :
+    width(width),
+    height(height),
+    tileWidth(tileWidth),
+    tileHeight(tileHeight),
+    tiles({tile}) {
+}
+
+std::optional<unsigned long> IQM::Bin::tile_budget(const std::unordered_map<std::string, std::string> &options) {
+    if (!options.contains("--tile-vram")) {
+        return std::nullopt;
+    }
+    return std::stoul(options.at("--tile-vram")) * 1024 * 1024;
+}
+
+unsigned IQM::Bin::tile_size(const unsigned long budget, const TileMemory &memory, const unsigned halo) {
+    // whole workgroups of the 16x16 shaders, memory grows with the side, so the largest fitting one is bisected
+    unsigned fits = 0;
+    unsigned exceeds = 1;
+    while (exceeds <= MAX_TILE_GROUPS && memory(exceeds * 16, exceeds * 16) <= budget) {
+        fits = exceeds;
+        exceeds *= 2;
+    }
+    exceeds = std::min(exceeds, MAX_TILE_GROUPS + 1);
+    while (exceeds - fits > 1) {
+        const auto middle = (fits + exceeds) / 2;
+        if (memory(middle * 16, middle * 16) <= budget) {
+            fits = middle;
+        } else {
+            exceeds = middle;
+        }
+    }
+
+    const auto side = fits * 16;
+    if (side <= 2 * halo) {
+        throw std::runtime_error("Tile VRAM budget is too small for the kernel size");
+    }
+    return side;
+}
+
+std::optional<unsigned long> IQM::Bin::pair_tile_budget(const std::optional<unsigned long> &tileBudget, const std::optional<unsigned long> &memoryBudget, const unsigned width, const unsigned height, const TileMemory &memory) {
+    if (tileBudget.has_value()) {
+        return tileBudget;
+    }
+    if (memoryBudget.has_value() && memory(width, height) > memoryBudget.value()) {
+        return memoryBudget;
+    }
+    return std::nullopt;
+}
+
+unsigned long IQM::Bin::pair_memory(const unsigned width, const unsigned height, const TileMemory &memory, const unsigned halo, const std::optional<unsigned long> &tileBudget) {
+    if (!tileBudget.has_value()) {
+        return memory(width, height);
+    }
+
+    // same tile size as the grid
+    const auto side = tile_size(tileBudget.value(), memory, halo);
+    return memory(std::min(width, side), std::min(height, side));
+}
+
+IQM::Bin::InputImage IQM::Bin::crop_tile(const InputImage &image, const TileGrid &grid, const Tile &tile) {
+    InputImage result{
+        .width = grid.tileWidth,
+        .height = grid.tileHeight,
+        .data = std::vector<unsigned char>(grid.tileWidth * grid.tileHeight * 4),
+    };
+
+    const auto rowSize = grid.tileWidth * 4;
+    for (unsigned y = 0; y < grid.tileHeight; y++) {
+        const auto src = image.pixels() + (static_cast<size_t>(tile.y + y) * image.width + tile.x) * 4;
+        std::copy_n(src, rowSize, result.data.data() + static_cast<size_t>(y) * rowSize);
+    }
+    return result;
+}
+
+void IQM::Bin::stitch_tile(std::vector<unsigned char> &map, const std::vector<unsigned char> &tileMap, const unsigned channels, const TileGrid &grid, const Tile &tile) {
+    const auto rowSize = tile.coreWidth * channels;
+    for (unsigned y = 0; y < tile.coreHeight; y++) {
+        const auto src = tileMap.data() + (static_cast<size_t>(tile.coreY - tile.y + y) * grid.tileWidth + (tile.coreX - tile.x)) * channels;
+        const auto dst = map.data() + (static_cast<size_t>(tile.coreY + y) * grid.width + tile.coreX) * channels;
+        std::copy_n(src, rowSize, dst);
+    }
+}
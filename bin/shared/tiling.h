@@ -0,0 +1,87 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_TILING_H
+#define IQM_BIN_TILING_H
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "io.h"
+
+namespace IQM::Bin {
+    struct Tile {
+        // top left corner of the processed region, which has the size of the grid tile
+        unsigned x, y;
+        // region of the output owned by this tile, in image coordinates
+        unsigned coreX, coreY, coreWidth, coreHeight;
+    };
+
+    // tile along one axis of the image, core ends where the next tile's core starts
+    struct AxisTile {
+        unsigned start;
+        unsigned coreStart;
+        unsigned coreEnd;
+    };
+
+    // overlapping `tileLength` tiles of one axis, the last one is shifted inwards to end at the image border
+    std::vector<AxisTile> split_axis(unsigned length, unsigned tileLength, unsigned halo);
+
+    /**
+     * Split of an image into overlapping tiles of equal size, for computing metrics with bounded device memory.
+     *
+     * Every tile is extended by `halo` pixels on each side, so pixels of its core see the same neighbourhood
+     * as in the full image. Tiles on image borders are shifted inwards instead of being cut,
+     * so all tiles share resources of one size. Cores don't overlap and together cover the whole image.
+     */
+    class TileGrid {
+    public:
+        TileGrid(unsigned width, unsigned height, unsigned tileSize, unsigned halo);
+        // grid of a single `tileWidth`x`tileHeight` tile, used to recompute one region of the image
+        TileGrid(unsigned width, unsigned height, unsigned tileWidth, unsigned tileHeight, const Tile &tile);
+
+        unsigned width, height;
+        unsigned tileWidth, tileHeight;
+        std::vector<Tile> tiles;
+    };
+
+    // progress of a pair computed tile by tile, decoded images stay in host memory
+    struct TiledPair {
+        TileGrid grid;
+        const InputImage *test;
+        const InputImage *ref;
+        unsigned current = 0;
+        // output map of the whole image, stitched from tile cores
+        std::vector<unsigned char> map;
+        // per-pixel sum of the metric over finished tiles
+        double sum = 0;
+        // pixels of finished tile cores
+        double area = 0;
+        // set in threshold mode once finished tiles decide whether the pair passes, remaining tiles are skipped
+        std::optional<bool> decided;
+    };
+
+    // device memory budget per tile from `--tile-vram` in MB, tiling is disabled when not set
+    std::optional<unsigned long> tile_budget(const std::unordered_map<std::string, std::string> &options);
+    // device memory of resources for a `width`x`height` tile, from the resource plan of the method
+    using TileMemory = std::function<unsigned long(unsigned width, unsigned height)>;
+
+    // largest tile side, whose resources fit into the budget
+    unsigned tile_size(unsigned long budget, const TileMemory &memory, unsigned halo);
+    // tile budget of a pair, `--tile-vram` if set, otherwise the memory budget if the whole pair doesn't fit into it
+    std::optional<unsigned long> pair_tile_budget(const std::optional<unsigned long> &tileBudget, const std::optional<unsigned long> &memoryBudget, unsigned width, unsigned height, const TileMemory &memory);
+    // device memory of resources for a pair, which is computed in tiles if the tile budget is set
+    unsigned long pair_memory(unsigned width, unsigned height, const TileMemory &memory, unsigned halo, const std::optional<unsigned long> &tileBudget);
+
+    // copies processed region of a tile out of a full RGBA u8 image
+    InputImage crop_tile(const InputImage &image, const TileGrid &grid, const Tile &tile);
+    // copies core of a tile map into the full map, both with `channels` bytes per pixel
+    void stitch_tile(std::vector<unsigned char> &map, const std::vector<unsigned char> &tileMap, unsigned channels, const TileGrid &grid, const Tile &tile);
+}
+
+#endif //IQM_BIN_TILING_H
@@ -0,0 +1,122 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "transient_images.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+IQM::Bin::TransientPlacement IQM::Bin::place_transient(const std::vector<TransientSlot> &slots) {
+    std::vector<unsigned> order(slots.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&](const unsigned a, const unsigned b) { return slots[a].size > slots[b].size; });
+
+    TransientPlacement placement{
+        .offsets = std::vector<unsigned long>(slots.size()),
+    };
+    auto &offsets = placement.offsets;
+    // already placed slots, sorted by offset
+    std::vector<unsigned> placed;
+    for (const auto index : order) {
+        const auto &slot = slots[index];
+
+        unsigned long offset = 0;
+        for (const auto other : placed) {
+            const auto &otherSlot = slots[other];
+            if (otherSlot.lastStep < slot.firstStep || slot.lastStep < otherSlot.firstStep) {
+                continue;
+            }
+
+            const auto otherEnd = offsets[other] + otherSlot.size;
+            if (otherEnd <= offset) {
+                continue;
+            }
+            if (offset + slot.size <= offsets[other]) {
+                break;
+            }
+            offset = (otherEnd + slot.alignment - 1) / slot.alignment * slot.alignment;
+        }
+
+        offsets[index] = offset;
+        placement.size = std::max(placement.size, offset + slot.size);
+        placed.insert(std::ranges::upper_bound(placed, offset, {}, [&](const unsigned i) { return offsets[i]; }), index);
+    }
+
+    return placement;
+}
+
+unsigned IQM::Bin::TransientImages::add(const vk::ImageCreateInfo &info, const unsigned firstStep, const unsigned lastStep) {
+    this->entries.push_back(Entry{
+        .info = info,
+        .firstStep = firstStep,
+        .lastStep = lastStep,
+    });
+    return this->entries.size() - 1;
+}
+
+std::vector<std::shared_ptr<IQM::Bin::VulkanImage>> IQM::Bin::TransientImages::create(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice, DeviceAllocation &memory) const {
+    std::vector<vk::raii::Image> images;
+    std::vector<vk::MemoryRequirements> requirements;
+    vk::MemoryRequirements total{
+        .size = 0,
+        .alignment = 1,
+        .memoryTypeBits = ~0u,
+    };
+
+    for (const auto &entry : this->entries) {
+        auto &image = images.emplace_back(device, entry.info);
+        const auto &imageRequirements = requirements.emplace_back(image.getMemoryRequirements());
+        total.alignment = std::max(total.alignment, imageRequirements.alignment);
+        total.memoryTypeBits &= imageRequirements.memoryTypeBits;
+    }
+
+    if (total.memoryTypeBits == 0) {
+        throw std::runtime_error("Transient images have no common memory type");
+    }
+
+    std::vector<TransientSlot> slots;
+    for (unsigned i = 0; i < this->entries.size(); i++) {
+        slots.push_back(TransientSlot{
+            .size = requirements[i].size,
+            .alignment = requirements[i].alignment,
+            .firstStep = this->entries[i].firstStep,
+            .lastStep = this->entries[i].lastStep,
+        });
+    }
+    const auto placement = place_transient(slots);
+    const auto &offsets = placement.offsets;
+    total.size = placement.size;
+
+    memory = VulkanResource::allocateImageMemory(device, physicalDevice, total);
+
+    std::vector<std::shared_ptr<VulkanImage>> result;
+    for (unsigned i = 0; i < images.size(); i++) {
+        images[i].bindMemory(*memory.memory(), memory.offset() + offsets[i]);
+        auto imageView = VulkanResource::createImageView(device, images[i], this->entries[i].info.format);
+
+        result.push_back(std::make_shared<VulkanImage>(VulkanImage{
+            .image = std::move(images[i]),
+            .imageView = std::move(imageView),
+            .width = this->entries[i].info.extent.width,
+            .height = this->entries[i].info.extent.height,
+        }));
+    }
+
+    return result;
+}
+
+unsigned long IQM::Bin::TransientImages::estimateSize() const {
+    std::vector<TransientSlot> slots;
+    for (const auto &entry : this->entries) {
+        slots.push_back(TransientSlot{
+            .size = static_cast<unsigned long>(vk::blockSize(entry.info.format)) * entry.info.extent.width * entry.info.extent.height * entry.info.extent.depth * entry.info.arrayLayers,
+            .alignment = 1,
+            .firstStep = entry.firstStep,
+            .lastStep = entry.lastStep,
+        });
+    }
+    return place_transient(slots).size;
+}
@@ -0,0 +1,64 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_TRANSIENT_IMAGES_H
+#define IQM_BIN_TRANSIENT_IMAGES_H
+
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+#include "vulkan_res.h"
+
+namespace IQM::Bin {
+    // memory needed by one transient image, steps are inclusive
+    struct TransientSlot {
+        unsigned long size;
+        unsigned long alignment;
+        unsigned firstStep;
+        unsigned lastStep;
+    };
+
+    struct TransientPlacement {
+        // offset of each slot in the shared memory
+        std::vector<unsigned long> offsets;
+        unsigned long size = 0;
+    };
+
+    // greedy placement used by `TransientImages`, slots alive at the same step don't overlap
+    TransientPlacement place_transient(const std::vector<TransientSlot> &slots);
+
+    /**
+     * Places intermediate images of one job into shared memory, based on their lifetimes.
+     *
+     * Each image is given the range of method steps during which its contents are used,
+     * images with overlapping ranges get disjoint memory, others may share it.
+     * Images are placed greedily from the largest, each at the lowest offset not taken
+     * by an already placed image alive at the same time.
+     *
+     * Contents of an image are lost whenever an image sharing its memory is written,
+     * so the method must transition it from undefined layout before its first write.
+     */
+    class TransientImages {
+    public:
+        // returns index of the image in the result of `create`, steps are inclusive
+        unsigned add(const vk::ImageCreateInfo &info, unsigned firstStep, unsigned lastStep);
+        // all images are backed by a single allocation, which is moved into `memory`
+        std::vector<std::shared_ptr<VulkanImage>> create(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice, DeviceAllocation &memory) const;
+        [[nodiscard]] bool empty() const { return this->entries.empty(); }
+        // size of the shared memory from tightly packed images, without creating them
+        [[nodiscard]] unsigned long estimateSize() const;
+    private:
+        struct Entry {
+            vk::ImageCreateInfo info;
+            unsigned firstStep;
+            unsigned lastStep;
+        };
+
+        std::vector<Entry> entries;
+    };
+}
+
+#endif //IQM_BIN_TRANSIENT_IMAGES_H
@@ -17,6 +17,14 @@ namespace IQM {
         virtual const std::shared_ptr<const vk::raii::CommandBuffer> cmdBufTransfer() const = 0;
         virtual const std::shared_ptr<const vk::raii::Queue> queue() const = 0;
         virtual const std::shared_ptr<const vk::raii::Queue> queueTransfer() const = 0;
+        virtual uint32_t queueFamily() const = 0;
+        virtual uint32_t queueFamilyTransfer() const = 0;
+        // R f16 storage images, the `shaderStorageImageExtendedFormats` feature is enabled when the device has it
+        virtual bool halfStorageImages() const = 0;
+        // nullptr if pipelines are not cached
+        virtual const vk::raii::PipelineCache* pipelineCache() const = 0;
+        // persists pipelines created since the last save
+        virtual void savePipelineCache() const = 0;
 
         virtual void waitForFence(const vk::raii::Fence &fence) const = 0;
     };
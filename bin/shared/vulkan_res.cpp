@@ -5,28 +5,99 @@
 
 #include "vulkan_res.h"
 
-uint32_t IQM::Bin::VulkanResource::findMemoryType(vk::PhysicalDeviceMemoryProperties const &memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask) {
-    auto typeIndex = static_cast<uint32_t>(~0);
+#include <cstring>
+#include <stdexcept>
+
+std::optional<uint32_t> IQM::Bin::VulkanResource::tryFindMemoryType(vk::PhysicalDeviceMemoryProperties const &memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask) {
     for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
         if ((typeBits & 1) && ((memoryProperties.memoryTypes[i].propertyFlags & requirementsMask) == requirementsMask)) {
-            typeIndex = i;
-            break;
+            return i;
         }
         typeBits >>= 1;
     }
-    assert(typeIndex != static_cast<uint32_t>(~0));
-    return typeIndex;
+    return std::nullopt;
+}
+
+uint32_t IQM::Bin::VulkanResource::findMemoryType(vk::PhysicalDeviceMemoryProperties const &memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask) {
+    const auto typeIndex = tryFindMemoryType(memoryProperties, typeBits, requirementsMask);
+    assert(typeIndex.has_value());
+    return typeIndex.value();
+}
+
+bool IQM::Bin::VulkanResource::unifiedMemory(const vk::raii::PhysicalDevice &physicalDevice) {
+    const auto type = physicalDevice.getProperties().deviceType;
+    if (type != vk::PhysicalDeviceType::eIntegratedGpu && type != vk::PhysicalDeviceType::eCpu) {
+        // resizable BAR makes memory of discrete GPUs host visible too, but host access goes over PCIe
+        return false;
+    }
+
+    const auto flags = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    return tryFindMemoryType(physicalDevice.getMemoryProperties(), ~0u, flags).has_value();
+}
+
+vk::MemoryPropertyFlags IQM::Bin::VulkanResource::hostReadMemory(const vk::raii::PhysicalDevice &physicalDevice) {
+    const auto properties = physicalDevice.getMemoryProperties();
+    // reads of uncached memory bypass CPU caches, which makes them an order of magnitude slower
+    for (const auto flags : {
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached | vk::MemoryPropertyFlagBits::eHostCoherent,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached,
+    }) {
+        if (tryFindMemoryType(properties, ~0u, flags).has_value()) {
+            return flags;
+        }
+    }
+    return vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
 }
 
-std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> IQM::Bin::VulkanResource::createBuffer(
+unsigned long IQM::Bin::VulkanResource::deviceBudget(const vk::raii::PhysicalDevice &physicalDevice) {
+    bool budgetSupported = false;
+    for (const auto &extension : physicalDevice.enumerateDeviceExtensionProperties()) {
+        if (strcmp(extension.extensionName.data(), VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            budgetSupported = true;
+        }
+    }
+
+    unsigned long budget = 0;
+    if (budgetSupported) {
+        // the budget accounts for memory used by other processes, and includes memory already used by this one
+        const auto chain = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const auto &properties = chain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+        const auto &budgetProperties = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+            if (properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+                budget += budgetProperties.heapBudget[i];
+            }
+        }
+        return budget;
+    }
+
+    const auto properties = physicalDevice.getMemoryProperties();
+    for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+        if (properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+            budget += properties.memoryHeaps[i].size;
+        }
+    }
+    return budget;
+}
+
+IQM::Bin::DeviceAllocation IQM::Bin::VulkanResource::allocateDeviceLocal(const vk::raii::Device &device, const vk::MemoryRequirements &requirements, const MemoryKind kind) {
+    allocateSum += requirements.size;
+
+    if (auto *arena = ArenaScope::current(); arena != nullptr) {
+        return arena->allocate(device, requirements, kind);
+    }
+    if (heap == nullptr) {
+        throw std::runtime_error("Device memory heap is not set, resources can only be created while the instance exists");
+    }
+    return heap->allocate(device, requirements, kind);
+}
+
+std::pair<vk::raii::Buffer, IQM::Bin::DeviceAllocation> IQM::Bin::VulkanResource::createBuffer(
     const vk::raii::Device &device,
     const vk::raii::PhysicalDevice &physicalDevice,
     unsigned bufferSize,
     vk::BufferUsageFlags bufferFlags,
     vk::MemoryPropertyFlags memoryFlags) {
-    // create now, so it's destroyed before buffer
-    vk::raii::DeviceMemory memory{nullptr};
-
     vk::BufferCreateInfo bufferCreateInfo{
         .size = bufferSize,
         .usage = bufferFlags,
@@ -40,16 +111,21 @@ std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> IQM::Bin::VulkanResource::cr
         memoryFlags
     );
 
-    vk::MemoryAllocateInfo memoryAllocateInfo{
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = memType
-    };
-
-    if (memoryFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) {
-        allocateSum += memReqs.size;
+    DeviceAllocation memory;
+    if (memoryFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+        // mapped memory can't be shared, mapping the same VkDeviceMemory twice is not allowed
+        vk::MemoryAllocateInfo memoryAllocateInfo{
+            .allocationSize = memReqs.size,
+            .memoryTypeIndex = memType
+        };
+        // type found for the flags may still be coherent, even if it wasn't required
+        const auto coherent = static_cast<bool>(physicalDevice.getMemoryProperties().memoryTypes[memType].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+        memory = DeviceAllocation::dedicated(vk::raii::DeviceMemory{device, memoryAllocateInfo}, memReqs.size, coherent);
+    } else {
+        memory = allocateDeviceLocal(device, memReqs, MemoryKind{.memoryType = memType, .image = false});
     }
 
-    memory = vk::raii::DeviceMemory{device, memoryAllocateInfo};
+    buffer.bindMemory(*memory.memory(), memory.offset());
 
     return std::make_pair(std::move(buffer), std::move(memory));
 }
@@ -58,9 +134,6 @@ IQM::Bin::VulkanImage IQM::Bin::VulkanResource::createImage(
     const vk::raii::Device &device,
     const vk::raii::PhysicalDevice &physicalDevice,
     const vk::ImageCreateInfo &imageInfo) {
-    // create now, so it's destroyed before buffer
-    vk::raii::DeviceMemory memory{nullptr};
-
     vk::raii::Image image{device, imageInfo};
     auto memReqs = image.getMemoryRequirements();
     const auto memType = findMemoryType(
@@ -69,20 +142,99 @@ IQM::Bin::VulkanImage IQM::Bin::VulkanResource::createImage(
         vk::MemoryPropertyFlagBits::eDeviceLocal
     );
 
+    // optimal tiling is assumed, so images get blocks separate from buffers
+    auto memory = allocateDeviceLocal(device, memReqs, MemoryKind{.memoryType = memType, .image = true});
+    image.bindMemory(*memory.memory(), memory.offset());
+
+    auto imageView = createImageView(device, image, imageInfo.format);
+
+    return VulkanImage{
+        .memory = std::move(memory),
+        .image = std::move(image),
+        .imageView = std::move(imageView),
+        .width = imageInfo.extent.width,
+        .height = imageInfo.extent.height,
+    };
+}
+
+IQM::Bin::VulkanImage IQM::Bin::VulkanResource::createHostImage(
+    const vk::raii::Device &device,
+    const vk::raii::PhysicalDevice &physicalDevice,
+    const vk::ImageCreateInfo &imageInfo) {
+    if (!unifiedMemory(physicalDevice)) {
+        return createImage(device, physicalDevice, imageInfo);
+    }
+
+    vk::ImageCreateInfo linearInfo = {imageInfo};
+    linearInfo.tiling = vk::ImageTiling::eLinear;
+    linearInfo.initialLayout = vk::ImageLayout::ePreinitialized;
+
+    // linear tiling may not support all usages of the format, or the full extent
+    try {
+        const auto properties = physicalDevice.getImageFormatProperties(linearInfo.format, linearInfo.imageType, linearInfo.tiling, linearInfo.usage, linearInfo.flags);
+        if (properties.maxExtent.width < linearInfo.extent.width || properties.maxExtent.height < linearInfo.extent.height) {
+            return createImage(device, physicalDevice, imageInfo);
+        }
+    } catch (const vk::FormatNotSupportedError&) {
+        return createImage(device, physicalDevice, imageInfo);
+    }
+
+    vk::raii::Image image{device, linearInfo};
+    const auto memReqs = image.getMemoryRequirements();
+    const auto memType = tryFindMemoryType(
+        physicalDevice.getMemoryProperties(),
+        memReqs.memoryTypeBits,
+        vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    if (!memType.has_value()) {
+        return createImage(device, physicalDevice, imageInfo);
+    }
+
+    // mapped memory can't be shared
     vk::MemoryAllocateInfo memoryAllocateInfo{
         .allocationSize = memReqs.size,
-        .memoryTypeIndex = memType
+        .memoryTypeIndex = memType.value(),
     };
-
+    auto memory = DeviceAllocation::dedicated(vk::raii::DeviceMemory{device, memoryAllocateInfo}, memReqs.size);
     allocateSum += memReqs.size;
+    image.bindMemory(*memory.memory(), memory.offset());
 
-    memory = vk::raii::DeviceMemory{device, memoryAllocateInfo};
-    image.bindMemory(memory, 0);
+    const auto layout = image.getSubresourceLayout(vk::ImageSubresource{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .arrayLayer = 0});
+    // freeing the memory unmaps it implicitly
+    auto *mapped = static_cast<unsigned char*>(memory.mapMemory(0, memReqs.size)) + layout.offset;
 
+    auto imageView = createImageView(device, image, imageInfo.format);
+
+    return VulkanImage{
+        .memory = std::move(memory),
+        .image = std::move(image),
+        .imageView = std::move(imageView),
+        .width = imageInfo.extent.width,
+        .height = imageInfo.extent.height,
+        .mapped = mapped,
+        .rowPitch = layout.rowPitch,
+        .preinitialized = true,
+    };
+}
+
+IQM::Bin::DeviceAllocation IQM::Bin::VulkanResource::allocateImageMemory(
+    const vk::raii::Device &device,
+    const vk::raii::PhysicalDevice &physicalDevice,
+    const vk::MemoryRequirements &requirements) {
+    const auto memType = findMemoryType(
+        physicalDevice.getMemoryProperties(),
+        requirements.memoryTypeBits,
+        vk::MemoryPropertyFlagBits::eDeviceLocal
+    );
+
+    return allocateDeviceLocal(device, requirements, MemoryKind{.memoryType = memType, .image = true});
+}
+
+vk::raii::ImageView IQM::Bin::VulkanResource::createImageView(const vk::raii::Device &device, const vk::raii::Image &image, const vk::Format format) {
     vk::ImageViewCreateInfo imageViewCreateInfo{
         .image = image,
         .viewType = vk::ImageViewType::e2D,
-        .format = imageInfo.format,
+        .format = format,
         .subresourceRange = vk::ImageSubresourceRange{
             .aspectMask = vk::ImageAspectFlagBits::eColor,
             .baseMipLevel = 0,
@@ -92,13 +244,7 @@ IQM::Bin::VulkanImage IQM::Bin::VulkanResource::createImage(
         }
     };
 
-    return VulkanImage{
-        .memory = std::move(memory),
-        .image = std::move(image),
-        .imageView = vk::raii::ImageView{device, imageViewCreateInfo},
-        .width = imageInfo.extent.width,
-        .height = imageInfo.extent.height,
-    };
+    return vk::raii::ImageView{device, imageViewCreateInfo};
 }
 
 void IQM::Bin::VulkanResource::initImages(const vk::raii::CommandBuffer &cmd_buf, const std::vector<std::shared_ptr<VulkanImage>>& images) {
@@ -108,8 +254,17 @@ void IQM::Bin::VulkanResource::initImages(const vk::raii::CommandBuffer &cmd_buf
 
     vk::ImageSubresourceRange imageSubresourceRange(aspectMask, 0, 1, 0, 1);
     for (uint32_t i = 0; i < barriers.size(); i++) {
+        // contents written by the host must survive the transition
+        auto oldLayout = vk::ImageLayout::eUndefined;
+        if (images[i]->preinitialized) {
+            oldLayout = vk::ImageLayout::ePreinitialized;
+            images[i]->preinitialized = false;
+        } else if (images[i]->mapped != nullptr) {
+            oldLayout = vk::ImageLayout::eGeneral;
+        }
+
         barriers[i] = vk::ImageMemoryBarrier{
-            .oldLayout = vk::ImageLayout::eUndefined,
+            .oldLayout = oldLayout,
             .newLayout = vk::ImageLayout::eGeneral,
             .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
             .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
@@ -6,22 +6,32 @@
 #ifndef IQM_VULKAN_RESOURCE_H
 #define IQM_VULKAN_RESOURCE_H
 
+#include <optional>
 #include <vulkan/vulkan_raii.hpp>
 
+#include "device_memory.h"
+
 namespace IQM::Bin {
     class VulkanImage {
     public:
-        vk::raii::DeviceMemory memory = VK_NULL_HANDLE;
+        DeviceAllocation memory;
         vk::raii::Image image = VK_NULL_HANDLE;
         vk::raii::ImageView imageView = VK_NULL_HANDLE;
 
         uint32_t width = 0;
         uint32_t height = 0;
+
+        // set for linear images written by the host, points to the first row
+        unsigned char *mapped = nullptr;
+        vk::DeviceSize rowPitch = 0;
+        // host written contents weren't transitioned to general layout yet
+        bool preinitialized = false;
     };
 
     class VulkanResource {
     public:
-        [[nodiscard]] static std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> createBuffer(
+        // buffer is already bound, host visible memory is allocated on its own so it can be mapped
+        [[nodiscard]] static std::pair<vk::raii::Buffer, DeviceAllocation> createBuffer(
             const vk::raii::Device &device,
             const vk::raii::PhysicalDevice &physicalDevice,
             unsigned bufferSize,
@@ -31,13 +41,37 @@ namespace IQM::Bin {
             const vk::raii::Device &device,
             const vk::raii::PhysicalDevice &physicalDevice,
             const vk::ImageCreateInfo &imageInfo);
+        // on unified memory devices creates a linear image mapped for host writes, otherwise same as `createImage`
+        [[nodiscard]] static VulkanImage createHostImage(
+            const vk::raii::Device &device,
+            const vk::raii::PhysicalDevice &physicalDevice,
+            const vk::ImageCreateInfo &imageInfo);
+        // device local memory for images bound by the caller, such as `TransientImages`
+        [[nodiscard]] static DeviceAllocation allocateImageMemory(const vk::raii::Device &device, const vk::raii::PhysicalDevice &physicalDevice, const vk::MemoryRequirements &requirements);
+        [[nodiscard]] static vk::raii::ImageView createImageView(const vk::raii::Device &device, const vk::raii::Image &image, vk::Format format);
+        // host visible memory for buffers also read by the host, cached if the device has it, coherent if possible,
+        // allocations of it are flushed after host writes and invalidated before host reads
+        [[nodiscard]] static vk::MemoryPropertyFlags hostReadMemory(const vk::raii::PhysicalDevice &physicalDevice);
+        // integrated GPUs and CPU implementations, whose device local memory is also host visible
+        [[nodiscard]] static bool unifiedMemory(const vk::raii::PhysicalDevice &physicalDevice);
+        // device local memory this process may use, from VK_EXT_memory_budget if supported, otherwise size of the heaps
+        [[nodiscard]] static unsigned long deviceBudget(const vk::raii::PhysicalDevice &physicalDevice);
         static void initImages(const vk::raii::CommandBuffer &cmd_buf, const std::vector<std::shared_ptr<VulkanImage>> &images);
         static void resetMemCounter() { allocateSum = 0; }
         static void addMemCounter(unsigned long mem) { allocateSum += mem; }
+        // device local memory bound to resources created on this thread since last reset
         static unsigned long memCounter() { return allocateSum; }
+        static const DeviceMemoryHeap& memoryHeap() { return *heap; }
+        // heap of the instance, set while its device exists, resources can only be created in between
+        static void useHeap(DeviceMemoryHeap *instanceHeap) { heap = instanceHeap; }
     private:
-        inline static unsigned long allocateSum;
+        // per thread, so sizes measured around resource creation don't include allocations of other threads
+        inline static thread_local unsigned long allocateSum = 0;
+        // device local memory of resources created outside of an `ArenaScope`, owned by the instance
+        inline static DeviceMemoryHeap *heap = nullptr;
+        static DeviceAllocation allocateDeviceLocal(const vk::raii::Device &device, const vk::MemoryRequirements &requirements, MemoryKind kind);
         static uint32_t findMemoryType(vk::PhysicalDeviceMemoryProperties const &memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask);
+        static std::optional<uint32_t> tryFindMemoryType(vk::PhysicalDeviceMemoryProperties const &memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask);
     };
 }
 
@@ -4,177 +4,242 @@
  */
 
 #include <iostream>
+#include <limits>
 #include "flip.h"
 #include "../../shared/debug_utils.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
 #include "IQM/base/viridis.h"
 #include "IQM/base/colorize.h"
 
 using IQM::VulkanInstance;
 
-void IQM::Bin::flip_run(const Args& args, const VulkanInstance& instance, const std::vector<Match>& imageMatches) {
-    IQM::FLIP flip(*instance.device());
-    IQM::Colorize colorizer(*instance.device());
+IQM::FLIPArguments IQM::Bin::flip_arguments(const std::unordered_map<std::string, std::string> &options) {
+    IQM::FLIPArguments flipArgs;
+    if (options.contains("--flip-width")) {
+        flipArgs.monitor_width = std::stof(options.at("--flip-width"));
+    }
+    if (options.contains("--flip-res")) {
+        flipArgs.monitor_resolution_x = std::stof(options.at("--flip-res"));
+    }
+    if (options.contains("--flip-distance")) {
+        flipArgs.monitor_distance = std::stof(options.at("--flip-distance"));
+    }
+    return flipArgs;
+}
 
-    FLIPArguments flipArgs;
-    if (args.options.contains("--flip-width")) {
-        flipArgs.monitor_width = std::stof(args.options.at("--flip-width"));
+IQM::Bin::FLIPJob::FLIPJob(const Args &args, const VulkanInstance &instance, ResourcePool<FLIPResources> &pool, const FLIPArguments &flipArgs, const IQM::FLIP &shared, const IQM::Colorize *sharedColorizer):
+    args(args),
+    instance(instance),
+    pool(pool),
+    flip(*instance.device(), shared),
+    flipArgs(flipArgs),
+    featureKernelSize(IQM::FLIP::featureKernelSize(flipArgs)),
+    tileBudget(tile_budget(args.options)),
+    gridFormat(score_grid_format(args.options)),
+    roi(args.options),
+    thresholds(args) {
+    if (sharedColorizer != nullptr) {
+        this->colorizer.emplace(*instance.device(), *sharedColorizer);
     }
-    if (args.options.contains("--flip-res")) {
-        flipArgs.monitor_resolution_x = std::stof(args.options.at("--flip-res"));
+    if (args.incremental) {
+        if (this->roi.enabled()) {
+            throw std::runtime_error("Region of interest can't be combined with --incremental");
+        }
+        this->session.emplace(this->tileHalo(), 0);
     }
-    if (args.options.contains("--flip-distance")) {
-        flipArgs.monitor_distance = std::stof(args.options.at("--flip-distance"));
+}
+
+void IQM::Bin::FLIPJob::prepare(const DecodedPair &pair) {
+    this->tiled.reset();
+    this->hasGrid = pair.match.outPath.has_value() && this->gridFormat.has_value();
+    this->pairMask = this->roi.enabled() ? this->roi.mask(this->instance, pair.test.width, pair.test.height) : IQM::Mask{};
+
+    this->incrementalPass = this->session.has_value() && this->sharedInput == nullptr;
+    if (this->incrementalPass) {
+        if (pair.match.outPath.has_value() && !this->hasGrid) {
+            throw std::runtime_error("Incremental computation only saves the score grid, set --grid");
+        }
+
+        this->session->plan(pair);
+        const auto &region = this->session->region();
+        const ResourceKey key{.method = Method::FLIP, .width = region.tileWidth, .height = region.tileHeight, .options = std::to_string(this->args.colorize) + std::to_string(this->featureKernelSize)};
+        this->pooled = this->pool.acquire(key, [&] { return flip_init_res(region.tileWidth, region.tileHeight, this->instance, this->args.colorize, this->featureKernelSize); });
+        if (this->session->whole()) {
+            this->refResident = hold_reference(this->pooled->res->reference, pair);
+            this->upload = flip_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+        } else {
+            this->pooled->res->reference.reset();
+            this->refResident = false;
+            const auto test = crop_tile(pair.test, region, region.tiles[0]);
+            const auto ref = crop_tile(*pair.ref, region, region.tiles[0]);
+            this->upload = flip_stage(*this->pooled->res, test, &ref);
+        }
+        return;
     }
 
-    if (args.verbose) {
-        std::cout << "FLIP monitor resolution: "<< flipArgs.monitor_resolution_x << std::endl
-        << "FLIP monitor distance: "<< flipArgs.monitor_distance << std::endl
-        << "FLIP monitor width: "<< flipArgs.monitor_width << std::endl;
+    const auto tileBudget = pair_tile_budget(this->tileBudget, this->memoryBudget, pair.test.width, pair.test.height, this->tileMemory());
+    // mask and score grid cover the whole pair, so it isn't split into tiles
+    if (tileBudget.has_value() && this->sharedInput == nullptr && !this->roi.enabled() && !this->gridFormat.has_value()) {
+        const auto halo = this->tileHalo();
+        TileGrid grid(pair.test.width, pair.test.height, tile_size(tileBudget.value(), this->tileMemory(), halo), halo);
+        if (grid.tiles.size() > 1) {
+            const ResourceKey key{.method = Method::FLIP, .width = grid.tileWidth, .height = grid.tileHeight, .options = std::to_string(this->args.colorize) + std::to_string(this->featureKernelSize)};
+            this->pooled = this->pool.acquire(key, [&] { return flip_init_res(grid.tileWidth, grid.tileHeight, this->instance, this->args.colorize, this->featureKernelSize); });
+            // every tile uploads its own part of the reference
+            this->pooled->res->reference.reset();
+            this->refResident = false;
+
+            this->tiled.emplace(TiledPair{
+                .grid = std::move(grid),
+                .test = &pair.test,
+                .ref = pair.ref.get(),
+                .map = std::vector<unsigned char>(pair.match.outPath.has_value() ? pair.test.width * pair.test.height * (this->args.colorize ? 4 : 1) : 0),
+            });
+            this->stageTile();
+            return;
+        }
     }
 
-    unsigned featureKernelSize = IQM::FLIP::featureKernelSize(flipArgs);
+    const ResourceKey key{.method = Method::FLIP, .width = pair.test.width, .height = pair.test.height, .options = std::to_string(this->args.colorize) + std::to_string(this->featureKernelSize)};
+    this->pooled = this->pool.acquire(key, [&] { return flip_init_res(pair.test.width, pair.test.height, this->instance, this->args.colorize, this->featureKernelSize); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = flip_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+    }
+}
 
-    int processed = 0;
+void IQM::Bin::FLIPJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    flip_record_upload(cmdBuf, *this->pooled->res, this->upload, this->sharedInput, this->refResident);
+}
 
-    for (const auto& match : imageMatches) {
-        try {
-            VulkanResource::resetMemCounter();
-            Timestamps timestamps;
-            auto start = std::chrono::high_resolution_clock::now();
+void IQM::Bin::FLIPJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    flip_record_compute(cmdBuf, this->instance, this->flip, this->colorizer.has_value() ? &this->colorizer.value() : nullptr, *this->pooled->res, this->flipArgs, this->tileSumRegion(), this->pairMask, this->hasGrid || this->incrementalPass);
+}
 
-            const auto input = load_image(match.testPath);
-            const auto reference = load_image(match.refPath);
-            if (input.height != reference.height || input.width != reference.width) {
-                throw std::runtime_error("Test and reference images have different sizes");
-            }
+void IQM::Bin::FLIPJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    flip_record_download(cmdBuf, *this->pooled->res, this->args.colorize, this->hasGrid || this->incrementalPass);
+}
 
-            timestamps.mark("images loaded");
-
-            initRenderDoc();
-
-            auto res = flip_init_res(input, reference, instance, args.colorize, featureKernelSize);
-            timestamps.mark("resources allocated");
-
-            flip_upload(instance, res);
-
-            auto flipInput = IQM::FLIPInput {
-                .args = flipArgs,
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivTest = &res.imageInput->imageView,
-                .ivRef = &res.imageRef->imageView,
-                .ivOut = &res.imageOut->imageView,
-                .ivFeatFilter = &res.imageFeatureFilter->imageView,
-                .imgOut = &res.imageOut->image,
-                .buffer = &res.buf,
-                .width = input.width,
-                .height = input.height
-            };
-
-            const vk::CommandBufferBeginInfo beginInfo = {
-                .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-            };
-            instance.cmdBuf()->begin(beginInfo);
-
-            flip.computeMetric(flipInput);
-
-            if (args.colorize) {
-                auto colorizerInput = IQM::ColorizeInput{
-                    .device = instance.device(),
-                    .cmdBuf = &*instance.cmdBuf(),
-                    .ivIn = &res.imageOut->imageView,
-                    .ivOut = &res.imageInput->imageView,
-                    .ivColormap = &res.imageColorMap->imageView,
-                    .width = input.width,
-                    .height = input.height
-                };
-
-                colorizer.compute(colorizerInput);
-            } else {
-                std::array offsets = {
-                    vk::Offset3D{0, 0, 0},
-                    vk::Offset3D{static_cast<int>(res.imageInput->width), static_cast<int>(res.imageInput->height), 1}
-                };
-                // copy RGBA f32 to RGBA u8
-                std::vector region {
-                    vk::ImageBlit {
-                        .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                        .srcOffsets = offsets,
-                        .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                        .dstOffsets = offsets,
-                    }
-                };
-                instance.cmdBuf()->blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageGreyscaleOut->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
-            }
+bool IQM::Bin::FLIPJob::nextPass() {
+    if (!this->tiled.has_value()) {
+        return false;
+    }
 
-            instance.cmdBuf()->end();
-
-            const std::vector cmdBufs = {
-                &**instance.cmdBuf()
-            };
-
-            auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
-            const vk::SubmitInfo submitInfo{
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*res.uploadDone,
-                .pWaitDstStageMask = &mask,
-                .commandBufferCount = 1,
-                .pCommandBuffers = *cmdBufs.data(),
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &*res.computeDone
-            };
-
-            instance.queue()->submit(submitInfo, {});
-            timestamps.mark("submit compute GPU pipeline");
-            // wait so cmd buffer can be reused for GPU -> CPU transfer
-            instance.waitForFence(res.transferFence);
-
-            auto result = flip_copy_back(instance, res, timestamps, args.colorize);
-
-            finishRenderDoc();
-
-            if (match.outPath.has_value()) {
-                if (args.colorize) {
-                    save_color_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                } else {
-                    save_char_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                }
-            }
+    auto &tiled = this->tiled.value();
+    const auto &tile = tiled.grid.tiles[tiled.current];
+    const auto result = flip_read_back(*this->pooled->res, false, false);
 
-            timestamps.mark("output saved");
+    // read back divides the sum of the core by the area of the whole tile
+    tiled.sum += static_cast<double>(result.meanFlip) * tiled.grid.tileWidth * tiled.grid.tileHeight;
+    tiled.area += static_cast<double>(tile.coreWidth) * tile.coreHeight;
+    if (!tiled.map.empty()) {
+        stitch_tile(tiled.map, result.imageData, this->args.colorize ? 4 : 1, tiled.grid, tile);
+    }
 
-            const auto end = std::chrono::high_resolution_clock::now();
-            std::cout << match.testPath << ": " << result.meanFlip << std::endl;
-            if (args.verbose) {
-                timestamps.print(start, end);
-                double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
-                std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to process '" << match.testPath << "': " << e.what() << std::endl;
-            continue;
+    tiled.current++;
+    if (tiled.current == tiled.grid.tiles.size()) {
+        return false;
+    }
+
+    // error of each remaining pixel lies in [0, 1], which bounds the mean of the whole image
+    if (this->thresholds.has("FLIP") && tiled.map.empty()) {
+        const auto pixels = static_cast<double>(tiled.grid.width) * tiled.grid.height;
+        tiled.decided = this->thresholds.decide("FLIP", tiled.sum / pixels, (tiled.sum + pixels - tiled.area) / pixels);
+        if (tiled.decided.has_value()) {
+            return false;
         }
+    }
+    this->stageTile();
+    return true;
+}
 
-        processed += 1;
+void IQM::Bin::FLIPJob::stageTile() {
+    const auto &tiled = this->tiled.value();
+    const auto &tile = tiled.grid.tiles[tiled.current];
+    const auto test = crop_tile(*tiled.test, tiled.grid, tile);
+    const auto ref = crop_tile(*tiled.ref, tiled.grid, tile);
+    this->upload = flip_stage(*this->pooled->res, test, &ref);
+}
+
+vk::Rect2D IQM::Bin::FLIPJob::tileSumRegion() const {
+    if (!this->tiled.has_value()) {
+        return {};
     }
 
-    std::cout << "Processed " << processed << "/" << imageMatches.size() <<" images" << std::endl;
+    // core of the tile in tile coordinates
+    const auto &tile = this->tiled->grid.tiles[this->tiled->current];
+    return vk::Rect2D{
+        .offset = vk::Offset2D{static_cast<int>(tile.coreX - tile.x), static_cast<int>(tile.coreY - tile.y)},
+        .extent = vk::Extent2D{tile.coreWidth, tile.coreHeight},
+    };
 }
 
-void IQM::Bin::flip_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::FLIP &flip, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref) {
-    VulkanResource::resetMemCounter();
-    FLIPArguments flipArgs;
-    if (args.options.contains("--flip-width")) {
-        flipArgs.monitor_width = std::stof(args.options.at("--flip-width"));
+std::vector<IQM::Bin::MetricValue> IQM::Bin::FLIPJob::finish(const DecodedPair &pair) {
+    FLIPResult result;
+    if (this->tiled.has_value() && this->tiled->decided.has_value()) {
+        const auto pass = this->tiled->decided;
+        this->tiled.reset();
+        this->pool.release(std::move(this->pooled.value()));
+        this->pooled.reset();
+        return {MetricValue{.name = "FLIP", .value = std::numeric_limits<float>::quiet_NaN(), .unit = "", .pass = pass, .computed = false}};
     }
-    if (args.options.contains("--flip-res")) {
-        flipArgs.monitor_resolution_x = std::stof(args.options.at("--flip-res"));
+    if (this->tiled.has_value()) {
+        result.meanFlip = static_cast<float>(this->tiled->sum / (static_cast<double>(pair.test.width) * pair.test.height));
+        result.imageData = std::move(this->tiled->map);
+        this->tiled.reset();
+    } else {
+        result = flip_read_back(*this->pooled->res, this->pairMask.enabled(), this->hasGrid || this->incrementalPass);
     }
-    if (args.options.contains("--flip-distance")) {
-        flipArgs.monitor_distance = std::stof(args.options.at("--flip-distance"));
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
+
+    if (this->incrementalPass) {
+        // region only holds the changed cells, the mean comes from sums of all cells
+        result.meanFlip = static_cast<float>(this->session->update(result.grid));
+        result.grid = this->session->grid();
     }
 
+    if (this->hasGrid) {
+        const auto grid = IQM::Reduce::gridExtent(pair.test.width, pair.test.height, SCORE_GRID_CELL);
+        save_score_grid(pair.match.outPath.value(), this->gridFormat.value(), result.grid, grid.width, grid.height);
+    } else if (pair.match.outPath.has_value()) {
+        if (this->args.colorize) {
+            save_color_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        } else {
+            save_char_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        }
+    }
+
+    return {MetricValue{.name = "FLIP", .value = result.meanFlip, .unit = ""}};
+}
+
+unsigned long IQM::Bin::FLIPJob::resourceSize() const {
+    return this->pooled.has_value() ? this->pooled->size : 0;
+}
+
+unsigned long IQM::Bin::FLIPJob::estimateSize(const DecodedPair &pair) const {
+    const auto tileBudget = this->sharedInput == nullptr && !this->roi.enabled() && !this->gridFormat.has_value() && !this->session.has_value() ? pair_tile_budget(this->tileBudget, this->memoryBudget, pair.test.width, pair.test.height, this->tileMemory()) : std::nullopt;
+    return pair_memory(pair.test.width, pair.test.height, this->tileMemory(), this->tileHalo(), tileBudget);
+}
+
+IQM::Bin::TileMemory IQM::Bin::FLIPJob::tileMemory() const {
+    const auto colorize = this->args.colorize;
+    const auto featureKernelSize = this->featureKernelSize;
+    return [=](const unsigned width, const unsigned height) {
+        return flip_plan(width, height, colorize, featureKernelSize).resources.estimate();
+    };
+}
+
+unsigned IQM::Bin::FLIPJob::tileHalo() const {
+    // both filters are clamped on image borders, so tile borders need half of the larger one
+    return std::max(IQM::FLIP::spatialKernelSize(this->flipArgs), this->featureKernelSize) / 2;
+}
+
+void IQM::Bin::flip_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::FLIP &flip, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref) {
+    VulkanResource::resetMemCounter();
+    const auto flipArgs = flip_arguments(args.options);
+
     if (args.verbose) {
         std::cout << "FLIP monitor resolution: "<< flipArgs.monitor_resolution_x << std::endl
         << "FLIP monitor distance: "<< flipArgs.monitor_distance << std::endl
@@ -182,7 +247,10 @@ void IQM::Bin::flip_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
     }
 
     unsigned featureKernelSize = IQM::FLIP::featureKernelSize(flipArgs);
-    IQM::Colorize colorizer(*instance.device());
+    std::optional<IQM::Colorize> colorizer;
+    if (args.colorize) {
+        colorizer.emplace(*instance.device(), instance.pipelineCache());
+    }
 
     try {
         Timestamps timestamps;
@@ -192,60 +260,18 @@ void IQM::Bin::flip_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
 
         initRenderDoc();
 
-        auto res = flip_init_res(input, ref, instance, args.colorize, featureKernelSize);
+        auto res = flip_init_res(input.width, input.height, instance, args.colorize, featureKernelSize);
+        const auto upload = flip_stage(res, input, &ref);
         timestamps.mark("resources allocated");
 
-        flip_upload(instance, res);
-
-        auto flipInput = IQM::FLIPInput {
-            .args = flipArgs,
-            .device = instance.device(),
-            .cmdBuf = &*instance.cmdBuf(),
-            .ivTest = &res.imageInput->imageView,
-            .ivRef = &res.imageRef->imageView,
-            .ivOut = &res.imageOut->imageView,
-            .ivFeatFilter = &res.imageFeatureFilter->imageView,
-            .imgOut = &res.imageOut->image,
-            .buffer = &res.buf,
-            .width = input.width,
-            .height = input.height
-        };
+        flip_upload(instance, res, upload);
 
         const vk::CommandBufferBeginInfo beginInfo = {
             .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
         };
         instance.cmdBuf()->begin(beginInfo);
 
-        flip.computeMetric(flipInput);
-
-        if (args.colorize) {
-            auto colorizerInput = IQM::ColorizeInput{
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivIn = &res.imageOut->imageView,
-                .ivOut = &res.imageInput->imageView,
-                .ivColormap = &res.imageColorMap->imageView,
-                .width = input.width,
-                .height = input.height,
-            };
-
-            colorizer.compute(colorizerInput);
-        } else {
-            std::array offsets = {
-                vk::Offset3D{0, 0, 0},
-                vk::Offset3D{static_cast<int>(res.imageInput->width), static_cast<int>(res.imageInput->height), 1}
-            };
-            // copy RGBA f32 to RGBA u8
-            std::vector region {
-                vk::ImageBlit {
-                    .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                    .srcOffsets = offsets,
-                    .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                    .dstOffsets = offsets,
-                }
-            };
-            instance.cmdBuf()->blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageGreyscaleOut->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
-        }
+        flip_record_compute(*instance.cmdBuf(), instance, flip, colorizer.has_value() ? &colorizer.value() : nullptr, res, flipArgs, {}, {}, false);
 
         instance.cmdBuf()->end();
 
@@ -288,64 +314,15 @@ void IQM::Bin::flip_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
     }
 }
 
-IQM::Bin::FLIPResources IQM::Bin::flip_init_res(const InputImage &test, const InputImage &ref, const VulkanInstance &instance, bool colorize, unsigned featureKernelSize) {
-    // always 4 channels on input, with 1B per channel
-    // add 1 float to end so buffer can be reused for writeback from GPU
-    const auto outSize = ((test.width * test.height) + 1) * sizeof(float);
-    const auto size = (test.width * test.height) * sizeof(float);
-    const auto sizeIntermediate = (test.width * test.height) * sizeof(float) * 13;
-    const auto colormapSize = 256 * 4 * sizeof(float);
-    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        outSize,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached
-    );
-    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        colormapSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [buf, mem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        sizeIntermediate,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-
-    stgBuf.bindMemory(stgMem, 0);
-    stgRefBuf.bindMemory(stgRefMem, 0);
-    cmBuf.bindMemory(cmMem, 0);
-    buf.bindMemory(mem, 0);
-
-    void * inBufData = stgMem.mapMemory(0, size, {});
-    memcpy(inBufData, test.data.data(), size);
-    stgMem.unmapMemory();
-
-    inBufData = stgRefMem.mapMemory(0, size, {});
-    memcpy(inBufData, ref.data.data(), size);
-    stgRefMem.unmapMemory();
-
-    inBufData = cmMem.mapMemory(0, colormapSize, {});
-    memcpy(inBufData, viridis, colormapSize);
-    cmMem.unmapMemory();
+IQM::Bin::FLIPPlan IQM::Bin::flip_plan(const unsigned width, const unsigned height, const bool colorize, const unsigned featureKernelSize) {
+    const auto sizeIntermediate = (width * height) * sizeof(float) * 13;
+    const auto grid = IQM::Reduce::gridExtent(width, height, SCORE_GRID_CELL);
 
     vk::ImageCreateInfo srcImageInfo = {
         .flags = {},
         .imageType = vk::ImageType::e2D,
         .format = vk::Format::eR8G8B8A8Unorm,
-        .extent = vk::Extent3D(test.width, test.height, 1),
+        .extent = vk::Extent3D(width, height, 1),
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
@@ -375,16 +352,62 @@ IQM::Bin::FLIPResources IQM::Bin::flip_init_res(const InputImage &test, const In
     colorMapImageInfo.extent = vk::Extent3D(256, 1, 1);
     colorMapImageInfo.format = vk::Format::eR32G32B32A32Sfloat;
 
-    auto const imageInput = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageRef = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageOut = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), floatImageInfo));
-    auto const imageFeatureFilter = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), featureImageInfo));
-    auto const imageColorMap = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), colorMapImageInfo));
-
-    auto imageGreyscale = std::shared_ptr<VulkanImage>();
+    FLIPPlan plan;
+    plan.buf = plan.resources.buffer(
+        sizeIntermediate,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst
+    );
+    plan.gridBuf = plan.resources.buffer(
+        grid.width * grid.height * sizeof(float),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+    );
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
+    plan.imageOut = plan.resources.image(floatImageInfo);
+    plan.imageFeatureFilter = plan.resources.image(featureImageInfo);
+    plan.imageColorMap = plan.resources.image(colorMapImageInfo);
     if (!colorize) {
-        imageGreyscale = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), greyscaleImageInfo));
+        plan.imageGreyscaleOut = plan.resources.image(greyscaleImageInfo);
     }
+    return plan;
+}
+
+IQM::Bin::FLIPResources IQM::Bin::flip_init_res(const unsigned width, const unsigned height, const VulkanInstance &instance, bool colorize, unsigned featureKernelSize) {
+    // always 4 channels on input, with 1B per channel
+    // add 1 float to end so buffer can be reused for writeback from GPU
+    const auto outSize = ((width * height) + 1) * sizeof(float);
+    const auto size = (width * height) * sizeof(float);
+    const auto colormapSize = 256 * 4 * sizeof(float);
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        outSize,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        colormapSize,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    void * inBufData = cmMem.mapMemory(0, colormapSize, {});
+    memcpy(inBufData, viridis, colormapSize);
+    cmMem.unmapMemory();
+
+    const auto plan = flip_plan(width, height, colorize, featureKernelSize);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [buf, mem] = planned.takeBuffer(plan.buf);
+    auto [gridBuf, gridMem] = planned.takeBuffer(plan.gridBuf);
 
     return FLIPResources{
         .stgInput = std::move(stgBuf),
@@ -393,49 +416,41 @@ IQM::Bin::FLIPResources IQM::Bin::flip_init_res(const InputImage &test, const In
         .stgRefMemory = std::move(stgRefMem),
         .stgColormap = std::move(cmBuf),
         .stgColormapMemory = std::move(cmMem),
-        .imageInput = imageInput,
-        .imageRef = imageRef,
-        .imageGreyscaleOut = imageGreyscale,
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
+        .imageGreyscaleOut = planned.image(plan.imageGreyscaleOut),
         .buf = std::move(buf),
         .memory = std::move(mem),
-        .imageFeatureFilter = imageFeatureFilter,
-        .imageColorMap = imageColorMap,
-        .imageOut = imageOut,
+        .gridBuf = std::move(gridBuf),
+        .gridMemory = std::move(gridMem),
+        .imageFeatureFilter = planned.image(plan.imageFeatureFilter),
+        .imageColorMap = planned.image(plan.imageColorMap),
+        .imageOut = planned.image(plan.imageOut),
         .uploadDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .computeDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .transferFence = instance.device()->createFence(vk::FenceCreateInfo{}),
     };
 }
 
-void IQM::Bin::flip_upload(const VulkanInstance &instance, const FLIPResources &res) {
-    const vk::CommandBufferBeginInfo beginInfo = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-    };
-    instance.cmdBufTransfer()->begin(beginInfo);
-
+void IQM::Bin::flip_record_upload(const vk::raii::CommandBuffer &cmdBuf, const FLIPResources &res, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
     std::vector imagesToInit = {
         res.imageInput,
-        res.imageRef,
         res.imageOut,
         res.imageFeatureFilter,
         res.imageColorMap,
         res.imageOut,
     };
 
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
+
     if (res.imageGreyscaleOut != nullptr) {
         imagesToInit.push_back(res.imageGreyscaleOut);
     }
 
-    VulkanResource::initImages(*instance.cmdBufTransfer(), imagesToInit);
+    VulkanResource::initImages(cmdBuf, imagesToInit);
 
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageInput->width,
-        .bufferImageHeight = res.imageInput->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageInput->width, res.imageInput->height, 1}
-    };
     vk::BufferImageCopy copyColorMapRegion{
         .bufferOffset = 0,
         .bufferRowLength = 256,
@@ -444,10 +459,16 @@ void IQM::Bin::flip_upload(const VulkanInstance &instance, const FLIPResources &
         .imageOffset = vk::Offset3D{0, 0, 0},
         .imageExtent = vk::Extent3D{256, 1, 1}
     };
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgInput, res.imageInput->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgRef, res.imageRef->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
+    cmdBuf.copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
+}
 
+void IQM::Bin::flip_upload(const VulkanInstance &instance, const FLIPResources &res, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    flip_record_upload(*instance.cmdBufTransfer(), res, upload, nullptr, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -461,17 +482,87 @@ void IQM::Bin::flip_upload(const VulkanInstance &instance, const FLIPResources &
         .pSignalSemaphores = &*res.uploadDone
     };
 
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
     instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
 }
 
-IQM::Bin::FLIPResult IQM::Bin::flip_copy_back(const VulkanInstance &instance, const FLIPResources &res, Timestamps &timestamps, bool colorize) {
-    FLIPResult result;
+IQM::Bin::InputUpload IQM::Bin::flip_stage(const FLIPResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
 
-    // copy out
-    const vk::CommandBufferBeginInfo beginInfoCopy = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+void IQM::Bin::flip_record_compute(const vk::raii::CommandBuffer &cmdBuf, const VulkanInstance &instance, IQM::FLIP &flip, IQM::Colorize *colorizer, const FLIPResources &res, const FLIPArguments &flipArgs, const vk::Rect2D &sumRegion, const IQM::Mask &mask, const bool grid) {
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+
+    auto flipInput = IQM::FLIPInput {
+        .args = flipArgs,
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .ivOut = &res.imageOut->imageView,
+        .ivFeatFilter = &res.imageFeatureFilter->imageView,
+        .imgOut = &res.imageOut->image,
+        .buffer = &res.buf,
+        .width = width,
+        .height = height,
+        .sumRegion = sumRegion,
+        .mask = mask,
+        .bufGrid = grid ? &res.gridBuf : nullptr,
+        .gridCell = SCORE_GRID_CELL,
     };
-    instance.cmdBufTransfer()->begin(beginInfoCopy);
+
+    flip.computeMetric(flipInput);
+
+    if (colorizer != nullptr) {
+        auto colorizerInput = IQM::ColorizeInput{
+            .device = instance.device(),
+            .cmdBuf = &cmdBuf,
+            .ivIn = &res.imageOut->imageView,
+            .ivOut = &res.imageInput->imageView,
+            .ivColormap = &res.imageColorMap->imageView,
+            .width = width,
+            .height = height
+        };
+
+        colorizer->compute(colorizerInput);
+    } else {
+        std::array offsets = {
+            vk::Offset3D{0, 0, 0},
+            vk::Offset3D{static_cast<int>(width), static_cast<int>(height), 1}
+        };
+        // copy RGBA f32 to RGBA u8
+        std::vector region {
+            vk::ImageBlit {
+                .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                .srcOffsets = offsets,
+                .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                .dstOffsets = offsets,
+            }
+        };
+        cmdBuf.blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageGreyscaleOut->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
+    }
+}
+
+void IQM::Bin::flip_record_download(const vk::raii::CommandBuffer &cmdBuf, const FLIPResources &res, const bool colorize, const bool grid) {
+    vk::BufferCopy bufCopy{
+        .srcOffset = 0,
+        .dstOffset = sizeof(unsigned char) * (res.imageInput->width * res.imageInput->height * 4),
+        .size = sizeof(float),
+    };
+    cmdBuf.copyBuffer(res.buf, res.stgInput, bufCopy);
+
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(res.imageInput->width, res.imageInput->height, SCORE_GRID_CELL);
+        vk::BufferCopy gridCopy{
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = extent.width * extent.height * sizeof(float),
+        };
+        cmdBuf.copyBuffer(res.gridBuf, res.stgInput, gridCopy);
+        return;
+    }
 
     vk::BufferImageCopy copyRegion{
         .bufferOffset = 0,
@@ -483,18 +574,43 @@ IQM::Bin::FLIPResult IQM::Bin::flip_copy_back(const VulkanInstance &instance, co
     };
 
     if (colorize) {
-        instance.cmdBufTransfer()->copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+        cmdBuf.copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
     } else {
-        instance.cmdBufTransfer()->copyImageToBuffer(res.imageGreyscaleOut->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+        cmdBuf.copyImageToBuffer(res.imageGreyscaleOut->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
     }
+}
 
-    vk::BufferCopy bufCopy{
-        .srcOffset = 0,
-        .dstOffset = sizeof(unsigned char) * (res.imageInput->width * res.imageInput->height * 4),
-        .size = sizeof(float),
-    };
-    instance.cmdBufTransfer()->copyBuffer(res.buf, res.stgInput, bufCopy);
+IQM::Bin::FLIPResult IQM::Bin::flip_read_back(const FLIPResources &res, const bool masked, const bool grid) {
+    FLIPResult result;
 
+    void * outBufData = res.stgInputMemory.mapMemory(0, ((res.imageOut->height * res.imageOut->width ) + 1) * sizeof(float), {});
+    res.stgInputMemory.invalidate();
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(res.imageOut->width, res.imageOut->height, SCORE_GRID_CELL);
+        result.grid.resize(extent.width * extent.height);
+        memcpy(result.grid.data(), outBufData, result.grid.size() * sizeof(float));
+    } else {
+        std::vector<unsigned char> outputData(res.imageOut->height * res.imageOut->width * 4);
+        memcpy(outputData.data(), outBufData, res.imageOut->height * res.imageOut->width * 4 * sizeof(unsigned char));
+        result.imageData = std::move(outputData);
+    }
+    result.meanFlip = (static_cast<float*>(outBufData))[res.imageOut->height * res.imageOut->width];
+    if (!masked) {
+        result.meanFlip /= static_cast<float>(res.imageOut->width) * static_cast<float>(res.imageOut->height);
+    }
+
+    res.stgInputMemory.unmapMemory();
+
+    return result;
+}
+
+IQM::Bin::FLIPResult IQM::Bin::flip_copy_back(const VulkanInstance &instance, const FLIPResources &res, Timestamps &timestamps, bool colorize) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    flip_record_download(*instance.cmdBufTransfer(), res, colorize, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -517,15 +633,8 @@ IQM::Bin::FLIPResult IQM::Bin::flip_copy_back(const VulkanInstance &instance, co
 
     timestamps.mark("end GPU work");
 
-    std::vector<unsigned char> outputData(res.imageOut->height * res.imageOut->width * 4);
-    void * outBufData = res.stgInputMemory.mapMemory(0, ((res.imageOut->height * res.imageOut->width ) + 1) * sizeof(float), {});
-    memcpy(outputData.data(), outBufData, res.imageOut->height * res.imageOut->width * 4 * sizeof(unsigned char));
-    result.meanFlip = (static_cast<float*>(outBufData))[res.imageOut->height * res.imageOut->width] / (static_cast<float>(res.imageOut->width) * static_cast<float>(res.imageOut->height));
-
-    res.stgInputMemory.unmapMemory();
+    auto result = flip_read_back(res, false, false);
     timestamps.mark("end copy from GPU");
 
-    result.imageData = std::move(outputData);
-
     return result;
 }
@@ -7,21 +7,28 @@
 #define IQM_BIN_FLIP_H
 
 #include <IQM/flip.h>
+#include <IQM/base/colorize.h>
 #include "../../shared/vulkan.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
 #include "../../shared/io.h"
 #include "../../shared/timestamps.h"
+#include "../../shared/tiling.h"
+#include "../../shared/resource_plan.h"
+#include "../../shared/roi.h"
+#include "../../shared/incremental.h"
 #include "../../IQM/args.h"
 #include "../../IQM-profile/args.h"
 
 namespace IQM::Bin {
     struct FLIPResources {
         vk::raii::Buffer stgInput = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
         vk::raii::Buffer stgRef = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
         vk::raii::Buffer stgColormap = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgColormapMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgColormapMemory;
 
         // RGBA u8 input/export images
         std::shared_ptr<VulkanImage> imageInput;
@@ -31,7 +38,10 @@ namespace IQM::Bin {
 
         // intermediate buffer
         vk::raii::Buffer buf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory memory = VK_NULL_HANDLE;
+        DeviceAllocation memory;
+        // mean error of each cell of the score grid
+        vk::raii::Buffer gridBuf = VK_NULL_HANDLE;
+        DeviceAllocation gridMemory;
 
         // 1x RGBA f32 filters,
         std::shared_ptr<VulkanImage> imageFeatureFilter;
@@ -45,18 +55,89 @@ namespace IQM::Bin {
         vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
         vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
         vk::raii::Fence transferFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
     };
 
     struct FLIPResult {
         std::vector<unsigned char> imageData;
+        std::vector<float> grid;
         float meanFlip;
     };
 
-    void flip_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+    // device local resources of `flip_init_res`, also used to estimate memory of a pair
+    struct FLIPPlan {
+        ResourcePlan resources;
+        unsigned buf;
+        unsigned gridBuf;
+        unsigned imageInput;
+        unsigned imageRef;
+        unsigned imageOut;
+        unsigned imageFeatureFilter;
+        unsigned imageColorMap;
+        std::optional<unsigned> imageGreyscaleOut;
+    };
+
+    class FLIPJob : public BatchJob {
+    public:
+        // `shared` provides pipelines reused by jobs of all slots, `sharedColorizer` is null without colorized output
+        FLIPJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<FLIPResources>& pool, const FLIPArguments& flipArgs, const IQM::FLIP& shared, const IQM::Colorize* sharedColorizer);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        bool nextPass() override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        void stageTile();
+        [[nodiscard]] vk::Rect2D tileSumRegion() const;
+        [[nodiscard]] unsigned tileHalo() const;
+        [[nodiscard]] TileMemory tileMemory() const;
+
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<FLIPResources>& pool;
+        IQM::FLIP flip;
+        // only created when output is colorized
+        std::optional<IQM::Colorize> colorizer;
+        FLIPArguments flipArgs;
+        unsigned featureKernelSize;
+        std::optional<unsigned long> tileBudget;
+        // set while the current pair is computed in tiles
+        std::optional<TiledPair> tiled;
+        // the score grid is downloaded and saved instead of the map
+        std::optional<ScoreGridFormat> gridFormat;
+        bool hasGrid = false;
+        RegionOfInterest roi;
+        Thresholds thresholds;
+        // mask of the current pair, empty without region of interest
+        IQM::Mask pairMask;
+        // set by `--incremental`, unused with shared input
+        std::optional<IncrementalSession> session;
+        // the current pair computes a region of the session
+        bool incrementalPass = false;
+        std::optional<PooledResource<FLIPResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+    };
+
+
     void flip_run_single(const IQM::ProfileArgs& args, const IQM::VulkanInstance& instance, IQM::FLIP& flip, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
 
-    FLIPResources flip_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance& instance, bool colorize, unsigned featureKernelSize);
-    void flip_upload(const IQM::VulkanInstance& instance, const FLIPResources& res);
+    FLIPArguments flip_arguments(const std::unordered_map<std::string, std::string> &options);
+    FLIPPlan flip_plan(unsigned width, unsigned height, bool colorize, unsigned featureKernelSize);
+    FLIPResources flip_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance, bool colorize, unsigned featureKernelSize);
+    InputUpload flip_stage(const FLIPResources& res, const InputImage &test, const InputImage *ref);
+    void flip_record_upload(const vk::raii::CommandBuffer& cmdBuf, const FLIPResources& res, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void flip_upload(const IQM::VulkanInstance& instance, const FLIPResources& res, const InputUpload& upload);
+    void flip_record_compute(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::FLIP& flip, IQM::Colorize* colorizer, const FLIPResources& res, const FLIPArguments& flipArgs, const vk::Rect2D &sumRegion, const IQM::Mask& mask, bool grid);
+    // the score grid takes the place of the map in staging memory, so only one of them is downloaded
+    void flip_record_download(const vk::raii::CommandBuffer& cmdBuf, const FLIPResources& res, bool colorize, bool grid);
+    // with a mask, the downloaded value is already the weighted mean
+    FLIPResult flip_read_back(const FLIPResources& res, bool masked, bool grid);
     FLIPResult flip_copy_back(const IQM::VulkanInstance& instance, const FLIPResources& res, Timestamps &timestamps, bool colorize);
 }
 
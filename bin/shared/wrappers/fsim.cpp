@@ -7,145 +7,94 @@
 #include "fsim.h"
 #include "../../shared/debug_utils.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/incremental.h"
 #include <IQM/fsim/fft_planner.h>
 
 using IQM::VulkanInstance;
 
-void IQM::Bin::fsim_run(const Args& args, const VulkanInstance& instance, const std::vector<Match>& imageMatches) {
-    IQM::FSIM fsim(*instance.device());
-
-    int processed = 0;
-
-    for (const auto& match : imageMatches) {
-        try {
-            VulkanResource::resetMemCounter();
-            Timestamps timestamps;
-            auto start = std::chrono::high_resolution_clock::now();
-
-            const auto input = load_image(match.testPath);
-            const auto reference = load_image(match.refPath);
-            if (input.height != reference.height || input.width != reference.width) {
-                throw std::runtime_error("Test and reference images have different sizes");
-            }
-
-            timestamps.mark("images loaded");
-
-            initRenderDoc();
-
-            auto [dWidth, dHeight] = FSIM::downscaledSize(input.width, input.height);
-
-            auto res = fsim_init_res(input, reference, instance, dWidth, dHeight);
-            timestamps.mark("resources allocated");
-
-            fsim_upload(instance, res);
-
-            auto flipInput = IQM::FSIMInput {
-                .device = instance.device(),
-                .physicalDevice = instance.physicalDevice(),
-                .queue = &*instance.queue(),
-                .commandPool = &*instance.cmdPool(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .fenceFft = &res.fftFence,
-                .fenceIfft = &res.ifftFence,
-                .ivTest = &res.imageInput->imageView,
-                .ivRef = &res.imageRef->imageView,
-                .ivTestDown = &res.imagesColor[0]->imageView,
-                .ivRefDown = &res.imagesColor[1]->imageView,
-                .ivTempFloat = {
-                    &res.imagesFloat[0]->imageView,
-                    &res.imagesFloat[1]->imageView,
-                    &res.imagesFloat[2]->imageView,
-                    &res.imagesFloat[3]->imageView,
-                    &res.imagesFloat[4]->imageView,
-                },
-                .ivFilterResponsesTest = {
-                    &res.imagesRg[0]->imageView,
-                    &res.imagesRg[1]->imageView,
-                    &res.imagesRg[2]->imageView,
-                    &res.imagesRg[3]->imageView,
-                },
-                .ivFilterResponsesRef = {
-                    &res.imagesRg[4]->imageView,
-                    &res.imagesRg[5]->imageView,
-                    &res.imagesRg[6]->imageView,
-                    &res.imagesRg[7]->imageView,
-                },
-                .ivFinalSums = {
-                    &res.imagesFloat[5]->imageView,
-                    &res.imagesFloat[6]->imageView,
-                    &res.imagesFloat[7]->imageView,
-                },
-                .imgFinalSums = {
-                    &res.imagesFloat[5]->image,
-                    &res.imagesFloat[6]->image,
-                    &res.imagesFloat[7]->image,
-                },
-                .bufFft = &res.bufFft,
-                .bufIfft = &res.bufIfft,
-                .fftApplication = nullptr,
-                .fftApplicationInverse = nullptr,
-                .width = input.width,
-                .height = input.height,
-            };
-
-            auto fftApplication = FftPlanner::initForward(flipInput, dWidth, dHeight);
-            auto fftApplicationInverse = FftPlanner::initInverse(flipInput, dWidth, dHeight);
-
-            flipInput.fftApplication = &fftApplication;
-            flipInput.fftApplicationInverse = &fftApplicationInverse;
-
-            const vk::CommandBufferBeginInfo beginInfo = {
-                .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-            };
-            instance.cmdBuf()->begin(beginInfo);
-
-            fsim.computeMetric(flipInput);
-
-            instance.cmdBuf()->end();
-
-            const std::vector cmdBufs = {
-                &**instance.cmdBuf()
-            };
-
-            auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
-            const vk::SubmitInfo submitInfo{
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*res.uploadDone,
-                .pWaitDstStageMask = &mask,
-                .commandBufferCount = 1,
-                .pCommandBuffers = *cmdBufs.data(),
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &*res.computeDone
-            };
-
-            instance.queue()->submit(submitInfo, {});
-            timestamps.mark("submit compute GPU pipeline");
-            // wait so cmd buffer can be reused for GPU -> CPU transfer
-            instance.waitForFence(res.transferFence);
-
-            auto result = fsim_copy_back(instance, res, timestamps);
-
-            finishRenderDoc();
-
-            FftPlanner::destroy(fftApplication);
-            FftPlanner::destroy(fftApplicationInverse);
-
-            const auto end = std::chrono::high_resolution_clock::now();
-            std::cout << match.testPath << ": " << result.fsim << " | " << result.fsimc << std::endl;
-            if (args.verbose) {
-                timestamps.print(start, end);
-                double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
-                std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to process '" << match.testPath << "': " << e.what() << std::endl;
-            continue;
-        }
+IQM::Bin::FSIMJob::FSIMJob(const Args &args, const VulkanInstance &instance, ResourcePool<FSIMResources> &pool, const IQM::FSIM &shared):
+    args(args),
+    instance(instance),
+    pool(pool),
+    fsim(*instance.device(), shared),
+    roi(args.options) {
+    // final values are only reduced from downscaled maps
+    require_no_score_grid(args.options, "FSIM");
+    IncrementalSession::requireUnset(args, "FSIM");
+}
+
+IQM::Bin::FSIMJob::~FSIMJob() {
+    this->destroyFft();
+}
+
+void IQM::Bin::FSIMJob::prepare(const DecodedPair &pair) {
+    // plans of a previous pair, if its submission failed
+    this->destroyFft();
 
-        processed += 1;
+    auto [dWidth, dHeight] = FSIM::downscaledSize(pair.test.width, pair.test.height);
+    // FSIM is evaluated on downscaled images, so the mask is downscaled the same way
+    const auto factor = FSIM::computeDownscaleFactor(static_cast<int>(pair.test.width), static_cast<int>(pair.test.height));
+    this->pairMask = this->roi.enabled() ? this->roi.mask(this->instance, pair.test.width, pair.test.height, factor, dWidth, dHeight) : IQM::Mask{};
+
+    const ResourceKey key{.method = Method::FSIM, .width = pair.test.width, .height = pair.test.height};
+    this->pooled = this->pool.acquire(key, [&] { return fsim_init_res(pair.test.width, pair.test.height, this->instance, dWidth, dHeight); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = fsim_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
     }
 
-    std::cout << "Processed " << processed << "/" << imageMatches.size() <<" images" << std::endl;
+    // plans are initialized on the main queue, they must exist until the compute work is finished
+    const auto fsimInput = fsim_input(this->instance, *this->pooled->res, *this->instance.cmdBuf());
+    this->fftApplication = FftPlanner::initForward(fsimInput, dWidth, dHeight);
+    this->fftApplicationInverse = FftPlanner::initInverse(fsimInput, dWidth, dHeight);
+    this->hasFft = true;
+}
+
+void IQM::Bin::FSIMJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    fsim_record_upload(cmdBuf, *this->pooled->res, this->upload, this->sharedInput, this->refResident);
+}
+
+void IQM::Bin::FSIMJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    auto fsimInput = fsim_input(this->instance, *this->pooled->res, cmdBuf);
+    fsimInput.fftApplication = &this->fftApplication;
+    fsimInput.fftApplicationInverse = &this->fftApplicationInverse;
+    fsimInput.mask = this->pairMask;
+
+    this->fsim.computeMetric(fsimInput);
+}
+
+void IQM::Bin::FSIMJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    fsim_record_download(cmdBuf, *this->pooled->res);
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::FSIMJob::finish(const DecodedPair &pair) {
+    const auto result = fsim_read_back(*this->pooled->res);
+    this->destroyFft();
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
+
+    return {
+        MetricValue{.name = "FSIM", .value = result.fsim, .unit = ""},
+        MetricValue{.name = "FSIMc", .value = result.fsimc, .unit = ""},
+    };
+}
+
+unsigned long IQM::Bin::FSIMJob::resourceSize() const {
+    return this->pooled.has_value() ? this->pooled->size : 0;
+}
+
+unsigned long IQM::Bin::FSIMJob::estimateSize(const DecodedPair &pair) const {
+    const auto [dWidth, dHeight] = FSIM::downscaledSize(pair.test.width, pair.test.height);
+    return fsim_plan(pair.test.width, pair.test.height, dWidth, dHeight).resources.estimate();
+}
+
+void IQM::Bin::FSIMJob::destroyFft() {
+    if (this->hasFft) {
+        FftPlanner::destroy(this->fftApplication);
+        FftPlanner::destroy(this->fftApplicationInverse);
+        this->hasFft = false;
+    }
 }
 
 void IQM::Bin::fsim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::FSIM &fsim, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref) {
@@ -160,59 +109,13 @@ void IQM::Bin::fsim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
 
         auto [dWidth, dHeight] = FSIM::downscaledSize(input.width, input.height);
 
-        auto res = fsim_init_res(input, ref, instance, dWidth, dHeight);
+        auto res = fsim_init_res(input.width, input.height, instance, dWidth, dHeight);
+        const auto upload = fsim_stage(res, input, &ref);
         timestamps.mark("resources allocated");
 
-        fsim_upload(instance, res);
-
-        auto fsimInput = IQM::FSIMInput {
-            .device = instance.device(),
-            .physicalDevice = instance.physicalDevice(),
-            .queue = &*instance.queue(),
-            .commandPool = &*instance.cmdPool(),
-            .cmdBuf = &*instance.cmdBuf(),
-            .fenceFft = &res.fftFence,
-            .fenceIfft = &res.ifftFence,
-            .ivTest = &res.imageInput->imageView,
-            .ivRef = &res.imageRef->imageView,
-            .ivTestDown = &res.imagesColor[0]->imageView,
-            .ivRefDown = &res.imagesColor[1]->imageView,
-            .ivTempFloat = {
-                &res.imagesFloat[0]->imageView,
-                &res.imagesFloat[1]->imageView,
-                &res.imagesFloat[2]->imageView,
-                &res.imagesFloat[3]->imageView,
-                &res.imagesFloat[4]->imageView,
-            },
-            .ivFilterResponsesTest = {
-                &res.imagesRg[0]->imageView,
-                &res.imagesRg[1]->imageView,
-                &res.imagesRg[2]->imageView,
-                &res.imagesRg[3]->imageView,
-            },
-            .ivFilterResponsesRef = {
-                &res.imagesRg[4]->imageView,
-                &res.imagesRg[5]->imageView,
-                &res.imagesRg[6]->imageView,
-                &res.imagesRg[7]->imageView,
-            },
-            .ivFinalSums = {
-                &res.imagesFloat[5]->imageView,
-                &res.imagesFloat[6]->imageView,
-                &res.imagesFloat[7]->imageView,
-            },
-            .imgFinalSums = {
-                &res.imagesFloat[5]->image,
-                &res.imagesFloat[6]->image,
-                &res.imagesFloat[7]->image,
-            },
-            .bufFft = &res.bufFft,
-            .bufIfft = &res.bufIfft,
-            .fftApplication = nullptr,
-            .fftApplicationInverse = nullptr,
-            .width = input.width,
-            .height = input.height,
-        };
+        fsim_upload(instance, res, upload);
+
+        auto fsimInput = fsim_input(instance, res, *instance.cmdBuf());
 
         auto fftApplication = FftPlanner::initForward(fsimInput, dWidth, dHeight);
         auto fftApplicationInverse = FftPlanner::initInverse(fsimInput, dWidth, dHeight);
@@ -269,64 +172,85 @@ void IQM::Bin::fsim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
     }
 }
 
-IQM::Bin::FSIMResources IQM::Bin::fsim_init_res(const InputImage &test, const InputImage &ref, const VulkanInstance& instance, const unsigned dWidth, const unsigned dHeight) {
-    // always 4 channels on input, with 1B per channel
-    const auto inputSize = (test.width * test.height) * 4;
-
-    // input buffers
-    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        inputSize,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached
-    );
-    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        inputSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-
-    stgBuf.bindMemory(stgMem, 0);
-    stgRefBuf.bindMemory(stgRefMem, 0);
-
-    void * inBufData = stgMem.mapMemory(0, inputSize, {});
-    memcpy(inBufData, test.data.data(), inputSize);
-    stgMem.unmapMemory();
-
-    inBufData = stgRefMem.mapMemory(0, inputSize, {});
-    memcpy(inBufData, ref.data.data(), inputSize);
-    stgRefMem.unmapMemory();
+IQM::FSIMInput IQM::Bin::fsim_input(const VulkanInstance &instance, const FSIMResources &res, const vk::raii::CommandBuffer &cmdBuf) {
+    return IQM::FSIMInput {
+        .device = instance.device(),
+        .physicalDevice = instance.physicalDevice(),
+        .queue = &*instance.queue(),
+        .commandPool = &*instance.cmdPool(),
+        .cmdBuf = &cmdBuf,
+        .fenceFft = &res.fftFence,
+        .fenceIfft = &res.ifftFence,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .ivTestDown = &res.imagesColor[0]->imageView,
+        .ivRefDown = &res.imagesColor[1]->imageView,
+        .ivTempFloat = {
+            &res.imagesFloat[0]->imageView,
+            &res.imagesFloat[1]->imageView,
+            &res.imagesFloat[2]->imageView,
+            &res.imagesFloat[3]->imageView,
+            &res.imagesFloat[4]->imageView,
+        },
+        .ivFilterResponsesTest = {
+            &res.imagesRg[0]->imageView,
+            &res.imagesRg[1]->imageView,
+            &res.imagesRg[2]->imageView,
+            &res.imagesRg[3]->imageView,
+        },
+        .ivFilterResponsesRef = {
+            &res.imagesRg[4]->imageView,
+            &res.imagesRg[5]->imageView,
+            &res.imagesRg[6]->imageView,
+            &res.imagesRg[7]->imageView,
+        },
+        .ivFinalSums = {
+            &res.imagesFloat[5]->imageView,
+            &res.imagesFloat[6]->imageView,
+            &res.imagesFloat[7]->imageView,
+        },
+        .imgFinalSums = {
+            &res.imagesFloat[5]->image,
+            &res.imagesFloat[6]->image,
+            &res.imagesFloat[7]->image,
+        },
+        .imgTempFloat = {
+            &res.imagesFloat[0]->image,
+            &res.imagesFloat[1]->image,
+            &res.imagesFloat[2]->image,
+            &res.imagesFloat[3]->image,
+            &res.imagesFloat[4]->image,
+        },
+        .imgFilterResponsesTest = {
+            &res.imagesRg[0]->image,
+            &res.imagesRg[1]->image,
+            &res.imagesRg[2]->image,
+            &res.imagesRg[3]->image,
+        },
+        .imgFilterResponsesRef = {
+            &res.imagesRg[4]->image,
+            &res.imagesRg[5]->image,
+            &res.imagesRg[6]->image,
+            &res.imagesRg[7]->image,
+        },
+        .bufFft = &res.bufFft,
+        .bufIfft = &res.bufIfft,
+        .fftApplication = nullptr,
+        .fftApplicationInverse = nullptr,
+        .width = res.imageInput->width,
+        .height = res.imageInput->height,
+    };
+}
 
-    // rest of buffers
+IQM::Bin::FSIMPlan IQM::Bin::fsim_plan(const unsigned width, const unsigned height, const unsigned dWidth, const unsigned dHeight) {
     const auto fftSize = sizeof(float) * (dWidth * dHeight) * 2 * 2;
     const auto ifftSize = sizeof(float) * (dWidth * dHeight) * 2 * FSIM_ORIENTATIONS * FSIM_SCALES * 3;
 
-    auto [fftBuf, fftMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        fftSize,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    fftBuf.bindMemory(fftMem, 0);
-    auto [ifftBuf, ifftMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        ifftSize,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    ifftBuf.bindMemory(ifftMem, 0);
-
-    // images
     vk::ImageCreateInfo srcImageInfo = {
         .flags = {},
         .imageType = vk::ImageType::e2D,
         .format = vk::Format::eR8G8B8A8Unorm,
-        .extent = vk::Extent3D(test.width, test.height, 1),
+        .extent = vk::Extent3D(width, height, 1),
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
@@ -349,23 +273,68 @@ IQM::Bin::FSIMResources IQM::Bin::fsim_init_res(const InputImage &test, const In
     vk::ImageCreateInfo colorImageInfo = {floatImageInfo};
     colorImageInfo.format = vk::Format::eR32G32B32A32Sfloat;
 
-    auto const imageInput = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageRef = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
+    FSIMPlan plan;
+    plan.bufFft = plan.resources.buffer(fftSize, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer);
+    plan.bufIfft = plan.resources.buffer(ifftSize, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer);
+
+    // images only used during part of the computation share memory, lifetimes are given by `FSIMInput`
+    const auto step = [](const FSIMStep value) { return static_cast<unsigned>(value); };
+    plan.imageInput = plan.resources.transientImage(srcImageInfo, step(FSIMStep::Downscale), step(FSIMStep::Downscale));
+    plan.imageFloatTemp = plan.resources.transientImage(floatImageInfo, step(FSIMStep::AngularFilter), step(FSIMStep::FilterCombinations));
+    for (int i = 0; i < 8; i++) {
+        plan.imagesRg.push_back(plan.resources.transientImage(rgImageInfo, step(FSIMStep::SumFilterResponses), step(FSIMStep::PhaseCongruency)));
+    }
+
+    // reference may stay resident between pairs, so it can't be shared
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
+    for (int i = 0; i < 7; i++) {
+        plan.imagesFloat.push_back(plan.resources.image(floatImageInfo));
+    }
+    for (int i = 0; i < 2; i++) {
+        plan.imagesColor.push_back(plan.resources.image(colorImageInfo));
+    }
+    return plan;
+}
+
+IQM::Bin::FSIMResources IQM::Bin::fsim_init_res(const unsigned width, const unsigned height, const VulkanInstance& instance, const unsigned dWidth, const unsigned dHeight) {
+    // always 4 channels on input, with 1B per channel
+    const auto inputSize = (width * height) * 4;
+
+    // input buffers
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        inputSize,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        inputSize,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    const auto plan = fsim_plan(width, height, dWidth, dHeight);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [fftBuf, fftMem] = planned.takeBuffer(plan.bufFft);
+    auto [ifftBuf, ifftMem] = planned.takeBuffer(plan.bufIfft);
 
     auto imagesFloat = std::vector<std::shared_ptr<VulkanImage>>();
     auto imagesRg = std::vector<std::shared_ptr<VulkanImage>>();
     auto imagesColor = std::vector<std::shared_ptr<VulkanImage>>();
 
-    for (int i = 0; i < 8; i++) {
-        imagesFloat.emplace_back(std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), floatImageInfo)));
+    for (const auto index : plan.imagesFloat) {
+        imagesFloat.push_back(planned.image(index));
     }
-
-    for (int i = 0; i < 8; i++) {
-        imagesRg.emplace_back(std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), rgImageInfo)));
+    // the fifth image is only used by the filters, so it lives in transient memory
+    imagesFloat.insert(imagesFloat.begin() + 4, planned.transientImages[plan.imageFloatTemp]);
+    for (const auto index : plan.imagesRg) {
+        imagesRg.push_back(planned.transientImages[index]);
     }
-
-    for (int i = 0; i < 2; i++) {
-        imagesColor.emplace_back(std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), colorImageInfo)));
+    for (const auto index : plan.imagesColor) {
+        imagesColor.push_back(planned.image(index));
     }
 
     return FSIMResources{
@@ -373,8 +342,9 @@ IQM::Bin::FSIMResources IQM::Bin::fsim_init_res(const InputImage &test, const In
         .stgInputMemory = std::move(stgMem),
         .stgRef = std::move(stgRefBuf),
         .stgRefMemory = std::move(stgRefMem),
-        .imageInput = imageInput,
-        .imageRef = imageRef,
+        .transientMemory = std::move(planned.transientMemory),
+        .imageInput = planned.transientImages[plan.imageInput],
+        .imageRef = planned.image(plan.imageRef),
         .imagesFloat = imagesFloat,
         .imagesRg = imagesRg,
         .imagesColor = imagesColor,
@@ -390,34 +360,31 @@ IQM::Bin::FSIMResources IQM::Bin::fsim_init_res(const InputImage &test, const In
     };
 }
 
-void IQM::Bin::fsim_upload(const VulkanInstance& instance, const FSIMResources& res) {
-    const vk::CommandBufferBeginInfo beginInfo = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-    };
-    instance.cmdBufTransfer()->begin(beginInfo);
-
+void IQM::Bin::fsim_record_upload(const vk::raii::CommandBuffer &cmdBuf, const FSIMResources &res, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
     std::vector imagesToInit = {
         res.imageInput,
-        res.imageRef,
     };
 
-    imagesToInit.insert(imagesToInit.end(), res.imagesFloat.begin(), res.imagesFloat.end());
-    imagesToInit.insert(imagesToInit.end(), res.imagesRg.begin(), res.imagesRg.end());
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
+
+    // `imagesFloat[4]` and `imagesRg` share memory with the input, FSIM initializes them before their first write
+    imagesToInit.insert(imagesToInit.end(), res.imagesFloat.begin(), res.imagesFloat.begin() + 4);
+    imagesToInit.insert(imagesToInit.end(), res.imagesFloat.begin() + 5, res.imagesFloat.end());
     imagesToInit.insert(imagesToInit.end(), res.imagesColor.begin(), res.imagesColor.end());
 
-    VulkanResource::initImages(*instance.cmdBufTransfer(), imagesToInit);
+    VulkanResource::initImages(cmdBuf, imagesToInit);
 
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageInput->width,
-        .bufferImageHeight = res.imageInput->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageInput->width, res.imageInput->height, 1}
-    };
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgInput, res.imageInput->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgRef, res.imageRef->image,  vk::ImageLayout::eGeneral, copyRegion);
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
+}
 
+void IQM::Bin::fsim_upload(const VulkanInstance& instance, const FSIMResources& res, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    fsim_record_upload(*instance.cmdBufTransfer(), res, upload, nullptr, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -431,25 +398,47 @@ void IQM::Bin::fsim_upload(const VulkanInstance& instance, const FSIMResources&
         .pSignalSemaphores = &*res.uploadDone
     };
 
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
     instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
 }
 
-IQM::Bin::FSIMResult IQM::Bin::fsim_copy_back(const VulkanInstance& instance, const FSIMResources& res, Timestamps &timestamps) {
-    FSIMResult result;
-
-    // copy out
-    const vk::CommandBufferBeginInfo beginInfoCopy = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-    };
-    instance.cmdBufTransfer()->begin(beginInfoCopy);
+IQM::Bin::InputUpload IQM::Bin::fsim_stage(const FSIMResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
 
+void IQM::Bin::fsim_record_download(const vk::raii::CommandBuffer &cmdBuf, const FSIMResources &res) {
     vk::BufferCopy bufCopy{
         .srcOffset = 0,
         .dstOffset = 0,
         .size = 3 * sizeof(float),
     };
-    instance.cmdBufTransfer()->copyBuffer(res.bufFft, res.stgInput, bufCopy);
+    cmdBuf.copyBuffer(res.bufFft, res.stgInput, bufCopy);
+}
+
+IQM::Bin::FSIMResult IQM::Bin::fsim_read_back(const FSIMResources &res) {
+    FSIMResult result;
+
+    std::vector<float> outputData(3);
+    void * outBufData = res.stgInputMemory.mapMemory(0, 3 * sizeof(float), {});
+    res.stgInputMemory.invalidate();
+    memcpy(outputData.data(), outBufData, 3 * sizeof(float));
+
+    res.stgInputMemory.unmapMemory();
+
+    result.fsim = outputData[1] / outputData[0];
+    result.fsimc = outputData[2] / outputData[0];
+
+    return result;
+}
 
+IQM::Bin::FSIMResult IQM::Bin::fsim_copy_back(const VulkanInstance& instance, const FSIMResources& res, Timestamps &timestamps) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    fsim_record_download(*instance.cmdBufTransfer(), res);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -472,15 +461,8 @@ IQM::Bin::FSIMResult IQM::Bin::fsim_copy_back(const VulkanInstance& instance, co
 
     timestamps.mark("end GPU work");
 
-    std::vector<float> outputData(3);
-    void * outBufData = res.stgInputMemory.mapMemory(0, 3 * sizeof(float), {});
-    memcpy(outputData.data(), outBufData, 3 * sizeof(float));
-
-    res.stgInputMemory.unmapMemory();
+    auto result = fsim_read_back(res);
     timestamps.mark("end copy from GPU");
 
-    result.fsim = outputData[1] / outputData[0];
-    result.fsimc = outputData[2] / outputData[0];
-
     return result;
-}
\ No newline at end of file
+}
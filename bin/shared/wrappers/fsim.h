@@ -9,17 +9,25 @@
 #include <IQM/fsim.h>
 #include "../../shared/vulkan.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
 #include "../../shared/io.h"
 #include "../../shared/timestamps.h"
+#include "../../shared/roi.h"
+#include "../../shared/resource_plan.h"
 #include "../../IQM/args.h"
 #include "../../IQM-profile/args.h"
 
 namespace IQM::Bin {
     struct FSIMResources {
         vk::raii::Buffer stgInput = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
         vk::raii::Buffer stgRef = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
+
+        // shared by `imageInput`, `imagesFloat[4]` and `imagesRg`, whose lifetimes don't overlap,
+        // declared before them, so it's freed only after the images bound to it are destroyed
+        DeviceAllocation transientMemory;
 
         // RGBA u8 input images
         std::shared_ptr<VulkanImage> imageInput;
@@ -33,9 +41,9 @@ namespace IQM::Bin {
         std::vector<std::shared_ptr<VulkanImage>> imagesColor;
 
         vk::raii::Buffer bufFft = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory memFft = VK_NULL_HANDLE;
+        DeviceAllocation memFft;
         vk::raii::Buffer bufIfft = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory memIfft = VK_NULL_HANDLE;
+        DeviceAllocation memIfft;
 
         vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
         vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
@@ -44,6 +52,24 @@ namespace IQM::Bin {
         // FFT
         vk::raii::Fence fftFence = VK_NULL_HANDLE;
         vk::raii::Fence ifftFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    // device local resources of `fsim_init_res`, also used to estimate memory of a pair
+    struct FSIMPlan {
+        ResourcePlan resources;
+        unsigned bufFft;
+        unsigned bufIfft;
+        unsigned imageRef;
+        // all float images except the fifth one, which is transient
+        std::vector<unsigned> imagesFloat;
+        std::vector<unsigned> imagesColor;
+        // indices of transient images
+        unsigned imageInput;
+        unsigned imageFloatTemp;
+        std::vector<unsigned> imagesRg;
     };
 
     struct FSIMResult {
@@ -51,11 +77,49 @@ namespace IQM::Bin {
         float fsimc;
     };
 
-    void fsim_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+    class FSIMJob : public BatchJob {
+    public:
+        // `shared` provides pipelines reused by jobs of all slots
+        FSIMJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<FSIMResources>& pool, const IQM::FSIM& shared);
+        ~FSIMJob() override;
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        void destroyFft();
+
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<FSIMResources>& pool;
+        IQM::FSIM fsim;
+        RegionOfInterest roi;
+        // mask of the current pair at the downscaled resolution, empty without region of interest
+        IQM::Mask pairMask;
+        std::optional<PooledResource<FSIMResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+
+        // FFT plans for current pair
+        VkFFTApplication fftApplication = {};
+        VkFFTApplication fftApplicationInverse = {};
+        bool hasFft = false;
+    };
+
+
     void fsim_run_single(const IQM::ProfileArgs& args, const IQM::VulkanInstance& instance, IQM::FSIM& fsim, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
 
-    FSIMResources fsim_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance& instance, unsigned dWidth, unsigned dHeight);
-    void fsim_upload(const IQM::VulkanInstance& instance, const FSIMResources& res);
+    FSIMPlan fsim_plan(unsigned width, unsigned height, unsigned dWidth, unsigned dHeight);
+    FSIMResources fsim_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance, unsigned dWidth, unsigned dHeight);
+    InputUpload fsim_stage(const FSIMResources& res, const InputImage &test, const InputImage *ref);
+    IQM::FSIMInput fsim_input(const IQM::VulkanInstance& instance, const FSIMResources& res, const vk::raii::CommandBuffer& cmdBuf);
+    void fsim_record_upload(const vk::raii::CommandBuffer& cmdBuf, const FSIMResources& res, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void fsim_upload(const IQM::VulkanInstance& instance, const FSIMResources& res, const InputUpload& upload);
+    void fsim_record_download(const vk::raii::CommandBuffer& cmdBuf, const FSIMResources& res);
+    FSIMResult fsim_read_back(const FSIMResources& res);
     FSIMResult fsim_copy_back(const IQM::VulkanInstance& instance, const FSIMResources& res, Timestamps &timestamps);
 }
 
@@ -7,162 +7,88 @@
 #include "lpips.h"
 #include "../../shared/debug_utils.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/incremental.h"
 #include "IQM/base/colorize.h"
 #include "IQM/base/viridis.h"
 
-void IQM::Bin::lpips_run(const IQM::Bin::Args &args, const IQM::VulkanInstance &instance, const std::vector<Match> &imageMatches) {
-    IQM::LPIPS lpips(*instance.device());
-    IQM::Colorize colorizer(*instance.device());
-
-    VulkanResource::resetMemCounter();
-
-    auto modelData = load_model("lpips.dat");
-    auto model = lpips_load_model(instance, lpips.modelSize(), modelData);
-    auto modelSize = VulkanResource::memCounter();
-
-    int processed = 0;
-
-    for (const auto& match : imageMatches) {
-        try {
-            VulkanResource::resetMemCounter();
-            // model is shared
-            VulkanResource::addMemCounter(modelSize);
-            Timestamps timestamps;
-            auto start = std::chrono::high_resolution_clock::now();
-
-            const auto input = load_image(match.testPath);
-            const auto reference = load_image(match.refPath);
-            if (input.height != reference.height || input.width != reference.width) {
-                throw std::runtime_error("Test and reference images have different sizes");
-            }
-
-            timestamps.mark("images loaded");
-
-            initRenderDoc();
-
-            auto sizes = lpips.bufferSizes(input.width, input.height);
-
-            auto res = lpips_init_res(input, reference, instance, sizes, args.outputPath.has_value(), args.colorize);
-            timestamps.mark("resources allocated");
-
-            lpips_upload(instance, res, model, lpips.modelSize(), args.outputPath.has_value(), args.colorize);
-
-            auto lpipsArgs = IQM::LPIPSInput {
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivTest = &res.imageInput->imageView,
-                .ivRef = &res.imageRef->imageView,
-                .imgOut = nullptr,
-                .bufWeights = &model.weightsBuf,
-                .bufTest = &res.convInputBuf,
-                .bufRef = &res.convRefBuf,
-                .bufComp = &res.compareBuf,
-                .width = input.width,
-                .height = input.height,
-            };
-
-            if (res.imageOut != nullptr) {
-                lpipsArgs.imgOut = &res.imageOut->image;
-            }
+IQM::Bin::LPIPSJob::LPIPSJob(const Args &args, const VulkanInstance &instance, ResourcePool<LPIPSResources> &pool, const LPIPSModelResources &model, const unsigned long modelMemSize, const IQM::LPIPS &shared, const IQM::Colorize *sharedColorizer):
+    args(args),
+    instance(instance),
+    pool(pool),
+    model(model),
+    modelMemSize(modelMemSize),
+    lpips(*instance.device(), shared),
+    gridFormat(score_grid_format(args.options)),
+    roi(args.options) {
+    if (sharedColorizer != nullptr) {
+        this->colorizer.emplace(*instance.device(), *sharedColorizer);
+    }
+    // the network sees the whole image, so no region can be recomputed on its own
+    IncrementalSession::requireUnset(args, "LPIPS");
+}
 
-            const vk::CommandBufferBeginInfo beginInfo = {
-                .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-            };
-            instance.cmdBuf()->begin(beginInfo);
-
-            lpips.computeMetric(lpipsArgs);
-
-            if (args.outputPath.has_value()) {
-                if (args.colorize) {
-                    auto colorizerInput = IQM::ColorizeInput{
-                        .device = instance.device(),
-                        .cmdBuf = &*instance.cmdBuf(),
-                        .ivIn = &res.imageOut->imageView,
-                        .ivOut = &res.imageInput->imageView,
-                        .ivColormap = &res.imageColorMap->imageView,
-                        .invert = false,
-                        .scaler = 4.0,
-                        .width = input.width,
-                        .height = input.height
-                    };
-
-                    colorizer.compute(colorizerInput);
-                } else {
-                    std::array offsets = {
-                        vk::Offset3D{0, 0, 0},
-                        vk::Offset3D{static_cast<int>(res.imageInput->width), static_cast<int>(res.imageInput->height), 1}
-                    };
-                    // copy RGBA f32 to RGBA u8
-                    std::vector region {
-                        vk::ImageBlit {
-                            .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                            .srcOffsets = offsets,
-                            .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                            .dstOffsets = offsets,
-                        }
-                    };
-                    instance.cmdBuf()->blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
-                }
-            }
+void IQM::Bin::LPIPSJob::prepare(const DecodedPair &pair) {
+    this->hasOutput = pair.match.outPath.has_value() && !this->gridFormat.has_value();
+    this->hasGrid = pair.match.outPath.has_value() && this->gridFormat.has_value();
+    this->pairMask = this->roi.enabled() ? this->roi.mask(this->instance, pair.test.width, pair.test.height) : IQM::Mask{};
 
-            instance.cmdBuf()->end();
+    const auto sizes = this->lpips.bufferSizes(pair.test.width, pair.test.height);
 
-            const std::vector cmdBufs = {
-                &**instance.cmdBuf()
-            };
+    const ResourceKey key{.method = Method::LPIPS, .width = pair.test.width, .height = pair.test.height, .options = std::to_string(this->hasOutput) + std::to_string(this->args.colorize)};
+    this->pooled = this->pool.acquire(key, [&] { return lpips_init_res(pair.test.width, pair.test.height, this->instance, sizes, this->hasOutput, this->args.colorize); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = lpips_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+    }
+}
 
-            auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
-            const vk::SubmitInfo submitInfo{
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*res.uploadDone,
-                .pWaitDstStageMask = &mask,
-                .commandBufferCount = 1,
-                .pCommandBuffers = *cmdBufs.data(),
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &*res.computeDone
-            };
+void IQM::Bin::LPIPSJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    lpips_record_upload(cmdBuf, *this->pooled->res, this->hasOutput, this->args.colorize, this->upload, this->sharedInput, this->refResident);
+}
 
-            instance.queue()->submit(submitInfo, {});
-            timestamps.mark("submit compute GPU pipeline");
-            // wait so cmd buffer can be reused for GPU -> CPU transfer
-            instance.waitForFence(res.transferFence);
+void IQM::Bin::LPIPSJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    lpips_record_compute(cmdBuf, this->instance, this->lpips, this->colorizer.has_value() ? &this->colorizer.value() : nullptr, *this->pooled->res, this->model, this->hasOutput, this->hasGrid, this->pairMask);
+}
 
-            auto result = lpips_copy_back(instance, res, timestamps, args.outputPath.has_value(), args.colorize);
+void IQM::Bin::LPIPSJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    lpips_record_download(cmdBuf, *this->pooled->res, this->hasOutput, this->args.colorize, this->hasGrid);
+}
 
-            finishRenderDoc();
-            if (match.outPath.has_value()) {
-                if (args.colorize) {
-                    save_color_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                } else {
-                    save_char_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                }
-            }
-
-            timestamps.mark("output saved");
-
-            const auto end = std::chrono::high_resolution_clock::now();
-            std::cout << match.testPath << ": " << result.distance << std::endl;
-            if (args.verbose) {
-                timestamps.print(start, end);
-                double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
-                std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to process '" << match.testPath << "': " << e.what() << std::endl;
-            continue;
+std::vector<IQM::Bin::MetricValue> IQM::Bin::LPIPSJob::finish(const DecodedPair &pair) {
+    const auto result = lpips_read_back(*this->pooled->res, this->hasOutput, this->args.colorize, this->hasGrid);
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
+
+    if (this->hasGrid) {
+        const auto grid = IQM::Reduce::gridExtent(pair.test.width, pair.test.height, SCORE_GRID_CELL);
+        save_score_grid(pair.match.outPath.value(), this->gridFormat.value(), result.grid, grid.width, grid.height);
+    } else if (pair.match.outPath.has_value()) {
+        if (this->args.colorize) {
+            save_color_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        } else {
+            save_char_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
         }
-
-        processed += 1;
     }
 
-    std::cout << "Processed " << processed << "/" << imageMatches.size() <<" images" << std::endl;
+    return {MetricValue{.name = "LPIPS", .value = result.distance, .unit = ""}};
+}
+
+unsigned long IQM::Bin::LPIPSJob::resourceSize() const {
+    // model is shared between all pairs
+    return this->modelMemSize + (this->pooled.has_value() ? this->pooled->size : 0);
+}
+
+unsigned long IQM::Bin::LPIPSJob::estimateSize(const DecodedPair &pair) const {
+    // model is allocated once, outside of the budget for pairs
+    const auto hasOutput = pair.match.outPath.has_value() && !this->gridFormat.has_value();
+    const auto sizes = this->lpips.bufferSizes(pair.test.width, pair.test.height);
+    return lpips_plan(pair.test.width, pair.test.height, sizes, hasOutput, this->args.colorize).resources.estimate();
 }
 
 void IQM::Bin::lpips_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::LPIPS &lpips, const IQM::Bin::InputImage &input, const IQM::Bin::InputImage &ref, const std::vector<float> &lpipsModel) {
     try {
         VulkanResource::resetMemCounter();
-        IQM::Colorize colorizer(*instance.device());
-
         Timestamps timestamps;
         auto start = std::chrono::high_resolution_clock::now();
 
@@ -172,11 +98,12 @@ void IQM::Bin::lpips_run_single(const IQM::ProfileArgs &args, const IQM::VulkanI
 
         auto sizes = lpips.bufferSizes(input.width, input.height);
 
-        auto res = lpips_init_res(input, ref, instance, sizes, true, args.colorize);
+        auto res = lpips_init_res(input.width, input.height, instance, sizes, true, args.colorize);
+        const auto upload = lpips_stage(res, input, &ref);
         auto model = lpips_load_model(instance, lpips.modelSize(), lpipsModel);
         timestamps.mark("resources allocated");
 
-        lpips_upload(instance, res, model, lpips.modelSize(), true, args.colorize);
+        lpips_upload(instance, res, true, args.colorize, upload);
 
         auto lpipsArgs = IQM::LPIPSInput {
             .device = instance.device(),
@@ -241,78 +168,14 @@ void IQM::Bin::lpips_run_single(const IQM::ProfileArgs &args, const IQM::VulkanI
     }
 }
 
-IQM::Bin::LPIPSResources IQM::Bin::lpips_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance &instance, const LPIPSBufferSizes &bufferSizes, const bool hasOutput, const bool colorize) {
-    // always 4 channels on input, with 1B per channel
-    const auto size = (test.width * test.height + 1) * 4;
-    const auto colormapSize = 256 * 4 * sizeof(float);
-    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached
-    );
-    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
-    *instance.device(),
-    *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        colormapSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-
-    auto [convInputBuf, convInputMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        bufferSizes.bufTest,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    auto [convRefBuf, convRefMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        bufferSizes.bufRef,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    auto [compBuf, compMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        bufferSizes.bufComp,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-
-    stgBuf.bindMemory(stgMem, 0);
-    stgRefBuf.bindMemory(stgRefMem, 0);
-    cmBuf.bindMemory(cmMem, 0);
-    convInputBuf.bindMemory(convInputMem, 0);
-    convRefBuf.bindMemory(convRefMem, 0);
-    compBuf.bindMemory(compMem, 0);
-
-    void * inBufData = stgMem.mapMemory(0, size, {});
-    memcpy(inBufData, test.data.data(), size);
-    stgMem.unmapMemory();
-
-    inBufData = stgRefMem.mapMemory(0, size, {});
-    memcpy(inBufData, ref.data.data(), size);
-    stgRefMem.unmapMemory();
-
-    inBufData = cmMem.mapMemory(0, colormapSize, {});
-    memcpy(inBufData, viridis, colormapSize);
-    cmMem.unmapMemory();
+IQM::Bin::LPIPSPlan IQM::Bin::lpips_plan(const unsigned width, const unsigned height, const LPIPSBufferSizes &bufferSizes, const bool hasOutput, const bool colorize) {
+    const auto grid = IQM::Reduce::gridExtent(width, height, SCORE_GRID_CELL);
 
     vk::ImageCreateInfo srcImageInfo = {
         .flags = {},
         .imageType = vk::ImageType::e2D,
         .format = vk::Format::eR8G8B8A8Unorm,
-        .extent = vk::Extent3D(test.width, test.height, 1),
+        .extent = vk::Extent3D(width, height, 1),
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
@@ -335,20 +198,64 @@ IQM::Bin::LPIPSResources IQM::Bin::lpips_init_res(const InputImage &test, const
     vk::ImageCreateInfo dstImageInfo = {srcImageInfo};
     dstImageInfo.format = vk::Format::eR32Sfloat;
 
-    auto const imageInput = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageRef = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-
-    auto imageOut = std::shared_ptr<VulkanImage>();
-    auto imageExport = std::shared_ptr<VulkanImage>();
-    auto imageColorMap = std::shared_ptr<VulkanImage>();
+    const auto bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    LPIPSPlan plan;
+    plan.convInputBuf = plan.resources.buffer(bufferSizes.bufTest, bufferUsage);
+    plan.convRefBuf = plan.resources.buffer(bufferSizes.bufRef, bufferUsage);
+    plan.compareBuf = plan.resources.buffer(bufferSizes.bufComp, bufferUsage);
+    plan.gridBuf = plan.resources.buffer(
+        grid.width * grid.height * sizeof(float),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+    );
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
     if (hasOutput) {
-        imageOut = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), dstImageInfo));
+        plan.imageOut = plan.resources.image(dstImageInfo);
         if (colorize) {
-            imageColorMap = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), colorMapImageInfo));
+            plan.imageColorMap = plan.resources.image(colorMapImageInfo);
         } else {
-            imageExport = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), exitImageInfo));
+            plan.imageExport = plan.resources.image(exitImageInfo);
         }
     }
+    return plan;
+}
+
+IQM::Bin::LPIPSResources IQM::Bin::lpips_init_res(const unsigned width, const unsigned height, const IQM::VulkanInstance &instance, const LPIPSBufferSizes &bufferSizes, const bool hasOutput, const bool colorize) {
+    // always 4 channels on input, with 1B per channel
+    const auto size = (width * height + 1) * 4;
+    const auto colormapSize = 256 * 4 * sizeof(float);
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+    *instance.device(),
+    *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        colormapSize,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    void * inBufData = cmMem.mapMemory(0, colormapSize, {});
+    memcpy(inBufData, viridis, colormapSize);
+    cmMem.unmapMemory();
+
+    const auto plan = lpips_plan(width, height, bufferSizes, hasOutput, colorize);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [convInputBuf, convInputMem] = planned.takeBuffer(plan.convInputBuf);
+    auto [convRefBuf, convRefMem] = planned.takeBuffer(plan.convRefBuf);
+    auto [compBuf, compMem] = planned.takeBuffer(plan.compareBuf);
+    auto [gridBuf, gridMem] = planned.takeBuffer(plan.gridBuf);
 
     return LPIPSResources{
         .stgInput = std::move(stgBuf),
@@ -363,28 +270,28 @@ IQM::Bin::LPIPSResources IQM::Bin::lpips_init_res(const InputImage &test, const
         .convRefMemory = std::move(convRefMem),
         .compareBuf = std::move(compBuf),
         .compareMemory = std::move(compMem),
-        .imageInput = imageInput,
-        .imageRef = imageRef,
-        .imageOut = imageOut,
-        .imageExport = imageExport,
-        .imageColorMap = imageColorMap,
+        .gridBuf = std::move(gridBuf),
+        .gridMemory = std::move(gridMem),
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
+        .imageOut = planned.image(plan.imageOut),
+        .imageExport = planned.image(plan.imageExport),
+        .imageColorMap = planned.image(plan.imageColorMap),
         .uploadDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .computeDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .transferFence = instance.device()->createFence(vk::FenceCreateInfo{}),
     };
 }
 
-void IQM::Bin::lpips_upload(const IQM::VulkanInstance &instance, const LPIPSResources &res, const LPIPSModelResources &model, const unsigned long modelSize, const bool hasOutput, const bool colorize) {
-    const vk::CommandBufferBeginInfo beginInfo = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-    };
-    instance.cmdBufTransfer()->begin(beginInfo);
-
+void IQM::Bin::lpips_record_upload(const vk::raii::CommandBuffer &cmdBuf, const LPIPSResources &res, const bool hasOutput, const bool colorize, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
     std::vector imagesToInit = {
         res.imageInput,
-        res.imageRef,
     };
 
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
+
     if (hasOutput) {
         imagesToInit.push_back(res.imageOut);
         if (colorize) {
@@ -394,25 +301,9 @@ void IQM::Bin::lpips_upload(const IQM::VulkanInstance &instance, const LPIPSReso
         }
     }
 
-    VulkanResource::initImages(*instance.cmdBufTransfer(), imagesToInit);
+    VulkanResource::initImages(cmdBuf, imagesToInit);
 
-    vk::BufferCopy modelRegion {
-        .srcOffset = 0,
-        .dstOffset = 0,
-        .size = modelSize,
-    };
-    instance.cmdBufTransfer()->copyBuffer(model.stgWeights, model.weightsBuf, {modelRegion});
-
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageInput->width,
-        .bufferImageHeight = res.imageInput->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageInput->width, res.imageInput->height, 1}
-    };
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgInput, res.imageInput->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgRef, res.imageRef->image,  vk::ImageLayout::eGeneral, copyRegion);
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
     if (hasOutput && colorize) {
         vk::BufferImageCopy copyColorMapRegion{
             .bufferOffset = 0,
@@ -422,9 +313,16 @@ void IQM::Bin::lpips_upload(const IQM::VulkanInstance &instance, const LPIPSReso
             .imageOffset = vk::Offset3D{0, 0, 0},
             .imageExtent = vk::Extent3D{256, 1, 1}
         };
-        instance.cmdBufTransfer()->copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
+        cmdBuf.copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
     }
+}
 
+void IQM::Bin::lpips_upload(const IQM::VulkanInstance &instance, const LPIPSResources &res, const bool hasOutput, const bool colorize, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    lpips_record_upload(*instance.cmdBufTransfer(), res, hasOutput, colorize, upload, nullptr, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -438,6 +336,8 @@ void IQM::Bin::lpips_upload(const IQM::VulkanInstance &instance, const LPIPSReso
         .pSignalSemaphores = &*res.uploadDone
     };
 
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
     instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
 }
 
@@ -457,13 +357,39 @@ IQM::Bin::LPIPSModelResources IQM::Bin::lpips_load_model(const IQM::VulkanInstan
         vk::MemoryPropertyFlagBits::eDeviceLocal
     );
 
-    stgWeightBuf.bindMemory(stgWeightMem, 0);
-    weightBuf.bindMemory(weightMem, 0);
 
     void * inBufData = stgWeightMem.mapMemory(0, modelSize, {});
     memcpy(inBufData, modelData.data(), modelSize);
     stgWeightMem.unmapMemory();
 
+    // weights are uploaded once here, so per-pair uploads don't rewrite buffer possibly read by other pairs
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+
+    vk::BufferCopy modelRegion {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = modelSize,
+    };
+    instance.cmdBufTransfer()->copyBuffer(stgWeightBuf, weightBuf, {modelRegion});
+
+    instance.cmdBufTransfer()->end();
+
+    const std::vector cmdBufsCopy = {
+        &**instance.cmdBufTransfer()
+    };
+
+    const vk::SubmitInfo submitInfoCopy{
+        .commandBufferCount = 1,
+        .pCommandBuffers = *cmdBufsCopy.data(),
+    };
+
+    const vk::raii::Fence fenceCopy{*instance.device(), vk::FenceCreateInfo{}};
+    instance.queueTransfer()->submit(submitInfoCopy, *fenceCopy);
+    instance.waitForFence(fenceCopy);
+
     return LPIPSModelResources{
         .stgWeights = std::move(stgWeightBuf),
         .stgWeightsMemory = std::move(stgWeightMem),
@@ -472,21 +398,88 @@ IQM::Bin::LPIPSModelResources IQM::Bin::lpips_load_model(const IQM::VulkanInstan
     };
 }
 
-IQM::Bin::LPIPSResult IQM::Bin::lpips_copy_back(const VulkanInstance &instance, const LPIPSResources &res, Timestamps &timestamps, bool hasOutput, bool colorize) {
-    LPIPSResult result;
+IQM::Bin::InputUpload IQM::Bin::lpips_stage(const LPIPSResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
 
-    // copy out
-    const vk::CommandBufferBeginInfo beginInfoCopy = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+void IQM::Bin::lpips_record_compute(const vk::raii::CommandBuffer &cmdBuf, const IQM::VulkanInstance &instance, IQM::LPIPS &lpips, IQM::Colorize *colorizer, const LPIPSResources &res, const LPIPSModelResources &model, const bool hasOutput, const bool grid, const IQM::Mask &mask) {
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+
+    auto lpipsArgs = IQM::LPIPSInput {
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .imgOut = nullptr,
+        .bufWeights = &model.weightsBuf,
+        .bufTest = &res.convInputBuf,
+        .bufRef = &res.convRefBuf,
+        .bufComp = &res.compareBuf,
+        .width = width,
+        .height = height,
+        .mask = mask,
+        .bufGrid = grid ? &res.gridBuf : nullptr,
+        .gridCell = SCORE_GRID_CELL,
     };
-    instance.cmdBufTransfer()->begin(beginInfoCopy);
 
+    if (res.imageOut != nullptr) {
+        lpipsArgs.imgOut = &res.imageOut->image;
+    }
+
+    lpips.computeMetric(lpipsArgs);
+
+    if (hasOutput) {
+        if (colorizer != nullptr) {
+            auto colorizerInput = IQM::ColorizeInput{
+                .device = instance.device(),
+                .cmdBuf = &cmdBuf,
+                .ivIn = &res.imageOut->imageView,
+                .ivOut = &res.imageInput->imageView,
+                .ivColormap = &res.imageColorMap->imageView,
+                .invert = false,
+                .scaler = 4.0,
+                .width = width,
+                .height = height
+            };
+
+            colorizer->compute(colorizerInput);
+        } else {
+            std::array offsets = {
+                vk::Offset3D{0, 0, 0},
+                vk::Offset3D{static_cast<int>(width), static_cast<int>(height), 1}
+            };
+            // copy RGBA f32 to RGBA u8
+            std::vector region {
+                vk::ImageBlit {
+                    .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .srcOffsets = offsets,
+                    .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .dstOffsets = offsets,
+                }
+            };
+            cmdBuf.blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
+        }
+    }
+}
+
+void IQM::Bin::lpips_record_download(const vk::raii::CommandBuffer &cmdBuf, const LPIPSResources &res, const bool hasOutput, const bool colorize, const bool grid) {
     vk::BufferCopy bufCopy{
         .srcOffset = 0,
         .dstOffset = 0,
         .size = sizeof(float),
     };
-    instance.cmdBufTransfer()->copyBuffer(res.convInputBuf, res.stgInput, bufCopy);
+    cmdBuf.copyBuffer(res.convInputBuf, res.stgInput, bufCopy);
+
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(res.imageInput->width, res.imageInput->height, SCORE_GRID_CELL);
+        vk::BufferCopy gridCopy{
+            .srcOffset = 0,
+            .dstOffset = sizeof(float),
+            .size = extent.width * extent.height * sizeof(float),
+        };
+        cmdBuf.copyBuffer(res.gridBuf, res.stgInput, gridCopy);
+    }
 
     if (hasOutput) {
         vk::BufferImageCopy copyRegion{
@@ -499,12 +492,50 @@ IQM::Bin::LPIPSResult IQM::Bin::lpips_copy_back(const VulkanInstance &instance,
         };
 
         if (colorize) {
-            instance.cmdBufTransfer()->copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
+            cmdBuf.copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
         } else {
-            instance.cmdBufTransfer()->copyImageToBuffer(res.imageExport->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
+            cmdBuf.copyImageToBuffer(res.imageExport->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
+        }
+    }
+}
+
+IQM::Bin::LPIPSResult IQM::Bin::lpips_read_back(const LPIPSResources &res, const bool hasOutput, const bool colorize, const bool grid) {
+    LPIPSResult result;
+
+    const auto outBufData = static_cast<unsigned char *>(res.stgInputMemory.mapMemory(0, sizeof(float) + res.imageInput->width * res.imageInput->height * 4, {}));
+    res.stgInputMemory.invalidate();
+    memcpy(&result.distance, outBufData, sizeof(float));
+
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(res.imageInput->width, res.imageInput->height, SCORE_GRID_CELL);
+        result.grid.resize(extent.width * extent.height);
+        memcpy(result.grid.data(), outBufData + sizeof(float), result.grid.size() * sizeof(float));
+    }
+
+    if (hasOutput) {
+        if (colorize) {
+            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height * 4);
+            memcpy(data.data(), outBufData + sizeof(float), res.imageInput->height * res.imageInput->width * 4 * sizeof(unsigned char));
+            result.imageData = std::move(data);
+        } else {
+            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height);
+            memcpy(data.data(), outBufData + sizeof(float), res.imageInput->height * res.imageInput->width * sizeof(unsigned char));
+            result.imageData = std::move(data);
         }
     }
 
+    res.stgInputMemory.unmapMemory();
+
+    return result;
+}
+
+IQM::Bin::LPIPSResult IQM::Bin::lpips_copy_back(const VulkanInstance &instance, const LPIPSResources &res, Timestamps &timestamps, bool hasOutput, bool colorize) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    lpips_record_download(*instance.cmdBufTransfer(), res, hasOutput, colorize, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -527,22 +558,7 @@ IQM::Bin::LPIPSResult IQM::Bin::lpips_copy_back(const VulkanInstance &instance,
 
     timestamps.mark("end GPU work");
 
-    void * outBufData = res.stgInputMemory.mapMemory(0, sizeof(float) + res.imageInput->width * res.imageInput->height * 4, {});
-    memcpy(&result.distance, outBufData, sizeof(float));
-
-    if (hasOutput) {
-        if (colorize) {
-            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height * 4);
-            memcpy(data.data(), outBufData + sizeof(float), res.imageInput->height * res.imageInput->width * 4 * sizeof(unsigned char));
-            result.imageData = std::move(data);
-        } else {
-            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height);
-            memcpy(data.data(), outBufData + sizeof(float), res.imageInput->height * res.imageInput->width * sizeof(unsigned char));
-            result.imageData = std::move(data);
-        }
-    }
-
-    res.stgInputMemory.unmapMemory();
+    auto result = lpips_read_back(res, hasOutput, colorize, false);
     timestamps.mark("end copy from GPU");
 
     return result;
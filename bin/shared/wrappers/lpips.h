@@ -7,28 +7,36 @@
 #define IQM_BIN_LPIPS_H
 
 #include <IQM/lpips.h>
+#include <IQM/base/colorize.h>
 #include "../../shared/vulkan.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
 #include "../../shared/io.h"
 #include "../../shared/timestamps.h"
+#include "../../shared/roi.h"
+#include "../../shared/resource_plan.h"
 #include "../../IQM/args.h"
 #include "../../IQM-profile/args.h"
 
 namespace IQM::Bin {
     struct LPIPSResources {
         vk::raii::Buffer stgInput = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
         vk::raii::Buffer stgRef = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
         vk::raii::Buffer stgColormap = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgColormapMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgColormapMemory;
 
         vk::raii::Buffer convInputBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory convInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation convInputMemory;
         vk::raii::Buffer convRefBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory convRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation convRefMemory;
         vk::raii::Buffer compareBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory compareMemory = VK_NULL_HANDLE;
+        DeviceAllocation compareMemory;
+        // mean distance of each cell of the score grid
+        vk::raii::Buffer gridBuf = VK_NULL_HANDLE;
+        DeviceAllocation gridMemory;
 
         // RGBA u8 input images
         std::shared_ptr<VulkanImage> imageInput;
@@ -46,26 +54,83 @@ namespace IQM::Bin {
         vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
         vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
         vk::raii::Fence transferFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
     };
 
     struct LPIPSModelResources {
         vk::raii::Buffer stgWeights = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgWeightsMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgWeightsMemory;
         vk::raii::Buffer weightsBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory weightsMemory = VK_NULL_HANDLE;
+        DeviceAllocation weightsMemory;
+    };
+
+    // device local resources of `lpips_init_res`, also used to estimate memory of a pair
+    struct LPIPSPlan {
+        ResourcePlan resources;
+        unsigned convInputBuf;
+        unsigned convRefBuf;
+        unsigned compareBuf;
+        unsigned gridBuf;
+        unsigned imageInput;
+        unsigned imageRef;
+        std::optional<unsigned> imageOut;
+        std::optional<unsigned> imageExport;
+        std::optional<unsigned> imageColorMap;
     };
 
     struct LPIPSResult {
         std::vector<unsigned char> imageData;
+        std::vector<float> grid;
         float distance;
     };
 
-    void lpips_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+    class LPIPSJob : public BatchJob {
+    public:
+        // `shared` provides pipelines reused by jobs of all slots, `sharedColorizer` is null without colorized output
+        LPIPSJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<LPIPSResources>& pool, const LPIPSModelResources& model, unsigned long modelMemSize, const IQM::LPIPS& shared, const IQM::Colorize* sharedColorizer);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<LPIPSResources>& pool;
+        const LPIPSModelResources& model;
+        unsigned long modelMemSize;
+        IQM::LPIPS lpips;
+        // only created when output is colorized
+        std::optional<IQM::Colorize> colorizer;
+        bool hasOutput = false;
+        // the score grid is saved instead of the output image
+        std::optional<ScoreGridFormat> gridFormat;
+        bool hasGrid = false;
+        RegionOfInterest roi;
+        // mask of the current pair, empty without region of interest
+        IQM::Mask pairMask;
+        std::optional<PooledResource<LPIPSResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+    };
+
+
     void lpips_run_single(const IQM::ProfileArgs& args, const IQM::VulkanInstance& instance, IQM::LPIPS& lpips, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref, const std::vector<float> &lpipsModel);
 
-    LPIPSResources lpips_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance& instance, const LPIPSBufferSizes &bufferSizes, bool hasOutput, bool colorize);
-    void lpips_upload(const IQM::VulkanInstance& instance, const LPIPSResources& res, const LPIPSModelResources &model, unsigned long modelSize, bool hasOutput, bool colorize);
+    LPIPSPlan lpips_plan(unsigned width, unsigned height, const LPIPSBufferSizes &bufferSizes, bool hasOutput, bool colorize);
+    LPIPSResources lpips_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance, const LPIPSBufferSizes &bufferSizes, bool hasOutput, bool colorize);
+    InputUpload lpips_stage(const LPIPSResources& res, const InputImage &test, const InputImage *ref);
+    void lpips_record_upload(const vk::raii::CommandBuffer& cmdBuf, const LPIPSResources& res, bool hasOutput, bool colorize, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void lpips_upload(const IQM::VulkanInstance& instance, const LPIPSResources& res, bool hasOutput, bool colorize, const InputUpload& upload);
     LPIPSModelResources lpips_load_model(const IQM::VulkanInstance& instance, unsigned long modelSize, const std::vector<float> &modelData);
+    void lpips_record_compute(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::LPIPS& lpips, IQM::Colorize* colorizer, const LPIPSResources& res, const LPIPSModelResources& model, bool hasOutput, bool grid, const IQM::Mask& mask);
+    // the score grid takes the place of the output image in staging memory, so they can't be downloaded together
+    void lpips_record_download(const vk::raii::CommandBuffer& cmdBuf, const LPIPSResources& res, bool hasOutput, bool colorize, bool grid);
+    LPIPSResult lpips_read_back(const LPIPSResources& res, bool hasOutput, bool colorize, bool grid);
     LPIPSResult lpips_copy_back(const IQM::VulkanInstance& instance, const LPIPSResources& res, Timestamps &timestamps, bool hasOutput, bool colorize);
 }
 
@@ -0,0 +1,329 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <iostream>
+#include "msssim.h"
+#include "../../shared/roi.h"
+#include "../../shared/incremental.h"
+#include "../../shared/debug_utils.h"
+#include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+
+using IQM::Bin::InputImage;
+using IQM::Bin::VulkanImage;
+using IQM::VulkanInstance;
+using IQM::Bin::VulkanResource;
+
+IQM::Bin::MSSSIMPlan IQM::Bin::msssim_plan(const unsigned width, const unsigned height, const IQM::MSSSIM &msssim) {
+    vk::ImageCreateInfo srcImageInfo = {
+        .flags = {},
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .extent = vk::Extent3D(width, height, 1),
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+
+    vk::ImageCreateInfo lumaImageInfo = {srcImageInfo};
+    lumaImageInfo.format = vk::Format::eR32Sfloat;
+    lumaImageInfo.usage = vk::ImageUsageFlagBits::eStorage;
+
+    MSSSIMPlan plan;
+    plan.scaleBuf = plan.resources.buffer(msssim.bufferSize(width, height), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc);
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
+    for (unsigned i = 0; i < IQM::MSSSIM_LEVELS; i++) {
+        lumaImageInfo.extent = vk::Extent3D(width >> i, height >> i, 1);
+        plan.imagesLumaTest.push_back(plan.resources.image(lumaImageInfo));
+        plan.imagesLumaRef.push_back(plan.resources.image(lumaImageInfo));
+    }
+    return plan;
+}
+
+IQM::Bin::MSSSIMResources IQM::Bin::msssim_init_res(const unsigned width, const unsigned height, const VulkanInstance &instance, const IQM::MSSSIM &msssim) {
+    // always 4 channels on input, with 1B per channel, result is read back through the input staging buffer
+    const auto size = (width * height) * 4;
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    const auto plan = msssim_plan(width, height, msssim);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [scaleBuf, scaleMem] = planned.takeBuffer(plan.scaleBuf);
+
+    std::vector<std::shared_ptr<VulkanImage>> imagesLumaTest;
+    std::vector<std::shared_ptr<VulkanImage>> imagesLumaRef;
+    for (unsigned i = 0; i < IQM::MSSSIM_LEVELS; i++) {
+        imagesLumaTest.push_back(planned.image(plan.imagesLumaTest[i]));
+        imagesLumaRef.push_back(planned.image(plan.imagesLumaRef[i]));
+    }
+
+    return MSSSIMResources{
+        .stgInput = std::move(stgBuf),
+        .stgInputMemory = std::move(stgMem),
+        .stgRef = std::move(stgRefBuf),
+        .stgRefMemory = std::move(stgRefMem),
+        .scaleBuf = std::move(scaleBuf),
+        .scaleMemory = std::move(scaleMem),
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
+        .imagesLumaTest = std::move(imagesLumaTest),
+        .imagesLumaRef = std::move(imagesLumaRef),
+        .uploadDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
+        .computeDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
+        .transferFence = instance.device()->createFence(vk::FenceCreateInfo{}),
+    };
+}
+
+IQM::Bin::MSSSIMJob::MSSSIMJob(const Args &args, const VulkanInstance &instance, ResourcePool<MSSSIMResources> &pool, const IQM::MSSSIM &shared):
+    args(args),
+    instance(instance),
+    pool(pool),
+    msssim(*instance.device(), shared) {
+    // levels are downscaled, so a full resolution mask doesn't apply to them
+    RegionOfInterest::requireUnset(args.options, "MS-SSIM");
+    require_no_score_grid(args.options, "MS-SSIM");
+    IncrementalSession::requireUnset(args, "MS-SSIM");
+}
+
+void IQM::Bin::MSSSIMJob::prepare(const DecodedPair &pair) {
+    const ResourceKey key{.method = Method::MS_SSIM, .width = pair.test.width, .height = pair.test.height};
+    this->pooled = this->pool.acquire(key, [&] { return msssim_init_res(pair.test.width, pair.test.height, this->instance, this->msssim); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = msssim_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+    }
+}
+
+void IQM::Bin::MSSSIMJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    msssim_record_upload(cmdBuf, *this->pooled->res, this->upload, this->sharedInput, this->refResident);
+}
+
+void IQM::Bin::MSSSIMJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    msssim_record_compute(cmdBuf, this->instance, this->msssim, *this->pooled->res);
+}
+
+void IQM::Bin::MSSSIMJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    msssim_record_download(cmdBuf, *this->pooled->res);
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::MSSSIMJob::finish(const DecodedPair &) {
+    const auto result = msssim_read_back(*this->pooled->res);
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
+
+    return {MetricValue{.name = "MS-SSIM", .value = result, .unit = ""}};
+}
+
+unsigned long IQM::Bin::MSSSIMJob::resourceSize() const {
+    return this->pooled.has_value() ? this->pooled->size : 0;
+}
+
+unsigned long IQM::Bin::MSSSIMJob::estimateSize(const DecodedPair &pair) const {
+    return msssim_plan(pair.test.width, pair.test.height, this->msssim).resources.estimate();
+}
+
+void IQM::Bin::msssim_run_single(const IQM::ProfileArgs &args, const VulkanInstance &instance, IQM::MSSSIM &msssim, const InputImage &input, const InputImage &ref) {
+    try {
+        VulkanResource::resetMemCounter();
+        Timestamps timestamps;
+        auto start = std::chrono::high_resolution_clock::now();
+
+        timestamps.mark("images loaded");
+
+        initRenderDoc();
+
+        auto res = msssim_init_res(input.width, input.height, instance, msssim);
+        const auto upload = msssim_stage(res, input, &ref);
+        timestamps.mark("resources allocated");
+
+        msssim_upload(instance, res, upload);
+
+        const vk::CommandBufferBeginInfo beginInfo = {
+            .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+        };
+        instance.cmdBuf()->begin(beginInfo);
+
+        msssim_record_compute(*instance.cmdBuf(), instance, msssim, res);
+
+        instance.cmdBuf()->end();
+
+        const std::vector cmdBufs = {
+            &**instance.cmdBuf()
+        };
+
+        auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
+        const vk::SubmitInfo submitInfo{
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &*res.uploadDone,
+            .pWaitDstStageMask = &mask,
+            .commandBufferCount = 1,
+            .pCommandBuffers = *cmdBufs.data(),
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &*res.computeDone
+        };
+
+        instance.queue()->submit(submitInfo, {});
+        timestamps.mark("submit compute GPU pipeline");
+        // wait so cmd buffer can be reused for GPU -> CPU transfer
+        instance.waitForFence(res.transferFence);
+
+        const auto result = msssim_copy_back(instance, res, timestamps);
+
+        finishRenderDoc();
+
+        timestamps.mark("output saved");
+
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        if (args.verbose) {
+            std::cout << args.inputPath << ": " << result << std::endl;
+            timestamps.print(start, end);
+
+            double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
+            std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to process '" << args.inputPath << "': " << e.what() << std::endl;
+    }
+}
+
+IQM::Bin::InputUpload IQM::Bin::msssim_stage(const MSSSIMResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
+
+void IQM::Bin::msssim_record_upload(const vk::raii::CommandBuffer &cmdBuf, const MSSSIMResources &res, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
+    std::vector imagesToInit = {
+        res.imageInput,
+    };
+
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
+
+    imagesToInit.insert(imagesToInit.end(), res.imagesLumaTest.begin(), res.imagesLumaTest.end());
+    imagesToInit.insert(imagesToInit.end(), res.imagesLumaRef.begin(), res.imagesLumaRef.end());
+
+    VulkanResource::initImages(cmdBuf, imagesToInit);
+
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
+}
+
+void IQM::Bin::msssim_upload(const VulkanInstance &instance, const MSSSIMResources &res, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    msssim_record_upload(*instance.cmdBufTransfer(), res, upload, nullptr, false);
+    instance.cmdBufTransfer()->end();
+
+    const std::vector cmdBufsCopy = {
+        &**instance.cmdBufTransfer()
+    };
+
+    const vk::SubmitInfo submitInfoCopy{
+        .commandBufferCount = 1,
+        .pCommandBuffers = *cmdBufsCopy.data(),
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &*res.uploadDone
+    };
+
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
+    instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
+}
+
+void IQM::Bin::msssim_record_compute(const vk::raii::CommandBuffer &cmdBuf, const VulkanInstance &instance, IQM::MSSSIM &msssim, const MSSSIMResources &res) {
+    auto msssimArgs = IQM::MSSSIMInput{
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .ivLumaTest = {},
+        .ivLumaRef = {},
+        .bufScales = &res.scaleBuf,
+        .width = res.imageInput->width,
+        .height = res.imageInput->height,
+    };
+    for (unsigned i = 0; i < IQM::MSSSIM_LEVELS; i++) {
+        msssimArgs.ivLumaTest[i] = &res.imagesLumaTest[i]->imageView;
+        msssimArgs.ivLumaRef[i] = &res.imagesLumaRef[i]->imageView;
+    }
+
+    msssim.computeMetric(msssimArgs);
+}
+
+void IQM::Bin::msssim_record_download(const vk::raii::CommandBuffer &cmdBuf, const MSSSIMResources &res) {
+    vk::BufferCopy bufCopy{
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = sizeof(float),
+    };
+    cmdBuf.copyBuffer(res.scaleBuf, res.stgInput, bufCopy);
+}
+
+float IQM::Bin::msssim_read_back(const MSSSIMResources &res) {
+    float result;
+
+    const auto outBufData = res.stgInputMemory.mapMemory(0, sizeof(float), {});
+    res.stgInputMemory.invalidate();
+    memcpy(&result, outBufData, sizeof(float));
+    res.stgInputMemory.unmapMemory();
+
+    return result;
+}
+
+float IQM::Bin::msssim_copy_back(const VulkanInstance &instance, const MSSSIMResources &res, Timestamps &timestamps) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    msssim_record_download(*instance.cmdBufTransfer(), res);
+    instance.cmdBufTransfer()->end();
+
+    const std::vector cmdBufsCopy = {
+        &**instance.cmdBufTransfer()
+    };
+
+    auto maskCopy = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eTransfer};
+    const vk::SubmitInfo submitInfoCopy{
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*res.computeDone,
+        .pWaitDstStageMask = &maskCopy,
+        .commandBufferCount = 1,
+        .pCommandBuffers = *cmdBufsCopy.data()
+    };
+
+    const vk::raii::Fence fenceCopy{*instance.device(), vk::FenceCreateInfo{}};
+
+    instance.queueTransfer()->submit(submitInfoCopy, *fenceCopy);
+    instance.device()->waitIdle();
+
+    timestamps.mark("end GPU work");
+
+    const auto result = msssim_read_back(res);
+    timestamps.mark("end copy from GPU");
+
+    return result;
+}
@@ -0,0 +1,90 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_MSSSIM_H
+#define IQM_BIN_MSSSIM_H
+
+#include <IQM/msssim.h>
+#include "../../shared/vulkan.h"
+#include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
+#include "../../shared/io.h"
+#include "../../shared/timestamps.h"
+#include "../../shared/resource_plan.h"
+#include "../../IQM/args.h"
+#include "../../IQM-profile/args.h"
+
+namespace IQM::Bin {
+    struct MSSSIMResources {
+        vk::raii::Buffer stgInput = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
+        vk::raii::Buffer stgRef = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
+        vk::raii::Buffer scaleBuf = VK_NULL_HANDLE;
+        DeviceAllocation scaleMemory;
+
+        // RGBA u8 input images
+        std::shared_ptr<VulkanImage> imageInput;
+        std::shared_ptr<VulkanImage> imageRef;
+
+        // R f32 luma pyramids, level i has half the size of level i - 1
+        std::vector<std::shared_ptr<VulkanImage>> imagesLumaTest;
+        std::vector<std::shared_ptr<VulkanImage>> imagesLumaRef;
+
+        vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
+        vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
+        vk::raii::Fence transferFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    // device local resources of `msssim_init_res`, also used to estimate memory of a pair
+    struct MSSSIMPlan {
+        ResourcePlan resources;
+        unsigned scaleBuf;
+        unsigned imageInput;
+        unsigned imageRef;
+        std::vector<unsigned> imagesLumaTest;
+        std::vector<unsigned> imagesLumaRef;
+    };
+
+    class MSSSIMJob : public BatchJob {
+    public:
+        // `shared` provides pipelines reused by jobs of all slots
+        MSSSIMJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<MSSSIMResources>& pool, const IQM::MSSSIM& shared);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<MSSSIMResources>& pool;
+        IQM::MSSSIM msssim;
+        std::optional<PooledResource<MSSSIMResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+    };
+
+
+    void msssim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::MSSSIM& msssim, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
+
+    MSSSIMPlan msssim_plan(unsigned width, unsigned height, const IQM::MSSSIM &msssim);
+    MSSSIMResources msssim_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance, const IQM::MSSSIM& msssim);
+    InputUpload msssim_stage(const MSSSIMResources& res, const InputImage &test, const InputImage *ref);
+    void msssim_record_upload(const vk::raii::CommandBuffer& cmdBuf, const MSSSIMResources& res, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void msssim_upload(const IQM::VulkanInstance& instance, const MSSSIMResources& res, const InputUpload& upload);
+    void msssim_record_compute(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::MSSSIM& msssim, const MSSSIMResources& res);
+    void msssim_record_download(const vk::raii::CommandBuffer& cmdBuf, const MSSSIMResources& res);
+    float msssim_read_back(const MSSSIMResources& res);
+    float msssim_copy_back(const IQM::VulkanInstance& instance, const MSSSIMResources& res, Timestamps &timestamps);
+}
+
+#endif //IQM_BIN_MSSSIM_H
@@ -0,0 +1,457 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <iostream>
+#include <limits>
+#include "multi.h"
+
+IQM::Bin::MultiJob::MultiJob(const VulkanInstance &instance, const std::vector<Method> &methods, std::vector<std::unique_ptr<BatchJob>> jobs, const Thresholds &thresholds):
+    instance(instance),
+    methods(methods),
+    jobs(std::move(jobs)),
+    thresholds(thresholds) {
+    // known before the first pair, so estimates of the jobs don't expect tiling
+    for (const auto &job : this->jobs) {
+        job->useSharedInput(&this->input);
+    }
+
+    // a failing cheap method decides the pair, so expensive methods are left for the second pass
+    for (const auto method : this->methods) {
+        this->firstPass.push_back((method == Method::PSNR || method == Method::SSIM) && this->thresholds.has(value_name(method)));
+    }
+    this->staged = std::ranges::find(this->firstPass, true) != this->firstPass.end() && std::ranges::find(this->firstPass, false) != this->firstPass.end();
+}
+
+void IQM::Bin::MultiJob::prepare(const DecodedPair &pair) {
+    const auto width = pair.test.width;
+    const auto height = pair.test.height;
+
+    if (this->input.imageInput == nullptr || this->input.imageInput->width != width || this->input.imageInput->height != height) {
+        this->input = SharedInput{};
+        const auto before = VulkanResource::memCounter();
+        this->input = shared_input_init_res(width, height, this->instance);
+        this->inputSize = VulkanResource::memCounter() - before;
+    }
+    this->refResident = hold_reference(this->input.reference, pair);
+    this->upload = shared_input_stage(this->input, pair.test, this->refResident ? nullptr : pair.ref.get());
+
+    this->pass = 0;
+    this->values.assign(this->jobs.size(), std::nullopt);
+    this->methodPairs.clear();
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        // jobs with shared input never read image data
+        this->methodPairs.push_back(DecodedPair{
+            .match = Match{
+                .testPath = pair.match.testPath,
+                .refPath = pair.match.refPath,
+                .outPath = multi_output_path(pair.match.outPath, this->methods[i]),
+            },
+            .test = InputImage{.width = width, .height = height, .data = {}},
+            .ref = pair.ref,
+            .reference = pair.reference,
+        });
+
+        if (this->inPass(i)) {
+            this->jobs[i]->prepare(this->methodPairs[i]);
+        }
+    }
+}
+
+void IQM::Bin::MultiJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    // shared input stays on device for the second pass
+    if (this->pass == 0) {
+        shared_input_record_upload(cmdBuf, this->input, this->upload, this->refResident);
+    }
+
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        if (this->inPass(i)) {
+            this->jobs[i]->recordUpload(cmdBuf);
+        }
+    }
+}
+
+void IQM::Bin::MultiJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    // methods don't share any written resources, so no barriers are needed between them
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        if (this->inPass(i)) {
+            this->jobs[i]->recordCompute(cmdBuf);
+        }
+    }
+}
+
+void IQM::Bin::MultiJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        if (this->inPass(i)) {
+            this->jobs[i]->recordDownload(cmdBuf);
+        }
+    }
+}
+
+bool IQM::Bin::MultiJob::nextPass() {
+    if (!this->staged || this->pass != 0) {
+        return false;
+    }
+
+    bool passed = true;
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        if (this->firstPass[i]) {
+            this->values[i] = this->jobs[i]->finish(this->methodPairs[i]);
+            passed = this->thresholds.judge(this->values[i].value()) && passed;
+        }
+    }
+    if (!passed) {
+        return false;
+    }
+
+    this->pass = 1;
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        if (this->inPass(i)) {
+            this->jobs[i]->prepare(this->methodPairs[i]);
+        }
+    }
+    return true;
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::MultiJob::finish(const DecodedPair &) {
+    std::vector<MetricValue> values;
+    for (unsigned i = 0; i < this->jobs.size(); i++) {
+        if (!this->computed(i)) {
+            values.push_back(MetricValue{.name = value_name(this->methods[i]), .value = std::numeric_limits<float>::quiet_NaN(), .unit = "", .computed = false});
+            continue;
+        }
+
+        auto methodValues = this->values[i].has_value() ? std::move(this->values[i].value()) : this->jobs[i]->finish(this->methodPairs[i]);
+        values.insert(values.end(), methodValues.begin(), methodValues.end());
+    }
+
+    return values;
+}
+
+bool IQM::Bin::MultiJob::inPass(const unsigned i) const {
+    return !this->staged || this->firstPass[i] == (this->pass == 0);
+}
+
+bool IQM::Bin::MultiJob::computed(const unsigned i) const {
+    return !this->staged || this->firstPass[i] || this->pass == 1;
+}
+
+unsigned long IQM::Bin::MultiJob::resourceSize() const {
+    unsigned long size = this->inputSize;
+    for (const auto &job : this->jobs) {
+        size += job->resourceSize();
+    }
+    return size;
+}
+
+unsigned long IQM::Bin::MultiJob::estimateSize(const DecodedPair &pair) const {
+    unsigned long size = shared_input_plan(pair.test.width, pair.test.height).resources.estimate();
+    for (const auto &job : this->jobs) {
+        size += job->estimateSize(pair);
+    }
+    return size;
+}
+
+template<typename T, typename... Params>
+const T& IQM::Bin::JobFactory::prototype(std::optional<T> &method, Params... params) {
+    if (!method.has_value()) {
+        method.emplace(*this->instance.device(), params...);
+    }
+    return method.value();
+}
+
+const IQM::Colorize* IQM::Bin::JobFactory::colorizePrototype() {
+    if (!this->args.colorize) {
+        return nullptr;
+    }
+    return &this->prototype(this->colorize, this->instance.pipelineCache());
+}
+
+IQM::Bin::JobFactory::JobFactory(const Args &args, const VulkanInstance &instance):
+    args(args),
+    instance(instance),
+    thresholds(args),
+    // cap is split between pools of all methods
+    poolCap(resource_pool_cap(args.options, *instance.physicalDevice()) / args.methods.size())
+#ifdef COMPILE_FLIP
+    , flipArgs(flip_arguments(args.options))
+#endif
+{
+    if (args.options.contains("--preview")) {
+        this->preview.emplace(args);
+    }
+#ifdef COMPILE_SSIM
+    this->ssimPool = std::make_unique<ResourcePool<SSIMResources>>(this->poolCap);
+    this->msssimPool = std::make_unique<ResourcePool<MSSSIMResources>>(this->poolCap);
+#endif
+#ifdef COMPILE_SVD
+    this->svdPool = std::make_unique<ResourcePool<SVDResources>>(this->poolCap);
+#endif
+#ifdef COMPILE_FSIM
+    this->fsimPool = std::make_unique<ResourcePool<FSIMResources>>(this->poolCap);
+#endif
+#ifdef COMPILE_FLIP
+    this->flipPool = std::make_unique<ResourcePool<FLIPResources>>(this->poolCap);
+#endif
+#ifdef COMPILE_PSNR
+    this->psnrPool = std::make_unique<ResourcePool<PSNRResources>>(this->poolCap);
+#endif
+#ifdef COMPILE_LPIPS
+    this->lpipsPool = std::make_unique<ResourcePool<LPIPSResources>>(this->poolCap);
+    if (std::ranges::find(args.methods, Method::LPIPS) != args.methods.end()) {
+        const auto &lpips = this->prototype(this->lpips, instance.pipelineCache());
+        const auto before = VulkanResource::memCounter();
+        auto modelData = load_model("lpips.dat");
+        this->lpipsModel = lpips_load_model(instance, lpips.modelSize(), modelData);
+        this->lpipsModelSize = VulkanResource::memCounter() - before;
+    }
+#endif
+}
+
+std::unique_ptr<IQM::Bin::BatchJob> IQM::Bin::JobFactory::create() {
+    if (this->args.methods.size() == 1) {
+        if (this->preview.has_value()) {
+            const auto &downsample = this->prototype(this->downsample, this->instance.pipelineCache());
+            return std::make_unique<PreviewJob>(this->args, this->instance, this->createMethod(this->args.methods.front()), this->preview.value(), downsample);
+        }
+        return this->createMethod(this->args.methods.front());
+    }
+
+    if (this->preview.has_value()) {
+        throw std::runtime_error("Preview is not supported with several methods");
+    }
+
+    // jobs with shared input upload whole pairs, so they can't recompute regions
+    if (this->args.incremental) {
+        throw std::runtime_error("Incremental computation is not supported with several methods");
+    }
+
+    std::vector<std::unique_ptr<BatchJob>> jobs;
+    for (const auto method : this->args.methods) {
+        jobs.push_back(this->createMethod(method));
+    }
+    return std::make_unique<MultiJob>(this->instance, this->args.methods, std::move(jobs), this->thresholds);
+}
+
+std::unique_ptr<IQM::Bin::BatchJob> IQM::Bin::JobFactory::createMethod(const Method method) {
+    switch (method) {
+        case Method::SSIM:
+#ifdef COMPILE_SSIM
+        {
+            const auto half = ssim_half_map(this->args, this->instance);
+            auto &ssim = half ? this->ssimHalf : this->ssim;
+            return std::make_unique<SSIMJob>(this->args, this->instance, *this->ssimPool, this->prototype(ssim, this->instance.pipelineCache(), half), this->colorizePrototype(), [this]() -> const IQM::SSIM& {
+                return this->prototype(this->ssimHalf, this->instance.pipelineCache(), true);
+            });
+        }
+#else
+            throw std::runtime_error("SSIM support is not compiled");
+#endif
+        case Method::CW_SSIM_CPU:
+            throw std::runtime_error("CW-SSIM is not implemented");
+        case Method::SVD:
+#ifdef COMPILE_SVD
+            return std::make_unique<SVDJob>(this->args, this->instance, *this->svdPool, this->prototype(this->svd, this->instance.pipelineCache()));
+#else
+            throw std::runtime_error("M-SVD support is not compiled");
+#endif
+        case Method::FSIM:
+#ifdef COMPILE_FSIM
+            return std::make_unique<FSIMJob>(this->args, this->instance, *this->fsimPool, this->prototype(this->fsim, this->instance.pipelineCache()));
+#else
+            throw std::runtime_error("FSIM support is not compiled");
+#endif
+        case Method::FLIP:
+#ifdef COMPILE_FLIP
+            return std::make_unique<FLIPJob>(this->args, this->instance, *this->flipPool, this->flipArgs, this->prototype(this->flip, this->instance.pipelineCache()), this->colorizePrototype());
+#else
+            throw std::runtime_error("FLIP support is not compiled");
+#endif
+        case Method::PSNR:
+#ifdef COMPILE_PSNR
+            return std::make_unique<PSNRJob>(this->args, this->instance, *this->psnrPool, this->prototype(this->psnr, this->instance.pipelineCache()), this->colorizePrototype());
+#else
+            throw std::runtime_error("PSNR support is not compiled");
+#endif
+        case Method::LPIPS:
+#ifdef COMPILE_LPIPS
+            return std::make_unique<LPIPSJob>(this->args, this->instance, *this->lpipsPool, this->lpipsModel.value(), this->lpipsModelSize, this->prototype(this->lpips, this->instance.pipelineCache()), this->colorizePrototype());
+#else
+            throw std::runtime_error("LPIPS support is not compiled");
+#endif
+        case Method::MS_SSIM:
+#ifdef COMPILE_SSIM
+            return std::make_unique<MSSSIMJob>(this->args, this->instance, *this->msssimPool, this->prototype(this->msssim, this->instance.pipelineCache()));
+#else
+            throw std::runtime_error("SSIM support is not compiled");
+#endif
+    }
+    throw std::runtime_error("unknown method");
+}
+
+void IQM::Bin::JobFactory::printPoolStats() const {
+    const auto print = [](const Method method, const auto &pool) {
+        std::cout << "Resource pool " << method_name(method) << ": " << pool.hitCount() << " reused, " << pool.missCount() << " allocated" << std::endl;
+    };
+
+    for (const auto method : this->args.methods) {
+        switch (method) {
+#ifdef COMPILE_SSIM
+            case Method::SSIM:
+                print(method, *this->ssimPool);
+                break;
+            case Method::MS_SSIM:
+                print(method, *this->msssimPool);
+                break;
+#endif
+#ifdef COMPILE_SVD
+            case Method::SVD:
+                print(method, *this->svdPool);
+                break;
+#endif
+#ifdef COMPILE_FSIM
+            case Method::FSIM:
+                print(method, *this->fsimPool);
+                break;
+#endif
+#ifdef COMPILE_FLIP
+            case Method::FLIP:
+                print(method, *this->flipPool);
+                break;
+#endif
+#ifdef COMPILE_PSNR
+            case Method::PSNR:
+                print(method, *this->psnrPool);
+                break;
+#endif
+#ifdef COMPILE_LPIPS
+            case Method::LPIPS:
+                print(method, *this->lpipsPool);
+                break;
+#endif
+            default:
+                break;
+        }
+    }
+}
+
+bool IQM::Bin::multi_run(const Args &args, const VulkanInstance &instance, const std::vector<Match> &imageMatches) {
+#ifdef COMPILE_FLIP
+    if (args.verbose && std::ranges::find(args.methods, Method::FLIP) != args.methods.end()) {
+        const auto flipArgs = flip_arguments(args.options);
+        std::cout << "FLIP monitor resolution: "<< flipArgs.monitor_resolution_x << std::endl
+        << "FLIP monitor distance: "<< flipArgs.monitor_distance << std::endl
+        << "FLIP monitor width: "<< flipArgs.monitor_width << std::endl;
+    }
+#endif
+
+    JobFactory factory(args, instance);
+
+    BatchExecutor executor(args, instance);
+    executor.printNames = args.methods.size() > 1;
+    executor.run(imageMatches, [&] { return factory.create(); });
+
+    if (args.verbose) {
+        factory.printPoolStats();
+    }
+
+    return executor.failed == 0;
+}
+
+IQM::Bin::SharedInputPlan IQM::Bin::shared_input_plan(const unsigned width, const unsigned height) {
+    vk::ImageCreateInfo srcImageInfo = {
+        .flags = {},
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .extent = vk::Extent3D(width, height, 1),
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        // preview mip levels are computed from the inputs in shaders
+        .usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+
+    SharedInputPlan plan;
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
+    return plan;
+}
+
+IQM::Bin::SharedInput IQM::Bin::shared_input_init_res(const unsigned width, const unsigned height, const VulkanInstance &instance) {
+    // always 4 channels on input, with 1B per channel
+    const auto size = (width * height) * 4;
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    const auto plan = shared_input_plan(width, height);
+    const auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+
+    return SharedInput{
+        .stgInput = std::move(stgBuf),
+        .stgInputMemory = std::move(stgMem),
+        .stgRef = std::move(stgRefBuf),
+        .stgRefMemory = std::move(stgRefMem),
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
+    };
+}
+
+IQM::Bin::InputUpload IQM::Bin::shared_input_stage(const SharedInput &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
+
+void IQM::Bin::shared_input_record_upload(const vk::raii::CommandBuffer &cmdBuf, const SharedInput &res, const InputUpload &upload, const bool refResident) {
+    if (refResident) {
+        VulkanResource::initImages(cmdBuf, {res.imageInput});
+    } else {
+        VulkanResource::initImages(cmdBuf, {res.imageInput, res.imageRef});
+    }
+
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, nullptr, refResident);
+
+    // copies into resources of each method read the shared images
+    vk::ImageSubresourceRange imageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    std::array<vk::ImageMemoryBarrier, 2> barriers;
+    const std::array images = {&res.imageInput->image, &res.imageRef->image};
+    for (unsigned i = 0; i < barriers.size(); i++) {
+        barriers[i] = vk::ImageMemoryBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+            .oldLayout = vk::ImageLayout::eGeneral,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .image = *images[i],
+            .subresourceRange = imageSubresourceRange
+        };
+    }
+    cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
+}
+
+std::optional<std::string> IQM::Bin::multi_output_path(const std::optional<std::string> &outPath, const Method method) {
+    if (!outPath.has_value()) {
+        return std::nullopt;
+    }
+
+    std::filesystem::path path(outPath.value());
+    path.replace_filename(path.stem().string() + "_" + method_name(method) + path.extension().string());
+    return path.string();
+}
@@ -0,0 +1,174 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_MULTI_H
+#define IQM_BIN_MULTI_H
+
+#include <IQM/base/colorize.h>
+#include "../../shared/vulkan.h"
+#include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
+#include "../../shared/io.h"
+#include "../../shared/resource_plan.h"
+#include "../../IQM/args.h"
+#include "preview.h"
+
+#if COMPILE_SSIM
+#include "ssim.h"
+#include "msssim.h"
+#endif
+
+#if COMPILE_SVD
+#include "svd.h"
+#endif
+
+#if COMPILE_FSIM
+#include "fsim.h"
+#endif
+
+#if COMPILE_FLIP
+#include "flip.h"
+#endif
+
+#if COMPILE_PSNR
+#include "psnr.h"
+#endif
+
+#if COMPILE_LPIPS
+#include "lpips.h"
+#endif
+
+namespace IQM::Bin {
+    /**
+     * Computes several methods for one pair.
+     *
+     * Images are staged and uploaded once into shared input images,
+     * which are then copied on device into resources of each method.
+     * All methods are recorded into the same command buffers.
+     *
+     * In threshold mode, cheap methods with a limit (PSNR and SSIM) are computed in the first pass,
+     * the other methods only run in a second pass on the same shared input if none of the cheap ones failed.
+     */
+    class MultiJob : public BatchJob {
+    public:
+        MultiJob(const IQM::VulkanInstance& instance, const std::vector<Method>& methods, std::vector<std::unique_ptr<BatchJob>> jobs, const Thresholds& thresholds);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        bool nextPass() override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        // whether job `i` is computed in the current pass
+        [[nodiscard]] bool inPass(unsigned i) const;
+        // whether job `i` was computed for the current pair
+        [[nodiscard]] bool computed(unsigned i) const;
+
+        const IQM::VulkanInstance& instance;
+        std::vector<Method> methods;
+        std::vector<std::unique_ptr<BatchJob>> jobs;
+        // pair as seen by each method, without image data and with separate output path
+        std::vector<DecodedPair> methodPairs;
+
+        // reallocated only when image size changes
+        SharedInput input;
+        unsigned long inputSize = 0;
+        InputUpload upload;
+        bool refResident = false;
+
+        Thresholds thresholds;
+        // jobs computed in the first pass, when methods are split into two
+        std::vector<bool> firstPass;
+        bool staged = false;
+        unsigned pass = 0;
+        // values of jobs finished after the first pass
+        std::vector<std::optional<std::vector<MetricValue>>> values;
+    };
+
+    /**
+     * Creates jobs for all selected methods, a single method job or `MultiJob` for several methods.
+     * With `--preview`, the single method job is wrapped in `PreviewJob`.
+     *
+     * Owns state shared by jobs of all slots, resource pools, LPIPS weights
+     * and one prototype of each method, whose pipelines are reused by jobs of all slots,
+     * so it must outlive the executor running the jobs.
+     */
+    class JobFactory {
+    public:
+        JobFactory(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance);
+        std::unique_ptr<BatchJob> create();
+        // prints reuse of resource pools of the selected methods
+        void printPoolStats() const;
+    private:
+        std::unique_ptr<BatchJob> createMethod(Method method);
+        // prototypes are created on first use, so only selected methods build their pipelines
+        template<typename T, typename... Params>
+        const T& prototype(std::optional<T>& method, Params... params);
+        // null unless output is colorized
+        const IQM::Colorize* colorizePrototype();
+
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        Thresholds thresholds;
+        std::optional<PreviewCalibration> preview;
+        unsigned long poolCap;
+        std::optional<IQM::Colorize> colorize;
+        std::optional<IQM::Downsample> downsample;
+#ifdef COMPILE_SSIM
+        std::unique_ptr<ResourcePool<SSIMResources>> ssimPool;
+        std::unique_ptr<ResourcePool<MSSSIMResources>> msssimPool;
+        // separate prototype is kept for each precision of the map
+        std::optional<IQM::SSIM> ssim;
+        std::optional<IQM::SSIM> ssimHalf;
+        std::optional<IQM::MSSSIM> msssim;
+#endif
+#ifdef COMPILE_SVD
+        std::unique_ptr<ResourcePool<SVDResources>> svdPool;
+        std::optional<IQM::SVD> svd;
+#endif
+#ifdef COMPILE_FSIM
+        std::unique_ptr<ResourcePool<FSIMResources>> fsimPool;
+        std::optional<IQM::FSIM> fsim;
+#endif
+#ifdef COMPILE_FLIP
+        std::unique_ptr<ResourcePool<FLIPResources>> flipPool;
+        FLIPArguments flipArgs;
+        std::optional<IQM::FLIP> flip;
+#endif
+#ifdef COMPILE_PSNR
+        std::unique_ptr<ResourcePool<PSNRResources>> psnrPool;
+        std::optional<IQM::PSNR> psnr;
+#endif
+#ifdef COMPILE_LPIPS
+        std::unique_ptr<ResourcePool<LPIPSResources>> lpipsPool;
+        std::optional<LPIPSModelResources> lpipsModel;
+        unsigned long lpipsModelSize = 0;
+        std::optional<IQM::LPIPS> lpips;
+#endif
+    };
+
+
+    // runs all selected methods, a single method is run with the same jobs as several ones
+    bool multi_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+
+    // RGBA u8 input images of `shared_input_init_res`
+    struct SharedInputPlan {
+        ResourcePlan resources;
+        unsigned imageInput;
+        unsigned imageRef;
+    };
+
+    SharedInputPlan shared_input_plan(unsigned width, unsigned height);
+    SharedInput shared_input_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance);
+    InputUpload shared_input_stage(const SharedInput& res, const InputImage &test, const InputImage *ref);
+    void shared_input_record_upload(const vk::raii::CommandBuffer& cmdBuf, const SharedInput& res, const InputUpload& upload, bool refResident);
+    // output of each method is saved next to requested output, with method name appended to stem
+    std::optional<std::string> multi_output_path(const std::optional<std::string>& outPath, Method method);
+}
+
+#endif //IQM_BIN_MULTI_H
@@ -0,0 +1,280 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "preview.h"
+#include "multi.h"
+#include "../../shared/roi.h"
+
+using IQM::Bin::VulkanImage;
+using IQM::Bin::VulkanResource;
+using IQM::VulkanInstance;
+
+IQM::Bin::PreviewCalibration::PreviewCalibration(const Args &args) {
+    this->levels = std::stoul(args.options.at("--preview"));
+    if (this->levels == 0 || this->levels > IQM::Downsample::MAX_LEVELS) {
+        throw std::runtime_error("Preview level must be between 1 and " + std::to_string(IQM::Downsample::MAX_LEVELS));
+    }
+    if (args.options.contains("--preview-refine")) {
+        this->refineEvery = std::stoul(args.options.at("--preview-refine"));
+    }
+}
+
+bool IQM::Bin::PreviewCalibration::refineNext() {
+    if (this->refineEvery == 0) {
+        return false;
+    }
+    return this->pairs++ % this->refineEvery == 0;
+}
+
+bool IQM::Bin::PreviewCalibration::refines() const {
+    return this->refineEvery > 0;
+}
+
+void IQM::Bin::PreviewCalibration::update(const std::vector<MetricValue> &preview, const std::vector<MetricValue> &full) {
+    for (const auto &value : full) {
+        for (const auto &approx : preview) {
+            // infinite PSNR of identical images has no meaningful difference
+            if (approx.name != value.name || !std::isfinite(approx.value) || !std::isfinite(value.value)) {
+                continue;
+            }
+            const auto difference = std::abs(value.value - approx.value);
+            const auto [it, inserted] = this->bands.emplace(value.name, difference);
+            if (!inserted) {
+                it->second = std::max(it->second, difference);
+            }
+        }
+    }
+}
+
+float IQM::Bin::PreviewCalibration::band(const std::string &name) const {
+    if (const auto it = this->bands.find(name); it != this->bands.end()) {
+        return it->second;
+    }
+    return std::numeric_limits<float>::quiet_NaN();
+}
+
+IQM::Bin::PreviewJob::PreviewJob(const Args &args, const VulkanInstance &instance, std::unique_ptr<BatchJob> job, PreviewCalibration &calibration, const IQM::Downsample &sharedDownsample):
+    instance(instance),
+    job(std::move(job)),
+    calibration(calibration),
+    downsample(*instance.device(), sharedDownsample) {
+    // regions are given in full resolution coordinates
+    RegionOfInterest::requireUnset(args.options, "preview");
+    if (args.incremental) {
+        throw std::runtime_error("Incremental computation can't be combined with --preview");
+    }
+}
+
+IQM::Bin::DecodedPair IQM::Bin::PreviewJob::levelPair(const DecodedPair &pair) const {
+    // jobs with shared input never read image data,
+    // the reference is copied by every pass, since the method alternates between the level and full resolution
+    return DecodedPair{
+        .match = Match{
+            .testPath = pair.match.testPath,
+            .refPath = pair.match.refPath,
+        },
+        .test = InputImage{.width = pair.test.width >> this->calibration.levels, .height = pair.test.height >> this->calibration.levels, .data = {}},
+        .ref = pair.ref,
+        .reference = nullptr,
+    };
+}
+
+void IQM::Bin::PreviewJob::prepare(const DecodedPair &pair) {
+    const auto width = pair.test.width;
+    const auto height = pair.test.height;
+
+    if (!this->res.has_value() || this->res->full.imageInput->width != width || this->res->full.imageInput->height != height) {
+        this->res.reset();
+        const auto before = VulkanResource::memCounter();
+        this->res = preview_init_res(width, height, this->calibration.levels, this->instance);
+        this->inputSize = VulkanResource::memCounter() - before;
+    }
+    this->refResident = hold_reference(this->res->full.reference, pair);
+    this->upload = shared_input_stage(this->res->full, pair.test, this->refResident ? nullptr : pair.ref.get());
+
+    this->methodPair = this->levelPair(pair);
+    this->fullPair = DecodedPair{
+        .match = pair.match,
+        .test = InputImage{.width = width, .height = height, .data = {}},
+        .ref = pair.ref,
+        .reference = nullptr,
+    };
+    this->refining = this->calibration.refineNext();
+    this->refinePass = false;
+    this->preview.clear();
+    this->pending.clear();
+
+    this->job->useSharedInput(&this->res->level);
+    this->job->prepare(this->methodPair);
+}
+
+void IQM::Bin::PreviewJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    // full resolution inputs stay on device for the refined pass
+    if (this->refinePass) {
+        this->job->recordUpload(cmdBuf);
+    } else {
+        shared_input_record_upload(cmdBuf, this->res->full, this->upload, this->refResident);
+    }
+}
+
+void IQM::Bin::PreviewJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    if (!this->refinePass) {
+        preview_record_levels(cmdBuf, this->instance, this->downsample, this->res.value());
+
+        // levels are only written by the compute pass, so the job copies them here instead of during upload
+        this->job->recordUpload(cmdBuf);
+
+        vk::MemoryBarrier memoryBarrier = {
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+        };
+        cmdBuf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+        );
+    }
+
+    this->job->recordCompute(cmdBuf);
+}
+
+void IQM::Bin::PreviewJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    this->job->recordDownload(cmdBuf);
+}
+
+bool IQM::Bin::PreviewJob::nextPass() {
+    if (this->job->nextPass()) {
+        return true;
+    }
+    if (!this->refining || this->refinePass) {
+        return false;
+    }
+
+    this->preview = this->job->finish(this->methodPair);
+    this->pending = this->preview;
+    this->setBands(this->pending);
+
+    this->refinePass = true;
+    this->job->useSharedInput(&this->res->full);
+    this->job->prepare(this->fullPair);
+    return true;
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::PreviewJob::partial() {
+    return std::exchange(this->pending, {});
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::PreviewJob::finish(const DecodedPair &) {
+    if (!this->refinePass) {
+        auto values = this->job->finish(this->methodPair);
+        this->setBands(values);
+        return values;
+    }
+
+    auto values = this->job->finish(this->fullPair);
+    this->calibration.update(this->preview, values);
+    return values;
+}
+
+void IQM::Bin::PreviewJob::setBands(std::vector<MetricValue> &values) const {
+    for (auto &value : values) {
+        value.band = this->calibration.band(value.name);
+    }
+}
+
+unsigned long IQM::Bin::PreviewJob::resourceSize() const {
+    return this->inputSize + this->job->resourceSize();
+}
+
+unsigned long IQM::Bin::PreviewJob::estimateSize(const DecodedPair &pair) const {
+    const auto width = pair.test.width;
+    const auto height = pair.test.height;
+    // full resolution inputs and mip levels of both images, resources of the method at the preview level
+    auto size = shared_input_plan(width, height).resources.estimate() + preview_plan(width, height, this->calibration.levels).resources.estimate() + this->job->estimateSize(this->levelPair(pair));
+    // refined pairs also compute the method at full resolution, while the preview resources stay pooled
+    if (this->calibration.refines()) {
+        size += this->job->estimateSize(pair);
+    }
+    return size;
+}
+
+IQM::Bin::PreviewPlan IQM::Bin::preview_plan(const unsigned width, const unsigned height, const unsigned levels) {
+    vk::ImageCreateInfo levelImageInfo = {
+        .flags = {},
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .extent = vk::Extent3D(width, height, 1),
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+
+    PreviewPlan plan;
+    for (unsigned i = 1; i <= levels; i++) {
+        levelImageInfo.extent = vk::Extent3D(width >> i, height >> i, 1);
+        plan.levelsTest.push_back(plan.resources.image(levelImageInfo));
+        plan.levelsRef.push_back(plan.resources.image(levelImageInfo));
+    }
+    return plan;
+}
+
+IQM::Bin::PreviewResources IQM::Bin::preview_init_res(const unsigned width, const unsigned height, const unsigned levels, const VulkanInstance &instance) {
+    if ((width >> levels) == 0 || (height >> levels) == 0) {
+        throw std::runtime_error("Images are too small for preview at level " + std::to_string(levels));
+    }
+
+    const auto plan = preview_plan(width, height, levels);
+    const auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+
+    std::vector<std::shared_ptr<VulkanImage>> levelsTest;
+    std::vector<std::shared_ptr<VulkanImage>> levelsRef;
+    for (unsigned i = 0; i < levels; i++) {
+        levelsTest.push_back(planned.image(plan.levelsTest[i]));
+        levelsRef.push_back(planned.image(plan.levelsRef[i]));
+    }
+
+    // the method only copies the last level, nothing is staged into it
+    SharedInput level;
+    level.imageInput = levelsTest.back();
+    level.imageRef = levelsRef.back();
+
+    return PreviewResources{
+        .full = shared_input_init_res(width, height, instance),
+        .levelsTest = std::move(levelsTest),
+        .levelsRef = std::move(levelsRef),
+        .level = std::move(level),
+    };
+}
+
+void IQM::Bin::preview_record_levels(const vk::raii::CommandBuffer &cmdBuf, const VulkanInstance &instance, IQM::Downsample &downsample, const PreviewResources &res) {
+    // levels are rewritten by every pair, so their previous contents can be discarded
+    std::vector<std::shared_ptr<VulkanImage>> levels(res.levelsTest);
+    levels.insert(levels.end(), res.levelsRef.begin(), res.levelsRef.end());
+    VulkanResource::initImages(cmdBuf, levels);
+
+    DownsampleInput input{
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.full.imageInput->imageView,
+        .ivRef = &res.full.imageRef->imageView,
+        .width = res.full.imageInput->width,
+        .height = res.full.imageInput->height,
+    };
+    for (unsigned i = 0; i < res.levelsTest.size(); i++) {
+        input.ivLevelsTest.push_back(&res.levelsTest[i]->imageView);
+        input.ivLevelsRef.push_back(&res.levelsRef[i]->imageView);
+    }
+
+    downsample.compute(input);
+}
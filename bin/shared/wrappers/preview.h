@@ -0,0 +1,109 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_BIN_PREVIEW_H
+#define IQM_BIN_PREVIEW_H
+
+#include <IQM/base/downsample.h>
+#include <unordered_map>
+#include "../../shared/vulkan_res.h"
+#include "../../shared/executor.h"
+#include "../../shared/resource_plan.h"
+#include "../../IQM/args.h"
+
+namespace IQM::Bin {
+    struct PreviewResources {
+        // full resolution inputs, shared input of the refined pass
+        SharedInput full;
+        // RGBA u8 mip levels, level i has half the size of level i - 1
+        std::vector<std::shared_ptr<VulkanImage>> levelsTest;
+        std::vector<std::shared_ptr<VulkanImage>> levelsRef;
+        // the last level, shared input of the preview pass
+        SharedInput level;
+    };
+
+    /**
+     * Settings of `--preview`, with the error band calibrated on pairs refined to full resolution.
+     *
+     * Band of each value is the largest difference between its preview and full resolution value seen so far,
+     * so it's unknown until the first pair is refined. Shared by jobs of all slots and kept between server requests.
+     */
+    class PreviewCalibration {
+    public:
+        explicit PreviewCalibration(const Args &args);
+        // returns whether the next pair is refined, every `--preview-refine` pair is
+        bool refineNext();
+        [[nodiscard]] bool refines() const;
+        void update(const std::vector<MetricValue> &preview, const std::vector<MetricValue> &full);
+        // half-width of the band of a value, NaN while uncalibrated
+        [[nodiscard]] float band(const std::string &name) const;
+
+        // mip level the metric is evaluated at, each level halves both dimensions
+        unsigned levels;
+    private:
+        unsigned refineEvery = 0;
+        unsigned pairs = 0;
+        std::unordered_map<std::string, float> bands;
+    };
+
+    /**
+     * Computes a method on a coarser mip level of the pair for a fast approximate result.
+     *
+     * Full resolution images are uploaded once and the mip chain is built on the GPU,
+     * the method job then copies the last level as its shared input, all in the same submission.
+     * Refined pairs are computed once more at full resolution in the next pass, from the images already on device,
+     * the preview is reported as soon as it's read back and the refined value updates the error band.
+     * Outputs are only saved by refined pairs.
+     */
+    class PreviewJob : public BatchJob {
+    public:
+        PreviewJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, std::unique_ptr<BatchJob> job, PreviewCalibration& calibration, const IQM::Downsample& sharedDownsample);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        bool nextPass() override;
+        std::vector<MetricValue> partial() override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        // pair as seen by the method at the preview level, without image data and output
+        [[nodiscard]] DecodedPair levelPair(const DecodedPair &pair) const;
+        void setBands(std::vector<MetricValue> &values) const;
+
+        const IQM::VulkanInstance& instance;
+        std::unique_ptr<BatchJob> job;
+        PreviewCalibration& calibration;
+        IQM::Downsample downsample;
+
+        // reallocated only when image size changes
+        std::optional<PreviewResources> res;
+        unsigned long inputSize = 0;
+        InputUpload upload;
+        bool refResident = false;
+
+        DecodedPair methodPair;
+        DecodedPair fullPair;
+        bool refining = false;
+        bool refinePass = false;
+        std::vector<MetricValue> preview;
+        // preview of a refined pair, until it's reported
+        std::vector<MetricValue> pending;
+    };
+
+    // mip levels of `preview_init_res`, without the full resolution inputs
+    struct PreviewPlan {
+        ResourcePlan resources;
+        std::vector<unsigned> levelsTest;
+        std::vector<unsigned> levelsRef;
+    };
+
+    PreviewPlan preview_plan(unsigned width, unsigned height, unsigned levels);
+    PreviewResources preview_init_res(unsigned width, unsigned height, unsigned levels, const IQM::VulkanInstance& instance);
+    void preview_record_levels(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::Downsample& downsample, const PreviewResources& res);
+}
+
+#endif //IQM_BIN_PREVIEW_H
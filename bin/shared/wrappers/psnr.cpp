@@ -3,10 +3,13 @@
  * Petr Volf - 2025
  */
 
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include "psnr.h"
 #include "../../shared/debug_utils.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
 #include "IQM/base/viridis.h"
 #include "IQM/base/colorize.h"
 
@@ -15,61 +18,14 @@ using IQM::Bin::VulkanImage;
 using IQM::VulkanInstance;
 using IQM::Bin::VulkanResource;
 
-IQM::Bin::PSNRResources IQM::Bin::psnr_init_res(const InputImage &test, const InputImage &ref, const VulkanInstance& instance, bool hasOutput, bool colorize) {
-    // always 4 channels on input, with 1B per channel, with one float for sum result
-    const auto size = (test.width * test.height) * 4 + sizeof(float);
-    const auto colormapSize = 256 * 4 * sizeof(float);
-    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached
-    );
-    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
-    *instance.device(),
-    *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        colormapSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [sumBuf, sumMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-
-    stgBuf.bindMemory(stgMem, 0);
-    stgRefBuf.bindMemory(stgRefMem, 0);
-    cmBuf.bindMemory(cmMem, 0);
-    sumBuf.bindMemory(sumMem, 0);
-
-    void * inBufData = stgMem.mapMemory(0, size, {});
-    memcpy(inBufData, test.data.data(), size);
-    stgMem.unmapMemory();
-
-    inBufData = stgRefMem.mapMemory(0, size, {});
-    memcpy(inBufData, ref.data.data(), size);
-    stgRefMem.unmapMemory();
-
-    inBufData = cmMem.mapMemory(0, colormapSize, {});
-    memcpy(inBufData, viridis, colormapSize);
-    cmMem.unmapMemory();
+IQM::Bin::PSNRPlan IQM::Bin::psnr_plan(const unsigned width, const unsigned height, const bool hasOutput, const bool colorize) {
+    const auto grid = IQM::Reduce::gridExtent(width, height, SCORE_GRID_CELL);
 
     vk::ImageCreateInfo srcImageInfo = {
         .flags = {},
         .imageType = vk::ImageType::e2D,
         .format = vk::Format::eR8G8B8A8Unorm,
-        .extent = vk::Extent3D(test.width, test.height, 1),
+        .extent = vk::Extent3D(width, height, 1),
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
@@ -92,20 +48,63 @@ IQM::Bin::PSNRResources IQM::Bin::psnr_init_res(const InputImage &test, const In
     vk::ImageCreateInfo dstImageInfo = {srcImageInfo};
     dstImageInfo.format = vk::Format::eR32Sfloat;
 
-    auto const imageInput = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageRef = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-
-    auto imageOut = std::shared_ptr<VulkanImage>();
-    auto imageExport = std::shared_ptr<VulkanImage>();
-    auto imageColorMap = std::shared_ptr<VulkanImage>();
+    PSNRPlan plan;
+    // one float per pixel, with one float for sum result
+    plan.sumBuf = plan.resources.buffer(
+        (width * height) * 4 + sizeof(float),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst
+    );
+    plan.gridBuf = plan.resources.buffer(
+        grid.width * grid.height * sizeof(float),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+    );
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
     if (hasOutput) {
-        imageOut = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), dstImageInfo));
+        plan.imageOut = plan.resources.image(dstImageInfo);
         if (colorize) {
-            imageColorMap = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), colorMapImageInfo));
+            plan.imageColorMap = plan.resources.image(colorMapImageInfo);
         } else {
-            imageExport = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), exitImageInfo));
+            plan.imageExport = plan.resources.image(exitImageInfo);
         }
     }
+    return plan;
+}
+
+IQM::Bin::PSNRResources IQM::Bin::psnr_init_res(const unsigned width, const unsigned height, const VulkanInstance& instance, bool hasOutput, bool colorize) {
+    // always 4 channels on input, with 1B per channel, with one float for sum result
+    const auto size = (width * height) * 4 + sizeof(float);
+    const auto colormapSize = 256 * 4 * sizeof(float);
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+    *instance.device(),
+    *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        colormapSize,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    void * inBufData = cmMem.mapMemory(0, colormapSize, {});
+    memcpy(inBufData, viridis, colormapSize);
+    cmMem.unmapMemory();
+
+    const auto plan = psnr_plan(width, height, hasOutput, colorize);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [sumBuf, sumMem] = planned.takeBuffer(plan.sumBuf);
+    auto [gridBuf, gridMem] = planned.takeBuffer(plan.gridBuf);
 
     return PSNRResources{
         .stgInput = std::move(stgBuf),
@@ -116,24 +115,23 @@ IQM::Bin::PSNRResources IQM::Bin::psnr_init_res(const InputImage &test, const In
         .stgColormapMemory = std::move(cmMem),
         .sumBuf = std::move(sumBuf),
         .sumMemory = std::move(sumMem),
-        .imageInput = imageInput,
-        .imageRef = imageRef,
-        .imageOut = imageOut,
-        .imageExport = imageExport,
-        .imageColorMap = imageColorMap,
+        .gridBuf = std::move(gridBuf),
+        .gridMemory = std::move(gridMem),
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
+        .imageOut = planned.image(plan.imageOut),
+        .imageExport = planned.image(plan.imageExport),
+        .imageColorMap = planned.image(plan.imageColorMap),
         .uploadDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .computeDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .transferFence = instance.device()->createFence(vk::FenceCreateInfo{}),
     };
 }
 
-void IQM::Bin::psnr_run(const Args& args, const VulkanInstance& instance, const std::vector<Match>& imageMatches) {
-    IQM::PSNR psnr(*instance.device());
-    IQM::Colorize colorizer(*instance.device());
-
+static IQM::PSNRVariant psnr_variant(const std::unordered_map<std::string, std::string> &options) {
     IQM::PSNRVariant variant = IQM::PSNRVariant::Luma;
-    if (args.options.contains("--psnr-variant")) {
-        auto opt = args.options.at("--psnr-variant");
+    if (options.contains("--psnr-variant")) {
+        auto opt = options.at("--psnr-variant");
         if (opt == "luma" || opt == "LUMA") {
             variant = IQM::PSNRVariant::Luma;
         } else if (opt == "rgb" || opt == "RGB") {
@@ -144,150 +142,220 @@ void IQM::Bin::psnr_run(const Args& args, const VulkanInstance& instance, const
             throw std::invalid_argument("Unknown PSNR variant");
         }
     }
+    return variant;
+}
 
-    int processed = 0;
-
-    for (const auto& match : imageMatches) {
-        try {
-            VulkanResource::resetMemCounter();
-            Timestamps timestamps;
-            auto start = std::chrono::high_resolution_clock::now();
+IQM::Bin::PSNRJob::PSNRJob(const Args &args, const VulkanInstance &instance, ResourcePool<PSNRResources> &pool, const IQM::PSNR &shared, const IQM::Colorize *sharedColorizer):
+    args(args),
+    instance(instance),
+    pool(pool),
+    psnr(*instance.device(), shared),
+    tileBudget(tile_budget(args.options)),
+    gridFormat(score_grid_format(args.options)),
+    roi(args.options),
+    thresholds(args) {
+    if (sharedColorizer != nullptr) {
+        this->colorizer.emplace(*instance.device(), *sharedColorizer);
+    }
+    if (args.incremental) {
+        if (this->roi.enabled()) {
+            throw std::runtime_error("Region of interest can't be combined with --incremental");
+        }
+        // PSNR is computed per pixel, so regions don't need any halo
+        this->session.emplace(0, 0);
+    }
+}
 
-            const auto input = load_image(match.testPath);
-            const auto reference = load_image(match.refPath);
-            if (input.height != reference.height || input.width != reference.width) {
-                throw std::runtime_error("Test and reference images have different sizes");
-            }
+void IQM::Bin::PSNRJob::prepare(const DecodedPair &pair) {
+    this->hasOutput = pair.match.outPath.has_value() && !this->gridFormat.has_value();
+    this->hasGrid = pair.match.outPath.has_value() && this->gridFormat.has_value();
+    this->pairMask = this->roi.enabled() ? this->roi.mask(this->instance, pair.test.width, pair.test.height) : IQM::Mask{};
 
-            timestamps.mark("images loaded");
+    this->tiled.reset();
+    this->incrementalPass = this->session.has_value() && this->sharedInput == nullptr;
+    if (this->incrementalPass) {
+        if (this->hasOutput) {
+            throw std::runtime_error("Incremental computation only saves the score grid, set --grid");
+        }
 
-            initRenderDoc();
+        this->session->plan(pair);
+        const auto &region = this->session->region();
+        const ResourceKey key{.method = Method::PSNR, .width = region.tileWidth, .height = region.tileHeight, .options = std::to_string(this->hasOutput) + std::to_string(this->args.colorize)};
+        this->pooled = this->pool.acquire(key, [&] { return psnr_init_res(region.tileWidth, region.tileHeight, this->instance, this->hasOutput, this->args.colorize); });
+        if (this->session->whole()) {
+            this->refResident = hold_reference(this->pooled->res->reference, pair);
+            this->upload = psnr_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+        } else {
+            this->pooled->res->reference.reset();
+            this->refResident = false;
+            const auto test = crop_tile(pair.test, region, region.tiles[0]);
+            const auto ref = crop_tile(*pair.ref, region, region.tiles[0]);
+            this->upload = psnr_stage(*this->pooled->res, test, &ref);
+        }
+        return;
+    }
 
-            auto res = psnr_init_res(input, reference, instance, args.outputPath.has_value(), args.colorize);
-            timestamps.mark("resources allocated");
+    const auto tileBudget = pair_tile_budget(this->tileBudget, this->memoryBudget, pair.test.width, pair.test.height, this->tileMemory(this->hasOutput));
+    // mask and score grid cover the whole pair, so it isn't split into tiles
+    if (tileBudget.has_value() && this->sharedInput == nullptr && !this->roi.enabled() && !this->gridFormat.has_value()) {
+        // PSNR is computed per pixel, so tiles don't need any halo
+        TileGrid grid(pair.test.width, pair.test.height, tile_size(tileBudget.value(), this->tileMemory(this->hasOutput), 0), 0);
+        if (grid.tiles.size() > 1) {
+            const ResourceKey key{.method = Method::PSNR, .width = grid.tileWidth, .height = grid.tileHeight, .options = std::to_string(this->hasOutput) + std::to_string(this->args.colorize)};
+            this->pooled = this->pool.acquire(key, [&] { return psnr_init_res(grid.tileWidth, grid.tileHeight, this->instance, this->hasOutput, this->args.colorize); });
+            // every tile uploads its own part of the reference
+            this->pooled->res->reference.reset();
+            this->refResident = false;
+
+            this->tiled.emplace(TiledPair{
+                .grid = std::move(grid),
+                .test = &pair.test,
+                .ref = pair.ref.get(),
+                .map = std::vector<unsigned char>(this->hasOutput ? pair.test.width * pair.test.height * (this->args.colorize ? 4 : 1) : 0),
+            });
+            this->stageTile();
+            return;
+        }
+    }
 
-            psnr_upload(instance, res, args.outputPath.has_value(), args.colorize);
+    const ResourceKey key{.method = Method::PSNR, .width = pair.test.width, .height = pair.test.height, .options = std::to_string(this->hasOutput) + std::to_string(this->args.colorize)};
+    this->pooled = this->pool.acquire(key, [&] { return psnr_init_res(pair.test.width, pair.test.height, this->instance, this->hasOutput, this->args.colorize); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = psnr_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+    }
+}
 
-            auto psnrArgs = IQM::PSNRInput {
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivTest = &res.imageInput->imageView,
-                .ivRef = &res.imageRef->imageView,
-                .bufSum = &res.sumBuf,
-                .imgOut = args.outputPath.has_value() ? &res.imageOut->image : nullptr,
-                .variant = variant,
-                .width = input.width,
-                .height = input.height,
-            };
+void IQM::Bin::PSNRJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    psnr_record_upload(cmdBuf, *this->pooled->res, this->hasOutput, this->args.colorize, this->upload, this->sharedInput, this->refResident);
+}
 
-            const vk::CommandBufferBeginInfo beginInfo = {
-                .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-            };
-            instance.cmdBuf()->begin(beginInfo);
-
-            psnr.computeMetric(psnrArgs);
-
-            if (args.outputPath.has_value()) {
-                if (args.colorize) {
-                    auto colorizerInput = IQM::ColorizeInput{
-                        .device = instance.device(),
-                        .cmdBuf = &*instance.cmdBuf(),
-                        .ivIn = &res.imageOut->imageView,
-                        .ivOut = &res.imageInput->imageView,
-                        .ivColormap = &res.imageColorMap->imageView,
-                        .invert = false,
-                        .scaler = 4.0,
-                        .width = input.width,
-                        .height = input.height
-                    };
-
-                    colorizer.compute(colorizerInput);
-                } else {
-                    std::array offsets = {
-                        vk::Offset3D{0, 0, 0},
-                        vk::Offset3D{static_cast<int>(res.imageInput->width), static_cast<int>(res.imageInput->height), 1}
-                    };
-                    // copy RGBA f32 to RGBA u8
-                    std::vector region {
-                        vk::ImageBlit {
-                            .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                            .srcOffsets = offsets,
-                            .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                            .dstOffsets = offsets,
-                        }
-                    };
-                    instance.cmdBuf()->blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
-                }
-            }
+void IQM::Bin::PSNRJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    psnr_record_compute(cmdBuf, this->instance, this->psnr, this->colorizer.has_value() ? &this->colorizer.value() : nullptr, *this->pooled->res, this->variant, this->hasOutput, this->hasGrid || this->incrementalPass, this->pairMask);
+}
 
-            instance.cmdBuf()->end();
+void IQM::Bin::PSNRJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    psnr_record_download(cmdBuf, *this->pooled->res, this->hasOutput, this->args.colorize, this->hasGrid || this->incrementalPass);
+}
 
-            const std::vector cmdBufs = {
-                &**instance.cmdBuf()
-            };
+bool IQM::Bin::PSNRJob::nextPass() {
+    if (!this->tiled.has_value()) {
+        return false;
+    }
 
-            auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
-            const vk::SubmitInfo submitInfo{
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*res.uploadDone,
-                .pWaitDstStageMask = &mask,
-                .commandBufferCount = 1,
-                .pCommandBuffers = *cmdBufs.data(),
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &*res.computeDone
-            };
+    auto &tiled = this->tiled.value();
+    const auto &tile = tiled.grid.tiles[tiled.current];
+    const auto result = psnr_read_back(*this->pooled->res, this->hasOutput, this->args.colorize, false);
 
-            instance.queue()->submit(submitInfo, {});
-            timestamps.mark("submit compute GPU pipeline");
-            // wait so cmd buffer can be reused for GPU -> CPU transfer
-            instance.waitForFence(res.transferFence);
+    // squared error summed over the tile, which is only non-zero inside its core
+    tiled.sum += std::pow(10.0, -result.db / 10.0) * tiled.grid.tileWidth * tiled.grid.tileHeight;
+    tiled.area += static_cast<double>(tile.coreWidth) * tile.coreHeight;
+    if (this->hasOutput) {
+        stitch_tile(tiled.map, result.imageData, this->args.colorize ? 4 : 1, tiled.grid, tile);
+    }
 
-            auto result = psnr_copy_back(instance, res, timestamps, args.outputPath.has_value(), args.colorize);
+    tiled.current++;
+    if (tiled.current == tiled.grid.tiles.size()) {
+        return false;
+    }
 
-            finishRenderDoc();
-            if (match.outPath.has_value()) {
-                if (args.colorize) {
-                    save_color_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                } else {
-                    save_char_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                }
-            }
+    // square error of each remaining pixel is at most 1, which bounds the error of the whole image
+    if (this->thresholds.has("PSNR") && !this->hasOutput) {
+        const auto pixels = static_cast<double>(tiled.grid.width) * tiled.grid.height;
+        tiled.decided = this->thresholds.decide("PSNR", -10.0 * std::log10((tiled.sum + pixels - tiled.area) / pixels), -10.0 * std::log10(tiled.sum / pixels));
+        if (tiled.decided.has_value()) {
+            return false;
+        }
+    }
+    this->stageTile();
+    return true;
+}
 
-            const auto end = std::chrono::high_resolution_clock::now();
-            std::cout << match.testPath << ": " << result.db << " dB" << std::endl;
-            if (args.verbose) {
-                timestamps.print(start, end);
-                double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
-                std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
+void IQM::Bin::PSNRJob::stageTile() {
+    const auto &tiled = this->tiled.value();
+    const auto &grid = tiled.grid;
+    const auto &tile = grid.tiles[tiled.current];
+    const auto test = crop_tile(*tiled.test, grid, tile);
+    auto ref = crop_tile(*tiled.ref, grid, tile);
+
+    // tiles overlap without halo, so pixels outside of the core are made equal and add no error
+    for (unsigned y = 0; y < grid.tileHeight; y++) {
+        for (unsigned x = 0; x < grid.tileWidth; x++) {
+            const bool inCore = tile.x + x >= tile.coreX && tile.x + x < tile.coreX + tile.coreWidth && tile.y + y >= tile.coreY && tile.y + y < tile.coreY + tile.coreHeight;
+            if (!inCore) {
+                const auto index = (static_cast<size_t>(y) * grid.tileWidth + x) * 4;
+                std::copy_n(test.data.data() + index, 4, ref.data.data() + index);
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to process '" << match.testPath << "': " << e.what() << std::endl;
-            continue;
         }
+    }
 
-        processed += 1;
+    this->upload = psnr_stage(*this->pooled->res, test, &ref);
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::PSNRJob::finish(const DecodedPair &pair) {
+    PSNRResult result;
+    if (this->tiled.has_value() && this->tiled->decided.has_value()) {
+        const auto pass = this->tiled->decided;
+        this->tiled.reset();
+        this->pool.release(std::move(this->pooled.value()));
+        this->pooled.reset();
+        return {MetricValue{.name = "PSNR", .value = std::numeric_limits<float>::quiet_NaN(), .unit = " dB", .pass = pass, .computed = false}};
     }
+    if (this->tiled.has_value()) {
+        result.db = static_cast<float>(-10.0 * std::log10(this->tiled->sum / (static_cast<double>(pair.test.width) * pair.test.height)));
+        result.imageData = std::move(this->tiled->map);
+        this->tiled.reset();
+    } else {
+        result = psnr_read_back(*this->pooled->res, this->hasOutput, this->args.colorize, this->hasGrid || this->incrementalPass);
+    }
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
 
-    std::cout << "Processed " << processed << "/" << imageMatches.size() <<" images" << std::endl;
+    if (this->incrementalPass) {
+        // region only holds the changed cells, the value comes from errors of all cells
+        result.db = static_cast<float>(-10.0 * std::log10(this->session->update(result.grid)));
+        result.grid = this->session->grid();
+    }
+
+    if (this->hasGrid) {
+        // cells hold mean square errors, converted the same way as the whole image
+        for (auto &cell : result.grid) {
+            cell = -10.0f * std::log10(cell);
+        }
+        const auto grid = IQM::Reduce::gridExtent(pair.test.width, pair.test.height, SCORE_GRID_CELL);
+        save_score_grid(pair.match.outPath.value(), this->gridFormat.value(), result.grid, grid.width, grid.height);
+    } else if (pair.match.outPath.has_value()) {
+        if (this->args.colorize) {
+            save_color_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        } else {
+            save_char_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        }
+    }
+
+    return {MetricValue{.name = "PSNR", .value = result.db, .unit = " dB"}};
+}
+
+unsigned long IQM::Bin::PSNRJob::resourceSize() const {
+    return this->pooled.has_value() ? this->pooled->size : 0;
+}
+
+unsigned long IQM::Bin::PSNRJob::estimateSize(const DecodedPair &pair) const {
+    const auto hasOutput = pair.match.outPath.has_value() && !this->gridFormat.has_value();
+    const auto tileBudget = this->sharedInput == nullptr && !this->roi.enabled() && !this->gridFormat.has_value() && !this->session.has_value() ? pair_tile_budget(this->tileBudget, this->memoryBudget, pair.test.width, pair.test.height, this->tileMemory(hasOutput)) : std::nullopt;
+    return pair_memory(pair.test.width, pair.test.height, this->tileMemory(hasOutput), 0, tileBudget);
+}
+
+IQM::Bin::TileMemory IQM::Bin::PSNRJob::tileMemory(const bool hasOutput) const {
+    const auto colorize = this->args.colorize;
+    return [=](const unsigned width, const unsigned height) {
+        return psnr_plan(width, height, hasOutput, colorize).resources.estimate();
+    };
 }
 
 void IQM::Bin::psnr_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::PSNR& psnr, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref) {
     try {
         VulkanResource::resetMemCounter();
-        IQM::Colorize colorizer(*instance.device());
-        IQM::PSNRVariant variant = IQM::PSNRVariant::Luma;
-        if (args.options.contains("--psnr-variant")) {
-            auto opt = args.options.at("--psnr-variant");
-            if (opt == "luma" || opt == "LUMA") {
-                variant = IQM::PSNRVariant::Luma;
-            } else if (opt == "rgb" || opt == "RGB") {
-                variant = IQM::PSNRVariant::RGB;
-            } else if (opt == "yuv" || opt == "YUV") {
-                variant = IQM::PSNRVariant::YUV;
-            } else {
-                throw std::invalid_argument("Unknown PSNR variant");
-            }
-        }
+        IQM::PSNRVariant variant = psnr_variant(args.options);
         Timestamps timestamps;
         auto start = std::chrono::high_resolution_clock::now();
 
@@ -295,28 +363,19 @@ void IQM::Bin::psnr_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
 
         initRenderDoc();
 
-        auto res = psnr_init_res(input, ref, instance, false, args.colorize);
+        auto res = psnr_init_res(input.width, input.height, instance, false, args.colorize);
+        const auto upload = psnr_stage(res, input, &ref);
         timestamps.mark("resources allocated");
 
-        psnr_upload(instance, res, false, args.colorize);
-
-        auto psnrArgs = IQM::PSNRInput {
-            .device = instance.device(),
-            .cmdBuf = &*instance.cmdBuf(),
-            .ivTest = &res.imageInput->imageView,
-            .ivRef = &res.imageRef->imageView,
-            .bufSum = &res.sumBuf,
-            .variant = variant,
-            .width = input.width,
-            .height = input.height,
-        };
+        psnr_upload(instance, res, false, args.colorize, upload);
 
         const vk::CommandBufferBeginInfo beginInfo = {
             .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
         };
         instance.cmdBuf()->begin(beginInfo);
 
-        psnr.computeMetric(psnrArgs);
+        // without output map nothing is colorized
+        psnr_record_compute(*instance.cmdBuf(), instance, psnr, nullptr, res, variant, false, false, {});
 
         instance.cmdBuf()->end();
 
@@ -360,17 +419,15 @@ void IQM::Bin::psnr_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
     }
 }
 
-void IQM::Bin::psnr_upload(const VulkanInstance &instance, const PSNRResources &res, bool hasOutput, bool colorize) {
-    const vk::CommandBufferBeginInfo beginInfo = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-    };
-    instance.cmdBufTransfer()->begin(beginInfo);
-
+void IQM::Bin::psnr_record_upload(const vk::raii::CommandBuffer &cmdBuf, const PSNRResources &res, const bool hasOutput, const bool colorize, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
     std::vector imagesToInit = {
         res.imageInput,
-        res.imageRef,
     };
 
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
+
     if (hasOutput) {
         imagesToInit.push_back(res.imageOut);
         if (colorize) {
@@ -380,18 +437,9 @@ void IQM::Bin::psnr_upload(const VulkanInstance &instance, const PSNRResources &
         }
     }
 
-    VulkanResource::initImages(*instance.cmdBufTransfer(), imagesToInit);
+    VulkanResource::initImages(cmdBuf, imagesToInit);
 
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageInput->width,
-        .bufferImageHeight = res.imageInput->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageInput->width, res.imageInput->height, 1}
-    };
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgInput, res.imageInput->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgRef, res.imageRef->image,  vk::ImageLayout::eGeneral, copyRegion);
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
     if (hasOutput && colorize) {
         vk::BufferImageCopy copyColorMapRegion{
             .bufferOffset = 0,
@@ -401,9 +449,16 @@ void IQM::Bin::psnr_upload(const VulkanInstance &instance, const PSNRResources &
             .imageOffset = vk::Offset3D{0, 0, 0},
             .imageExtent = vk::Extent3D{256, 1, 1}
         };
-        instance.cmdBufTransfer()->copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
+        cmdBuf.copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
     }
+}
 
+void IQM::Bin::psnr_upload(const VulkanInstance &instance, const PSNRResources &res, bool hasOutput, bool colorize, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    psnr_record_upload(*instance.cmdBufTransfer(), res, hasOutput, colorize, upload, nullptr, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -417,24 +472,87 @@ void IQM::Bin::psnr_upload(const VulkanInstance &instance, const PSNRResources &
         .pSignalSemaphores = &*res.uploadDone
     };
 
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
     instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
 }
 
-IQM::Bin::PSNRResult IQM::Bin::psnr_copy_back(const VulkanInstance &instance, const PSNRResources &res, Timestamps &timestamps, bool hasOutput, bool colorize) {
-    PSNRResult result;
+IQM::Bin::InputUpload IQM::Bin::psnr_stage(const PSNRResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
 
-    // copy out
-    const vk::CommandBufferBeginInfo beginInfoCopy = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+void IQM::Bin::psnr_record_compute(const vk::raii::CommandBuffer &cmdBuf, const VulkanInstance &instance, IQM::PSNR &psnr, IQM::Colorize *colorizer, const PSNRResources &res, const IQM::PSNRVariant variant, const bool hasOutput, const bool grid, const IQM::Mask &mask) {
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+
+    auto psnrArgs = IQM::PSNRInput {
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .bufSum = &res.sumBuf,
+        .imgOut = hasOutput ? &res.imageOut->image : nullptr,
+        .variant = variant,
+        .width = width,
+        .height = height,
+        .mask = mask,
+        .bufGrid = grid ? &res.gridBuf : nullptr,
+        .gridCell = SCORE_GRID_CELL,
     };
-    instance.cmdBufTransfer()->begin(beginInfoCopy);
 
+    psnr.computeMetric(psnrArgs);
+
+    if (hasOutput) {
+        if (colorizer != nullptr) {
+            auto colorizerInput = IQM::ColorizeInput{
+                .device = instance.device(),
+                .cmdBuf = &cmdBuf,
+                .ivIn = &res.imageOut->imageView,
+                .ivOut = &res.imageInput->imageView,
+                .ivColormap = &res.imageColorMap->imageView,
+                .invert = false,
+                .scaler = 4.0,
+                .width = width,
+                .height = height
+            };
+
+            colorizer->compute(colorizerInput);
+        } else {
+            std::array offsets = {
+                vk::Offset3D{0, 0, 0},
+                vk::Offset3D{static_cast<int>(width), static_cast<int>(height), 1}
+            };
+            // copy RGBA f32 to RGBA u8
+            std::vector region {
+                vk::ImageBlit {
+                    .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .srcOffsets = offsets,
+                    .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                    .dstOffsets = offsets,
+                }
+            };
+            cmdBuf.blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
+        }
+    }
+}
+
+void IQM::Bin::psnr_record_download(const vk::raii::CommandBuffer &cmdBuf, const PSNRResources &res, const bool hasOutput, const bool colorize, const bool grid) {
     vk::BufferCopy bufCopy{
         .srcOffset = 0,
         .dstOffset = 0,
         .size = sizeof(float),
     };
-    instance.cmdBufTransfer()->copyBuffer(res.sumBuf, res.stgInput, bufCopy);
+    cmdBuf.copyBuffer(res.sumBuf, res.stgInput, bufCopy);
+
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(res.imageInput->width, res.imageInput->height, SCORE_GRID_CELL);
+        vk::BufferCopy gridCopy{
+            .srcOffset = 0,
+            .dstOffset = sizeof(float),
+            .size = extent.width * extent.height * sizeof(float),
+        };
+        cmdBuf.copyBuffer(res.gridBuf, res.stgInput, gridCopy);
+    }
 
     if (hasOutput) {
         vk::BufferImageCopy copyRegion{
@@ -447,12 +565,50 @@ IQM::Bin::PSNRResult IQM::Bin::psnr_copy_back(const VulkanInstance &instance, co
         };
 
         if (colorize) {
-            instance.cmdBufTransfer()->copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
+            cmdBuf.copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
         } else {
-            instance.cmdBufTransfer()->copyImageToBuffer(res.imageExport->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
+            cmdBuf.copyImageToBuffer(res.imageExport->image, vk::ImageLayout::eGeneral, res.stgInput, {copyRegion});
         }
     }
+}
 
+IQM::Bin::PSNRResult IQM::Bin::psnr_read_back(const PSNRResources &res, const bool hasOutput, const bool colorize, const bool grid) {
+    PSNRResult result;
+
+    const auto outBufData = static_cast<float *>(res.stgInputMemory.mapMemory(0, sizeof(float) + res.imageInput->width * res.imageInput->height * 4, {}));
+    res.stgInputMemory.invalidate();
+    memcpy(&result.db, outBufData, sizeof(float));
+
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(res.imageInput->width, res.imageInput->height, SCORE_GRID_CELL);
+        result.grid.assign(outBufData + 1, outBufData + 1 + extent.width * extent.height);
+    }
+
+    if (hasOutput) {
+        // image data start after the PSNR value
+        if (colorize) {
+            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height * 4);
+            memcpy(data.data(), outBufData + 1, res.imageInput->height * res.imageInput->width * 4 * sizeof(unsigned char));
+            result.imageData = std::move(data);
+        } else {
+            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height);
+            memcpy(data.data(), outBufData + 1, res.imageInput->height * res.imageInput->width * sizeof(unsigned char));
+            result.imageData = std::move(data);
+        }
+    }
+
+    res.stgInputMemory.unmapMemory();
+
+    return result;
+}
+
+IQM::Bin::PSNRResult IQM::Bin::psnr_copy_back(const VulkanInstance &instance, const PSNRResources &res, Timestamps &timestamps, bool hasOutput, bool colorize) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    psnr_record_download(*instance.cmdBufTransfer(), res, hasOutput, colorize, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -475,22 +631,7 @@ IQM::Bin::PSNRResult IQM::Bin::psnr_copy_back(const VulkanInstance &instance, co
 
     timestamps.mark("end GPU work");
 
-    const auto outBufData = static_cast<float *>(res.stgInputMemory.mapMemory(0, sizeof(float) + res.imageInput->width * res.imageInput->height * 4, {}));
-    memcpy(&result.db, outBufData, sizeof(float));
-
-    if (hasOutput) {
-        if (colorize) {
-            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height * 4);
-            memcpy(data.data(), outBufData + sizeof(float), res.imageInput->height * res.imageInput->width * 4 * sizeof(unsigned char));
-            result.imageData = std::move(data);
-        } else {
-            std::vector<unsigned char> data(res.imageInput->width * res.imageInput->height);
-            memcpy(data.data(), outBufData + sizeof(float), res.imageInput->height * res.imageInput->width * sizeof(unsigned char));
-            result.imageData = std::move(data);
-        }
-    }
-
-    res.stgInputMemory.unmapMemory();
+    auto result = psnr_read_back(res, hasOutput, colorize, false);
     timestamps.mark("end copy from GPU");
 
     return result;
@@ -7,23 +7,33 @@
 #define IQM_BIN_PSNR_H
 
 #include <IQM/psnr.h>
+#include <IQM/base/colorize.h>
 #include "../../shared/vulkan.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
 #include "../../shared/io.h"
 #include "../../shared/timestamps.h"
+#include "../../shared/tiling.h"
+#include "../../shared/resource_plan.h"
+#include "../../shared/roi.h"
+#include "../../shared/incremental.h"
 #include "../../IQM/args.h"
 #include "../../IQM-profile/args.h"
 
 namespace IQM::Bin {
     struct PSNRResources {
         vk::raii::Buffer stgInput = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
         vk::raii::Buffer stgRef = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
         vk::raii::Buffer stgColormap = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgColormapMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgColormapMemory;
         vk::raii::Buffer sumBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory sumMemory = VK_NULL_HANDLE;
+        DeviceAllocation sumMemory;
+        // mean square error of each cell of the score grid
+        vk::raii::Buffer gridBuf = VK_NULL_HANDLE;
+        DeviceAllocation gridMemory;
 
         // RGBA u8 input images
         std::shared_ptr<VulkanImage> imageInput;
@@ -41,18 +51,85 @@ namespace IQM::Bin {
         vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
         vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
         vk::raii::Fence transferFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    // device local resources of `psnr_init_res`, also used to estimate memory of a pair
+    struct PSNRPlan {
+        ResourcePlan resources;
+        unsigned sumBuf;
+        unsigned gridBuf;
+        unsigned imageInput;
+        unsigned imageRef;
+        std::optional<unsigned> imageOut;
+        std::optional<unsigned> imageExport;
+        std::optional<unsigned> imageColorMap;
     };
 
     struct PSNRResult {
         std::vector<unsigned char> imageData;
+        // mean square error of each cell of the score grid
+        std::vector<float> grid;
         float db;
     };
 
-    void psnr_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+    class PSNRJob : public BatchJob {
+    public:
+        // `shared` provides pipelines reused by jobs of all slots, `sharedColorizer` is null without colorized output
+        PSNRJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<PSNRResources>& pool, const IQM::PSNR& shared, const IQM::Colorize* sharedColorizer);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        bool nextPass() override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        void stageTile();
+        [[nodiscard]] TileMemory tileMemory(bool hasOutput) const;
+
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<PSNRResources>& pool;
+        IQM::PSNR psnr;
+        std::optional<unsigned long> tileBudget;
+        // set while the current pair is computed in tiles
+        std::optional<TiledPair> tiled;
+        // only created when output is colorized
+        std::optional<IQM::Colorize> colorizer;
+        IQM::PSNRVariant variant;
+        bool hasOutput = false;
+        // the score grid is saved instead of the output image
+        std::optional<ScoreGridFormat> gridFormat;
+        bool hasGrid = false;
+        RegionOfInterest roi;
+        Thresholds thresholds;
+        // mask of the current pair, empty without region of interest
+        IQM::Mask pairMask;
+        // set by `--incremental`, unused with shared input
+        std::optional<IncrementalSession> session;
+        // the current pair computes a region of the session
+        bool incrementalPass = false;
+        std::optional<PooledResource<PSNRResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+    };
+
+
     void psnr_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::PSNR& psnr, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
 
-    PSNRResources psnr_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance& instance, bool hasOutput, bool colorize);
-    void psnr_upload(const IQM::VulkanInstance& instance, const PSNRResources& res, bool hasOutput, bool colorize);
+    PSNRPlan psnr_plan(unsigned width, unsigned height, bool hasOutput, bool colorize);
+    PSNRResources psnr_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance, bool hasOutput, bool colorize);
+    InputUpload psnr_stage(const PSNRResources& res, const InputImage &test, const InputImage *ref);
+    void psnr_record_upload(const vk::raii::CommandBuffer& cmdBuf, const PSNRResources& res, bool hasOutput, bool colorize, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void psnr_upload(const IQM::VulkanInstance& instance, const PSNRResources& res, bool hasOutput, bool colorize, const InputUpload& upload);
+    void psnr_record_compute(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::PSNR& psnr, IQM::Colorize* colorizer, const PSNRResources& res, IQM::PSNRVariant variant, bool hasOutput, bool grid, const IQM::Mask& mask);
+    // the score grid takes the place of the output image in staging memory, so they can't be downloaded together
+    void psnr_record_download(const vk::raii::CommandBuffer& cmdBuf, const PSNRResources& res, bool hasOutput, bool colorize, bool grid);
+    PSNRResult psnr_read_back(const PSNRResources& res, bool hasOutput, bool colorize, bool grid);
     PSNRResult psnr_copy_back(const IQM::VulkanInstance& instance, const PSNRResources& res, Timestamps &timestamps, bool hasOutput, bool colorize);
 }
 
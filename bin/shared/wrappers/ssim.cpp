@@ -3,10 +3,14 @@
  * Petr Volf - 2025
  */
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include "ssim.h"
 #include "../../shared/debug_utils.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
 #include "IQM/base/viridis.h"
 #include "IQM/base/colorize.h"
 
@@ -15,62 +19,45 @@ using IQM::Bin::VulkanImage;
 using IQM::VulkanInstance;
 using IQM::Bin::VulkanResource;
 
-IQM::Bin::SSIMResources IQM::Bin::ssim_init_res(const InputImage &test, const InputImage &ref, const VulkanInstance& instance) {
-    // always 4 channels on input, with 1B per channel
-    // add 1 float to end so buffer can be reused for writeback from GPU
-    const auto size = (test.width * test.height + 1) * 4;
-    const auto colormapSize = 256 * 4 * sizeof(float);
-    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached
-    );
-    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
-    *instance.device(),
-    *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        colormapSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [mssimBuf, mssimMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
+bool IQM::Bin::ssim_half_precision(const std::unordered_map<std::string, std::string> &options, const VulkanInstance &instance) {
+    if (!options.contains("--ssim-precision")) {
+        return false;
+    }
 
-    stgBuf.bindMemory(stgMem, 0);
-    stgRefBuf.bindMemory(stgRefMem, 0);
-    cmBuf.bindMemory(cmMem, 0);
-    mssimBuf.bindMemory(mssimMem, 0);
+    const auto &precision = options.at("--ssim-precision");
+    if (precision != "fp16" && precision != "fp32") {
+        throw std::runtime_error("Unknown SSIM precision: " + precision);
+    }
+    if (precision == "fp32") {
+        return false;
+    }
 
-    void * inBufData = stgMem.mapMemory(0, size, {});
-    memcpy(inBufData, test.data.data(), size);
-    stgMem.unmapMemory();
+    if (!instance.halfStorageImages()) {
+        // jobs of every slot ask again, the fallback is reported once
+        static bool reported = false;
+        if (!reported) {
+            std::cerr << "Device doesn't support R16F storage images, SSIM map is stored in fp32" << std::endl;
+            reported = true;
+        }
+        return false;
+    }
+    return true;
+}
 
-    inBufData = stgRefMem.mapMemory(0, size, {});
-    memcpy(inBufData, ref.data.data(), size);
-    stgRefMem.unmapMemory();
+bool IQM::Bin::ssim_half_map(const Args &args, const VulkanInstance &instance) {
+    return !args.colorize && ssim_half_precision(args.options, instance);
+}
 
-    inBufData = cmMem.mapMemory(0, colormapSize, {});
-    memcpy(inBufData, viridis, colormapSize);
-    cmMem.unmapMemory();
+IQM::Bin::SSIMPlan IQM::Bin::ssim_plan(const unsigned width, const unsigned height, const bool halfPrecision, const bool intermediates, const bool hasOutput) {
+    // one partial sum and one sum of weights per 16x16 tile
+    const auto [groupsX, groupsY] = IQM::GPU::VulkanRuntime::compute2DGroupCounts(width, height, 16);
+    const auto grid = IQM::Reduce::gridExtent(width, height, SCORE_GRID_CELL);
 
     vk::ImageCreateInfo srcImageInfo = {
         .flags = {},
         .imageType = vk::ImageType::e2D,
         .format = vk::Format::eR8G8B8A8Unorm,
-        .extent = vk::Extent3D(test.width, test.height, 1),
+        .extent = vk::Extent3D(width, height, 1),
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
@@ -92,22 +79,78 @@ IQM::Bin::SSIMResources IQM::Bin::ssim_init_res(const InputImage &test, const In
 
     vk::ImageCreateInfo dstImageInfo = {srcImageInfo};
     dstImageInfo.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc;
-    dstImageInfo.format = vk::Format::eR32Sfloat;
+    // with intermediates the output is also the f32 scratch image of the blur
+    dstImageInfo.format = halfPrecision && !intermediates ? vk::Format::eR16Sfloat : vk::Format::eR32Sfloat;
 
     vk::ImageCreateInfo colorMapImageInfo = {srcImageInfo};
     colorMapImageInfo.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferDst;
     colorMapImageInfo.extent = vk::Extent3D(256, 1, 1);
     colorMapImageInfo.format = vk::Format::eR32G32B32A32Sfloat;
 
-    auto const imageInput = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageRef = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageOut = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), dstImageInfo));
-    auto const imageExport = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), exitImageInfo));
-    auto const imageColorMap = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), colorMapImageInfo));
-    auto imagesBlurred = std::vector<std::shared_ptr<VulkanImage>>();
+    SSIMPlan plan;
+    plan.mssimBuf = plan.resources.buffer(
+        2 * groupsX * groupsY * sizeof(float),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst
+    );
+    plan.gridBuf = plan.resources.buffer(
+        grid.width * grid.height * sizeof(float),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc
+    );
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
+    // blur passes of intermediates use the output image as scratch
+    if (intermediates || hasOutput) {
+        plan.imageOut = plan.resources.image(dstImageInfo);
+    }
+    if (hasOutput) {
+        plan.imageExport = plan.resources.image(exitImageInfo);
+        plan.imageColorMap = plan.resources.image(colorMapImageInfo);
+    }
+    for (int i = 0; i < (intermediates ? 5 : 0); i++) {
+        plan.imagesBlurred.push_back(plan.resources.image(intermediateImageInfo));
+    }
+    return plan;
+}
 
-    for (int i = 0; i < 5; i++) {
-        imagesBlurred.emplace_back(std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), intermediateImageInfo)));
+IQM::Bin::SSIMResources IQM::Bin::ssim_init_res(const unsigned width, const unsigned height, const VulkanInstance& instance, const bool halfPrecision, const bool intermediates, const bool hasOutput) {
+    // always 4 channels on input, with 1B per channel
+    // add 2 floats to end so buffer can be reused for writeback of the sum and its weight from GPU
+    const auto size = (width * height + 2) * 4;
+    const auto colormapSize = 256 * 4 * sizeof(float);
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+    *instance.device(),
+    *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    auto [cmBuf, cmMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        colormapSize,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    void * inBufData = cmMem.mapMemory(0, colormapSize, {});
+    memcpy(inBufData, viridis, colormapSize);
+    cmMem.unmapMemory();
+
+    const auto plan = ssim_plan(width, height, halfPrecision, intermediates, hasOutput);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [mssimBuf, mssimMem] = planned.takeBuffer(plan.mssimBuf);
+    auto [gridBuf, gridMem] = planned.takeBuffer(plan.gridBuf);
+
+    auto imagesBlurred = std::vector<std::shared_ptr<VulkanImage>>();
+    for (const auto index : plan.imagesBlurred) {
+        imagesBlurred.push_back(planned.image(index));
     }
 
     return SSIMResources{
@@ -119,157 +162,265 @@ IQM::Bin::SSIMResources IQM::Bin::ssim_init_res(const InputImage &test, const In
         .stgColormapMemory = std::move(cmMem),
         .mssimBuf = std::move(mssimBuf),
         .mssimMemory = std::move(mssimMem),
-        .imageInput = imageInput,
-        .imageRef = imageRef,
+        .gridBuf = std::move(gridBuf),
+        .gridMemory = std::move(gridMem),
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
         .imagesBlurred = imagesBlurred,
-        .imageOut = imageOut,
-        .imageExport = imageExport,
-        .imageColorMap = imageColorMap,
+        .imageOut = planned.image(plan.imageOut),
+        .imageExport = planned.image(plan.imageExport),
+        .imageColorMap = planned.image(plan.imageColorMap),
         .uploadDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .computeDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .transferFence = instance.device()->createFence(vk::FenceCreateInfo{}),
     };
 }
 
-void IQM::Bin::ssim_run(const Args& args, const VulkanInstance& instance, const std::vector<Match>& imageMatches) {
-    IQM::SSIM ssim(*instance.device());
-    IQM::Colorize colorizer(*instance.device());
+IQM::Bin::SSIMJob::SSIMJob(const Args &args, const VulkanInstance &instance, ResourcePool<SSIMResources> &pool, const IQM::SSIM &shared, const IQM::Colorize *sharedColorizer, std::function<const IQM::SSIM&()> sharedHalf):
+    args(args),
+    instance(instance),
+    pool(pool),
+    halfPrecision(ssim_half_map(args, instance)),
+    ssim(*instance.device(), shared),
+    sharedHalf(std::move(sharedHalf)),
+    tileBudget(tile_budget(args.options)),
+    gridFormat(score_grid_format(args.options)),
+    roi(args.options),
+    thresholds(args) {
+    if (sharedColorizer != nullptr) {
+        this->colorizer.emplace(*instance.device(), *sharedColorizer);
+    }
+    if (args.incremental) {
+        if (this->roi.enabled()) {
+            throw std::runtime_error("Region of interest can't be combined with --incremental");
+        }
+        // border of half the kernel is left out of MSSIM, the same reach is needed around changed cells
+        const unsigned halo = (this->ssim.kernelSize - 1) / 2;
+        this->session.emplace(halo, halo);
+    }
+}
 
-    int processed = 0;
+void IQM::Bin::SSIMJob::prepare(const DecodedPair &pair) {
+    this->tiled.reset();
+    this->hasOutput = pair.match.outPath.has_value() && !this->gridFormat.has_value();
+    this->hasGrid = pair.match.outPath.has_value() && this->gridFormat.has_value();
+    this->pairMask = this->roi.enabled() ? this->roi.mask(this->instance, pair.test.width, pair.test.height) : IQM::Mask{};
+    this->pairHalf = this->pairHalfPrecision(pair.test.width, pair.test.height, this->hasOutput);
+    if (this->pairHalf && !this->halfPrecision && !this->ssimHalf.has_value()) {
+        this->ssimHalf.emplace(*this->instance.device(), this->sharedHalf());
+    }
 
-    for (const auto& match : imageMatches) {
-        try {
-            VulkanResource::resetMemCounter();
-            Timestamps timestamps;
-            auto start = std::chrono::high_resolution_clock::now();
+    this->incrementalPass = this->session.has_value() && this->sharedInput == nullptr;
+    if (this->incrementalPass) {
+        if (this->hasOutput) {
+            throw std::runtime_error("Incremental computation only saves the score grid, set --grid");
+        }
 
-            const auto input = load_image(match.testPath);
-            const auto reference = load_image(match.refPath);
-            if (input.height != reference.height || input.width != reference.width) {
-                throw std::runtime_error("Test and reference images have different sizes");
-            }
+        this->session->plan(pair);
+        const auto &region = this->session->region();
+        const ResourceKey key{.method = Method::SSIM, .width = region.tileWidth, .height = region.tileHeight, .options = std::to_string(this->pairHalf) + std::to_string(this->hasOutput)};
+        this->pooled = this->pool.acquire(key, [&] { return ssim_init_res(region.tileWidth, region.tileHeight, this->instance, this->pairHalf, this->ssim.usesIntermediates(), this->hasOutput); });
+        if (this->session->whole()) {
+            this->refResident = hold_reference(this->pooled->res->reference, pair);
+            this->upload = ssim_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+        } else {
+            this->pooled->res->reference.reset();
+            this->refResident = false;
+            const auto test = crop_tile(pair.test, region, region.tiles[0]);
+            const auto ref = crop_tile(*pair.ref, region, region.tiles[0]);
+            this->upload = ssim_stage(*this->pooled->res, test, &ref);
+        }
+        return;
+    }
 
-            timestamps.mark("images loaded");
-
-            initRenderDoc();
-
-            auto res = ssim_init_res(input, reference, instance);
-            timestamps.mark("resources allocated");
-
-            ssim_upload(instance, res);
-
-            auto ssimArgs = IQM::SSIMInput {
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivTest = &res.imageInput->imageView,
-                .ivRef = &res.imageRef->imageView,
-                .ivMeanTest = &res.imagesBlurred[0]->imageView,
-                .ivMeanRef = &res.imagesBlurred[1]->imageView,
-                .ivVarTest = &res.imagesBlurred[2]->imageView,
-                .ivVarRef = &res.imagesBlurred[3]->imageView,
-                .ivCovar = &res.imagesBlurred[4]->imageView,
-                .ivOut = &res.imageOut->imageView,
-                .imgOut = &res.imageOut->image,
-                .bufMssim = &res.mssimBuf,
-                .width = input.width,
-                .height = input.height
-            };
-
-            const vk::CommandBufferBeginInfo beginInfo = {
-                .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-            };
-            instance.cmdBuf()->begin(beginInfo);
-
-            ssim.computeMetric(ssimArgs);
-
-            if (args.colorize) {
-                auto colorizerInput = IQM::ColorizeInput{
-                    .device = instance.device(),
-                    .cmdBuf = &*instance.cmdBuf(),
-                    .ivIn = &res.imageOut->imageView,
-                    .ivOut = &res.imageInput->imageView,
-                    .ivColormap = &res.imageColorMap->imageView,
-                    .invert = true,
-                    .width = input.width,
-                    .height = input.height
-                };
-
-                colorizer.compute(colorizerInput);
-            } else {
-                std::array offsets = {
-                    vk::Offset3D{0, 0, 0},
-                    vk::Offset3D{static_cast<int>(res.imageInput->width), static_cast<int>(res.imageInput->height), 1}
-                };
-                // copy RGBA f32 to RGBA u8
-                std::vector region {
-                    vk::ImageBlit {
-                        .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                        .srcOffsets = offsets,
-                        .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                        .dstOffsets = offsets,
-                    }
-                };
-                instance.cmdBuf()->blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
-            }
+    const auto tileBudget = this->pairTileBudget(pair.test.width, pair.test.height, this->pairHalf, this->hasOutput);
+    if (tileBudget.has_value()) {
+        const unsigned halo = (this->ssim.kernelSize - 1) / 2;
+        TileGrid grid(pair.test.width, pair.test.height, tile_size(tileBudget.value(), this->tileMemory(this->pairHalf, this->hasOutput), halo), halo);
+        if (grid.tiles.size() > 1) {
+            const ResourceKey key{.method = Method::SSIM, .width = grid.tileWidth, .height = grid.tileHeight, .options = std::to_string(this->pairHalf) + std::to_string(this->hasOutput)};
+            this->pooled = this->pool.acquire(key, [&] { return ssim_init_res(grid.tileWidth, grid.tileHeight, this->instance, this->pairHalf, this->ssim.usesIntermediates(), this->hasOutput); });
+            // every tile uploads its own part of the reference
+            this->pooled->res->reference.reset();
+            this->refResident = false;
+
+            this->tiled.emplace(TiledPair{
+                .grid = std::move(grid),
+                .test = &pair.test,
+                .ref = pair.ref.get(),
+                .map = std::vector<unsigned char>(this->hasOutput ? pair.test.width * pair.test.height * (this->args.colorize ? 4 : 1) : 0),
+            });
+            this->stageTile();
+            return;
+        }
+    }
 
-            instance.cmdBuf()->end();
-
-            const std::vector cmdBufs = {
-                &**instance.cmdBuf()
-            };
-
-            auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
-            const vk::SubmitInfo submitInfo{
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*res.uploadDone,
-                .pWaitDstStageMask = &mask,
-                .commandBufferCount = 1,
-                .pCommandBuffers = *cmdBufs.data(),
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &*res.computeDone
-            };
-
-            instance.queue()->submit(submitInfo, {});
-            timestamps.mark("submit compute GPU pipeline");
-            // wait so cmd buffer can be reused for GPU -> CPU transfer
-            instance.waitForFence(res.transferFence);
-
-            auto result = ssim_copy_back(instance, res, timestamps, ssim.kernelSize, args.colorize);
-
-            finishRenderDoc();
-
-            if (match.outPath.has_value()) {
-                if (args.colorize) {
-                    save_color_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                } else {
-                    save_char_image(args.outputPath.value(), result.imageData, input.width, input.height);
-                }
-            }
+    const ResourceKey key{.method = Method::SSIM, .width = pair.test.width, .height = pair.test.height, .options = std::to_string(this->pairHalf) + std::to_string(this->hasOutput)};
+    this->pooled = this->pool.acquire(key, [&] { return ssim_init_res(pair.test.width, pair.test.height, this->instance, this->pairHalf, this->ssim.usesIntermediates(), this->hasOutput); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = ssim_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+    }
+}
 
-            timestamps.mark("output saved");
+void IQM::Bin::SSIMJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    ssim_record_upload(cmdBuf, *this->pooled->res, this->upload, this->sharedInput, this->refResident);
+}
 
-            const auto end = std::chrono::high_resolution_clock::now();
-            std::cout << match.testPath << ": " << result.mssim << std::endl;
-            if (args.verbose) {
-                timestamps.print(start, end);
-                double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
-                std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to process '" << match.testPath << "': " << e.what() << std::endl;
-            continue;
+void IQM::Bin::SSIMJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    auto &ssim = this->pairHalf && !this->halfPrecision ? this->ssimHalf.value() : this->ssim;
+    ssim_record_compute(cmdBuf, this->instance, ssim, this->colorizer.has_value() ? &this->colorizer.value() : nullptr, *this->pooled->res, this->refResident, this->tileSumRegion(), this->pairMask, this->hasGrid || this->incrementalPass);
+}
+
+void IQM::Bin::SSIMJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    ssim_record_download(cmdBuf, *this->pooled->res, this->args.colorize, this->hasGrid || this->incrementalPass);
+}
+
+bool IQM::Bin::SSIMJob::nextPass() {
+    if (!this->tiled.has_value()) {
+        return false;
+    }
+
+    auto &tiled = this->tiled.value();
+    const auto &tile = tiled.grid.tiles[tiled.current];
+    const auto result = ssim_read_back(*this->pooled->res, false);
+
+    // read back divides the sum of the region by its area
+    const auto region = this->tileSumRegion();
+    tiled.sum += static_cast<double>(result.mssim) * region.extent.width * region.extent.height;
+    tiled.area += static_cast<double>(region.extent.width) * region.extent.height;
+    if (!tiled.map.empty()) {
+        stitch_tile(tiled.map, result.imageData, this->args.colorize ? 4 : 1, tiled.grid, tile);
+    }
+
+    tiled.current++;
+    if (tiled.current == tiled.grid.tiles.size()) {
+        return false;
+    }
+
+    // SSIM of each remaining pixel lies in [-1, 1], which bounds MSSIM of the whole image
+    if (this->thresholds.has("SSIM") && tiled.map.empty()) {
+        const auto offset = this->ssim.kernelSize - 1;
+        const auto pixels = static_cast<double>(tiled.grid.width - offset) * (tiled.grid.height - offset);
+        const auto remaining = pixels - tiled.area;
+        tiled.decided = this->thresholds.decide("SSIM", (tiled.sum - remaining) / pixels, (tiled.sum + remaining) / pixels);
+        if (tiled.decided.has_value()) {
+            return false;
         }
+    }
+    this->stageTile();
+    return true;
+}
+
+void IQM::Bin::SSIMJob::stageTile() {
+    const auto &tiled = this->tiled.value();
+    const auto &tile = tiled.grid.tiles[tiled.current];
+    const auto test = crop_tile(*tiled.test, tiled.grid, tile);
+    const auto ref = crop_tile(*tiled.ref, tiled.grid, tile);
+    this->upload = ssim_stage(*this->pooled->res, test, &ref);
+}
 
-        processed += 1;
+vk::Rect2D IQM::Bin::SSIMJob::tileSumRegion() const {
+    if (!this->tiled.has_value() && !this->incrementalPass) {
+        return {};
     }
 
-    std::cout << "Processed " << processed << "/" << imageMatches.size() <<" images" << std::endl;
+    // core of the tile, without the image border that is left out of MSSIM, in tile coordinates
+    const auto &grid = this->tiled.has_value() ? this->tiled->grid : this->session->region();
+    const auto &tile = this->tiled.has_value() ? grid.tiles[this->tiled->current] : grid.tiles[0];
+    const unsigned border = (this->ssim.kernelSize - 1) / 2;
+    const auto left = std::max(tile.coreX, border);
+    const auto top = std::max(tile.coreY, border);
+    const auto right = std::min(tile.coreX + tile.coreWidth, grid.width - border);
+    const auto bottom = std::min(tile.coreY + tile.coreHeight, grid.height - border);
+
+    return vk::Rect2D{
+        .offset = vk::Offset2D{static_cast<int>(left - tile.x), static_cast<int>(top - tile.y)},
+        // cores entirely inside of the border have zero area, so they add nothing
+        .extent = vk::Extent2D{std::max(right, left) - left, std::max(bottom, top) - top},
+    };
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::SSIMJob::finish(const DecodedPair &pair) {
+    SSIMResult result;
+    if (this->tiled.has_value() && this->tiled->decided.has_value()) {
+        const auto pass = this->tiled->decided;
+        this->tiled.reset();
+        this->pool.release(std::move(this->pooled.value()));
+        this->pooled.reset();
+        return {MetricValue{.name = "SSIM", .value = std::numeric_limits<float>::quiet_NaN(), .unit = "", .pass = pass, .computed = false}};
+    }
+    if (this->tiled.has_value()) {
+        const auto offset = this->ssim.kernelSize - 1;
+        result.mssim = static_cast<float>(this->tiled->sum / (static_cast<double>(pair.test.width - offset) * (pair.test.height - offset)));
+        result.imageData = std::move(this->tiled->map);
+        this->tiled.reset();
+    } else {
+        result = ssim_read_back(*this->pooled->res, this->hasGrid || this->incrementalPass);
+    }
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
+
+    if (this->incrementalPass) {
+        // region only holds the changed cells, MSSIM comes from sums of all cells
+        result.mssim = static_cast<float>(this->session->update(result.grid));
+        result.grid = this->session->grid();
+    }
+
+    if (this->hasGrid) {
+        const auto grid = IQM::Reduce::gridExtent(pair.test.width, pair.test.height, SCORE_GRID_CELL);
+        save_score_grid(pair.match.outPath.value(), this->gridFormat.value(), result.grid, grid.width, grid.height);
+    } else if (pair.match.outPath.has_value()) {
+        if (this->args.colorize) {
+            save_color_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        } else {
+            save_char_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
+        }
+    }
+
+    return {MetricValue{.name = "SSIM", .value = result.mssim, .unit = ""}};
+}
+
+unsigned long IQM::Bin::SSIMJob::resourceSize() const {
+    return this->pooled.has_value() ? this->pooled->size : 0;
+}
+
+unsigned long IQM::Bin::SSIMJob::estimateSize(const DecodedPair &pair) const {
+    const auto hasOutput = pair.match.outPath.has_value() && !this->gridFormat.has_value();
+    const auto half = this->pairHalfPrecision(pair.test.width, pair.test.height, hasOutput);
+    const unsigned halo = (this->ssim.kernelSize - 1) / 2;
+    return pair_memory(pair.test.width, pair.test.height, this->tileMemory(half, hasOutput), halo, this->pairTileBudget(pair.test.width, pair.test.height, half, hasOutput));
+}
+
+IQM::Bin::TileMemory IQM::Bin::SSIMJob::tileMemory(const bool half, const bool hasOutput) const {
+    const auto intermediates = this->ssim.usesIntermediates();
+    return [=](const unsigned width, const unsigned height) {
+        return ssim_plan(width, height, half, intermediates, hasOutput).resources.estimate();
+    };
+}
+
+bool IQM::Bin::SSIMJob::pairHalfPrecision(const unsigned width, const unsigned height, const bool hasOutput) const {
+    // explicit tiling keeps the selected precision, only the map written by the fused shader can be stored in f16
+    if (this->halfPrecision || !this->memoryBudget.has_value() || this->tileBudget.has_value() || this->ssim.usesIntermediates() || !hasOutput || this->colorizer.has_value() || !this->instance.halfStorageImages()) {
+        return this->halfPrecision;
+    }
+
+    // pairs fitting neither way are tiled in f32 instead
+    const auto budget = this->memoryBudget.value();
+    return this->tileMemory(false, true)(width, height) > budget && this->tileMemory(true, true)(width, height) <= budget;
+}
+
+std::optional<unsigned long> IQM::Bin::SSIMJob::pairTileBudget(const unsigned width, const unsigned height, const bool half, const bool hasOutput) const {
+    // mask covers the whole pair, so it isn't split into tiles
+    if (this->sharedInput != nullptr || this->roi.enabled() || this->gridFormat.has_value() || this->session.has_value()) {
+        return std::nullopt;
+    }
+    return pair_tile_budget(this->tileBudget, this->memoryBudget, width, height, this->tileMemory(half, hasOutput));
 }
 
 void IQM::Bin::ssim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::SSIM& ssim, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref) {
     try {
         VulkanResource::resetMemCounter();
-        IQM::Colorize colorizer(*instance.device());
         Timestamps timestamps;
         auto start = std::chrono::high_resolution_clock::now();
 
@@ -277,64 +428,19 @@ void IQM::Bin::ssim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
 
         initRenderDoc();
 
-        auto res = ssim_init_res(input, ref, instance);
+        auto res = ssim_init_res(input.width, input.height, instance, ssim_half_precision(args.options, instance), ssim.usesIntermediates(), false);
+        const auto upload = ssim_stage(res, input, &ref);
         timestamps.mark("resources allocated");
 
-        ssim_upload(instance, res);
-
-        auto ssimArgs = IQM::SSIMInput {
-            .device = instance.device(),
-            .cmdBuf = &*instance.cmdBuf(),
-            .ivTest = &res.imageInput->imageView,
-            .ivRef = &res.imageRef->imageView,
-            .ivMeanTest = &res.imagesBlurred[0]->imageView,
-            .ivMeanRef = &res.imagesBlurred[1]->imageView,
-            .ivVarTest = &res.imagesBlurred[2]->imageView,
-            .ivVarRef = &res.imagesBlurred[3]->imageView,
-            .ivCovar = &res.imagesBlurred[4]->imageView,
-            .ivOut = &res.imageOut->imageView,
-            .imgOut = &res.imageOut->image,
-            .bufMssim = &res.mssimBuf,
-            .width = input.width,
-            .height = input.height
-        };
+        ssim_upload(instance, res, upload);
 
         const vk::CommandBufferBeginInfo beginInfo = {
             .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
         };
         instance.cmdBuf()->begin(beginInfo);
 
-        ssim.computeMetric(ssimArgs);
-
-        if (args.colorize) {
-            auto colorizerInput = IQM::ColorizeInput{
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivIn = &res.imageOut->imageView,
-                .ivOut = &res.imageInput->imageView,
-                .ivColormap = &res.imageColorMap->imageView,
-                .invert = true,
-                .width = input.width,
-                .height = input.height
-            };
-
-            colorizer.compute(colorizerInput);
-        } else {
-            std::array offsets = {
-                vk::Offset3D{0, 0, 0},
-                vk::Offset3D{static_cast<int>(res.imageInput->width), static_cast<int>(res.imageInput->height), 1}
-            };
-            // copy RGBA f32 to RGBA u8
-            std::vector region {
-                vk::ImageBlit {
-                    .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                    .srcOffsets = offsets,
-                    .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-                    .dstOffsets = offsets,
-                }
-            };
-            instance.cmdBuf()->blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
-        }
+        // only the value is profiled, without output map nothing is colorized
+        ssim_record_compute(*instance.cmdBuf(), instance, ssim, nullptr, res, false, {}, {}, false);
 
         instance.cmdBuf()->end();
 
@@ -358,7 +464,7 @@ void IQM::Bin::ssim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
         // wait so cmd buffer can be reused for GPU -> CPU transfer
         instance.waitForFence(res.transferFence);
 
-        auto result = ssim_copy_back(instance, res, timestamps, ssim.kernelSize, args.colorize);
+        auto result = ssim_copy_back(instance, res, timestamps, false);
 
         finishRenderDoc();
 
@@ -378,32 +484,181 @@ void IQM::Bin::ssim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIn
     }
 }
 
-void IQM::Bin::ssim_upload(const VulkanInstance &instance, const SSIMResources &res) {
+// sum of the region and its weight, which follows the partial sums of all tiles, is copied after the map
+static void ssim_record_sum_download(const vk::raii::CommandBuffer &cmdBuf, const IQM::Bin::SSIMResources &res) {
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+    const auto [groupsX, groupsY] = IQM::GPU::VulkanRuntime::compute2DGroupCounts(width, height, 16);
+    const std::vector bufCopies = {
+        vk::BufferCopy{
+            .srcOffset = 0,
+            .dstOffset = sizeof(float) * width * height,
+            .size = sizeof(float),
+        },
+        vk::BufferCopy{
+            .srcOffset = sizeof(float) * groupsX * groupsY,
+            .dstOffset = sizeof(float) * (width * height + 1),
+            .size = sizeof(float),
+        },
+    };
+    cmdBuf.copyBuffer(res.mssimBuf, res.stgInput, bufCopies);
+}
+
+static float half_to_float(const uint16_t half) {
+    const auto sign = (half & 0x8000) ? -1.0f : 1.0f;
+    const int exponent = (half >> 10) & 0x1F;
+    const int mantissa = half & 0x3FF;
+
+    if (exponent == 0) {
+        return sign * std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    if (exponent == 0x1F) {
+        return mantissa == 0 ? sign * std::numeric_limits<float>::infinity() : std::numeric_limits<float>::quiet_NaN();
+    }
+    return sign * std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+}
+
+struct PrecisionRun {
+    float mssim;
+    std::vector<float> map;
+    unsigned long memory;
+};
+
+// computes one pair with the output map kept in the chosen precision and reads the map back as f32
+static PrecisionRun ssim_compute_map(const IQM::VulkanInstance &instance, IQM::SSIM &ssim, const IQM::Bin::InputImage &input, const IQM::Bin::InputImage &ref, const bool halfPrecision) {
+    VulkanResource::resetMemCounter();
+    const auto res = IQM::Bin::ssim_init_res(input.width, input.height, instance, halfPrecision, false, true);
+    const auto memory = VulkanResource::memCounter();
+    const auto upload = IQM::Bin::ssim_stage(res, input, &ref);
+
+    IQM::Bin::ssim_upload(instance, res, upload);
+
     const vk::CommandBufferBeginInfo beginInfo = {
         .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
     };
+    instance.cmdBuf()->begin(beginInfo);
+    IQM::Bin::ssim_record_compute(*instance.cmdBuf(), instance, ssim, nullptr, res, false, {}, {}, false);
+    instance.cmdBuf()->end();
+
+    auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
+    const vk::SubmitInfo submitInfo{
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*res.uploadDone,
+        .pWaitDstStageMask = &mask,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &**instance.cmdBuf(),
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &*res.computeDone
+    };
+    instance.queue()->submit(submitInfo, {});
+    // wait so cmd buffer can be reused for GPU -> CPU transfer
+    instance.waitForFence(res.transferFence);
+
+    // the map itself is downloaded instead of the u8 export
+    const auto width = input.width;
+    const auto height = input.height;
     instance.cmdBufTransfer()->begin(beginInfo);
+    const vk::BufferImageCopy copyRegion{
+        .bufferOffset = 0,
+        .bufferRowLength = width,
+        .bufferImageHeight = height,
+        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+        .imageOffset = vk::Offset3D{0, 0, 0},
+        .imageExtent = vk::Extent3D{width, height, 1}
+    };
+    instance.cmdBufTransfer()->copyImageToBuffer(res.imageOut->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+    ssim_record_sum_download(*instance.cmdBufTransfer(), res);
+    instance.cmdBufTransfer()->end();
 
+    auto maskCopy = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eTransfer};
+    const vk::SubmitInfo submitInfoCopy{
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*res.computeDone,
+        .pWaitDstStageMask = &maskCopy,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &**instance.cmdBufTransfer()
+    };
+    instance.queueTransfer()->submit(submitInfoCopy, {});
+    instance.device()->waitIdle();
+
+    const auto pixels = static_cast<size_t>(width) * height;
+    const auto outBufData = res.stgInputMemory.mapMemory(0, (pixels + 2) * sizeof(float), {});
+    const auto values = static_cast<const float*>(outBufData);
+
+    PrecisionRun run{
+        .mssim = values[pixels] / values[pixels + 1],
+        .map = std::vector<float>(pixels),
+        .memory = memory,
+    };
+    if (halfPrecision) {
+        const auto halves = static_cast<const uint16_t*>(outBufData);
+        for (size_t i = 0; i < pixels; i++) {
+            run.map[i] = half_to_float(halves[i]);
+        }
+    } else {
+        std::copy_n(values, pixels, run.map.begin());
+    }
+
+    res.stgInputMemory.unmapMemory();
+    return run;
+}
+
+void IQM::Bin::ssim_compare_precision(const IQM::VulkanInstance &instance, IQM::SSIM &ssim, IQM::SSIM &ssimHalf, const IQM::Bin::InputImage &input, const IQM::Bin::InputImage &ref) {
+    try {
+        if (ssim.usesIntermediates()) {
+            std::cout << "SSIM map is computed from R f32 intermediate images with this kernel, fp16 has no effect" << std::endl;
+            return;
+        }
+
+        const auto full = ssim_compute_map(instance, ssim, input, ref, false);
+        const auto half = ssim_compute_map(instance, ssimHalf, input, ref, true);
+
+        double maxError = 0.0;
+        double sumError = 0.0;
+        for (size_t i = 0; i < full.map.size(); i++) {
+            const double error = std::abs(static_cast<double>(half.map[i]) - full.map[i]);
+            maxError = std::max(maxError, error);
+            sumError += error;
+        }
+
+        std::cout << "MSSIM fp32: " << full.mssim << ", fp16: " << half.mssim << ", difference: " << std::abs(half.mssim - full.mssim) << std::endl;
+        std::cout << "SSIM map error of fp16: max " << maxError << ", mean " << sumError / static_cast<double>(full.map.size()) << std::endl;
+        std::cout << "VRAM used for resources with output map: " << static_cast<double>(full.memory) / 1024 / 1024 << " MB fp32, "
+                  << static_cast<double>(half.memory) / 1024 / 1024 << " MB fp16" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to compare SSIM precision: " << e.what() << std::endl;
+    }
+}
+
+void IQM::Bin::ssim_record_upload(const vk::raii::CommandBuffer &cmdBuf, const SSIMResources &res, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
     std::vector imagesToInit = {
         res.imageInput,
-        res.imageRef,
-        res.imageOut,
-        res.imageExport,
-        res.imageColorMap,
     };
 
-    imagesToInit.insert(imagesToInit.end(), res.imagesBlurred.begin(), res.imagesBlurred.end());
+    for (const auto &image : {res.imageOut, res.imageExport, res.imageColorMap}) {
+        if (image != nullptr) {
+            imagesToInit.push_back(image);
+        }
+    }
+
+    // blurred reference mean and variance are kept along with resident reference
+    for (unsigned i = 0; i < res.imagesBlurred.size(); i++) {
+        if (!refResident || (i != 1 && i != 3)) {
+            imagesToInit.push_back(res.imagesBlurred[i]);
+        }
+    }
+
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
 
-    VulkanResource::initImages(*instance.cmdBufTransfer(), imagesToInit);
+    VulkanResource::initImages(cmdBuf, imagesToInit);
+
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
+    if (res.imageColorMap == nullptr) {
+        return;
+    }
 
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageInput->width,
-        .bufferImageHeight = res.imageInput->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageInput->width, res.imageInput->height, 1}
-    };
     vk::BufferImageCopy copyColorMapRegion{
         .bufferOffset = 0,
         .bufferRowLength = 256,
@@ -412,9 +667,15 @@ void IQM::Bin::ssim_upload(const VulkanInstance &instance, const SSIMResources &
         .imageOffset = vk::Offset3D{0, 0, 0},
         .imageExtent = vk::Extent3D{256, 1, 1}
     };
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgInput, res.imageInput->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgRef, res.imageRef->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
+    cmdBuf.copyBufferToImage(res.stgColormap, res.imageColorMap->image,  vk::ImageLayout::eGeneral, copyColorMapRegion);
+}
+
+void IQM::Bin::ssim_upload(const VulkanInstance &instance, const SSIMResources &res, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    ssim_record_upload(*instance.cmdBufTransfer(), res, upload, nullptr, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -428,40 +689,146 @@ void IQM::Bin::ssim_upload(const VulkanInstance &instance, const SSIMResources &
         .pSignalSemaphores = &*res.uploadDone
     };
 
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
     instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
 }
 
-IQM::Bin::SSIMResult IQM::Bin::ssim_copy_back(const VulkanInstance &instance, const SSIMResources &res, Timestamps &timestamps, const uint32_t kernelSize, const bool colorize) {
-    SSIMResult result;
+IQM::Bin::InputUpload IQM::Bin::ssim_stage(const SSIMResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
 
-    // copy out
-    const vk::CommandBufferBeginInfo beginInfoCopy = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+void IQM::Bin::ssim_record_compute(const vk::raii::CommandBuffer &cmdBuf, const VulkanInstance &instance, IQM::SSIM &ssim, IQM::Colorize *colorizer, const SSIMResources &res, const bool refResident, const vk::Rect2D &sumRegion, const IQM::Mask &mask, const bool grid) {
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+    const auto blurred = [&](const unsigned i) -> const vk::raii::ImageView * {
+        return i < res.imagesBlurred.size() ? &res.imagesBlurred[i]->imageView : nullptr;
     };
-    instance.cmdBufTransfer()->begin(beginInfoCopy);
 
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageExport->width,
-        .bufferImageHeight = res.imageExport->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageExport->width, res.imageExport->height, 1}
+    auto ssimArgs = IQM::SSIMInput {
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .ivMeanTest = blurred(0),
+        .ivMeanRef = blurred(1),
+        .ivVarTest = blurred(2),
+        .ivVarRef = blurred(3),
+        .ivCovar = blurred(4),
+        .ivOut = res.imageOut != nullptr ? &res.imageOut->imageView : nullptr,
+        .bufMssim = &res.mssimBuf,
+        .width = width,
+        .height = height,
+        .cachedReference = refResident,
+        .sumRegion = sumRegion,
+        .mask = mask,
+        .bufGrid = grid ? &res.gridBuf : nullptr,
+        .gridCell = SCORE_GRID_CELL,
     };
 
-    if (colorize) {
-        instance.cmdBufTransfer()->copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+    ssim.computeMetric(ssimArgs);
+
+    if (res.imageExport == nullptr) {
+        return;
+    }
+
+    if (colorizer != nullptr) {
+        auto colorizerInput = IQM::ColorizeInput{
+            .device = instance.device(),
+            .cmdBuf = &cmdBuf,
+            .ivIn = &res.imageOut->imageView,
+            .ivOut = &res.imageInput->imageView,
+            .ivColormap = &res.imageColorMap->imageView,
+            .invert = true,
+            .width = width,
+            .height = height
+        };
+
+        colorizer->compute(colorizerInput);
     } else {
-        instance.cmdBufTransfer()->copyImageToBuffer(res.imageExport->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+        std::array offsets = {
+            vk::Offset3D{0, 0, 0},
+            vk::Offset3D{static_cast<int>(width), static_cast<int>(height), 1}
+        };
+        // copy RGBA f32 to RGBA u8
+        std::vector region {
+            vk::ImageBlit {
+                .srcSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                .srcOffsets = offsets,
+                .dstSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                .dstOffsets = offsets,
+            }
+        };
+        cmdBuf.blitImage(res.imageOut->image, vk::ImageLayout::eGeneral, res.imageExport->image, vk::ImageLayout::eGeneral, {region}, vk::Filter::eNearest);
     }
+}
 
-    vk::BufferCopy bufCopy{
-        .srcOffset = 0,
-        .dstOffset = sizeof(float) * res.imageExport->width * res.imageExport->height,
-        .size = sizeof(float),
-    };
-    instance.cmdBufTransfer()->copyBuffer(res.mssimBuf, res.stgInput, bufCopy);
+void IQM::Bin::ssim_record_download(const vk::raii::CommandBuffer &cmdBuf, const SSIMResources &res, const bool colorize, const bool grid) {
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+
+    if (res.imageExport != nullptr) {
+        vk::BufferImageCopy copyRegion{
+            .bufferOffset = 0,
+            .bufferRowLength = width,
+            .bufferImageHeight = height,
+            .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+            .imageOffset = vk::Offset3D{0, 0, 0},
+            .imageExtent = vk::Extent3D{width, height, 1}
+        };
+
+        if (colorize) {
+            cmdBuf.copyImageToBuffer(res.imageInput->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+        } else {
+            cmdBuf.copyImageToBuffer(res.imageExport->image, vk::ImageLayout::eGeneral, res.stgInput, copyRegion);
+        }
+    }
 
+    ssim_record_sum_download(cmdBuf, res);
+
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(width, height, SCORE_GRID_CELL);
+        vk::BufferCopy gridCopy{
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = extent.width * extent.height * sizeof(float),
+        };
+        cmdBuf.copyBuffer(res.gridBuf, res.stgInput, gridCopy);
+    }
+}
+
+IQM::Bin::SSIMResult IQM::Bin::ssim_read_back(const SSIMResources &res, const bool grid) {
+    SSIMResult result;
+
+    const auto width = res.imageInput->width;
+    const auto height = res.imageInput->height;
+    void * outBufData = res.stgInputMemory.mapMemory(0, (height * width + 2) * sizeof(float), {});
+    res.stgInputMemory.invalidate();
+    // map is only downloaded with output
+    if (res.imageExport != nullptr) {
+        std::vector<unsigned char> outputData(height * width * 4);
+        memcpy(outputData.data(), outBufData, height * width * 4 * sizeof(unsigned char));
+        result.imageData = std::move(outputData);
+    }
+    if (grid) {
+        const auto extent = IQM::Reduce::gridExtent(width, height, SCORE_GRID_CELL);
+        result.grid.resize(extent.width * extent.height);
+        memcpy(result.grid.data(), outBufData, result.grid.size() * sizeof(float));
+    }
+    result.mssim = (static_cast<float*>(outBufData))[height * width] / (static_cast<float*>(outBufData))[height * width + 1];
+
+    res.stgInputMemory.unmapMemory();
+
+    return result;
+}
+
+IQM::Bin::SSIMResult IQM::Bin::ssim_copy_back(const VulkanInstance &instance, const SSIMResources &res, Timestamps &timestamps, const bool colorize) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    ssim_record_download(*instance.cmdBufTransfer(), res, colorize, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -484,16 +851,8 @@ IQM::Bin::SSIMResult IQM::Bin::ssim_copy_back(const VulkanInstance &instance, co
 
     timestamps.mark("end GPU work");
 
-    const auto offset = kernelSize - 1;
-    std::vector<unsigned char> outputData(res.imageExport->height * res.imageExport->width * 4);
-    void * outBufData = res.stgInputMemory.mapMemory(0, (res.imageExport->height * res.imageExport->width + 1) * sizeof(float), {});
-    memcpy(outputData.data(), outBufData, res.imageExport->height * res.imageExport->width * 4 * sizeof(unsigned char));
-    result.mssim = (static_cast<float*>(outBufData))[res.imageExport->height * res.imageExport->width] / (static_cast<float>(res.imageExport->width - offset) * static_cast<float>(res.imageExport->height - offset));
-
-    res.stgInputMemory.unmapMemory();
+    auto result = ssim_read_back(res, false);
     timestamps.mark("end copy from GPU");
 
-    result.imageData = std::move(outputData);
-
     return result;
 }
@@ -7,56 +7,152 @@
 #define IQM_BIN_SSIM_H
 
 #include <IQM/ssim.h>
+#include <functional>
+#include <IQM/base/colorize.h>
 #include "../../shared/vulkan.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
 #include "../../shared/io.h"
 #include "../../shared/timestamps.h"
+#include "../../shared/tiling.h"
+#include "../../shared/resource_plan.h"
+#include "../../shared/roi.h"
+#include "../../shared/incremental.h"
 #include "../../IQM/args.h"
 #include "../../IQM-profile/args.h"
 
 namespace IQM::Bin {
     struct SSIMResources {
         vk::raii::Buffer stgInput = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
         vk::raii::Buffer stgRef = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
         vk::raii::Buffer stgColormap = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgColormapMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgColormapMemory;
         vk::raii::Buffer mssimBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory mssimMemory = VK_NULL_HANDLE;
+        DeviceAllocation mssimMemory;
+        // MSSIM of each cell of the score grid
+        vk::raii::Buffer gridBuf = VK_NULL_HANDLE;
+        DeviceAllocation gridMemory;
 
         // RGBA u8 input images
         std::shared_ptr<VulkanImage> imageInput;
         std::shared_ptr<VulkanImage> imageRef;
 
-        // 5x R f32 intermediate images
+        // 5x R f32 intermediate images, empty if the method does not use them
         std::vector<std::shared_ptr<VulkanImage>> imagesBlurred;
 
-        // R f32 output image
+        // R f32 output image, R f16 with half precision and without intermediates, only present with intermediates or output map
         std::shared_ptr<VulkanImage> imageOut;
 
-        // R u8 export image
+        // R u8 export image, only present with output map
         std::shared_ptr<VulkanImage> imageExport;
 
-        // RGBA f32 colormap
+        // RGBA f32 colormap, only present with output map
         std::shared_ptr<VulkanImage> imageColorMap;
 
         vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
         vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
         vk::raii::Fence transferFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    // device local resources of `ssim_init_res`, also used to estimate memory of a pair
+    struct SSIMPlan {
+        ResourcePlan resources;
+        unsigned mssimBuf;
+        unsigned gridBuf;
+        unsigned imageInput;
+        unsigned imageRef;
+        std::vector<unsigned> imagesBlurred;
+        std::optional<unsigned> imageOut;
+        std::optional<unsigned> imageExport;
+        std::optional<unsigned> imageColorMap;
     };
 
     struct SSIMResult {
         std::vector<unsigned char> imageData;
+        std::vector<float> grid;
         float mssim;
     };
 
-    void ssim_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+    class SSIMJob : public BatchJob {
+    public:
+        // `shared` and `sharedHalf` provide pipelines reused by jobs of all slots, `sharedColorizer` is null without colorized output
+        SSIMJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<SSIMResources>& pool, const IQM::SSIM& shared, const IQM::Colorize* sharedColorizer, std::function<const IQM::SSIM&()> sharedHalf);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        bool nextPass() override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        void stageTile();
+        [[nodiscard]] vk::Rect2D tileSumRegion() const;
+        // f16 intermediates are used for pairs, which only fit into the memory budget with them
+        [[nodiscard]] bool pairHalfPrecision(unsigned width, unsigned height, bool hasOutput) const;
+        [[nodiscard]] std::optional<unsigned long> pairTileBudget(unsigned width, unsigned height, bool half, bool hasOutput) const;
+        [[nodiscard]] TileMemory tileMemory(bool half, bool hasOutput) const;
+
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<SSIMResources>& pool;
+        // set by `--ssim-precision`
+        bool halfPrecision;
+        IQM::SSIM ssim;
+        // created once a pair falls back to f16 intermediates
+        std::optional<IQM::SSIM> ssimHalf;
+        std::function<const IQM::SSIM&()> sharedHalf;
+        // precision of the current pair
+        bool pairHalf = false;
+        // whether the current pair saves its map
+        bool hasOutput = false;
+        // the score grid is saved instead of the map
+        std::optional<ScoreGridFormat> gridFormat;
+        bool hasGrid = false;
+        std::optional<unsigned long> tileBudget;
+        // set while the current pair is computed in tiles
+        std::optional<TiledPair> tiled;
+        RegionOfInterest roi;
+        Thresholds thresholds;
+        // mask of the current pair, empty without region of interest
+        IQM::Mask pairMask;
+        // set by `--incremental`, unused with shared input
+        std::optional<IncrementalSession> session;
+        // the current pair computes a region of the session
+        bool incrementalPass = false;
+        // only created when output is colorized
+        std::optional<IQM::Colorize> colorizer;
+        std::optional<PooledResource<SSIMResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+    };
+
+
     void ssim_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::SSIM& ssim, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
 
-    SSIMResources ssim_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance& instance);
-    void ssim_upload(const IQM::VulkanInstance& instance, const SSIMResources& res);
-    SSIMResult ssim_copy_back(const IQM::VulkanInstance& instance, const SSIMResources& res, Timestamps &timestamps, uint32_t kernelSize, bool colorize);
+    // reports error of the R f16 output map and MSSIM against R f32 on one pair
+    void ssim_compare_precision(const IQM::VulkanInstance &instance, IQM::SSIM& ssim, IQM::SSIM& ssimHalf, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
+
+    // whether `--ssim-precision fp16` selects R f16 output map, falls back to f32 if the device can't store R f16 images
+    bool ssim_half_precision(const std::unordered_map<std::string, std::string> &options, const IQM::VulkanInstance &instance);
+    // colorization reads R f32 maps, so colorized output keeps the map in f32
+    bool ssim_half_map(const IQM::Bin::Args& args, const IQM::VulkanInstance &instance);
+    SSIMPlan ssim_plan(unsigned width, unsigned height, bool halfPrecision, bool intermediates, bool hasOutput);
+    SSIMResources ssim_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance, bool halfPrecision, bool intermediates, bool hasOutput);
+    InputUpload ssim_stage(const SSIMResources& res, const InputImage &test, const InputImage *ref);
+    void ssim_record_upload(const vk::raii::CommandBuffer& cmdBuf, const SSIMResources& res, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void ssim_upload(const IQM::VulkanInstance& instance, const SSIMResources& res, const InputUpload& upload);
+    void ssim_record_compute(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::SSIM& ssim, IQM::Colorize* colorizer, const SSIMResources& res, bool refResident, const vk::Rect2D &sumRegion, const IQM::Mask& mask, bool grid);
+    // the score grid takes the place of the output map in staging memory, so they can't be downloaded together
+    void ssim_record_download(const vk::raii::CommandBuffer& cmdBuf, const SSIMResources& res, bool colorize, bool grid);
+    SSIMResult ssim_read_back(const SSIMResources& res, bool grid);
+    SSIMResult ssim_copy_back(const IQM::VulkanInstance& instance, const SSIMResources& res, Timestamps &timestamps, bool colorize);
 }
 
 #endif //IQM_BIN_SSIM_H
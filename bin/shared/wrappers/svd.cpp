@@ -5,105 +5,63 @@
 
 #include <iostream>
 #include "svd.h"
+#include "../../shared/roi.h"
+#include "../../shared/incremental.h"
 #include "../../shared/debug_utils.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+
+IQM::Bin::SVDJob::SVDJob(const Args &args, const VulkanInstance &instance, ResourcePool<SVDResources> &pool, const IQM::SVD &shared):
+    args(args),
+    instance(instance),
+    pool(pool),
+    svd(*instance.device(), shared) {
+    // result is a deviation over all blocks, not a mean of pixel values
+    RegionOfInterest::requireUnset(args.options, "SVD");
+    require_no_score_grid(args.options, "SVD");
+    IncrementalSession::requireUnset(args, "SVD");
+}
 
-void IQM::Bin::svd_run(const IQM::Bin::Args &args, const IQM::VulkanInstance &instance, const std::vector<Match> &imageMatches) {
-    IQM::SVD svd(*instance.device());
-
-    int processed = 0;
-
-    for (const auto& match : imageMatches) {
-        try {
-            VulkanResource::resetMemCounter();
-            Timestamps timestamps;
-            auto start = std::chrono::high_resolution_clock::now();
-
-            const auto input = load_image(match.testPath);
-            const auto reference = load_image(match.refPath);
-            if (input.height != reference.height || input.width != reference.width) {
-                throw std::runtime_error("Test and reference images have different sizes");
-            }
-
-            timestamps.mark("images loaded");
-
-            initRenderDoc();
-
-            auto res = svd_init_res(input, reference, instance);
-            timestamps.mark("resources allocated");
-
-            svd_upload(instance, res);
-
-            auto svdArgs = IQM::SVDInput {
-                .device = instance.device(),
-                .cmdBuf = &*instance.cmdBuf(),
-                .ivTest = &res.imageInput->imageView,
-                .ivRef = &res.imageRef->imageView,
-                .ivConvTest = &res.imagesFloat[0]->imageView,
-                .ivConvRef = &res.imagesFloat[1]->imageView,
-                .bufSvd = &res.svdBuf,
-                .bufReduce = &res.reduceBuf,
-                .bufSort = &res.sortBuf,
-                .bufSortTemp = &res.sortTempBuf,
-                .width = input.width,
-                .height = input.height
-            };
-
-            const vk::CommandBufferBeginInfo beginInfo = {
-                .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-            };
-            instance.cmdBuf()->begin(beginInfo);
-
-            svd.computeMetric(svdArgs);
-
-            instance.cmdBuf()->end();
-
-            const std::vector cmdBufs = {
-                &**instance.cmdBuf()
-            };
-
-            auto mask = vk::PipelineStageFlags{vk::PipelineStageFlagBits::eComputeShader};
-            const vk::SubmitInfo submitInfo{
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = &*res.uploadDone,
-                .pWaitDstStageMask = &mask,
-                .commandBufferCount = 1,
-                .pCommandBuffers = *cmdBufs.data(),
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = &*res.computeDone
-            };
-
-            instance.queue()->submit(submitInfo, {});
-            timestamps.mark("submit compute GPU pipeline");
-            // wait so cmd buffer can be reused for GPU -> CPU transfer
-            instance.waitForFence(res.transferFence);
-
-            auto result = svd_copy_back(instance, res, timestamps, input.width/8 * input.height/8);
-
-            finishRenderDoc();
-
-            if (match.outPath.has_value()) {
-                save_float_image(args.outputPath.value(), result.imageData, input.width, input.height);
-            }
-
-            timestamps.mark("output saved");
-
-            const auto end = std::chrono::high_resolution_clock::now();
-            std::cout << match.testPath << ": " << result.msvd << std::endl;
-            if (args.verbose) {
-                timestamps.print(start, end);
-                double mbSize = static_cast<double>(VulkanResource::memCounter()) / 1024 / 1024;
-                std::cout << "VRAM used for resources: " << mbSize << " MB" << std::endl;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to process '" << match.testPath << "': " << e.what() << std::endl;
-            continue;
-        }
+void IQM::Bin::SVDJob::prepare(const DecodedPair &pair) {
+    const ResourceKey key{.method = Method::SVD, .width = pair.test.width, .height = pair.test.height};
+    this->pooled = this->pool.acquire(key, [&] { return svd_init_res(pair.test.width, pair.test.height, this->instance); });
+    this->refResident = hold_reference(this->pooled->res->reference, pair);
+    if (this->sharedInput == nullptr) {
+        this->upload = svd_stage(*this->pooled->res, pair.test, this->refResident ? nullptr : pair.ref.get());
+    }
+}
+
+void IQM::Bin::SVDJob::recordUpload(const vk::raii::CommandBuffer &cmdBuf) {
+    svd_record_upload(cmdBuf, *this->pooled->res, this->upload, this->sharedInput, this->refResident);
+}
+
+void IQM::Bin::SVDJob::recordCompute(const vk::raii::CommandBuffer &cmdBuf) {
+    svd_record_compute(cmdBuf, this->instance, this->svd, *this->pooled->res);
+}
 
-        processed += 1;
+void IQM::Bin::SVDJob::recordDownload(const vk::raii::CommandBuffer &cmdBuf) {
+    const auto &res = *this->pooled->res;
+    svd_record_download(cmdBuf, res, res.imageInput->width/8 * res.imageInput->height/8);
+}
+
+std::vector<IQM::Bin::MetricValue> IQM::Bin::SVDJob::finish(const DecodedPair &pair) {
+    const auto result = svd_read_back(*this->pooled->res, pair.test.width/8 * pair.test.height/8);
+    this->pool.release(std::move(this->pooled.value()));
+    this->pooled.reset();
+
+    if (pair.match.outPath.has_value()) {
+        save_float_image(pair.match.outPath.value(), result.imageData, pair.test.width, pair.test.height);
     }
 
-    std::cout << "Processed " << processed << "/" << imageMatches.size() <<" images" << std::endl;
+    return {MetricValue{.name = "MSVD", .value = result.msvd, .unit = ""}};
+}
+
+unsigned long IQM::Bin::SVDJob::resourceSize() const {
+    return this->pooled.has_value() ? this->pooled->size : 0;
+}
+
+unsigned long IQM::Bin::SVDJob::estimateSize(const DecodedPair &pair) const {
+    return svd_plan(pair.test.width, pair.test.height).resources.estimate();
 }
 
 void IQM::Bin::svd_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::SVD &svd, const IQM::Bin::InputImage &input, const IQM::Bin::InputImage &ref) {
@@ -116,32 +74,18 @@ void IQM::Bin::svd_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIns
 
         initRenderDoc();
 
-        auto res = svd_init_res(input, ref, instance);
+        auto res = svd_init_res(input.width, input.height, instance);
+        const auto upload = svd_stage(res, input, &ref);
         timestamps.mark("resources allocated");
 
-        svd_upload(instance, res);
-
-        auto svdArgs = IQM::SVDInput {
-            .device = instance.device(),
-            .cmdBuf = &*instance.cmdBuf(),
-            .ivTest = &res.imageInput->imageView,
-            .ivRef = &res.imageRef->imageView,
-            .ivConvTest = &res.imagesFloat[0]->imageView,
-            .ivConvRef = &res.imagesFloat[1]->imageView,
-            .bufSvd = &res.svdBuf,
-            .bufReduce = &res.reduceBuf,
-            .bufSort = &res.sortBuf,
-            .bufSortTemp = &res.sortTempBuf,
-            .width = input.width,
-            .height = input.height
-        };
+        svd_upload(instance, res, upload);
 
         const vk::CommandBufferBeginInfo beginInfo = {
             .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
         };
         instance.cmdBuf()->begin(beginInfo);
 
-        svd.computeMetric(svdArgs);
+        svd_record_compute(*instance.cmdBuf(), instance, svd, res);
 
         instance.cmdBuf()->end();
 
@@ -185,74 +129,15 @@ void IQM::Bin::svd_run_single(const IQM::ProfileArgs &args, const IQM::VulkanIns
     }
 }
 
-IQM::Bin::SVDResources IQM::Bin::svd_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance &instance) {
-    // always 4 channels on input, with 1B per channel
-    const auto size = (test.width * test.height) * 4;
-    const auto downSize = (test.width/8 * test.height/8) * 4;
-    const auto downSizeSvd = (test.width/8 * test.height/8) * 4 * 8 * 2;
-    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostCached
-    );
-    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
-    *instance.device(),
-    *instance.physicalDevice(),
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    auto [svdBuf, svdMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        downSizeSvd,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    auto [reduceBuf, reduceMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        downSize,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    auto [sortBuf, sortMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        downSize,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-    auto [sortTempBuf, sortTempMem] = VulkanResource::createBuffer(
-        *instance.device(),
-        *instance.physicalDevice(),
-        downSize,
-        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
-    );
-
-    stgBuf.bindMemory(stgMem, 0);
-    stgRefBuf.bindMemory(stgRefMem, 0);
-    svdBuf.bindMemory(svdMem, 0);
-    reduceBuf.bindMemory(reduceMem, 0);
-    sortBuf.bindMemory(sortMem, 0);
-    sortTempBuf.bindMemory(sortTempMem, 0);
-
-    void * inBufData = stgMem.mapMemory(0, size, {});
-    memcpy(inBufData, test.data.data(), size);
-    stgMem.unmapMemory();
-
-    inBufData = stgRefMem.mapMemory(0, size, {});
-    memcpy(inBufData, ref.data.data(), size);
-    stgRefMem.unmapMemory();
+IQM::Bin::SVDPlan IQM::Bin::svd_plan(const unsigned width, const unsigned height) {
+    const auto downSize = (width/8 * height/8) * 4;
+    const auto downSizeSvd = (width/8 * height/8) * 4 * 8 * 2;
 
     vk::ImageCreateInfo srcImageInfo = {
         .flags = {},
         .imageType = vk::ImageType::e2D,
         .format = vk::Format::eR8G8B8A8Unorm,
-        .extent = vk::Extent3D(test.width, test.height, 1),
+        .extent = vk::Extent3D(width, height, 1),
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
@@ -268,16 +153,48 @@ IQM::Bin::SVDResources IQM::Bin::svd_init_res(const InputImage &test, const Inpu
     intermediateImageInfo.usage = vk::ImageUsageFlagBits::eStorage;
     intermediateImageInfo.format = vk::Format::eR32Sfloat;
 
-    vk::ImageCreateInfo dstImageInfo = {srcImageInfo};
-    dstImageInfo.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc;
-    dstImageInfo.format = vk::Format::eR32Sfloat;
+    const auto bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    SVDPlan plan;
+    plan.svdBuf = plan.resources.buffer(downSizeSvd, bufferUsage);
+    plan.reduceBuf = plan.resources.buffer(downSize, bufferUsage);
+    plan.sortBuf = plan.resources.buffer(downSize, bufferUsage);
+    plan.sortTempBuf = plan.resources.buffer(downSize, bufferUsage);
+    plan.imageInput = plan.resources.hostImage(srcImageInfo);
+    plan.imageRef = plan.resources.hostImage(srcImageInfo);
+    for (int i = 0; i < 2; i++) {
+        plan.imagesFloat.push_back(plan.resources.image(intermediateImageInfo));
+    }
+    return plan;
+}
 
-    auto const imageInput = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto const imageRef = std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), srcImageInfo));
-    auto imagesFloat = std::vector<std::shared_ptr<VulkanImage>>();
+IQM::Bin::SVDResources IQM::Bin::svd_init_res(const unsigned width, const unsigned height, const IQM::VulkanInstance &instance) {
+    // always 4 channels on input, with 1B per channel
+    const auto size = (width * height) * 4;
+    auto [stgBuf, stgMem] = VulkanResource::createBuffer(
+        *instance.device(),
+        *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        VulkanResource::hostReadMemory(*instance.physicalDevice())
+    );
+    auto [stgRefBuf, stgRefMem] = VulkanResource::createBuffer(
+    *instance.device(),
+    *instance.physicalDevice(),
+        size,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
 
-    for (int i = 0; i < 2; i++) {
-        imagesFloat.emplace_back(std::make_shared<VulkanImage>(VulkanResource::createImage(*instance.device(), *instance.physicalDevice(), intermediateImageInfo)));
+    const auto plan = svd_plan(width, height);
+    auto planned = plan.resources.create(*instance.device(), *instance.physicalDevice());
+    auto [svdBuf, svdMem] = planned.takeBuffer(plan.svdBuf);
+    auto [reduceBuf, reduceMem] = planned.takeBuffer(plan.reduceBuf);
+    auto [sortBuf, sortMem] = planned.takeBuffer(plan.sortBuf);
+    auto [sortTempBuf, sortTempMem] = planned.takeBuffer(plan.sortTempBuf);
+
+    auto imagesFloat = std::vector<std::shared_ptr<VulkanImage>>();
+    for (const auto index : plan.imagesFloat) {
+        imagesFloat.push_back(planned.image(index));
     }
 
     return SVDResources{
@@ -293,8 +210,8 @@ IQM::Bin::SVDResources IQM::Bin::svd_init_res(const InputImage &test, const Inpu
         .sortMemory = std::move(sortMem),
         .sortTempBuf = std::move(sortTempBuf),
         .sortTempMemory = std::move(sortTempMem),
-        .imageInput = imageInput,
-        .imageRef = imageRef,
+        .imageInput = planned.image(plan.imageInput),
+        .imageRef = planned.image(plan.imageRef),
         .imagesFloat = imagesFloat,
         .uploadDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
         .computeDone = instance.device()->createSemaphore(vk::SemaphoreCreateInfo{}),
@@ -302,32 +219,28 @@ IQM::Bin::SVDResources IQM::Bin::svd_init_res(const InputImage &test, const Inpu
     };
 }
 
-void IQM::Bin::svd_upload(const IQM::VulkanInstance &instance, const SVDResources &res) {
-    const vk::CommandBufferBeginInfo beginInfo = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
-    };
-    instance.cmdBufTransfer()->begin(beginInfo);
-
+void IQM::Bin::svd_record_upload(const vk::raii::CommandBuffer &cmdBuf, const SVDResources &res, const InputUpload &upload, const SharedInput *shared, const bool refResident) {
     std::vector imagesToInit = {
         res.imageInput,
-        res.imageRef,
     };
 
+    if (!refResident) {
+        imagesToInit.push_back(res.imageRef);
+    }
+
     imagesToInit.insert(imagesToInit.end(), res.imagesFloat.begin(), res.imagesFloat.end());
 
-    VulkanResource::initImages(*instance.cmdBufTransfer(), imagesToInit);
+    VulkanResource::initImages(cmdBuf, imagesToInit);
 
-    vk::BufferImageCopy copyRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = res.imageInput->width,
-        .bufferImageHeight = res.imageInput->height,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{res.imageInput->width, res.imageInput->height, 1}
-    };
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgInput, res.imageInput->image,  vk::ImageLayout::eGeneral, copyRegion);
-    instance.cmdBufTransfer()->copyBufferToImage(res.stgRef, res.imageRef->image,  vk::ImageLayout::eGeneral, copyRegion);
+    record_input_upload(cmdBuf, upload, *res.imageInput, *res.imageRef, shared, refResident);
+}
 
+void IQM::Bin::svd_upload(const IQM::VulkanInstance &instance, const SVDResources &res, const InputUpload &upload) {
+    const vk::CommandBufferBeginInfo beginInfo = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfo);
+    svd_record_upload(*instance.cmdBufTransfer(), res, upload, nullptr, false);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -341,31 +254,71 @@ void IQM::Bin::svd_upload(const IQM::VulkanInstance &instance, const SVDResource
         .pSignalSemaphores = &*res.uploadDone
     };
 
+    // fence is reused, when resources come from pool
+    instance.device()->resetFences({*res.transferFence});
     instance.queueTransfer()->submit(submitInfoCopy, res.transferFence);
 }
 
-IQM::Bin::SVDResult IQM::Bin::svd_copy_back(const IQM::VulkanInstance &instance, const SVDResources &res, Timestamps &timestamps, uint32_t pixelCount) {
-    SVDResult result;
+IQM::Bin::InputUpload IQM::Bin::svd_stage(const SVDResources &res, const InputImage &test, const InputImage *ref) {
+    return stage_input(res.stgInput, res.stgInputMemory, res.stgRef, res.stgRefMemory, *res.imageInput, *res.imageRef, test, ref);
+}
 
-    // copy out
-    const vk::CommandBufferBeginInfo beginInfoCopy = {
-        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+void IQM::Bin::svd_record_compute(const vk::raii::CommandBuffer &cmdBuf, const IQM::VulkanInstance &instance, IQM::SVD &svd, const SVDResources &res) {
+    auto svdArgs = IQM::SVDInput {
+        .device = instance.device(),
+        .cmdBuf = &cmdBuf,
+        .ivTest = &res.imageInput->imageView,
+        .ivRef = &res.imageRef->imageView,
+        .ivConvTest = &res.imagesFloat[0]->imageView,
+        .ivConvRef = &res.imagesFloat[1]->imageView,
+        .bufSvd = &res.svdBuf,
+        .bufReduce = &res.reduceBuf,
+        .bufSort = &res.sortBuf,
+        .bufSortTemp = &res.sortTempBuf,
+        .width = res.imageInput->width,
+        .height = res.imageInput->height
     };
-    instance.cmdBufTransfer()->begin(beginInfoCopy);
 
+    svd.computeMetric(svdArgs);
+}
+
+void IQM::Bin::svd_record_download(const vk::raii::CommandBuffer &cmdBuf, const SVDResources &res, uint32_t pixelCount) {
     vk::BufferCopy copyRegion{
         .srcOffset = 0,
         .dstOffset = 0,
         .size = sizeof(float) * pixelCount,
     };
-    instance.cmdBufTransfer()->copyBuffer(res.reduceBuf, res.stgInput, copyRegion);
+    cmdBuf.copyBuffer(res.reduceBuf, res.stgInput, copyRegion);
     vk::BufferCopy bufCopy{
         .srcOffset = 0,
         .dstOffset = sizeof(float) * pixelCount,
         .size = sizeof(float),
     };
-    instance.cmdBufTransfer()->copyBuffer(res.sortTempBuf, res.stgInput, bufCopy);
+    cmdBuf.copyBuffer(res.sortTempBuf, res.stgInput, bufCopy);
+}
+
+IQM::Bin::SVDResult IQM::Bin::svd_read_back(const SVDResources &res, uint32_t pixelCount) {
+    SVDResult result;
+
+    std::vector<float> outputData(pixelCount);
+    void * outBufData = res.stgInputMemory.mapMemory(0, (pixelCount + 1) * sizeof(float), {});
+    res.stgInputMemory.invalidate();
+    memcpy(outputData.data(), outBufData, pixelCount * sizeof(float));
+    result.msvd = (static_cast<float*>(outBufData))[pixelCount];
+    res.stgInputMemory.unmapMemory();
+
+    result.imageData = std::move(outputData);
+
+    return result;
+}
 
+IQM::Bin::SVDResult IQM::Bin::svd_copy_back(const IQM::VulkanInstance &instance, const SVDResources &res, Timestamps &timestamps, uint32_t pixelCount) {
+    // copy out
+    const vk::CommandBufferBeginInfo beginInfoCopy = {
+        .flags = vk::CommandBufferUsageFlags{vk::CommandBufferUsageFlagBits::eOneTimeSubmit},
+    };
+    instance.cmdBufTransfer()->begin(beginInfoCopy);
+    svd_record_download(*instance.cmdBufTransfer(), res, pixelCount);
     instance.cmdBufTransfer()->end();
 
     const std::vector cmdBufsCopy = {
@@ -388,14 +341,8 @@ IQM::Bin::SVDResult IQM::Bin::svd_copy_back(const IQM::VulkanInstance &instance,
 
     timestamps.mark("end GPU work");
 
-    std::vector<float> outputData(pixelCount);
-    void * outBufData = res.stgInputMemory.mapMemory(0, (pixelCount + 1) * sizeof(float), {});
-    memcpy(outputData.data(), outBufData, pixelCount * sizeof(float));
-    result.msvd = (static_cast<float*>(outBufData))[pixelCount];
-    res.stgInputMemory.unmapMemory();
+    auto result = svd_read_back(res, pixelCount);
     timestamps.mark("end copy from GPU");
 
-    result.imageData = std::move(outputData);
-
     return result;
 }
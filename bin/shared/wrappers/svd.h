@@ -9,25 +9,28 @@
 #include <IQM/svd.h>
 #include "../../shared/vulkan.h"
 #include "../../shared/vulkan_res.h"
+#include "../../shared/resource_pool.h"
+#include "../../shared/executor.h"
 #include "../../shared/io.h"
 #include "../../shared/timestamps.h"
+#include "../../shared/resource_plan.h"
 #include "../../IQM/args.h"
 #include "../../IQM-profile/args.h"
 
 namespace IQM::Bin {
     struct SVDResources {
         vk::raii::Buffer stgInput = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgInputMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgInputMemory;
         vk::raii::Buffer stgRef = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory stgRefMemory = VK_NULL_HANDLE;
+        DeviceAllocation stgRefMemory;
         vk::raii::Buffer svdBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory svdMemory = VK_NULL_HANDLE;
+        DeviceAllocation svdMemory;
         vk::raii::Buffer reduceBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory reduceMemory = VK_NULL_HANDLE;
+        DeviceAllocation reduceMemory;
         vk::raii::Buffer sortBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory sortMemory = VK_NULL_HANDLE;
+        DeviceAllocation sortMemory;
         vk::raii::Buffer sortTempBuf = VK_NULL_HANDLE;
-        vk::raii::DeviceMemory sortTempMemory = VK_NULL_HANDLE;
+        DeviceAllocation sortTempMemory;
 
         // RGBA u8 input images
         std::shared_ptr<VulkanImage> imageInput;
@@ -39,6 +42,21 @@ namespace IQM::Bin {
         vk::raii::Semaphore uploadDone = VK_NULL_HANDLE;
         vk::raii::Semaphore computeDone = VK_NULL_HANDLE;
         vk::raii::Fence transferFence = VK_NULL_HANDLE;
+
+        // pinned reference held in `imageRef`
+        std::shared_ptr<const ReferenceHandle> reference;
+    };
+
+    // device local resources of `svd_init_res`, also used to estimate memory of a pair
+    struct SVDPlan {
+        ResourcePlan resources;
+        unsigned svdBuf;
+        unsigned reduceBuf;
+        unsigned sortBuf;
+        unsigned sortTempBuf;
+        unsigned imageInput;
+        unsigned imageRef;
+        std::vector<unsigned> imagesFloat;
     };
 
     struct SVDResult {
@@ -46,11 +64,38 @@ namespace IQM::Bin {
         float msvd;
     };
 
-    void svd_run(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, const std::vector<Match>& imageMatches);
+    class SVDJob : public BatchJob {
+    public:
+        // `shared` provides pipelines reused by jobs of all slots
+        SVDJob(const IQM::Bin::Args& args, const IQM::VulkanInstance& instance, ResourcePool<SVDResources>& pool, const IQM::SVD& shared);
+        void prepare(const DecodedPair &pair) override;
+        void recordUpload(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordCompute(const vk::raii::CommandBuffer &cmdBuf) override;
+        void recordDownload(const vk::raii::CommandBuffer &cmdBuf) override;
+        std::vector<MetricValue> finish(const DecodedPair &pair) override;
+        [[nodiscard]] unsigned long resourceSize() const override;
+        [[nodiscard]] unsigned long estimateSize(const DecodedPair &pair) const override;
+    private:
+        const IQM::Bin::Args& args;
+        const IQM::VulkanInstance& instance;
+        ResourcePool<SVDResources>& pool;
+        IQM::SVD svd;
+        std::optional<PooledResource<SVDResources>> pooled;
+        InputUpload upload;
+        bool refResident = false;
+    };
+
+
     void svd_run_single(const IQM::ProfileArgs &args, const IQM::VulkanInstance &instance, IQM::SVD& svd, const IQM::Bin::InputImage& input, const IQM::Bin::InputImage& ref);
 
-    SVDResources svd_init_res(const InputImage &test, const InputImage &ref, const IQM::VulkanInstance& instance);
-    void svd_upload(const IQM::VulkanInstance& instance, const SVDResources& res);
+    SVDPlan svd_plan(unsigned width, unsigned height);
+    SVDResources svd_init_res(unsigned width, unsigned height, const IQM::VulkanInstance& instance);
+    InputUpload svd_stage(const SVDResources& res, const InputImage &test, const InputImage *ref);
+    void svd_record_upload(const vk::raii::CommandBuffer& cmdBuf, const SVDResources& res, const InputUpload& upload, const SharedInput* shared, bool refResident);
+    void svd_upload(const IQM::VulkanInstance& instance, const SVDResources& res, const InputUpload& upload);
+    void svd_record_compute(const vk::raii::CommandBuffer& cmdBuf, const IQM::VulkanInstance& instance, IQM::SVD& svd, const SVDResources& res);
+    void svd_record_download(const vk::raii::CommandBuffer& cmdBuf, const SVDResources& res, uint32_t pixelCount);
+    SVDResult svd_read_back(const SVDResources& res, uint32_t pixelCount);
     SVDResult svd_copy_back(const IQM::VulkanInstance& instance, const SVDResources& res, Timestamps &timestamps, uint32_t pixelCount);
 }
 
@@ -25,4 +25,9 @@ for i in $files; do
   path=${path%.glsl}
   # compile shaders to files which are then included
   glslc "$i" -o "shaders_out/$path.inc" -mfmt=c --target-env=vulkan1.2
+  # shaders with configurable map format also get a half precision variant
+  grep "MAP_FORMAT" $i >> /dev/null
+  if [[ $? = 0 ]]; then
+    glslc "$i" -o "shaders_out/${path}_fp16.inc" -mfmt=c --target-env=vulkan1.2 -DMAP_FORMAT=r16f
+  fi
 done
@@ -6,6 +6,7 @@
 #define IQM_COLORIZE_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
 
 namespace IQM {
     struct ColorizeInput {
@@ -31,14 +32,22 @@ namespace IQM {
      */
     class Colorize {
     public:
-        explicit Colorize(const vk::raii::Device &device);
+        explicit Colorize(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        Colorize(const vk::raii::Device &device, const Colorize &other);
         void compute(const ColorizeInput& input);
     private:
-        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+        void allocateDescriptors(const vk::raii::Device &device);
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
     };
 }
@@ -0,0 +1,58 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+#ifndef IQM_DOWNSAMPLE_H
+#define IQM_DOWNSAMPLE_H
+
+#include <IQM/base/vulkan_runtime.h>
+#include <memory>
+
+namespace IQM {
+    /**
+     * Input parameters for a mip chain of a test and reference image.
+     *
+     * Source views `ivTest` and `ivRef` are expected to be views into RGBA u8 images of WxH.
+     * Level views `ivLevelsTest` and `ivLevelsRef` are RGBA u8 images as well, view `i` holds mip level `i + 1`
+     * with dimensions `(W >> (i + 1))x(H >> (i + 1))`. All images should be in layout GENERAL.
+     */
+    struct DownsampleInput {
+        const vk::raii::Device *device;
+        const vk::raii::CommandBuffer *cmdBuf;
+        const vk::raii::ImageView *ivTest, *ivRef;
+        std::vector<const vk::raii::ImageView *> ivLevelsTest, ivLevelsRef;
+        unsigned width, height;
+    };
+
+    /**
+     * Mip chain of an image pair, each level is a 2x2 average of the previous one.
+     *
+     * Levels are averaged in the encoded RGBA u8 values, the same way a metric sees the inputs.
+     * The last level is followed by a barrier, so it can be read by both shaders and transfers.
+     */
+    class Downsample {
+    public:
+        explicit Downsample(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        Downsample(const vk::raii::Device &device, const Downsample &other);
+        void compute(const DownsampleInput& input);
+
+        static constexpr unsigned MAX_LEVELS = 8;
+    private:
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+        void allocateDescriptors(const vk::raii::Device &device);
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        // level i to level i + 1
+        std::vector<vk::raii::DescriptorSet> descSets;
+    };
+}
+
+#endif //IQM_DOWNSAMPLE_H
@@ -0,0 +1,32 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_MASK_H
+#define IQM_MASK_H
+
+#include <IQM/base/vulkan_runtime.h>
+
+namespace IQM {
+    /**
+     * Optional region of interest of a metric.
+     *
+     * `buffer` holds one f32 weight per pixel of the resolution the metric is evaluated at, in row major order.
+     * Final reduction of the metric is weighted by it, pixels with zero weight don't contribute at all.
+     * `bounds` must contain all pixels with nonzero weight, work outside of it may be skipped.
+     * Weights must not all be zero.
+     *
+     * A list of rectangles is expressed as a mask with weight 1 inside of them.
+     */
+    struct Mask {
+        const vk::raii::Buffer *buffer = nullptr;
+        vk::Rect2D bounds = {};
+
+        [[nodiscard]] bool enabled() const {
+            return this->buffer != nullptr;
+        }
+    };
+}
+
+#endif //IQM_MASK_H
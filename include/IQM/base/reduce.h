@@ -0,0 +1,115 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+#ifndef IQM_REDUCE_H
+#define IQM_REDUCE_H
+
+#include <IQM/base/vulkan_runtime.h>
+#include <memory>
+
+namespace IQM {
+    enum class ReduceOp {
+        Sum = 0,
+        Min = 1,
+        Max = 2,
+        // sum divided by the number of elements
+        Mean = 3,
+        SumOfSquares = 4,
+        // sum of values multiplied by weights bound by `Reduce::setUpDescriptors`, divided by the sum of the weights
+        WeightedMean = 5,
+    };
+
+    /**
+     * Input parameters for reduction of f32 arrays in the buffer bound by `Reduce::setUpDescriptors`.
+     *
+     * Reduces `count` arrays of `size` elements, the first one starts at element `offset`
+     * and each next one `stride` elements after the start of the previous one.
+     *
+     * Result of each array is written over its first element,
+     * rest of the array is partially overwritten by intermediate results.
+     *
+     * Element `i` of each array is weighted by weight `i` in the weighted mean.
+     * Elements with zero weight are skipped, so they may hold any value.
+     */
+    struct ReduceInput {
+        const vk::raii::CommandBuffer *cmdBuf;
+        ReduceOp op = ReduceOp::Sum;
+        unsigned size;
+        unsigned offset = 0;
+        unsigned count = 1;
+        unsigned stride = 0;
+    };
+
+    // source of the weights of `ReduceGridInput`
+    enum class GridWeights {
+        // each element has weight 1
+        None = 0,
+        // weights bound by `Reduce::setUpDescriptors`, as in the weighted mean
+        Buffer = 1,
+        // elements are already weighted sums, sums of their weights start at element `weightOffset` of the reduced buffer
+        Sums = 2,
+    };
+
+    /**
+     * Input parameters for a grid of means of a `width`x`height` f32 array,
+     * stored row by row at element `offset` of the buffer bound by `Reduce::setUpDescriptors`.
+     *
+     * Each `cell`x`cell` square of the array is averaged into one value of the buffer bound by `Reduce::setUpGrid`,
+     * the grid has `Reduce::gridExtent` cells stored row by row. Cells whose weights are all zero are NaN.
+     * The array itself is left unchanged, so it can be reduced afterwards.
+     */
+    struct ReduceGridInput {
+        const vk::raii::CommandBuffer *cmdBuf;
+        unsigned width, height;
+        unsigned cell;
+        unsigned offset = 0;
+        GridWeights weights = GridWeights::None;
+        unsigned weightOffset = 0;
+    };
+
+    /**
+     * Parallel in-place reduction used by all methods.
+     *
+     * Workgroups reduce with subgroup arithmetic, only results of subgroups go through shared memory.
+     * Arrays which one workgroup can reduce in a single pass take one dispatch,
+     * larger ones take two: first a bounded number of workgroups reduce contiguous chunks,
+     * each storing its result over the first element of its chunk, then one workgroup reduces these.
+     * Dispatches are followed by a barrier, so the results can be read by both shaders and transfers.
+     */
+    class Reduce {
+    public:
+        explicit Reduce(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        Reduce(const vk::raii::Device &device, const Reduce &other);
+        // binds `range` bytes from the start of `buffer`, must be called before recording reductions
+        void setUpDescriptors(const vk::raii::Device &device, const vk::raii::Buffer &buffer, vk::DeviceSize range) const;
+        // also binds `weightRange` bytes of f32 weights from the start of `weights` for `ReduceOp::WeightedMean`
+        void setUpDescriptors(const vk::raii::Device &device, const vk::raii::Buffer &buffer, vk::DeviceSize range, const vk::raii::Buffer &weights, vk::DeviceSize weightRange) const;
+        // binds `range` bytes from the start of `grid` as the output of `Reduce::grid`
+        void setUpGrid(const vk::raii::Device &device, const vk::raii::Buffer &grid, vk::DeviceSize range) const;
+        void reduce(const ReduceInput& input) const;
+        void grid(const ReduceGridInput& input) const;
+
+        static vk::Extent2D gridExtent(unsigned width, unsigned height, unsigned cell);
+    private:
+        void dispatch(const ReduceInput& input, unsigned size, unsigned step, unsigned chunk, unsigned groups, unsigned pass) const;
+        static void barrier(const vk::raii::CommandBuffer &cmdBuf);
+
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineGrid = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+        void allocateDescriptors(const vk::raii::Device &device);
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
+    };
+}
+
+#endif //IQM_REDUCE_H
@@ -22,7 +22,15 @@ namespace IQM::GPU {
         [[nodiscard]] static vk::raii::Pipeline createComputePipeline(
             const vk::raii::Device &device,
             const vk::raii::ShaderModule &shader,
-            const vk::raii::PipelineLayout &layout);
+            const vk::raii::PipelineLayout &layout,
+            const vk::raii::PipelineCache *cache = nullptr);
+        // pipeline with specialization constants set by `specInfo`
+        [[nodiscard]] static vk::raii::Pipeline createComputePipeline(
+            const vk::raii::Device &device,
+            const vk::raii::ShaderModule &shader,
+            const vk::raii::PipelineLayout &layout,
+            const vk::SpecializationInfo &specInfo,
+            const vk::raii::PipelineCache *cache = nullptr);
         [[nodiscard]] static vk::raii::DescriptorPool createDescPool(
             const vk::raii::Device &device,
             uint32_t maxSets,
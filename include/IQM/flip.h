@@ -8,6 +8,9 @@
 
 #include <IQM/flip/color_pipeline.h>
 #include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/reduce.h>
+#include <IQM/base/mask.h>
+#include <memory>
 
 namespace IQM {
     struct FLIPArguments {
@@ -25,6 +28,14 @@ namespace IQM {
      * `ivFeatFilter` should be in RGBA f32 format with dimensions Kx1 where K is returned from `featureKernelSize`.
      *  `buffer` must be of size WxHx52 B
      * All images should be in layout GENERAL.
+     *
+     * After the computation, sum of the error map is on the zero-th index of `buffer`.
+     * Only `sumRegion` of the map is summed, if its extent is not empty.
+     * With a `mask` the zero-th index holds the mean of the error map weighted by it instead,
+     * `sumRegion` can't be combined with it.
+     *
+     * If `bufGrid` is not null, the mean error of each `gridCell`x`gridCell` square of the whole map
+     * is stored there, laid out as described by `ReduceGridInput`.
      */
     struct FLIPInput {
         const FLIPArguments args;
@@ -34,11 +45,17 @@ namespace IQM {
         const vk::raii::Image *imgOut;
         const vk::raii::Buffer *buffer;
         unsigned width, height;
+        vk::Rect2D sumRegion = {};
+        Mask mask = {};
+        const vk::raii::Buffer *bufGrid = nullptr;
+        unsigned gridCell = 64;
     };
 
     class FLIP {
     public:
-        explicit FLIP(const vk::raii::Device &device);
+        explicit FLIP(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        FLIP(const vk::raii::Device &device, const FLIP &other);
         void computeMetric(const FLIPInput& input);
 
         float static pixelsPerDegree(const FLIPArguments &args);
@@ -53,40 +70,44 @@ namespace IQM {
         void computeMean(const FLIPInput& input);
         void setUpDescriptors(const FLIPInput& input);
 
+        void allocateDescriptors(const vk::raii::Device &device);
+
+        struct Pipelines {
+            vk::raii::PipelineLayout inputConvertLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline inputConvertPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout inputConvertDescSetLayout = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout featureFilterCreateLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline featureFilterCreatePipeline = VK_NULL_HANDLE;
+            vk::raii::Pipeline featureFilterNormalizePipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout featureFilterCreateDescSetLayout = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout featureFilterHorizontalLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline featureFilterHorizontalPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout featureFilterHorizontalDescSetLayout = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout featureDetectLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline featureDetectPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout featureDetectDescSetLayout = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout errorCombineLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline errorCombinePipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout errorCombineDescSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
 
         FLIPColorPipeline colorPipeline;
+        Reduce reduce;
 
-        vk::raii::PipelineLayout inputConvertLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline inputConvertPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout inputConvertDescSetLayout = VK_NULL_HANDLE;
         vk::raii::DescriptorSet inputConvertDescSet = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout featureFilterCreateLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline featureFilterCreatePipeline = VK_NULL_HANDLE;
-        vk::raii::Pipeline featureFilterNormalizePipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout featureFilterCreateDescSetLayout = VK_NULL_HANDLE;
         vk::raii::DescriptorSet featureFilterCreateDescSet = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout featureFilterHorizontalLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline featureFilterHorizontalPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout featureFilterHorizontalDescSetLayout = VK_NULL_HANDLE;
         vk::raii::DescriptorSet featureFilterHorizontalDescSet = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout featureDetectLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline featureDetectPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout featureDetectDescSetLayout = VK_NULL_HANDLE;
         vk::raii::DescriptorSet featureDetectDescSet = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout errorCombineLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline errorCombinePipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout errorCombineDescSetLayout = VK_NULL_HANDLE;
         vk::raii::DescriptorSet errorCombineDescSet = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout sumLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline sumPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout sumDescSetLayout = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet sumDescSet = VK_NULL_HANDLE;
     };
 }
 
@@ -7,27 +7,49 @@
 #define IQM_FLIP_COLORPIPELINE_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <map>
+#include <memory>
 
 namespace IQM {
     struct FLIPInput;
 
     class FLIPColorPipeline {
     public:
-        explicit FLIPColorPipeline(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FLIPColorPipeline(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors from `descPool`
+        FLIPColorPipeline(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FLIPColorPipeline &other);
         void prefilter(const FLIPInput& input, float pixels_per_degree);
         void computeErrorMap(const FLIPInput& input);
 
         void setUpDescriptors(const FLIPInput& input);
     private:
-        vk::raii::PipelineLayout csfPrefilterLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline csfPrefilterPipeline = VK_NULL_HANDLE;
-        vk::raii::Pipeline csfPrefilterHorizontalPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        // prefilter pipelines specialized for one pixels per degree value
+        struct PrefilterPipelines {
+            vk::raii::Pipeline horizontal = VK_NULL_HANDLE;
+            vk::raii::Pipeline vertical = VK_NULL_HANDLE;
+        };
+        const PrefilterPipelines& specializedPrefilter(const FLIPInput& input, float pixels_per_degree);
+
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+
+        struct Pipelines {
+            // used for pipelines created on demand, so it must outlive the method
+            const vk::raii::PipelineCache *pipelineCache = nullptr;
+
+            vk::raii::PipelineLayout csfPrefilterLayout = VK_NULL_HANDLE;
+            // created on first use of each pixels per degree value
+            std::map<float, PrefilterPipelines> prefilterPipelines;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout spatialDetectLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline spatialDetectPipeline = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet csfPrefilterDescSet = VK_NULL_HANDLE;
         vk::raii::DescriptorSet csfPrefilterHorizontalDescSet = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout spatialDetectLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline spatialDetectPipeline = VK_NULL_HANDLE;
         vk::raii::DescriptorSet spatialDetectDescSet = VK_NULL_HANDLE;
     };
 }
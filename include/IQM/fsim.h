@@ -8,6 +8,7 @@
 #include <vkFFT.h>
 
 #include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/mask.h>
 #include <IQM/fsim/log_gabor.h>
 #include <IQM/fsim/angular_filter.h>
 #include <IQM/fsim/estimate_energy.h>
@@ -17,11 +18,30 @@
 #include <IQM/fsim/phase_congruency.h>
 #include <IQM/fsim/sum_filter_responses.h>
 #include <IQM/fsim/partitions.h>
+#include <memory>
 
 namespace IQM {
     constexpr int FSIM_ORIENTATIONS = 4;
     constexpr int FSIM_SCALES = 4;
 
+    /**
+     * Passes of `FSIM::computeMetric` in recording order, used to describe lifetimes of intermediate resources.
+     */
+    enum class FSIMStep : unsigned {
+        Downscale,
+        LogGabor,
+        AngularFilter,
+        Fft,
+        FilterCombinations,
+        InverseFft,
+        SumFilterResponses,
+        NoisePower,
+        EstimateEnergy,
+        GradientMap,
+        PhaseCongruency,
+        FinalMultiply,
+    };
+
     /**
      * ## Images with format RGBA u8 | (WxH)
      * - *ivTest, *ivRef
@@ -39,9 +59,22 @@ namespace IQM {
      * `bufFft` must have size D(WxH) x sizeof(float) x 4
      * `bufIfft` must have size D(WxH) x sizeof(float) x 96
      *
+     * ## Lifetimes
+     * Contents of some resources are only needed between certain passes (see `FSIMStep`):
+     * - *ivTest, *ivRef: Downscale
+     * - *ivTempFloat[4]: AngularFilter - FilterCombinations
+     * - *ivFilterResponsesTest, *ivFilterResponsesRef: SumFilterResponses - PhaseCongruency
+     *
+     * These images are transitioned from undefined layout to general before their first write,
+     * so they may share memory with each other, as long as their lifetimes don't overlap.
+     * All other resources are used from their first pass until the end.
+     *
      * After finishing, output values FSIM and FSIM can be computed from values in `bufFft`:
      *  - FSIM = bufFft[1] / bufFft[0];
      *  - FSIMc = bufFft[2] / bufFft[0];
+     *
+     * The optional `mask` weights pixels of the downscaled images, so it has D(WxH) weights.
+     * With it the three values are weighted means instead of sums, which leaves their ratios valid.
      */
     struct FSIMInput {
         const vk::raii::Device *device;
@@ -56,34 +89,59 @@ namespace IQM {
         const vk::raii::ImageView *ivFilterResponsesRef[FSIM_ORIENTATIONS];
         const vk::raii::ImageView *ivFinalSums[3];
         const vk::raii::Image *imgFinalSums[3];
+        const vk::raii::Image *imgTempFloat[5];
+        const vk::raii::Image *imgFilterResponsesTest[FSIM_ORIENTATIONS];
+        const vk::raii::Image *imgFilterResponsesRef[FSIM_ORIENTATIONS];
         const vk::raii::Buffer *bufFft, *bufIfft;
         // FFT lib
         VkFFTApplication *fftApplication;
         VkFFTApplication *fftApplicationInverse;
         unsigned width, height;
+        Mask mask = {};
     };
 
     class FSIM {
     public:
-        explicit FSIM(const vk::raii::Device &device);
+        explicit FSIM(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        FSIM(const vk::raii::Device &device, const FSIM &other);
         void computeMetric(const FSIMInput& input);
 
         static std::pair<unsigned, unsigned> downscaledSize(unsigned width, unsigned height);
+        // side of the square of source pixels averaged into one downscaled pixel
+        static int computeDownscaleFactor(int width, int height);
 
     private:
         void initDescriptors(const FSIMInput& input, const FftBufferPartitions& partitions);
-        static int computeDownscaleFactor(int width, int height);
         void computeDownscaledImages(const FSIMInput& input, int factor, int width, int height);
         void createGradientMap(const FSIMInput& input, int, int);
         void computeFft(const FSIMInput& input, unsigned width, unsigned height);
         void computeMassInverseFft(const FSIMInput& input);
+        static void discardImages(const FSIMInput& input, const std::vector<const vk::raii::Image*>& images);
 
         static unsigned sortBufSize(unsigned dWidth, unsigned dHeight);
+        void allocateDescriptors(const vk::raii::Device &device);
 
-        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::DescriptorSetLayout descSetLayoutImageOp = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutImBufOp = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout layoutDownscale = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineDownscale = VK_NULL_HANDLE;
+
+            // gradient map pass
+            vk::raii::PipelineLayout layoutGradientMap = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineGradientMap = VK_NULL_HANDLE;
+
+            // extract luma for FFT library pass
+            vk::raii::PipelineLayout layoutExtractLuma = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineExtractLuma = VK_NULL_HANDLE;
+        };
 
-        vk::raii::DescriptorSetLayout descSetLayoutImageOp = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutImBufOp = VK_NULL_HANDLE;
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
 
         FSIMLogGabor logGaborFilter;
         FSIMAngularFilter angularFilter;
@@ -94,18 +152,8 @@ namespace IQM {
         FSIMPhaseCongruency phaseCongruency;
         FSIMFinalMultiply final_multiply;
 
-        vk::raii::PipelineLayout layoutDownscale = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineDownscale = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetDownscale = VK_NULL_HANDLE;
-
-        // gradient map pass
-        vk::raii::PipelineLayout layoutGradientMap = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineGradientMap = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetGradientMap = VK_NULL_HANDLE;
-
-        // extract luma for FFT library pass
-        vk::raii::PipelineLayout layoutExtractLuma = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineExtractLuma = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetExtractLumaIn = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetExtractLumaRef = VK_NULL_HANDLE;
     };
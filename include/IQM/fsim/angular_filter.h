@@ -7,19 +7,28 @@
 #define FSIM_ANGULAR_FILTER_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
 
 namespace IQM {
     struct FSIMInput;
 
     class FSIMAngularFilter {
         friend class FSIM;
-        explicit FSIMAngularFilter(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMAngularFilter(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMAngularFilter(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMAngularFilter &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput& input) const;
         void constructFilter(const FSIMInput &input, unsigned width, unsigned height);
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
     };
 }
@@ -7,6 +7,8 @@
 #define FSIM_ESTIMATE_ENERGY_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
+#include <IQM/base/reduce.h>
 
 namespace IQM {
     struct FSIMInput;
@@ -15,19 +17,24 @@ namespace IQM {
      */
     class FSIMEstimateEnergy {
         friend class FSIM;
-        explicit FSIMEstimateEnergy(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMEstimateEnergy(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMEstimateEnergy(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMEstimateEnergy &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void estimateEnergy(const FSIMInput& input, unsigned width, unsigned height);
         void setUpDescriptors(const FSIMInput& input, unsigned width, unsigned height);
 
-        vk::raii::PipelineLayout estimateEnergyLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline estimateEnergyPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout estimateEnergyDescSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout estimateEnergyLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline estimateEnergyPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout estimateEnergyDescSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet estimateEnergyDescSet = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout sumLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline sumPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout sumDescSetLayout = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet sumDescSet = VK_NULL_HANDLE;
+        Reduce reduce;
     };
 }
 
@@ -7,6 +7,8 @@
 #define FSIM_FILTER_COMBINATIONS_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
+#include <IQM/base/reduce.h>
 #include <IQM/fsim/partitions.h>
 
 namespace IQM {
@@ -30,20 +32,25 @@ namespace IQM {
      */
     class FSIMFilterCombinations {
         friend class FSIM;
-        explicit FSIMFilterCombinations(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMFilterCombinations(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMFilterCombinations(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMFilterCombinations &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput &input, unsigned width, unsigned height);
         void combineFilters(const FSIMInput &input, unsigned width, unsigned height, const FftBufferPartitions& partitions);
 
-        vk::raii::PipelineLayout multPackLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline multPackPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout multPackDescSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout multPackLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline multPackPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout multPackDescSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet multPackDescSet = VK_NULL_HANDLE;
 
         // noise sum part
-        vk::raii::PipelineLayout sumLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline sumPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout sumDescSetLayout = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet sumDescSet = VK_NULL_HANDLE;
+        Reduce reduce;
     };
 }
 
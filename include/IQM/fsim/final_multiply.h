@@ -7,25 +7,32 @@
 #define FSIM_FINAL_MULTIPLY_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
+#include <IQM/base/reduce.h>
 
 namespace IQM {
     struct FSIMInput;
 
     class FSIMFinalMultiply {
         friend class FSIM;
-        explicit FSIMFinalMultiply(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMFinalMultiply(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMFinalMultiply(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMFinalMultiply &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput &input, unsigned width, unsigned height);
         void computeMetrics(const FSIMInput &input, unsigned width, unsigned height);
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout sumLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline sumPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout sumDescSetLayout = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet sumDescSet = VK_NULL_HANDLE;
+        Reduce reduce;
 
         void sumImages(const FSIMInput& input, unsigned width, unsigned height);
     };
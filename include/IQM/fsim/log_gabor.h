@@ -7,19 +7,28 @@
 #define FSIM_LOG_GABOR_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
 
 namespace IQM {
     struct FSIMInput;
 
     class FSIMLogGabor {
         friend class FSIM;
-        explicit FSIMLogGabor(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMLogGabor(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMLogGabor(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMLogGabor &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput& input) const;
         void constructFilter(const FSIMInput &input, int width, int height);
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
     };
 }
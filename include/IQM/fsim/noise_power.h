@@ -7,6 +7,7 @@
 #define FSIM_NOISE_POWER_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
 #include <IQM/fsim/partitions.h>
 
 namespace IQM {
@@ -14,28 +15,36 @@ namespace IQM {
 
     class FSIMNoisePower {
         friend class FSIM;
-        explicit FSIMNoisePower(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMNoisePower(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMNoisePower(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMNoisePower &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput& input, unsigned width, unsigned height, const FftBufferPartitions& partitions) const;
         void computeNoisePower(const FSIMInput &input, unsigned width, unsigned height);
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout layoutSort = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutSortHistogram = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineSort = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineSortHistogram = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutSort = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout layoutNoisePower = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineNoisePower = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutNoisePower = VK_NULL_HANDLE;
+        };
 
-        vk::raii::PipelineLayout layoutSort = VK_NULL_HANDLE;
-        vk::raii::PipelineLayout layoutSortHistogram = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSort = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSortHistogram = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutSort = VK_NULL_HANDLE;
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortEven = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortOdd = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortHistogramEven = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortHistogramOdd = VK_NULL_HANDLE;
-
-        vk::raii::PipelineLayout layoutNoisePower = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineNoisePower = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutNoisePower = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetNoisePower = VK_NULL_HANDLE;
     };
 }
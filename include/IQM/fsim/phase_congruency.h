@@ -5,23 +5,31 @@
 
 #ifndef FSIM_PHASE_CONGRUENCY_H
 #define FSIM_PHASE_CONGRUENCY_H
-#include <memory>
 
 #include <IQM/base/vulkan_runtime.h>
 #include <IQM/fsim/partitions.h>
+#include <memory>
 
 namespace IQM {
     struct FSIMInput;
 
     class FSIMPhaseCongruency {
         friend class FSIM;
-        explicit FSIMPhaseCongruency(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMPhaseCongruency(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMPhaseCongruency(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMPhaseCongruency &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput& input, unsigned width, unsigned height, const FftBufferPartitions& partitions) const;
         void compute(const FSIMInput &input, unsigned width, unsigned height);
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
     };
 }
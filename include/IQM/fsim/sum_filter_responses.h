@@ -7,6 +7,7 @@
 #define FSIM_SUM_FILTER_RESPONSES_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <memory>
 
 namespace IQM {
     struct FSIMInput;
@@ -16,13 +17,21 @@ namespace IQM {
      */
     class FSIMSumFilterResponses {
         friend class FSIM;
-        explicit FSIMSumFilterResponses(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
+        explicit FSIMSumFilterResponses(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache = nullptr);
+        FSIMSumFilterResponses(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMSumFilterResponses &other);
+        void allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool);
         void setUpDescriptors(const FSIMInput& input, unsigned width, unsigned height);
         void computeSums(const FSIMInput& input, unsigned width, unsigned height);
 
-        vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layout = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
         vk::raii::DescriptorSet descSet = VK_NULL_HANDLE;
     };
 }
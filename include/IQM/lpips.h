@@ -6,6 +6,9 @@
 #ifndef LPIPS_H
 #define LPIPS_H
 #include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/reduce.h>
+#include <IQM/base/mask.h>
+#include <memory>
 
 namespace IQM {
     struct LPIPSInput {
@@ -15,6 +18,11 @@ namespace IQM {
         const vk::raii::Image *imgOut;
         const vk::raii::Buffer *bufWeights, *bufTest, *bufRef, *bufComp;
         unsigned width, height;
+        // weights of the final average, which is a plain mean without it
+        Mask mask = {};
+        // optional means of `gridCell`x`gridCell` squares of the distance map, laid out as described by `ReduceGridInput`
+        const vk::raii::Buffer *bufGrid = nullptr;
+        unsigned gridCell = 64;
     };
 
     struct ConvParams {
@@ -39,7 +47,9 @@ namespace IQM {
 
     class LPIPS {
     public:
-        explicit LPIPS(const vk::raii::Device &device);
+        explicit LPIPS(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        LPIPS(const vk::raii::Device &device, const LPIPS &other);
         [[nodiscard]] unsigned long modelSize() const;
         [[nodiscard]] LPIPSBufferSizes bufferSizes(unsigned width, unsigned height) const;
         void computeMetric(const LPIPSInput& input);
@@ -79,7 +89,8 @@ namespace IQM {
         };
 
     private:
-        void createConvPipelines(const vk::raii::Device &device, const vk::raii::ShaderModule &sm, const vk::raii::ShaderModule &smBig, const vk::raii::PipelineLayout &layout);
+        void allocateDescriptors(const vk::raii::Device &device);
+        void createConvPipelines(const vk::raii::Device &device, const vk::raii::ShaderModule &sm, const vk::raii::ShaderModule &smBig, const vk::raii::PipelineLayout &layout, const vk::raii::PipelineCache *cache);
 
         void setUpDescriptors(const LPIPSInput& input) const;
         void preprocess(const LPIPSInput& input);
@@ -93,40 +104,40 @@ namespace IQM {
 
         [[nodiscard]] ConvBufferHalves bufferHalves(unsigned width, unsigned height) const;
 
-        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout preprocessLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline preprocessPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout preprocessDescSetLayout = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout preprocessLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline preprocessPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout preprocessDescSetLayout = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet preprocessDescSet = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout convLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline convPipelineBig = VK_NULL_HANDLE;
+            vk::raii::Pipeline convPipelineMedium = VK_NULL_HANDLE;
+            vk::raii::Pipeline convPipelineSmall = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout convDescSetLayout = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout convLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline convPipelineBig = VK_NULL_HANDLE;
-        vk::raii::Pipeline convPipelineMedium = VK_NULL_HANDLE;
-        vk::raii::Pipeline convPipelineSmall = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout convDescSetLayout = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout maxPoolLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline maxPoolPipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout maxPoolDescSetLayout = VK_NULL_HANDLE;
 
-        std::vector<vk::raii::DescriptorSet> convDescSets;
+            vk::raii::PipelineLayout compareLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline comparePipeline = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout compareDescSetLayout = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout maxPoolLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline maxPoolPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout maxPoolDescSetLayout = VK_NULL_HANDLE;
-        std::vector<vk::raii::DescriptorSet> maxPoolDescSets;
+            vk::raii::PipelineLayout reconstructLayout = VK_NULL_HANDLE;
+            vk::raii::Pipeline reconstructPipeline = VK_NULL_HANDLE;
+        };
 
-        vk::raii::PipelineLayout compareLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline comparePipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout compareDescSetLayout = VK_NULL_HANDLE;
-        std::vector<vk::raii::DescriptorSet> compareDescSets;
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
 
-        vk::raii::PipelineLayout reconstructLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline reconstructPipeline = VK_NULL_HANDLE;
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet preprocessDescSet = VK_NULL_HANDLE;
+        std::vector<vk::raii::DescriptorSet> convDescSets;
+        std::vector<vk::raii::DescriptorSet> maxPoolDescSets;
+        std::vector<vk::raii::DescriptorSet> compareDescSets;
         vk::raii::DescriptorSet reconstructDescSet = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout sumLayout = VK_NULL_HANDLE;
-        vk::raii::Pipeline sumPipeline = VK_NULL_HANDLE;
-        vk::raii::Pipeline postprocessPipeline = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet sumDescSet = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout sumDescSetLayout = VK_NULL_HANDLE;
+        Reduce reduce;
     };
 }
 
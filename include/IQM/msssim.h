@@ -0,0 +1,102 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef MSSSIM_H
+#define MSSSIM_H
+
+#include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/reduce.h>
+#include <IQM/ssim/gauss_kernel.h>
+#include <map>
+#include <memory>
+
+namespace IQM {
+    static constexpr unsigned MSSSIM_LEVELS = 5;
+
+    /**
+     * Input parameters for MS-SSIM computation.
+     *
+     * Source image views `ivTest` and `ivRef` are expected to be views into RGBA u8 images of WxH.
+     * Pyramid views `ivLumaTest` and `ivLumaRef` are R f32 images, level `i` has dimensions `(W >> i)x(H >> i)`.
+     * All images should be in layout GENERAL.
+     *
+     * Buffer should have size of at least `MSSSIM::bufferSize` bytes.
+     * MS-SSIM result is on the zero-th index of `bufScales`.
+     */
+    struct MSSSIMInput {
+        const vk::raii::Device *device;
+        const vk::raii::CommandBuffer *cmdBuf;
+        const vk::raii::ImageView *ivTest, *ivRef;
+        std::array<const vk::raii::ImageView *, MSSSIM_LEVELS> ivLumaTest, ivLumaRef;
+        const vk::raii::Buffer *bufScales;
+        unsigned width, height;
+    };
+
+    /**
+     * Multi-scale SSIM.
+     *
+     * Luma pyramid is built on the GPU by 2x2 averaging, each scale is evaluated by the fused SSIM kernel,
+     * contrast-structure maps of all scales, and full SSIM of the last one, are packed into one buffer,
+     * averaged over pixels with the whole kernel inside the image, and combined with the standard weights.
+     * Everything is recorded into the single command buffer, there is no graphical output.
+     */
+    class MSSSIM {
+    public:
+        explicit MSSSIM(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines and parameters of `other` and only allocates own descriptors, so both can be recorded independently
+        MSSSIM(const vk::raii::Device &device, const MSSSIM &other);
+        void computeMetric(const MSSSIMInput& input);
+        // bytes of the scale buffer needed for WxH input, throws if the input is too small for all scales
+        [[nodiscard]] unsigned long bufferSize(unsigned width, unsigned height) const;
+
+        // only fused kernels are supported
+        static constexpr int MAX_KERNEL_SIZE = 2 * GaussKernel::MAX_RADIUS + 1;
+
+        int kernelSize = 11;
+        float k_1 = 0.01;
+        float k_2 = 0.03;
+        float sigma = 1.5;
+    private:
+        // packed values of each scale start at this element, also validates kernel and image size
+        [[nodiscard]] std::array<unsigned, MSSSIM_LEVELS> scaleOffsets(unsigned width, unsigned height) const;
+        void initDescriptors(const MSSSIMInput& input);
+        const vk::raii::Pipeline& specializedPipeline(const vk::raii::Device &device);
+        void allocateDescriptors(const vk::raii::Device &device);
+
+        struct Pipelines {
+            // used for pipelines created on demand, so it must outlive the method
+            const vk::raii::PipelineCache *pipelineCache = nullptr;
+
+            vk::raii::DescriptorSetLayout descSetLayoutPyramid = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutPyramid = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineLuma = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineDownsample = VK_NULL_HANDLE;
+
+            vk::raii::DescriptorSetLayout descSetLayoutScale = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutScale = VK_NULL_HANDLE;
+
+            vk::raii::DescriptorSetLayout descSetLayoutCombine = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutCombine = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineCombine = VK_NULL_HANDLE;
+
+            // scale pipelines created on first use of each kernel size and sigma
+            std::map<std::pair<int, float>, vk::raii::Pipeline> scalePipelines;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetLuma = VK_NULL_HANDLE;
+        // level i to level i + 1
+        std::vector<vk::raii::DescriptorSet> descSetsDownsample;
+        std::vector<vk::raii::DescriptorSet> descSetsScale;
+        vk::raii::DescriptorSet descSetCombine = VK_NULL_HANDLE;
+
+        Reduce reduce;
+    };
+}
+
+#endif //MSSSIM_H
@@ -7,6 +7,9 @@
 #define IQM_PSNR_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/reduce.h>
+#include <IQM/base/mask.h>
+#include <memory>
 
 namespace IQM {
     enum PSNRVariant {
@@ -25,7 +28,13 @@ namespace IQM {
      *
      * If the image `imgOut` is not null, square errors will be saved there.
      *
+     * With a `mask`, the mean square error is weighted by it and without `imgOut`
+     * errors are only computed for tiles intersecting its bounds.
+     *
      * PSNR result is on the zero-th index of `bufSum`.
+     *
+     * If `bufGrid` is not null, the mean square error of each `gridCell`x`gridCell` square of the image
+     * is stored there, laid out as described by `ReduceGridInput`.
      */
     struct PSNRInput {
         const vk::raii::Device *device;
@@ -35,27 +44,39 @@ namespace IQM {
         const vk::raii::Image *imgOut = nullptr;
         PSNRVariant variant;
         unsigned width, height;
+        Mask mask = {};
+        const vk::raii::Buffer *bufGrid = nullptr;
+        unsigned gridCell = 64;
     };
 
     class PSNR {
     public:
-        explicit PSNR(const vk::raii::Device &device);
+        explicit PSNR(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        PSNR(const vk::raii::Device &device, const PSNR &other);
         void computeMetric(const PSNRInput& input);
     private:
-        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layoutPack = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelinePack = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutPack = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutPack = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelinePack = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutPack = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetPack = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutSum = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutSum = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutSum = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSum = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutSum = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelinePost = VK_NULL_HANDLE;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetPack = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSum = VK_NULL_HANDLE;
 
-        vk::raii::Pipeline pipelinePost = VK_NULL_HANDLE;
+        Reduce reduce;
 
+        void allocateDescriptors(const vk::raii::Device &device);
         void initDescriptors(const PSNRInput& input);
     };
 }
@@ -7,6 +7,11 @@
 #define SSIM_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/reduce.h>
+#include <IQM/base/mask.h>
+#include <IQM/ssim/gauss_kernel.h>
+#include <map>
+#include <memory>
 
 namespace IQM {
     /**
@@ -14,55 +19,120 @@ namespace IQM {
      *
      * Source image views `ivTest` and `ivRef` are expected to be views into RGBA u8 images of WxH.
      * Rest of image views are expected to be in R f32 format with dimensions WxH.
+     * If the method was created with `halfPrecision` and doesn't use intermediates, `ivOut` is in R f16 format instead,
+     * MSSIM is still summed from f32 values. Intermediates are always R f32, variances are differences of their
+     * nearly equal blurred moments, which f16 can't hold precisely. With intermediates `ivOut` is also the f32 scratch
+     * image of the blur, so it stays R f32 as well.
+     * The intermediates (`ivMeanTest` to `ivCovar`) are only used if `SSIM::usesIntermediates` is true,
+     * otherwise they may be null.
+     * Without intermediates `ivOut` may also be null, then the graphical measure is not written at all.
      * All images should be in layout GENERAL.
      *
-     * Buffer should have size of WxHx4 bytes.
+     * Buffer should hold two floats for each started 16x16 tile of the image.
      *
-     * After the computation the resulting graphical measure is in `imgOut`.
-     * MSSIM result is on the zero-th index of `bufMssim`.
+     * After the computation the resulting graphical measure is in `ivOut`.
+     * MSSIM is the value on the zero-th index of `bufMssim` divided by the value on the index equal to the number of tiles.
+     * These are the sum of `sumRegion` of the measure, which defaults to the whole image without a border of half the kernel size,
+     * and the area of the region.
+     * The sums are accumulated per tile while the measure is computed, so the output image is never read back.
+     * With a `mask`, the region is also limited to its bounds and each pixel is weighted by it,
+     * the second value is then the sum of the weights.
+     * Without `ivOut`, tiles outside of the region only clear their partial sums.
+     *
+     * If `bufGrid` is not null, MSSIM of each `gridCell`x`gridCell` square of the region is stored there,
+     * laid out as described by `ReduceGridInput`. It is combined from the tile sums, so `gridCell` must be a multiple of 16.
+     *
+     * `ivMeanRef` and `ivVarRef` hold blurred reference mean and squared mean after the computation.
+     * If `cachedReference` is set, they are expected to still hold these values from a previous computation
+     * with the same reference and kernel parameters, and only test side intermediates are computed.
+     * Without intermediates `cachedReference` is ignored, the fused shader keeps reference moments
+     * only in shared memory, so they are recomputed every time.
      */
     struct SSIMInput {
         const vk::raii::Device *device;
         const vk::raii::CommandBuffer *cmdBuf;
         const vk::raii::ImageView *ivTest, *ivRef, *ivMeanTest, *ivMeanRef, *ivVarTest, *ivVarRef, *ivCovar, *ivOut;
-        const vk::raii::Image *imgOut;
         const vk::raii::Buffer *bufMssim;
         unsigned width, height;
+        bool cachedReference = false;
+        // summed part of the output, used when its extent is not empty
+        vk::Rect2D sumRegion = {};
+        Mask mask = {};
+        const vk::raii::Buffer *bufGrid = nullptr;
+        unsigned gridCell = 64;
     };
 
     class SSIM {
     public:
-        explicit SSIM(const vk::raii::Device &device);
+        explicit SSIM(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr, bool halfPrecision = false);
+        // reuses pipelines and parameters of `other` and only allocates own descriptors, so both can be recorded independently
+        SSIM(const vk::raii::Device &device, const SSIM &other);
         void computeMetric(const SSIMInput& input);
+        /**
+         * Kernels up to `MAX_FUSED_KERNEL_SIZE` are computed by a single fused shader,
+         * which blurs all five moments in shared memory and writes only the output.
+         * Larger kernels blur each moment separately through the intermediate images.
+         */
+        [[nodiscard]] bool usesIntermediates() const;
+
+        static constexpr int MAX_FUSED_KERNEL_SIZE = 2 * GaussKernel::MAX_RADIUS + 1;
 
         int kernelSize = 11;
         float k_1 = 0.01;
         float k_2 = 0.03;
         float sigma = 1.5;
     private:
-        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        // blur pipelines specialized for one kernel size and sigma
+        struct KernelPipelines {
+            vk::raii::Pipeline fused = VK_NULL_HANDLE;
+            // fused variant without the output image
+            vk::raii::Pipeline fusedSum = VK_NULL_HANDLE;
+            vk::raii::Pipeline gaussHorizontal = VK_NULL_HANDLE;
+            vk::raii::Pipeline gauss = VK_NULL_HANDLE;
+        };
 
-        vk::raii::PipelineLayout layoutSsim = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSsim = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutSsim = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetSsim = VK_NULL_HANDLE;
+        struct Pipelines {
+            // selects the fused shader variant writing the map in R f16
+            bool halfPrecision = false;
 
-        vk::raii::PipelineLayout layoutLumapack = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineLumapack = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutLumapack = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetLumapack = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutSsim = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineSsim = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutSsim = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout layoutFused = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutFused = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutGauss = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineGauss = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineGaussHorizontal = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutLumapack = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineLumapack = VK_NULL_HANDLE;
+            // only created once a cached reference is used
+            vk::raii::Pipeline pipelineLumapackTest = VK_NULL_HANDLE;
+            // used for pipelines created on demand, so it must outlive the method
+            const vk::raii::PipelineCache *pipelineCache = nullptr;
+            vk::raii::DescriptorSetLayout descSetLayoutLumapack = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout layoutGauss = VK_NULL_HANDLE;
+
+            // created on first use of each kernel size and sigma
+            std::map<std::pair<int, float>, KernelPipelines> kernelPipelines;
+        };
+
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetSsim = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetFused = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetLumapack = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetGauss = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutMssim = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineMssim = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutMssim = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetMssim = VK_NULL_HANDLE;
+        Reduce reduce;
 
+        void allocateDescriptors(const vk::raii::Device &device);
         void initDescriptors(const SSIMInput& input);
+        // creates pipelines missing for the current kernel, `writeMap` selects the fused variant
+        const KernelPipelines& specializedPipelines(const vk::raii::Device &device, bool writeMap);
+        void computeFused(const SSIMInput& input, const KernelPipelines& pipelines, const vk::Rect2D& region, unsigned groupsX, unsigned groupsY);
+        void computeSeparable(const SSIMInput& input, const KernelPipelines& pipelines, const vk::Rect2D& region, unsigned groupsX, unsigned groupsY);
     };
 }
 
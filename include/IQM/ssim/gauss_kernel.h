@@ -0,0 +1,42 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_SSIM_GAUSS_KERNEL_H
+#define IQM_SSIM_GAUSS_KERNEL_H
+
+#include <IQM/base/vulkan_runtime.h>
+#include <array>
+#include <vector>
+
+namespace IQM {
+    /**
+     * Specialization constants of the gaussian kernel shared by SSIM shaders.
+     *
+     * Kernel size and sigma are constants 0 and 1, unnormalized weights for offsets 0 to `MAX_RADIUS`
+     * are constants 2 onwards, so fused shaders don't evaluate the exponential per tap.
+     */
+    class GaussKernel {
+    public:
+        GaussKernel(int kernelSize, float sigma);
+        // specialization info points into this object
+        GaussKernel(const GaussKernel&) = delete;
+        GaussKernel& operator=(const GaussKernel&) = delete;
+
+        [[nodiscard]] const vk::SpecializationInfo& specializationInfo() const;
+
+        // largest radius with precomputed weights, must match MAX_RADIUS in the shaders
+        static constexpr int MAX_RADIUS = 8;
+    private:
+        struct {
+            int32_t kernelSize;
+            float sigma;
+            std::array<float, MAX_RADIUS + 1> weights;
+        } constants;
+        std::vector<vk::SpecializationMapEntry> entries;
+        vk::SpecializationInfo info;
+    };
+}
+
+#endif //IQM_SSIM_GAUSS_KERNEL_H
@@ -7,6 +7,8 @@
 #define SVD_H
 
 #include <IQM/base/vulkan_runtime.h>
+#include <IQM/base/reduce.h>
+#include <memory>
 
 namespace IQM {
     struct SVDInput {
@@ -22,7 +24,9 @@ namespace IQM {
 
     class SVD {
     public:
-        explicit SVD(const vk::raii::Device &device);
+        explicit SVD(const vk::raii::Device &device, const vk::raii::PipelineCache *cache = nullptr);
+        // reuses pipelines of `other` and only allocates own descriptors, so both can be recorded independently
+        SVD(const vk::raii::Device &device, const SVD &other);
         void computeMetric(const SVDInput& input);
 
     private:
@@ -32,38 +36,45 @@ namespace IQM {
         void sortBlocks(const SVDInput& input);
         void computeMsvd(const SVDInput& input);
 
-        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        struct Pipelines {
+            vk::raii::PipelineLayout layoutConvert = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineConvert = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutConvert = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutConvert = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineConvert = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutConvert = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetConvert = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutSvd = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineSvd = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutSvd = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutSvd = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSvd = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutSvd = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetSvd = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutReduce = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineReduce = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutReduce = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutReduce = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineReduce = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutReduce = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetReduce = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutSort = VK_NULL_HANDLE;
+            vk::raii::PipelineLayout layoutSortHistogram = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineSort = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineSortHistogram = VK_NULL_HANDLE;
+            vk::raii::DescriptorSetLayout descSetLayoutSort = VK_NULL_HANDLE;
+
+            vk::raii::PipelineLayout layoutDiff = VK_NULL_HANDLE;
+            vk::raii::Pipeline pipelineDiff = VK_NULL_HANDLE;
+        };
 
-        vk::raii::PipelineLayout layoutSort = VK_NULL_HANDLE;
-        vk::raii::PipelineLayout layoutSortHistogram = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSort = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSortHistogram = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutSort = VK_NULL_HANDLE;
+        // shared by all instances created from the same one
+        std::shared_ptr<Pipelines> shared;
+
+        vk::raii::DescriptorPool descPool = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetConvert = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetSvd = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetReduce = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortEven = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortOdd = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortHistogramEven = VK_NULL_HANDLE;
         vk::raii::DescriptorSet descSetSortHistogramOdd = VK_NULL_HANDLE;
+        vk::raii::DescriptorSet descSetDiff = VK_NULL_HANDLE;
 
-        vk::raii::PipelineLayout layoutSum = VK_NULL_HANDLE;
-        vk::raii::Pipeline pipelineSum = VK_NULL_HANDLE;
-        vk::raii::DescriptorSetLayout descSetLayoutSum = VK_NULL_HANDLE;
-        vk::raii::DescriptorSet descSetSum = VK_NULL_HANDLE;
+        Reduce reduce;
 
+        void allocateDescriptors(const vk::raii::Device &device);
         void initDescriptors(const SVDInput& input);
     };
 }
@@ -0,0 +1,30 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D input_img[2];
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2D output_img[2];
+
+// 2x2 box filter of encoded values, output has floor of half the input size, so the odd last row and column are dropped
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+
+    if (pos.x >= imageSize(output_img[0]).x || pos.y >= imageSize(output_img[0]).y) {
+        return;
+    }
+
+    ivec2 src = pos * 2;
+    for (int i = 0; i < 2; i++) {
+        vec4 sum = imageLoad(input_img[i], src)
+            + imageLoad(input_img[i], src + ivec2(1, 0))
+            + imageLoad(input_img[i], src + ivec2(0, 1))
+            + imageLoad(input_img[i], src + ivec2(1, 1));
+        imageStore(output_img[i], pos, sum * 0.25);
+    }
+}
@@ -0,0 +1,156 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+#extension GL_KHR_shader_subgroup_basic: enable
+#extension GL_KHR_shader_subgroup_arithmetic: enable
+
+#define REDUCE_SIZE 256
+
+#define OP_SUM 0
+#define OP_MIN 1
+#define OP_MAX 2
+#define OP_MEAN 3
+#define OP_SUM_OF_SQUARES 4
+#define OP_WEIGHTED_MEAN 5
+
+// pass flags
+#define PASS_FIRST 1
+#define PASS_LAST 2
+
+layout (local_size_x = REDUCE_SIZE, local_size_y = 1) in;
+
+layout(std430, set = 0, binding = 0) buffer InOutBuf {
+    float data[];
+};
+
+// per element weights of the weighted mean, only read by the first pass
+layout(std430, set = 0, binding = 1) readonly buffer WeightBuf {
+    float weights[];
+};
+
+layout( push_constant ) uniform constants {
+    // first element of the first array
+    uint offset;
+    // elements between starts of consecutive arrays
+    uint stride;
+    // number of values reduced by this pass in each array
+    uint size;
+    // elements between consecutive values
+    uint step;
+    // number of values reduced by one workgroup
+    uint chunk;
+    uint op;
+    uint pass;
+    // number of elements of each array, used for mean
+    uint total;
+} push_consts;
+
+// one partial result per subgroup
+shared float subResults[REDUCE_SIZE];
+// partial sums of weights for the weighted mean
+shared float subWeights[REDUCE_SIZE];
+
+float identity() {
+    if (push_consts.op == OP_MIN) {
+        return uintBitsToFloat(0x7f800000);
+    } else if (push_consts.op == OP_MAX) {
+        return uintBitsToFloat(0xff800000);
+    }
+    return 0.0;
+}
+
+float combine(float a, float b) {
+    if (push_consts.op == OP_MIN) {
+        return min(a, b);
+    } else if (push_consts.op == OP_MAX) {
+        return max(a, b);
+    }
+    return a + b;
+}
+
+float subgroupCombine(float value) {
+    if (push_consts.op == OP_MIN) {
+        return subgroupMin(value);
+    } else if (push_consts.op == OP_MAX) {
+        return subgroupMax(value);
+    }
+    return subgroupAdd(value);
+}
+
+void main() {
+    uint tid = gl_LocalInvocationID.x;
+    uint base = push_consts.offset + gl_WorkGroupID.y * push_consts.stride;
+    uint start = gl_WorkGroupID.x * push_consts.chunk;
+    uint end = min(start + push_consts.chunk, push_consts.size);
+    bool first = (push_consts.pass & PASS_FIRST) != 0;
+    bool square = push_consts.op == OP_SUM_OF_SQUARES && first;
+    bool weighted = push_consts.op == OP_WEIGHTED_MEAN;
+
+    float value = identity();
+    float weight = 0.0;
+    for (uint i = start + tid; i < end; i += REDUCE_SIZE) {
+        float current = data[base + i * push_consts.step];
+        if (!weighted) {
+            value = combine(value, square ? current * current : current);
+        } else if (first) {
+            // values with zero weight may be left unwritten, so they must not be multiplied
+            float w = weights[i];
+            if (w > 0.0) {
+                value += current * w;
+                weight += w;
+            }
+        } else {
+            // the first pass stores the weight after the value of its chunk
+            value += current;
+            weight += data[base + i * push_consts.step + 1];
+        }
+    }
+
+    value = subgroupCombine(value);
+    if (weighted) {
+        weight = subgroupAdd(weight);
+    }
+    if (subgroupElect()) {
+        subResults[gl_SubgroupID] = value;
+        subWeights[gl_SubgroupID] = weight;
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    if (gl_SubgroupID == 0) {
+        value = identity();
+        for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize) {
+            value = combine(value, subResults[i]);
+        }
+        value = subgroupCombine(value);
+
+        weight = 0.0;
+        if (weighted) {
+            for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize) {
+                weight += subWeights[i];
+            }
+            weight = subgroupAdd(weight);
+        }
+
+        bool last = (push_consts.pass & PASS_LAST) != 0;
+        if (push_consts.op == OP_MEAN && last) {
+            value /= float(push_consts.total);
+        } else if (weighted && last) {
+            value /= weight;
+        }
+
+        // the first value of the chunk is only read by this workgroup, so the result can be stored in its place
+        if (subgroupElect()) {
+            data[base + start * push_consts.step] = value;
+            // chunks of the first pass hold many elements, so the second one is free for the weight
+            if (weighted && !last) {
+                data[base + start * push_consts.step + 1] = weight;
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+#extension GL_KHR_shader_subgroup_basic: enable
+#extension GL_KHR_shader_subgroup_arithmetic: enable
+
+// weight sources
+#define WEIGHTS_NONE 0
+#define WEIGHTS_BUFFER 1
+#define WEIGHTS_SUMS 2
+
+// one workgroup per cell of the grid
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout(std430, set = 0, binding = 0) readonly buffer InBuf {
+    float data[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer WeightBuf {
+    float weights[];
+};
+
+layout(std430, set = 0, binding = 2) writeonly buffer GridBuf {
+    float grid[];
+};
+
+layout( push_constant ) uniform constants {
+    // first element of the 2D array
+    uint offset;
+    uint width;
+    uint height;
+    // side of the square of elements averaged into one cell
+    uint cell;
+    uint weighting;
+    // first element of the weight sums, with WEIGHTS_SUMS
+    uint weightOffset;
+} push_consts;
+
+shared vec2 subgroupSums[256];
+
+void main() {
+    uvec2 start = gl_WorkGroupID.xy * push_consts.cell;
+    uvec2 end = min(start + push_consts.cell, uvec2(push_consts.width, push_consts.height));
+
+    vec2 sum = vec2(0.0);
+    for (uint y = start.y + gl_LocalInvocationID.y; y < end.y; y += gl_WorkGroupSize.y) {
+        for (uint x = start.x + gl_LocalInvocationID.x; x < end.x; x += gl_WorkGroupSize.x) {
+            uint i = y * push_consts.width + x;
+            float current = data[push_consts.offset + i];
+            if (push_consts.weighting == WEIGHTS_NONE) {
+                sum += vec2(current, 1.0);
+            } else if (push_consts.weighting == WEIGHTS_BUFFER) {
+                // same as the weighted mean, values with zero weight may be left unwritten
+                float w = weights[i];
+                if (w > 0.0) {
+                    sum += vec2(current * w, w);
+                }
+            } else {
+                // values are already weighted sums
+                sum += vec2(current, data[push_consts.weightOffset + i]);
+            }
+        }
+    }
+
+    sum = subgroupAdd(sum);
+    if (subgroupElect()) {
+        subgroupSums[gl_SubgroupID] = sum;
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    if (gl_SubgroupID == 0) {
+        sum = vec2(0.0);
+        for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize) {
+            sum += subgroupSums[i];
+        }
+        sum = subgroupAdd(sum);
+
+        if (subgroupElect()) {
+            // cells without any weight are NaN
+            grid[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = sum.y > 0.0 ? sum.x / sum.y : uintBitsToFloat(0x7fc00000);
+        }
+    }
+}
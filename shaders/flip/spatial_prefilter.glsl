@@ -10,6 +10,10 @@
 
 layout (local_size_x = 1024, local_size_y = 1) in;
 
+// pipelines are specialized for pixels per degree, so filter values of the unrolled loop are constant
+layout (constant_id = 0) const int RADIUS = 10;
+layout (constant_id = 1) const float DELTA_X = 0.015;
+
 layout(std430, set = 0, binding = 0) buffer OutBuf {
     float data[];
 } outData[2];
@@ -18,7 +22,6 @@ layout(std430, set = 0, binding = 1) buffer InBuf {
 } inData;
 
 layout( push_constant ) uniform constants {
-    float pixels_per_degree;
     uint index;
     uint size;
     uint width;
@@ -56,20 +59,16 @@ void main() {
     uint z = push_consts.index;
     ivec2 pos = ivec2(x, y);
 
-    int radius = int(ceil(3.0 * sqrt(0.04 / (2.0 * PI * PI)) * push_consts.pixels_per_degree));
-    int halfSize = radius;
-    float deltaX = 1.0 / push_consts.pixels_per_degree;
-
     vec3 opponent = vec3(0.0);
     vec3 opponentTotal = vec3(0.0);
 
-    for (int k = -halfSize; k <= halfSize; k++) {
+    for (int k = -RADIUS; k <= RADIUS; k++) {
         uint actualY = uint(clamp(int(y) - k, 0, int(push_consts.height) - 1));
 
         uint index = (x + actualY * push_consts.width) * 3;
         vec3 ycc = vec3(inData.data[index], inData.data[index + 1], inData.data[index + 2]);
 
-        float yy = float(k) * deltaX;
+        float yy = float(k) * DELTA_X;
         float d = yy * yy;
 
         vec3 filter_val = vec3(getGaussValue(d, lumaParams), getGaussValue(d, rgParams), getGaussValue(d, byParams));
@@ -10,6 +10,10 @@
 
 layout (local_size_x = 1024, local_size_y = 1) in;
 
+// pipelines are specialized for pixels per degree, so filter values of the unrolled loop are constant
+layout (constant_id = 0) const int RADIUS = 10;
+layout (constant_id = 1) const float DELTA_X = 0.015;
+
 layout(std430, set = 0, binding = 0) buffer InBuf {
     float data[];
 } inData[2];
@@ -18,7 +22,6 @@ layout(std430, set = 0, binding = 1) buffer OutBuf {
 } outData;
 
 layout( push_constant ) uniform constants {
-    float pixels_per_degree;
     uint index;
     uint size;
     uint width;
@@ -45,21 +48,17 @@ void main() {
     uint z = push_consts.index;
     ivec2 pos = ivec2(x, y);
 
-    int radius = int(ceil(3.0 * sqrt(0.04 / (2.0 * PI * PI)) * push_consts.pixels_per_degree));
-    int halfSize = radius;
-    float deltaX = 1.0 / push_consts.pixels_per_degree;
-
     vec3 opponent = vec3(0.0);
     vec3 opponentTotal = vec3(0.0);
 
-    for (int j = -halfSize; j <= halfSize; j++) {
+    for (int j = -RADIUS; j <= RADIUS; j++) {
         uint actualX = uint(clamp(int(x) - j, 0, int(push_consts.width) - 1));
         int k = 0;
 
         uint index = (actualX + y * push_consts.width) * 3;
         vec3 ycc = vec3(inData[z].data[index], inData[z].data[index + 1], inData[z].data[index + 2]);
 
-        float xx = float(j) * deltaX;
+        float xx = float(j) * DELTA_X;
         float d = xx * xx;
 
         vec3 filter_val = vec3(getGaussValue(d, lumaParams), getGaussValue(d, rgParams), getGaussValue(d, byParams));
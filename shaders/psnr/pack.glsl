@@ -15,6 +15,8 @@ layout(std430, set = 0, binding = 1) buffer OutBuf {
 
 layout( push_constant ) uniform constants {
     int variant;
+    // first pixel of the dispatched area
+    ivec2 origin;
 } push_consts;
 
 // Rec. 601 - same as openCV
@@ -32,8 +34,8 @@ vec3 rec601(vec3 color) {
 }
 
 void main() {
-    uint x = gl_WorkGroupID.x * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
-    uint y = gl_WorkGroupID.y * gl_WorkGroupSize.y + gl_LocalInvocationID.y;
+    uint x = push_consts.origin.x + gl_WorkGroupID.x * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+    uint y = push_consts.origin.y + gl_WorkGroupID.y * gl_WorkGroupSize.y + gl_LocalInvocationID.y;
     ivec2 maxPos = imageSize(input_img[0]);
     ivec2 pos = ivec2(x, y);
 
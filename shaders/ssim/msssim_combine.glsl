@@ -0,0 +1,32 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+
+#define LEVELS 5
+
+layout (local_size_x = 1, local_size_y = 1) in;
+
+layout(std430, set = 0, binding = 0) buffer InOutBuf {
+    float data[];
+};
+
+layout( push_constant ) uniform constants {
+    // mean of each scale, as left by the reduction
+    uint offsets[LEVELS];
+} push_consts;
+
+// weights from the original MS-SSIM paper
+const float weights[LEVELS] = float[](0.0448, 0.2856, 0.3001, 0.2363, 0.1333);
+
+void main() {
+    float result = 1.0;
+    for (int i = 0; i < LEVELS; i++) {
+        // negative means would give NaN for the fractional exponents
+        result *= pow(max(data[push_consts.offsets[i]], 0.0), weights[i]);
+    }
+    data[0] = result;
+}
@@ -0,0 +1,30 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+layout(set = 0, binding = 0, r32f) uniform readonly image2D input_img[2];
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D output_img[2];
+
+// 2x2 box filter, output has floor of half the input size, so the odd last row and column are dropped
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+
+    if (pos.x >= imageSize(output_img[0]).x || pos.y >= imageSize(output_img[0]).y) {
+        return;
+    }
+
+    ivec2 src = pos * 2;
+    for (int i = 0; i < 2; i++) {
+        float sum = imageLoad(input_img[i], src).x
+            + imageLoad(input_img[i], src + ivec2(1, 0)).x
+            + imageLoad(input_img[i], src + ivec2(0, 1)).x
+            + imageLoad(input_img[i], src + ivec2(1, 1)).x;
+        imageStore(output_img[i], pos, vec4(sum * 0.25, 0.0, 0.0, 0.0));
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+
+#include "ssim_fused_shared.glsl"
+
+layout(set = 0, binding = 0, r32f) uniform readonly image2D input_img[2];
+
+layout(std430, set = 0, binding = 1) buffer OutBuf {
+    float data[];
+};
+
+layout( push_constant ) uniform constants {
+    float k_1;
+    float k_2;
+    // first element of this scale in the buffer
+    uint offset;
+    // the coarsest scale also includes the luminance term
+    uint lastScale;
+} push_consts;
+
+vec2 loadLuma(ivec2 pos) {
+    return vec2(imageLoad(input_img[0], pos).x, imageLoad(input_img[1], pos).x);
+}
+
+void main() {
+    ivec2 size = imageSize(input_img[0]);
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+
+    Moments moments = blurredMoments(size);
+
+    // only pixels with the whole kernel inside the image are written, packed row by row
+    if (pos.x < RADIUS || pos.y < RADIUS || pos.x >= size.x - RADIUS || pos.y >= size.y - RADIUS) {
+        return;
+    }
+
+    float c_1 = pow(push_consts.k_1, 2);
+    float c_2 = pow(push_consts.k_2, 2);
+
+    float value = (2.0 * moments.covar + c_2) / (moments.varTest + moments.varRef + c_2);
+    if (push_consts.lastScale != 0) {
+        value *= (2.0 * moments.meanTest * moments.meanRef + c_1) / (pow(moments.meanTest, 2.0) + pow(moments.meanRef, 2.0) + c_1);
+    }
+
+    uint validWidth = uint(size.x - 2 * RADIUS);
+    data[push_consts.offset + uint(pos.y - RADIUS) * validWidth + uint(pos.x - RADIUS)] = value;
+}
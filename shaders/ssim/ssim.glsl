@@ -5,6 +5,8 @@
 
 #version 450
 #pragma shader_stage(compute)
+#extension GL_KHR_shader_subgroup_basic: enable
+#extension GL_KHR_shader_subgroup_arithmetic: enable
 
 #include "ssim_shared.glsl"
 
@@ -13,36 +15,52 @@ layout (local_size_x = 16, local_size_y = 16) in;
 layout(set = 0, binding = 0, r32f) uniform readonly image2D input_img[5];
 layout(set = 0, binding = 1, r32f) uniform writeonly image2D output_img;
 
+layout(std430, set = 0, binding = 2) buffer SumBuf {
+    float sums[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer MaskBuf {
+    float mask[];
+};
+
+#include "ssim_group_sum.glsl"
+
 layout( push_constant ) uniform constants {
     int kernelSize;
     float k_1;
     float k_2;
     float sigma;
+    // summed part of the image
+    ivec2 regionOffset;
+    ivec2 regionSize;
+    // weights pixels of the region by `mask`
+    uint masked;
 } push_consts;
 
 void main() {
     float c_1 = pow(push_consts.k_1, 2);
     float c_2 = pow(push_consts.k_2, 2);
 
-    uint x = gl_WorkGroupID.x * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
-    uint y = gl_WorkGroupID.y * gl_WorkGroupSize.y + gl_LocalInvocationID.y;
     ivec2 maxPos = imageSize(input_img[0]);
-    ivec2 pos = ivec2(x, y);
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
 
-    if (x >= maxPos.x || y >= maxPos.y) {
-        return;
-    }
+    // all invocations take part in the workgroup sum
+    float outCol = 0.0;
+    if (pos.x < maxPos.x && pos.y < maxPos.y) {
+        float meanImg = imageLoad(input_img[0], pos).x;
+        float meanRef = imageLoad(input_img[1], pos).x;
 
-    float meanImg = imageLoad(input_img[0], pos).x;
-    float meanRef = imageLoad(input_img[1], pos).x;
+        float varInput = imageLoad(input_img[2], pos).x - (meanImg * meanImg);
+        float varRef = imageLoad(input_img[3], pos).x - (meanRef * meanRef);
+        float coVar = imageLoad(input_img[4], pos).x - (meanImg * meanRef);
 
-    float varInput = imageLoad(input_img[2], pos).x - (meanImg * meanImg);
-    float varRef = imageLoad(input_img[3], pos).x - (meanRef * meanRef);
-    float coVar = imageLoad(input_img[4], pos).x - (meanImg * meanRef);
+        float smallPart = (2.0 * coVar + c_2) /  (varInput + varRef + c_2);
+        float bigPart = (2.0 * meanImg * meanRef + c_1) / (pow(meanImg, 2.0) + pow(meanRef, 2.0) + c_1);
+        outCol = smallPart * bigPart;
 
-    float smallPart = (2.0 * coVar + c_2) /  (varInput + varRef + c_2);
-    float bigPart = (2.0 * meanImg * meanRef + c_1) / (pow(meanImg, 2.0) + pow(meanRef, 2.0) + c_1);
-    float outCol = smallPart * bigPart;
+        imageStore(output_img, pos, vec4(vec3(outCol), 1.0));
+    }
 
-    imageStore(output_img, pos, vec4(vec3(outCol), 1.0));
-}
\ No newline at end of file
+    float weight = pixelWeight(pos, maxPos.x, push_consts.regionOffset, push_consts.regionSize, push_consts.masked != 0);
+    storeGroupSum(outCol * weight, weight);
+}
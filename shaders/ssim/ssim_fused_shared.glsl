@@ -0,0 +1,155 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+// Blurred SSIM moments of one 16x16 tile, computed in shared memory.
+// Including shader defines `loadLuma`, returning luma of test and reference at given position in the image.
+
+// largest kernel radius, must match SSIM::MAX_FUSED_KERNEL_SIZE
+#define MAX_RADIUS 8
+#define GROUP_SIZE 16
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+// pipelines are specialized for kernel parameters, weights are computed on the host for offsets 0 to the radius
+layout (constant_id = 0) const int KERNEL_SIZE = 11;
+layout (constant_id = 2) const float WEIGHT_0 = 1.0;
+layout (constant_id = 3) const float WEIGHT_1 = 0.0;
+layout (constant_id = 4) const float WEIGHT_2 = 0.0;
+layout (constant_id = 5) const float WEIGHT_3 = 0.0;
+layout (constant_id = 6) const float WEIGHT_4 = 0.0;
+layout (constant_id = 7) const float WEIGHT_5 = 0.0;
+layout (constant_id = 8) const float WEIGHT_6 = 0.0;
+layout (constant_id = 9) const float WEIGHT_7 = 0.0;
+layout (constant_id = 10) const float WEIGHT_8 = 0.0;
+
+const int RADIUS = (KERNEL_SIZE - 1) / 2;
+const int TILE_SIZE = GROUP_SIZE + 2 * RADIUS;
+const float weights[MAX_RADIUS + 1] = float[](WEIGHT_0, WEIGHT_1, WEIGHT_2, WEIGHT_3, WEIGHT_4, WEIGHT_5, WEIGHT_6, WEIGHT_7, WEIGHT_8);
+
+// holds the luma tile of both images first, then the horizontally blurred moments of every tile row
+shared float tile[5 * TILE_SIZE * GROUP_SIZE];
+
+struct Moments {
+    float meanTest;
+    float meanRef;
+    float varTest;
+    float varRef;
+    float covar;
+};
+
+vec2 loadLuma(ivec2 pos);
+
+uint lumaIndex(uint image, uint x, uint y) {
+    return image * TILE_SIZE * TILE_SIZE + y * TILE_SIZE + x;
+}
+
+uint momentIndex(uint moment, uint x, uint y) {
+    return (moment * TILE_SIZE + y) * GROUP_SIZE + x;
+}
+
+// must be called by all invocations, result is only valid for invocations inside the image
+Moments blurredMoments(ivec2 size) {
+    uint tid = gl_LocalInvocationIndex;
+    ivec2 origin = ivec2(gl_WorkGroupID.xy * GROUP_SIZE) - RADIUS;
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+
+    for (uint i = tid; i < TILE_SIZE * TILE_SIZE; i += GROUP_SIZE * GROUP_SIZE) {
+        uint tx = i % TILE_SIZE;
+        uint ty = i / TILE_SIZE;
+        ivec2 src = origin + ivec2(tx, ty);
+        vec2 luma = vec2(0.0);
+        if (all(greaterThanEqual(src, ivec2(0))) && all(lessThan(src, size))) {
+            luma = loadLuma(src);
+        }
+        tile[lumaIndex(0, tx, ty)] = luma.x;
+        tile[lumaIndex(1, tx, ty)] = luma.y;
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    // horizontal pass, each thread handles its column in up to two tile rows
+    // taps outside the image are skipped and the rest renormalized, same as the separate blur passes
+    float moments[2][5];
+    for (uint row = 0; row < 2; row++) {
+        uint ty = gl_LocalInvocationID.y + row * GROUP_SIZE;
+        for (uint m = 0; m < 5; m++) {
+            moments[row][m] = 0.0;
+        }
+        if (ty >= TILE_SIZE) {
+            continue;
+        }
+
+        float totalWeight = 0.0;
+        for (int offset = -RADIUS; offset <= RADIUS; offset++) {
+            int x = pos.x + offset;
+            if (x < 0 || x >= size.x) {
+                continue;
+            }
+            float weight = weights[abs(offset)];
+            uint tx = uint(int(gl_LocalInvocationID.x) + RADIUS + offset);
+            float lumaTest = tile[lumaIndex(0, tx, ty)];
+            float lumaRef = tile[lumaIndex(1, tx, ty)];
+            moments[row][0] += lumaTest * weight;
+            moments[row][1] += lumaRef * weight;
+            moments[row][2] += lumaTest * lumaTest * weight;
+            moments[row][3] += lumaRef * lumaRef * weight;
+            moments[row][4] += lumaTest * lumaRef * weight;
+            totalWeight += weight;
+        }
+        for (uint m = 0; m < 5; m++) {
+            moments[row][m] /= totalWeight;
+        }
+    }
+
+    // the luma tile is overwritten by the blurred moments
+    barrier();
+
+    for (uint row = 0; row < 2; row++) {
+        uint ty = gl_LocalInvocationID.y + row * GROUP_SIZE;
+        if (ty >= TILE_SIZE) {
+            continue;
+        }
+        for (uint m = 0; m < 5; m++) {
+            tile[momentIndex(m, gl_LocalInvocationID.x, ty)] = moments[row][m];
+        }
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    // vertical pass
+    float blurred[5] = float[5](0.0, 0.0, 0.0, 0.0, 0.0);
+    float totalWeight = 0.0;
+    for (int offset = -RADIUS; offset <= RADIUS; offset++) {
+        int y = pos.y + offset;
+        if (y < 0 || y >= size.y) {
+            continue;
+        }
+        float weight = weights[abs(offset)];
+        uint ty = uint(int(gl_LocalInvocationID.y) + RADIUS + offset);
+        for (uint m = 0; m < 5; m++) {
+            blurred[m] += tile[momentIndex(m, gl_LocalInvocationID.x, ty)] * weight;
+        }
+        totalWeight += weight;
+    }
+
+    Moments result;
+    result.meanTest = blurred[0] / totalWeight;
+    result.meanRef = blurred[1] / totalWeight;
+    result.varTest = blurred[2] / totalWeight - (result.meanTest * result.meanTest);
+    result.varRef = blurred[3] / totalWeight - (result.meanRef * result.meanRef);
+    result.covar = blurred[4] / totalWeight - (result.meanTest * result.meanRef);
+    return result;
+}
+
+float ssimValue(Moments moments, float k_1, float k_2) {
+    float c_1 = pow(k_1, 2);
+    float c_2 = pow(k_2, 2);
+
+    float smallPart = (2.0 * moments.covar + c_2) /  (moments.varTest + moments.varRef + c_2);
+    float bigPart = (2.0 * moments.meanTest * moments.meanRef + c_1) / (pow(moments.meanTest, 2.0) + pow(moments.meanRef, 2.0) + c_1);
+    return smallPart * bigPart;
+}
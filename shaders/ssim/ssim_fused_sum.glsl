@@ -0,0 +1,70 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+#extension GL_KHR_shader_subgroup_basic: enable
+#extension GL_KHR_shader_subgroup_arithmetic: enable
+
+#include "ssim_fused_shared.glsl"
+
+// same as the fused SSIM, but only sums the region without writing the map,
+// so tiles outside of the region are skipped
+
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D input_img[2];
+
+layout(std430, set = 0, binding = 1) buffer SumBuf {
+    float sums[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer MaskBuf {
+    float mask[];
+};
+
+#include "ssim_group_sum.glsl"
+
+layout( push_constant ) uniform constants {
+    float k_1;
+    float k_2;
+    // summed part of the image
+    ivec2 regionOffset;
+    ivec2 regionSize;
+    // weights pixels of the region by `mask`
+    uint masked;
+} push_consts;
+
+// Rec. 601 - same as openCV
+float luminance(vec4 color) {
+    return 0.299 * color.r + 0.587 * color.g + 0.114 * color.b;
+}
+
+// SSIM reference does the conversion in u8 format, so emulate that
+vec2 loadLuma(ivec2 pos) {
+    float lumaTest = round(luminance(imageLoad(input_img[0], pos)) * 255.0) / 255.0;
+    float lumaRef = round(luminance(imageLoad(input_img[1], pos)) * 255.0) / 255.0;
+    return vec2(lumaTest, lumaRef);
+}
+
+void main() {
+    ivec2 size = imageSize(input_img[0]);
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+
+    // the whole workgroup leaves together, so no barrier is left waiting
+    ivec2 tileStart = ivec2(gl_WorkGroupID.xy * GROUP_SIZE);
+    ivec2 regionEnd = push_consts.regionOffset + push_consts.regionSize;
+    if (any(greaterThanEqual(tileStart, regionEnd)) || any(lessThanEqual(tileStart + GROUP_SIZE, push_consts.regionOffset))) {
+        if (gl_LocalInvocationIndex == 0) {
+            sums[groupSumIndex()] = 0.0;
+            sums[gl_NumWorkGroups.x * gl_NumWorkGroups.y + groupSumIndex()] = 0.0;
+        }
+        return;
+    }
+
+    Moments moments = blurredMoments(size);
+
+    // region lies inside the image, so moments of invocations outside of it are never used
+    float weight = pixelWeight(pos, size.x, push_consts.regionOffset, push_consts.regionSize, push_consts.masked != 0);
+    storeGroupSum(weight > 0.0 ? ssimValue(moments, push_consts.k_1, push_consts.k_2) * weight : 0.0, weight);
+}
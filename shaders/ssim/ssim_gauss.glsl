@@ -10,12 +10,14 @@
 
 layout (local_size_x = 16, local_size_y = 16) in;
 
+// pipelines are specialized for kernel parameters, so weights of the unrolled loop are constant
+layout (constant_id = 0) const int KERNEL_SIZE = 11;
+layout (constant_id = 1) const float SIGMA = 1.5;
+
 layout(set = 0, binding = 0, r32f) uniform image2D output_img[5];
 layout(set = 0, binding = 1, r32f) uniform image2D temp_img;
 
 layout( push_constant ) uniform constants {
-    int kernelSize;
-    float sigma;
     int index;
 } push_consts;
 
@@ -31,8 +33,8 @@ void main() {
 
     float total = 0.0;
     float totalWeight = 0.0;
-    int start = -(push_consts.kernelSize - 1) / 2;
-    int end = (push_consts.kernelSize - 1) / 2;
+    const int start = -(KERNEL_SIZE - 1) / 2;
+    const int end = (KERNEL_SIZE - 1) / 2;
 
     // vertical blur
     for (int yOffset = start; yOffset <= end; yOffset++) {
@@ -41,7 +43,7 @@ void main() {
         if (y >= size.y || y < 0) {
             continue;
         }
-        float weight = gaussWeight(yOffset, push_consts.sigma);
+        float weight = gaussWeight(yOffset, SIGMA);
         total += imageLoad(temp_img, ivec2(x, y)).x * weight;
         totalWeight += weight;
     }
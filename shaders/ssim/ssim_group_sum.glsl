@@ -0,0 +1,48 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+// Sum of one value per invocation of the workgroup, stored into `sums` at index of the workgroup.
+// Including shader enables subgroup arithmetic and declares the `sums` and `mask` buffers.
+
+// one partial result per subgroup, at most one per invocation of the 16x16 workgroup
+shared vec2 subgroupSums[256];
+
+// weight of the pixel in the sum, zero outside of the summed region
+float pixelWeight(ivec2 pos, int width, ivec2 regionOffset, ivec2 regionSize, bool masked) {
+    bool inRegion = all(greaterThanEqual(pos, regionOffset)) && all(lessThan(pos, regionOffset + regionSize));
+    if (!inRegion) {
+        return 0.0;
+    }
+    return masked ? mask[pos.y * width + pos.x] : 1.0;
+}
+
+uint groupSumIndex() {
+    return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+}
+
+// must be called by all invocations,
+// sum of `weight` is stored one workgroup count after the sum of values
+void storeGroupSum(float value, float weight) {
+    vec2 pair = subgroupAdd(vec2(value, weight));
+    if (subgroupElect()) {
+        subgroupSums[gl_SubgroupID] = pair;
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    if (gl_SubgroupID == 0) {
+        vec2 sum = vec2(0.0);
+        for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize) {
+            sum += subgroupSums[i];
+        }
+        sum = subgroupAdd(sum);
+
+        if (subgroupElect()) {
+            sums[groupSumIndex()] = sum.x;
+            sums[gl_NumWorkGroups.x * gl_NumWorkGroups.y + groupSumIndex()] = sum.y;
+        }
+    }
+}
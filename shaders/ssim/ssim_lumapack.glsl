@@ -6,6 +6,8 @@
 #version 450
 #pragma shader_stage(compute)
 
+#include "ssim_shared.glsl"
+
 layout (local_size_x = 16, local_size_y = 16) in;
 
 layout(set = 0, binding = 0, rgba8) uniform readonly image2D input_img[2];
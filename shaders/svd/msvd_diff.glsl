@@ -0,0 +1,38 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#version 450
+#pragma shader_stage(compute)
+
+layout (local_size_x = 256, local_size_y = 1) in;
+
+layout(std430, set = 0, binding = 0) buffer InOutBuf {
+    float data[];
+};
+
+layout(std430, set = 0, binding = 1) buffer SortedBuf {
+    float sortedData[];
+};
+
+layout( push_constant ) uniform constants {
+    // number of values
+    uint size;
+} push_consts;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= push_consts.size) {
+        return;
+    }
+
+    float median;
+    if (push_consts.size % 2 == 0) {
+        median = (sortedData[push_consts.size / 2 - 1] + sortedData[push_consts.size / 2]);
+    } else {
+        median = sortedData[push_consts.size / 2];
+    }
+
+    data[i] = abs(data[i] - median);
+}
@@ -11,20 +11,35 @@ static std::vector<uint32_t> src =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::Colorize::Colorize(const vk::raii::Device &device):
-descPool(VulkanRuntime::createDescPool(device, 8, {
-    vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 8}
-})) {
+IQM::Colorize::Colorize(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
     const auto sm = VulkanRuntime::createShaderModule(device, src);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 1},
         {vk::DescriptorType::eStorageImage, 1},
         {vk::DescriptorType::eStorageImage, 1},
     });
 
+    const auto ranges = VulkanRuntime::createPushConstantRange(2 * sizeof(int));
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, ranges);
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, sm, this->shared->layout, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::Colorize::Colorize(const vk::raii::Device &device, const Colorize &other):
+shared(other.shared) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::Colorize::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, 8, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 8}
+    });
+
     const std::vector allDescLayouts = {
-        *this->descSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -35,10 +50,6 @@ descPool(VulkanRuntime::createDescPool(device, 8, {
 
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->descSet = std::move(sets[0]);
-
-    const auto ranges = VulkanRuntime::createPushConstantRange(2 * sizeof(int));
-    this->layout = VulkanRuntime::createPipelineLayout(device, {this->descSetLayout}, ranges);
-    this->pipeline = VulkanRuntime::createComputePipeline(device, sm, this->layout);
 }
 
 void IQM::Colorize::compute(const ColorizeInput &input) {
@@ -68,10 +79,10 @@ void IQM::Colorize::compute(const ColorizeInput &input) {
         writeSetInput, writeSetOutput, writeSetColormap,
     }, nullptr);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
-    input.cmdBuf->pushConstants<int>(this->layout, vk::ShaderStageFlagBits::eCompute, 0, input.invert);
-    input.cmdBuf->pushConstants<float>(this->layout, vk::ShaderStageFlagBits::eCompute, sizeof(int), input.scaler);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
+    input.cmdBuf->pushConstants<int>(this->shared->layout, vk::ShaderStageFlagBits::eCompute, 0, input.invert);
+    input.cmdBuf->pushConstants<float>(this->shared->layout, vk::ShaderStageFlagBits::eCompute, sizeof(int), input.scaler);
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
@@ -0,0 +1,108 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <IQM/base/downsample.h>
+
+#include <string>
+
+static std::vector<uint32_t> src =
+#include <base/downsample.inc>
+;
+
+using IQM::GPU::VulkanRuntime;
+
+IQM::Downsample::Downsample(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
+    const auto sm = VulkanRuntime::createShaderModule(device, src);
+
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
+        {vk::DescriptorType::eStorageImage, 2},
+        {vk::DescriptorType::eStorageImage, 2},
+    });
+
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayout}, {});
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, sm, this->shared->layout, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::Downsample::Downsample(const vk::raii::Device &device, const Downsample &other):
+shared(other.shared) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::Downsample::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, MAX_LEVELS, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 4 * MAX_LEVELS}
+    });
+
+    const std::vector allDescLayouts(MAX_LEVELS, *this->shared->descSetLayout);
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .descriptorPool = this->descPool,
+        .descriptorSetCount = static_cast<uint32_t>(allDescLayouts.size()),
+        .pSetLayouts = allDescLayouts.data()
+    };
+
+    auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
+    for (auto &set : sets) {
+        this->descSets.push_back(std::move(set));
+    }
+}
+
+void IQM::Downsample::compute(const DownsampleInput &input) {
+    const auto levels = static_cast<unsigned>(input.ivLevelsTest.size());
+    if (levels == 0) {
+        return;
+    }
+    if (levels > MAX_LEVELS || input.ivLevelsRef.size() != levels) {
+        throw std::runtime_error("Mip chain supports up to " + std::to_string(MAX_LEVELS) + " levels of both images");
+    }
+    if ((input.width >> levels) == 0 || (input.height >> levels) == 0) {
+        throw std::runtime_error("Images are too small for " + std::to_string(levels) + " mip levels");
+    }
+
+    // write sets point into these, so all of them have to outlive the update
+    std::vector<std::vector<vk::DescriptorImageInfo>> imageInfos;
+    imageInfos.push_back(VulkanRuntime::createImageInfos({input.ivTest, input.ivRef}));
+    for (unsigned i = 0; i < levels; i++) {
+        imageInfos.push_back(VulkanRuntime::createImageInfos({input.ivLevelsTest[i], input.ivLevelsRef[i]}));
+    }
+
+    std::vector<vk::WriteDescriptorSet> writeSets;
+    for (unsigned i = 0; i < levels; i++) {
+        writeSets.push_back(VulkanRuntime::createWriteSet(this->descSets[i], 0, imageInfos[i]));
+        writeSets.push_back(VulkanRuntime::createWriteSet(this->descSets[i], 1, imageInfos[i + 1]));
+    }
+    input.device->updateDescriptorSets(writeSets, nullptr);
+
+    vk::MemoryBarrier memoryBarrier = {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    for (unsigned i = 0; i < levels; i++) {
+        if (i != 0) {
+            input.cmdBuf->pipelineBarrier(
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+            );
+        }
+
+        //shaders work in 16x16 tiles
+        const auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width >> (i + 1), input.height >> (i + 1), 16);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSets[i]}, {});
+        input.cmdBuf->dispatch(groupsX, groupsY, 1);
+    }
+
+    memoryBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead;
+    input.cmdBuf->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+    );
+}
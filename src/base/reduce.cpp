@@ -0,0 +1,209 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <IQM/base/reduce.h>
+
+#include <algorithm>
+#include <array>
+
+static std::vector<uint32_t> src =
+#include <base/reduce.inc>
+;
+
+static std::vector<uint32_t> srcGrid =
+#include <base/reduce_grid.inc>
+;
+
+using IQM::GPU::VulkanRuntime;
+
+// threads of one workgroup
+static constexpr unsigned REDUCE_SIZE = 256;
+// arrays up to this size are reduced by a single workgroup
+static constexpr unsigned SINGLE_PASS_SIZE = REDUCE_SIZE * 64;
+// workgroups of the first pass, enough to saturate memory bandwidth
+static constexpr unsigned MAX_GROUPS = 1024;
+
+static constexpr unsigned PASS_FIRST = 1;
+static constexpr unsigned PASS_LAST = 2;
+
+IQM::Reduce::Reduce(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
+    const auto sm = VulkanRuntime::createShaderModule(device, src);
+    const auto smGrid = VulkanRuntime::createShaderModule(device, srcGrid);
+
+    // grid output is only used by the grid pipeline
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
+        {vk::DescriptorType::eStorageBuffer, 1},
+        {vk::DescriptorType::eStorageBuffer, 1},
+        {vk::DescriptorType::eStorageBuffer, 1},
+    });
+
+    // 8x uint - offset, stride, size, step, chunk, op, pass, total
+    // grid uses the first 6 - offset, width, height, cell, weighting, weight offset
+    const auto ranges = VulkanRuntime::createPushConstantRange(8 * sizeof(uint32_t));
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, ranges);
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, sm, this->shared->layout, cache);
+    this->shared->pipelineGrid = VulkanRuntime::createComputePipeline(device, smGrid, this->shared->layout, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::Reduce::Reduce(const vk::raii::Device &device, const Reduce &other):
+shared(other.shared) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::Reduce::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, 1, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 3}
+    });
+
+    const std::vector allDescLayouts = {
+        *this->shared->descSetLayout,
+    };
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .descriptorPool = this->descPool,
+        .descriptorSetCount = static_cast<uint32_t>(allDescLayouts.size()),
+        .pSetLayouts = allDescLayouts.data()
+    };
+
+    auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
+    this->descSet = std::move(sets[0]);
+}
+
+void IQM::Reduce::setUpDescriptors(const vk::raii::Device &device, const vk::raii::Buffer &buffer, const vk::DeviceSize range) const {
+    // weights are only read by the weighted mean, so the reduced buffer stands in for them
+    this->setUpDescriptors(device, buffer, range, buffer, range);
+}
+
+void IQM::Reduce::setUpDescriptors(const vk::raii::Device &device, const vk::raii::Buffer &buffer, const vk::DeviceSize range, const vk::raii::Buffer &weights, const vk::DeviceSize weightRange) const {
+    const std::vector bufInfos = {
+        vk::DescriptorBufferInfo{
+            .buffer = *buffer,
+            .offset = 0,
+            .range = range,
+        }
+    };
+
+    const std::vector weightInfos = {
+        vk::DescriptorBufferInfo{
+            .buffer = *weights,
+            .offset = 0,
+            .range = weightRange,
+        }
+    };
+
+    const auto writeSet = VulkanRuntime::createWriteSet(
+        this->descSet,
+        0,
+        bufInfos
+    );
+
+    const auto writeSetWeights = VulkanRuntime::createWriteSet(
+        this->descSet,
+        1,
+        weightInfos
+    );
+
+    device.updateDescriptorSets({writeSet, writeSetWeights}, nullptr);
+}
+
+void IQM::Reduce::setUpGrid(const vk::raii::Device &device, const vk::raii::Buffer &grid, const vk::DeviceSize range) const {
+    const std::vector gridInfos = {
+        vk::DescriptorBufferInfo{
+            .buffer = *grid,
+            .offset = 0,
+            .range = range,
+        }
+    };
+
+    const auto writeSet = VulkanRuntime::createWriteSet(
+        this->descSet,
+        2,
+        gridInfos
+    );
+
+    device.updateDescriptorSets({writeSet}, nullptr);
+}
+
+vk::Extent2D IQM::Reduce::gridExtent(const unsigned width, const unsigned height, const unsigned cell) {
+    return vk::Extent2D{(width + cell - 1) / cell, (height + cell - 1) / cell};
+}
+
+void IQM::Reduce::grid(const ReduceGridInput &input) const {
+    const auto extent = gridExtent(input.width, input.height, input.cell);
+    if (extent.width == 0 || extent.height == 0) {
+        return;
+    }
+
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineGrid);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
+
+    const std::array<uint32_t, 6> values = {
+        input.offset,
+        input.width,
+        input.height,
+        input.cell,
+        static_cast<uint32_t>(input.weights),
+        input.weightOffset,
+    };
+    input.cmdBuf->pushConstants<std::array<uint32_t, 6>>(this->shared->layout, vk::ShaderStageFlagBits::eCompute, 0, values);
+    input.cmdBuf->dispatch(extent.width, extent.height, 1);
+
+    barrier(*input.cmdBuf);
+}
+
+void IQM::Reduce::reduce(const ReduceInput &input) const {
+    if (input.size == 0 || input.count == 0) {
+        return;
+    }
+
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
+
+    if (input.size <= SINGLE_PASS_SIZE) {
+        this->dispatch(input, input.size, 1, input.size, 1, PASS_FIRST | PASS_LAST);
+        return;
+    }
+
+    const auto groups = std::min((input.size + SINGLE_PASS_SIZE - 1) / SINGLE_PASS_SIZE * 4, MAX_GROUPS);
+    const auto chunk = (input.size + groups - 1) / groups;
+    // rounding of the chunk can leave the last groups empty
+    const auto usedGroups = (input.size + chunk - 1) / chunk;
+
+    this->dispatch(input, input.size, 1, chunk, usedGroups, PASS_FIRST);
+    this->dispatch(input, usedGroups, chunk, usedGroups, 1, PASS_LAST);
+}
+
+void IQM::Reduce::dispatch(const ReduceInput &input, const unsigned size, const unsigned step, const unsigned chunk, const unsigned groups, const unsigned pass) const {
+    const std::array<uint32_t, 8> values = {
+        input.offset,
+        input.stride,
+        size,
+        step,
+        chunk,
+        static_cast<uint32_t>(input.op),
+        pass,
+        input.size,
+    };
+    input.cmdBuf->pushConstants<std::array<uint32_t, 8>>(this->shared->layout, vk::ShaderStageFlagBits::eCompute, 0, values);
+    input.cmdBuf->dispatch(groups, input.count, 1);
+
+    barrier(*input.cmdBuf);
+}
+
+void IQM::Reduce::barrier(const vk::raii::CommandBuffer &cmdBuf) {
+    vk::MemoryBarrier memoryBarrier = {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
+    };
+
+    cmdBuf.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+    );
+}
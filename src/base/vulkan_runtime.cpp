@@ -36,7 +36,8 @@ vk::raii::PipelineLayout IQM::GPU::VulkanRuntime::createPipelineLayout(
 vk::raii::Pipeline IQM::GPU::VulkanRuntime::createComputePipeline(
     const vk::raii::Device &device,
     const vk::raii::ShaderModule &shader,
-    const vk::raii::PipelineLayout &layout) {
+    const vk::raii::PipelineLayout &layout,
+    const vk::raii::PipelineCache *cache) {
     vk::ComputePipelineCreateInfo computePipelineCreateInfo{
         .stage = vk::PipelineShaderStageCreateInfo {
             .stage = vk::ShaderStageFlagBits::eCompute,
@@ -47,7 +48,27 @@ vk::raii::Pipeline IQM::GPU::VulkanRuntime::createComputePipeline(
         .layout = layout
     };
 
-    return std::move(vk::raii::Pipelines{device, nullptr, computePipelineCreateInfo}.front());
+    return std::move(vk::raii::Pipelines{device, cache, computePipelineCreateInfo}.front());
+}
+
+vk::raii::Pipeline IQM::GPU::VulkanRuntime::createComputePipeline(
+    const vk::raii::Device &device,
+    const vk::raii::ShaderModule &shader,
+    const vk::raii::PipelineLayout &layout,
+    const vk::SpecializationInfo &specInfo,
+    const vk::raii::PipelineCache *cache) {
+    vk::ComputePipelineCreateInfo computePipelineCreateInfo{
+        .stage = vk::PipelineShaderStageCreateInfo {
+            .stage = vk::ShaderStageFlagBits::eCompute,
+            .module = shader,
+            // all shaders will start in main
+            .pName = "main",
+            .pSpecializationInfo = &specInfo,
+        },
+        .layout = layout
+    };
+
+    return std::move(vk::raii::Pipelines{device, cache, computePipelineCreateInfo}.front());
 }
 
 uint32_t findMemoryType(vk::PhysicalDeviceMemoryProperties const &memoryProperties, uint32_t typeBits, vk::MemoryPropertyFlags requirementsMask) {
@@ -30,18 +30,21 @@ static std::vector<uint32_t> srcErrCombine =
 #include <flip/combine_error_maps.inc>
 ;
 
-static std::vector<uint32_t> srcSum =
-#include <flip/sum.inc>
-;
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FLIP::FLIP(const vk::raii::Device &device):
-descPool(VulkanRuntime::createDescPool(device, 64, {
-    vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 128},
-    vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 32}
-})),
-colorPipeline(device, descPool)
+static vk::raii::DescriptorPool flip_desc_pool(const vk::raii::Device &device) {
+    return VulkanRuntime::createDescPool(device, 64, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 128},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 32}
+    });
+}
+
+IQM::FLIP::FLIP(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+descPool(flip_desc_pool(device)),
+colorPipeline(device, descPool, cache),
+reduce(device, cache)
 {
     const auto smInputConvert = VulkanRuntime::createShaderModule(device, srcInputConvert);
     const auto smFeatureFilterCreate = VulkanRuntime::createShaderModule(device, srcFeatureFilterCreate);
@@ -49,45 +52,69 @@ colorPipeline(device, descPool)
     const auto smFeatureFilterHorizontal = VulkanRuntime::createShaderModule(device, srcFeatureFilterHorizontal);
     const auto smFeatureDetect = VulkanRuntime::createShaderModule(device, srcFeatureDetect);
     const auto smErrorCombine = VulkanRuntime::createShaderModule(device, srcErrCombine);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcSum);
 
-    this->inputConvertDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->inputConvertDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageBuffer, 2},
     });
 
-    this->featureFilterCreateDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->featureFilterCreateDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 1},
     });
 
-    this->featureFilterHorizontalDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->featureFilterHorizontalDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageImage, 1},
     });
 
-    this->featureDetectDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->featureDetectDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageImage, 1},
     });
 
-    this->errorCombineDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->errorCombineDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->sumDescSetLayout = VulkanRuntime::createDescLayout(device, {
-        {vk::DescriptorType::eStorageBuffer, 1},
-    });
+    this->shared->inputConvertLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->inputConvertDescSetLayout}, {});
+    this->shared->inputConvertPipeline = VulkanRuntime::createComputePipeline(device, smInputConvert, this->shared->inputConvertLayout, cache);
+
+    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(float));
+    this->shared->featureFilterCreateLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->featureFilterCreateDescSetLayout}, ranges);
+    this->shared->featureFilterCreatePipeline = VulkanRuntime::createComputePipeline(device, smFeatureFilterCreate, this->shared->featureFilterCreateLayout, cache);
+    this->shared->featureFilterNormalizePipeline = VulkanRuntime::createComputePipeline(device, smFeatureFilterNormalize, this->shared->featureFilterCreateLayout, cache);
+
+    const auto rangesHor = VulkanRuntime::createPushConstantRange(3 * sizeof(unsigned));
+    this->shared->featureFilterHorizontalLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->featureFilterHorizontalDescSetLayout}, rangesHor);
+    this->shared->featureFilterHorizontalPipeline = VulkanRuntime::createComputePipeline(device, smFeatureFilterHorizontal, this->shared->featureFilterHorizontalLayout, cache);
+
+    this->shared->featureDetectLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->featureDetectDescSetLayout}, rangesHor);
+    this->shared->featureDetectPipeline = VulkanRuntime::createComputePipeline(device, smFeatureDetect, this->shared->featureDetectLayout, cache);
+
+    this->shared->errorCombineLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->errorCombineDescSetLayout}, ranges);
+    this->shared->errorCombinePipeline = VulkanRuntime::createComputePipeline(device, smErrorCombine, this->shared->errorCombineLayout, cache);
 
+    this->allocateDescriptors(device);
+}
+
+IQM::FLIP::FLIP(const vk::raii::Device &device, const FLIP &other):
+shared(other.shared),
+descPool(flip_desc_pool(device)),
+colorPipeline(device, descPool, other.colorPipeline),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::FLIP::allocateDescriptors(const vk::raii::Device &device) {
     const std::vector allDescLayouts = {
-        *this->inputConvertDescSetLayout,
-        *this->featureFilterCreateDescSetLayout,
-        *this->featureFilterHorizontalDescSetLayout,
-        *this->featureDetectDescSetLayout,
-        *this->errorCombineDescSetLayout,
-        *this->sumDescSetLayout,
+        *this->shared->inputConvertDescSetLayout,
+        *this->shared->featureFilterCreateDescSetLayout,
+        *this->shared->featureFilterHorizontalDescSetLayout,
+        *this->shared->featureDetectDescSetLayout,
+        *this->shared->errorCombineDescSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -102,28 +129,6 @@ colorPipeline(device, descPool)
     this->featureFilterHorizontalDescSet = std::move(sets[2]);
     this->featureDetectDescSet = std::move(sets[3]);
     this->errorCombineDescSet = std::move(sets[4]);
-    this->sumDescSet = std::move(sets[5]);
-
-    this->inputConvertLayout = VulkanRuntime::createPipelineLayout(device, {this->inputConvertDescSetLayout}, {});
-    this->inputConvertPipeline = VulkanRuntime::createComputePipeline(device, smInputConvert, this->inputConvertLayout);
-
-    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(float));
-    this->featureFilterCreateLayout = VulkanRuntime::createPipelineLayout(device, {this->featureFilterCreateDescSetLayout}, ranges);
-    this->featureFilterCreatePipeline = VulkanRuntime::createComputePipeline(device, smFeatureFilterCreate, this->featureFilterCreateLayout);
-    this->featureFilterNormalizePipeline = VulkanRuntime::createComputePipeline(device, smFeatureFilterNormalize, this->featureFilterCreateLayout);
-
-    const auto rangesHor = VulkanRuntime::createPushConstantRange(3 * sizeof(unsigned));
-    this->featureFilterHorizontalLayout = VulkanRuntime::createPipelineLayout(device, {this->featureFilterHorizontalDescSetLayout}, rangesHor);
-    this->featureFilterHorizontalPipeline = VulkanRuntime::createComputePipeline(device, smFeatureFilterHorizontal, this->featureFilterHorizontalLayout);
-
-    this->featureDetectLayout = VulkanRuntime::createPipelineLayout(device, {this->featureDetectDescSetLayout}, rangesHor);
-    this->featureDetectPipeline = VulkanRuntime::createComputePipeline(device, smFeatureDetect, this->featureDetectLayout);
-
-    this->errorCombineLayout = VulkanRuntime::createPipelineLayout(device, {this->errorCombineDescSetLayout}, ranges);
-    this->errorCombinePipeline = VulkanRuntime::createComputePipeline(device, smErrorCombine, this->errorCombineLayout);
-
-    this->sumLayout = VulkanRuntime::createPipelineLayout(device, {this->sumDescSetLayout}, ranges);
-    this->sumPipeline = VulkanRuntime::createComputePipeline(device, smSum, this->sumLayout);
 }
 
 void IQM::FLIP::computeMetric(const FLIPInput &input) {
@@ -153,8 +158,8 @@ unsigned IQM::FLIP::featureKernelSize(const FLIPArguments &args) {
 }
 
 void IQM::FLIP::convertToYCxCz(const FLIPInput& input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->inputConvertPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->inputConvertLayout, 0, {this->inputConvertDescSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->inputConvertPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->inputConvertLayout, 0, {this->inputConvertDescSet}, {});
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
@@ -166,9 +171,9 @@ void IQM::FLIP::createFeatureFilters(const FLIPInput& input) {
     float pixelsPerDegree = FLIP::pixelsPerDegree(input.args);
     int gaussianKernelSize = FLIP::featureKernelSize(input.args);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->featureFilterCreatePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->featureFilterCreateLayout, 0, {this->featureFilterCreateDescSet}, {});
-    input.cmdBuf->pushConstants<float>(this->featureFilterCreateLayout, vk::ShaderStageFlagBits::eCompute, 0, pixelsPerDegree);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->featureFilterCreatePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->featureFilterCreateLayout, 0, {this->featureFilterCreateDescSet}, {});
+    input.cmdBuf->pushConstants<float>(this->shared->featureFilterCreateLayout, vk::ShaderStageFlagBits::eCompute, 0, pixelsPerDegree);
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(gaussianKernelSize, gaussianKernelSize, 16);
@@ -186,9 +191,9 @@ void IQM::FLIP::createFeatureFilters(const FLIPInput& input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->featureFilterNormalizePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->featureFilterCreateLayout, 0, {this->featureFilterCreateDescSet}, {});
-    input.cmdBuf->pushConstants<float>(this->featureFilterCreateLayout, vk::ShaderStageFlagBits::eCompute, 0, pixelsPerDegree);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->featureFilterNormalizePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->featureFilterCreateLayout, 0, {this->featureFilterCreateDescSet}, {});
+    input.cmdBuf->pushConstants<float>(this->shared->featureFilterCreateLayout, vk::ShaderStageFlagBits::eCompute, 0, pixelsPerDegree);
 
     input.cmdBuf->dispatch(groupsX, 1, 2);
 }
@@ -205,11 +210,11 @@ void IQM::FLIP::computeFeatureErrorMap(const FLIPInput& input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->featureFilterHorizontalPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->featureFilterHorizontalLayout, 0, {this->featureFilterHorizontalDescSet}, {});
-    input.cmdBuf->pushConstants<uint32_t>(this->featureFilterHorizontalLayout, vk::ShaderStageFlagBits::eCompute, 0 * sizeof(float), input.width * input.height);
-    input.cmdBuf->pushConstants<uint32_t>(this->featureFilterHorizontalLayout, vk::ShaderStageFlagBits::eCompute, 1 * sizeof(float), input.width);
-    input.cmdBuf->pushConstants<uint32_t>(this->featureFilterHorizontalLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(float), input.height);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->featureFilterHorizontalPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->featureFilterHorizontalLayout, 0, {this->featureFilterHorizontalDescSet}, {});
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->featureFilterHorizontalLayout, vk::ShaderStageFlagBits::eCompute, 0 * sizeof(float), input.width * input.height);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->featureFilterHorizontalLayout, vk::ShaderStageFlagBits::eCompute, 1 * sizeof(float), input.width);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->featureFilterHorizontalLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(float), input.height);
 
     auto groups = VulkanRuntime::compute1DGroupCount(input.width * input.height, 1024);
 
@@ -221,11 +226,11 @@ void IQM::FLIP::computeFeatureErrorMap(const FLIPInput& input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->featureDetectPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->featureDetectLayout, 0, {this->featureDetectDescSet}, {});
-    input.cmdBuf->pushConstants<uint32_t>(this->featureDetectLayout, vk::ShaderStageFlagBits::eCompute, 0 * sizeof(float), input.width * input.height);
-    input.cmdBuf->pushConstants<uint32_t>(this->featureDetectLayout, vk::ShaderStageFlagBits::eCompute, 1 * sizeof(float), input.width);
-    input.cmdBuf->pushConstants<uint32_t>(this->featureDetectLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(float), input.height);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->featureDetectPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->featureDetectLayout, 0, {this->featureDetectDescSet}, {});
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->featureDetectLayout, vk::ShaderStageFlagBits::eCompute, 0 * sizeof(float), input.width * input.height);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->featureDetectLayout, vk::ShaderStageFlagBits::eCompute, 1 * sizeof(float), input.width);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->featureDetectLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(float), input.height);
 
     input.cmdBuf->dispatch(groups, 1, 1);
 
@@ -248,9 +253,9 @@ void IQM::FLIP::computeFinalErrorMap(const FLIPInput& input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->errorCombinePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->errorCombineLayout, 0, {this->errorCombineDescSet}, {});
-    input.cmdBuf->pushConstants<uint32_t>(this->errorCombineLayout, vk::ShaderStageFlagBits::eCompute, 0, input.width * input.height);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->errorCombinePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->errorCombineLayout, 0, {this->errorCombineDescSet}, {});
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->errorCombineLayout, vk::ShaderStageFlagBits::eCompute, 0, input.width * input.height);
 
     auto groups = VulkanRuntime::compute1DGroupCount(input.width * input.height, 1024);
 
@@ -290,40 +295,69 @@ void IQM::FLIP::computeFinalErrorMap(const FLIPInput& input) {
 }
 
 void IQM::FLIP::computeMean(const FLIPInput &input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->sumPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->sumLayout, 0, {this->sumDescSet}, {});
+    uint32_t bufferSize = (input.width) * (input.height);
 
-    const auto sumSize = 1024;
+    if (input.bufGrid != nullptr) {
+        // computed before the map is reduced or replaced by the summed region
+        this->reduce.grid(ReduceGridInput{
+            .cmdBuf = input.cmdBuf,
+            .width = input.width,
+            .height = input.height,
+            .cell = input.gridCell,
+            .weights = input.mask.enabled() ? GridWeights::Buffer : GridWeights::None,
+        });
+    }
 
-    uint32_t bufferSize = (input.width) * (input.height);
-    uint64_t groups = (bufferSize / sumSize) + 1;
-    uint32_t size = bufferSize;
+    if (input.mask.enabled()) {
+        // the final error map is still at the start of the buffer, in the same layout as the mask
+        this->reduce.reduce(ReduceInput{
+            .cmdBuf = input.cmdBuf,
+            .op = ReduceOp::WeightedMean,
+            .size = bufferSize,
+        });
+        return;
+    }
+
+    if (input.sumRegion.extent.width != 0 && input.sumRegion.extent.height != 0) {
+        // final error map is already copied to `imgOut`, so the region can be packed to the start of the buffer
+        vk::MemoryBarrier memoryBarrier = {
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eTransferRead,
+            .dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
+        };
+        input.cmdBuf->pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+        );
 
-    for (;;) {
-        input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, size);
-        input.cmdBuf->dispatch(groups, 1, 1);
+        vk::BufferImageCopy region = {
+            .bufferOffset = 0,
+            .bufferRowLength = input.sumRegion.extent.width,
+            .bufferImageHeight = input.sumRegion.extent.height,
+            .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+            .imageOffset = vk::Offset3D{input.sumRegion.offset.x, input.sumRegion.offset.y, 0},
+            .imageExtent = vk::Extent3D{input.sumRegion.extent.width, input.sumRegion.extent.height, 1}
+        };
+        input.cmdBuf->copyImageToBuffer(*input.imgOut, vk::ImageLayout::eGeneral, *input.buffer, {region});
 
-        vk::BufferMemoryBarrier barrier = {
-            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-            .buffer = *input.buffer,
-            .offset = 0,
-            .size = bufferSize * sizeof(float),
+        memoryBarrier = {
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
         };
         input.cmdBuf->pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
             vk::PipelineStageFlagBits::eComputeShader,
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::DependencyFlagBits::eDeviceGroup,
-            {},
-            {barrier},
-            {}
+            vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
         );
-        if (groups == 1) {
-            break;
-        }
-        size = groups;
-        groups = (groups / sumSize) + 1;
+
+        bufferSize = input.sumRegion.extent.width * input.sumRegion.extent.height;
     }
+
+    this->reduce.reduce(ReduceInput{
+        .cmdBuf = input.cmdBuf,
+        .op = ReduceOp::Sum,
+        .size = bufferSize,
+    });
 }
 
 void IQM::FLIP::setUpDescriptors(const FLIPInput& input) {
@@ -460,18 +494,21 @@ void IQM::FLIP::setUpDescriptors(const FLIPInput& input) {
         outBufInfo
     );
 
-    auto writeSetSum = VulkanRuntime::createWriteSet(
-        this->sumDescSet,
-        0,
-        outBufInfo
-    );
-
     input.device->updateDescriptorSets({
         writeSetConvertInput, writeSetConvertOutput,
         writeSetFeatureFilter,
         writeSetHorizontalInput, writeSetHorizontalFilters, writeSetHorizontalOutput,
         writeSetDetectInput, writeSetDetectFilters, writeSetDetectOutput,
         writeSetFinalIn, writeSetFinalOut,
-        writeSetSum
     }, nullptr);
+
+    if (input.mask.enabled()) {
+        this->reduce.setUpDescriptors(*input.device, *input.buffer, floatRange, *input.mask.buffer, floatRange);
+    } else {
+        this->reduce.setUpDescriptors(*input.device, *input.buffer, floatRange);
+    }
+    if (input.bufGrid != nullptr) {
+        const auto grid = Reduce::gridExtent(input.width, input.height, input.gridCell);
+        this->reduce.setUpGrid(*input.device, *input.bufGrid, grid.width * grid.height * sizeof(float));
+    }
 }
@@ -5,6 +5,7 @@
 
 #include <IQM/flip/color_pipeline.h>
 #include <IQM/flip.h>
+#include <array>
 
 static std::vector<uint32_t> srcHorizontal =
 #include <flip/spatial_prefilter_horizontal.inc>
@@ -20,20 +21,37 @@ static std::vector<uint32_t> srcDetect =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FLIPColorPipeline::FLIPColorPipeline(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
-    const auto smCsfPrefilterHorizontal = VulkanRuntime::createShaderModule(device, srcHorizontal);
-    const auto smCsfPrefilter = VulkanRuntime::createShaderModule(device, srcPrefilter);
+IQM::FLIPColorPipeline::FLIPColorPipeline(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
+    this->shared->pipelineCache = cache;
+
     const auto smSpatialDetect = VulkanRuntime::createShaderModule(device, srcDetect);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
+    const auto ranges = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
+    this->shared->csfPrefilterLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, ranges);
+
+    const auto rangesDetect = VulkanRuntime::createPushConstantRange(sizeof(uint32_t));
+    this->shared->spatialDetectLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, rangesDetect);
+    this->shared->spatialDetectPipeline = VulkanRuntime::createComputePipeline(device, smSpatialDetect, this->shared->spatialDetectLayout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FLIPColorPipeline::FLIPColorPipeline(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FLIPColorPipeline &other):
+shared(other.shared) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FLIPColorPipeline::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector allDescLayouts = {
-        *this->descSetLayout,
-        *this->descSetLayout,
-        *this->descSetLayout,
+        *this->shared->descSetLayout,
+        *this->shared->descSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -46,25 +64,53 @@ IQM::FLIPColorPipeline::FLIPColorPipeline(const vk::raii::Device &device, const
     this->csfPrefilterHorizontalDescSet = std::move(sets[0]);
     this->csfPrefilterDescSet = std::move(sets[1]);
     this->spatialDetectDescSet = std::move(sets[2]);
+}
 
-    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(float) + 4 * sizeof(uint32_t));
-    this->csfPrefilterLayout = VulkanRuntime::createPipelineLayout(device, {this->descSetLayout}, ranges);
-    this->csfPrefilterHorizontalPipeline = VulkanRuntime::createComputePipeline(device, smCsfPrefilterHorizontal, this->csfPrefilterLayout);
-    this->csfPrefilterPipeline = VulkanRuntime::createComputePipeline(device, smCsfPrefilter, this->csfPrefilterLayout);
+const IQM::FLIPColorPipeline::PrefilterPipelines& IQM::FLIPColorPipeline::specializedPrefilter(const FLIPInput& input, const float pixels_per_degree) {
+    if (const auto it = this->shared->prefilterPipelines.find(pixels_per_degree); it != this->shared->prefilterPipelines.end()) {
+        return it->second;
+    }
+
+    // radius and distance between taps in degrees
+    struct {
+        int32_t radius;
+        float deltaX;
+    } constants = {
+        .radius = static_cast<int32_t>(FLIP::spatialKernelSize(input.args) - 1) / 2,
+        .deltaX = 1.0f / pixels_per_degree,
+    };
 
-    const auto rangesDetect = VulkanRuntime::createPushConstantRange(sizeof(uint32_t));
-    this->spatialDetectLayout = VulkanRuntime::createPipelineLayout(device, {this->descSetLayout}, rangesDetect);
-    this->spatialDetectPipeline = VulkanRuntime::createComputePipeline(device, smSpatialDetect, this->spatialDetectLayout);
+    const std::array entries = {
+        vk::SpecializationMapEntry{0, offsetof(decltype(constants), radius), sizeof(int32_t)},
+        vk::SpecializationMapEntry{1, offsetof(decltype(constants), deltaX), sizeof(float)},
+    };
+
+    const vk::SpecializationInfo specInfo{
+        static_cast<uint32_t>(entries.size()),
+        entries.data(),
+        sizeof(constants),
+        &constants,
+    };
+
+    const auto smCsfPrefilterHorizontal = VulkanRuntime::createShaderModule(*input.device, srcHorizontal);
+    const auto smCsfPrefilter = VulkanRuntime::createShaderModule(*input.device, srcPrefilter);
+
+    PrefilterPipelines pipelines;
+    pipelines.horizontal = VulkanRuntime::createComputePipeline(*input.device, smCsfPrefilterHorizontal, this->shared->csfPrefilterLayout, specInfo, this->shared->pipelineCache);
+    pipelines.vertical = VulkanRuntime::createComputePipeline(*input.device, smCsfPrefilter, this->shared->csfPrefilterLayout, specInfo, this->shared->pipelineCache);
+
+    return this->shared->prefilterPipelines.emplace(pixels_per_degree, std::move(pipelines)).first->second;
 }
 
 void IQM::FLIPColorPipeline::prefilter(const FLIPInput& input, float pixels_per_degree) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->csfPrefilterHorizontalPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->csfPrefilterLayout, 0, {this->csfPrefilterHorizontalDescSet}, {});
-    input.cmdBuf->pushConstants<float>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, pixels_per_degree);
-    input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, sizeof(float), 0u);
-    input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(float), input.width * input.height);
-    input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 3 * sizeof(float), input.width);
-    input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 4 * sizeof(float), input.height);
+    const auto &pipelines = this->specializedPrefilter(input, pixels_per_degree);
+
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.horizontal);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->csfPrefilterLayout, 0, {this->csfPrefilterHorizontalDescSet}, {});
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, 0u);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, sizeof(uint32_t), input.width * input.height);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(uint32_t), input.width);
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 3 * sizeof(uint32_t), input.height);
 
     //shaders work in 16x16 tiles
     auto groups = VulkanRuntime::compute1DGroupCount(input.width * input.height, 1024);
@@ -82,10 +128,8 @@ void IQM::FLIPColorPipeline::prefilter(const FLIPInput& input, float pixels_per_
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->csfPrefilterPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->csfPrefilterLayout, 0, {this->csfPrefilterDescSet}, {});
-    //input.cmdBuf->pushConstants<float>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, pixels_per_degree);
-    //input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, sizeof(float), 0u);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.vertical);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->csfPrefilterLayout, 0, {this->csfPrefilterDescSet}, {});
 
     input.cmdBuf->dispatch(groups, 1, 1);
 
@@ -95,10 +139,9 @@ void IQM::FLIPColorPipeline::prefilter(const FLIPInput& input, float pixels_per_
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->csfPrefilterHorizontalPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->csfPrefilterLayout, 0, {this->csfPrefilterHorizontalDescSet}, {});
-    //input.cmdBuf->pushConstants<float>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, pixels_per_degree);
-    input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, sizeof(float), 1u);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.horizontal);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->csfPrefilterLayout, 0, {this->csfPrefilterHorizontalDescSet}, {});
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, 1u);
 
     input.cmdBuf->dispatch(groups, 1, 1);
 
@@ -108,10 +151,8 @@ void IQM::FLIPColorPipeline::prefilter(const FLIPInput& input, float pixels_per_
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->csfPrefilterPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->csfPrefilterLayout, 0, {this->csfPrefilterDescSet}, {});
-    //input.cmdBuf->pushConstants<float>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, pixels_per_degree);
-    //input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, sizeof(float), 1u);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.vertical);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->csfPrefilterLayout, 0, {this->csfPrefilterDescSet}, {});
 
     input.cmdBuf->dispatch(groups, 1, 1);
 }
@@ -128,9 +169,9 @@ void IQM::FLIPColorPipeline::computeErrorMap(const FLIPInput& input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->spatialDetectPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->spatialDetectLayout, 0, {this->spatialDetectDescSet}, {});
-    input.cmdBuf->pushConstants<uint32_t>(this->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, input.width * input.height);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->spatialDetectPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->spatialDetectLayout, 0, {this->spatialDetectDescSet}, {});
+    input.cmdBuf->pushConstants<uint32_t>(this->shared->csfPrefilterLayout, vk::ShaderStageFlagBits::eCompute, 0, input.width * input.height);
 
     auto groups = VulkanRuntime::compute1DGroupCount(input.width * input.height, 1024);
 
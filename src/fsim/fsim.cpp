@@ -21,39 +21,74 @@ static std::vector<uint32_t> srcExtractLuma =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIM::FSIM(const vk::raii::Device &device):
-descPool(VulkanRuntime::createDescPool(device, 64, {
-    vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 128},
-    vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 32}
-})),
-logGaborFilter(device, descPool),
-angularFilter(device, descPool),
-combinations(device, descPool),
-sumFilterResponses(device, descPool),
-noise_power(device, descPool),
-estimateEnergy(device, descPool),
-phaseCongruency(device, descPool),
-final_multiply(device, descPool)
+static vk::raii::DescriptorPool fsim_desc_pool(const vk::raii::Device &device) {
+    return VulkanRuntime::createDescPool(device, 64, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 128},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 32}
+    });
+}
+
+IQM::FSIM::FSIM(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+descPool(fsim_desc_pool(device)),
+logGaborFilter(device, descPool, cache),
+angularFilter(device, descPool, cache),
+combinations(device, descPool, cache),
+sumFilterResponses(device, descPool, cache),
+noise_power(device, descPool, cache),
+estimateEnergy(device, descPool, cache),
+phaseCongruency(device, descPool, cache),
+final_multiply(device, descPool, cache)
 {
     const auto smDownscale = VulkanRuntime::createShaderModule(device, srcDownscale);
     const auto smGradientMap = VulkanRuntime::createShaderModule(device, srcGradient);
     const auto smExtractLuma = VulkanRuntime::createShaderModule(device, srcExtractLuma);
 
-    this->descSetLayoutImageOp = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutImageOp = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageImage, 2},
     });
 
-    this->descSetLayoutImBufOp = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutImBufOp = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
+    // 1x int - kernel size
+    const auto downsampleRanges = VulkanRuntime::createPushConstantRange(sizeof(int));
+
+    this->shared->layoutDownscale = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutImageOp}, downsampleRanges);
+    this->shared->pipelineDownscale = VulkanRuntime::createComputePipeline(device, smDownscale, this->shared->layoutDownscale, cache);
+
+    this->shared->layoutGradientMap = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutImageOp}, {});
+    this->shared->pipelineGradientMap = VulkanRuntime::createComputePipeline(device, smGradientMap, this->shared->layoutGradientMap, cache);
+
+    this->shared->layoutExtractLuma = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutImBufOp}, {});
+    this->shared->pipelineExtractLuma = VulkanRuntime::createComputePipeline(device, smExtractLuma, this->shared->layoutExtractLuma, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::FSIM::FSIM(const vk::raii::Device &device, const FSIM &other):
+shared(other.shared),
+descPool(fsim_desc_pool(device)),
+logGaborFilter(device, descPool, other.logGaborFilter),
+angularFilter(device, descPool, other.angularFilter),
+combinations(device, descPool, other.combinations),
+sumFilterResponses(device, descPool, other.sumFilterResponses),
+noise_power(device, descPool, other.noise_power),
+estimateEnergy(device, descPool, other.estimateEnergy),
+phaseCongruency(device, descPool, other.phaseCongruency),
+final_multiply(device, descPool, other.final_multiply) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::FSIM::allocateDescriptors(const vk::raii::Device &device) {
     const std::vector allLayouts = {
-        *this->descSetLayoutImageOp,
-        *this->descSetLayoutImageOp,
-        *this->descSetLayoutImBufOp,
-        *this->descSetLayoutImBufOp,
+        *this->shared->descSetLayoutImageOp,
+        *this->shared->descSetLayoutImageOp,
+        *this->shared->descSetLayoutImBufOp,
+        *this->shared->descSetLayoutImBufOp,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -67,18 +102,6 @@ final_multiply(device, descPool)
     this->descSetGradientMap = std::move(sets[1]);
     this->descSetExtractLumaIn = std::move(sets[2]);
     this->descSetExtractLumaRef = std::move(sets[3]);
-
-    // 1x int - kernel size
-    const auto downsampleRanges = VulkanRuntime::createPushConstantRange(sizeof(int));
-
-    this->layoutDownscale = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutImageOp}, downsampleRanges);
-    this->pipelineDownscale = VulkanRuntime::createComputePipeline(device, smDownscale, this->layoutDownscale);
-
-    this->layoutGradientMap = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutImageOp}, {});
-    this->pipelineGradientMap = VulkanRuntime::createComputePipeline(device, smGradientMap, this->layoutGradientMap);
-
-    this->layoutExtractLuma = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutImBufOp}, {});
-    this->pipelineExtractLuma = VulkanRuntime::createComputePipeline(device, smExtractLuma, this->layoutExtractLuma);
 }
 
 void IQM::FSIM::computeMetric(const FSIMInput &input) {
@@ -100,6 +123,8 @@ void IQM::FSIM::computeMetric(const FSIMInput &input) {
 
     this->computeDownscaledImages(input, F, widthDownscale, heightDownscale);
     this->logGaborFilter.constructFilter(input, widthDownscale, heightDownscale);
+    // may share memory with the input images
+    discardImages(input, {input.imgTempFloat[4]});
     this->angularFilter.constructFilter(input, widthDownscale, heightDownscale);
 
     vk::MemoryBarrier barrier{
@@ -119,6 +144,10 @@ void IQM::FSIM::computeMetric(const FSIMInput &input) {
     this->computeFft(input, widthDownscale, heightDownscale);
     this->combinations.combineFilters(input, widthDownscale, heightDownscale, partitions);
     this->computeMassInverseFft(input);
+    discardImages(input, {
+        input.imgFilterResponsesTest[0], input.imgFilterResponsesTest[1], input.imgFilterResponsesTest[2], input.imgFilterResponsesTest[3],
+        input.imgFilterResponsesRef[0], input.imgFilterResponsesRef[1], input.imgFilterResponsesRef[2], input.imgFilterResponsesRef[3],
+    });
     this->sumFilterResponses.computeSums(input, widthDownscale, heightDownscale);;
     this->noise_power.computeNoisePower(input, widthDownscale, heightDownscale);
     this->estimateEnergy.estimateEnergy(input, widthDownscale, heightDownscale);
@@ -127,6 +156,38 @@ void IQM::FSIM::computeMetric(const FSIMInput &input) {
     this->final_multiply.computeMetrics(input, widthDownscale, heightDownscale);
 }
 
+void IQM::FSIM::discardImages(const FSIMInput &input, const std::vector<const vk::raii::Image*> &images) {
+    std::vector<vk::ImageMemoryBarrier> barriers;
+    for (const auto *image : images) {
+        // previous contents belong to resources sharing the memory, so they are not preserved
+        barriers.push_back(vk::ImageMemoryBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .image = **image,
+            .subresourceRange = vk::ImageSubresourceRange{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        });
+    }
+
+    input.cmdBuf->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        {},
+        nullptr,
+        nullptr,
+        barriers
+    );
+}
+
 std::pair<unsigned, unsigned> IQM::FSIM::downscaledSize(const unsigned width, const unsigned height) {
     const int F = computeDownscaleFactor(width, height);
     const auto widthDownscale = static_cast<unsigned>(std::round(static_cast<float>(width) / static_cast<float>(F)));
@@ -256,17 +317,17 @@ void IQM::FSIM::initDescriptors(const FSIMInput &input, const FftBufferPartition
 }
 
 void IQM::FSIM::computeDownscaledImages(const FSIMInput &input, int factor, int width, int height) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineDownscale);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutDownscale, 0, {this->descSetDownscale}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineDownscale);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutDownscale, 0, {this->descSetDownscale}, {});
 
-    input.cmdBuf->pushConstants<int>(this->layoutDownscale, vk::ShaderStageFlagBits::eCompute, 0, factor);
+    input.cmdBuf->pushConstants<int>(this->shared->layoutDownscale, vk::ShaderStageFlagBits::eCompute, 0, factor);
 
     input.cmdBuf->dispatch(width * height, 1, 2);
 }
 
 void IQM::FSIM::createGradientMap(const FSIMInput& input, int width, int height) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineGradientMap);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutGradientMap, 0, {this->descSetGradientMap}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineGradientMap);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutGradientMap, 0, {this->descSetGradientMap}, {});
 
     //shader works in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 16);
@@ -278,11 +339,11 @@ void IQM::FSIM::computeFft(const FSIMInput &input, const unsigned width, const u
     //shader works in 8x8 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 8);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineExtractLuma);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutExtractLuma, 0, {this->descSetExtractLumaIn}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineExtractLuma);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutExtractLuma, 0, {this->descSetExtractLumaIn}, {});
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutExtractLuma, 0, {this->descSetExtractLumaRef}, {});
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutExtractLuma, 0, {this->descSetExtractLumaRef}, {});
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
     vk::MemoryBarrier barrier{
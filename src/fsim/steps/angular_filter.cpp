@@ -12,15 +12,28 @@ static std::vector<uint32_t> src =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMAngularFilter::FSIMAngularFilter(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMAngularFilter::FSIMAngularFilter(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
     const auto smAngular = VulkanRuntime::createShaderModule(device, src);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, FSIM_ORIENTATIONS},
     });
 
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayout}, {});
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, smAngular, this->shared->layout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMAngularFilter::FSIMAngularFilter(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMAngularFilter &other):
+shared(other.shared) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FSIMAngularFilter::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layout = {
-        *this->descSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -30,14 +43,11 @@ IQM::FSIMAngularFilter::FSIMAngularFilter(const vk::raii::Device &device, const
     };
 
     this->descSet = std::move(vk::raii::DescriptorSets{device, descriptorSetAllocateInfo}.front());
-
-    this->layout = VulkanRuntime::createPipelineLayout(device, layout, {});
-    this->pipeline = VulkanRuntime::createComputePipeline(device, smAngular, this->layout);
 }
 
 void IQM::FSIMAngularFilter::constructFilter(const FSIMInput &input, const unsigned width, const unsigned height) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
 
     //shader works in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 16);
@@ -10,28 +10,35 @@ static std::vector<uint32_t> srcMultFilters =
 #include <fsim/fsim_mult_filters.inc>
 ;
 
-static std::vector<uint32_t> srcEnergySum =
-#include <fsim/fsim_noise_energy_sum.inc>
-;
-
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMEstimateEnergy::FSIMEstimateEnergy(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMEstimateEnergy::FSIMEstimateEnergy(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
     const auto smEstimate = VulkanRuntime::createShaderModule(device, srcMultFilters);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcEnergySum);
 
-    this->estimateEnergyDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->estimateEnergyDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, FSIM_ORIENTATIONS * 2},
     });
 
-    this->sumDescSetLayout = VulkanRuntime::createDescLayout(device, {
-        {vk::DescriptorType::eStorageBuffer, FSIM_ORIENTATIONS * 2},
-    });
+    const auto estimateEnergyRanges = VulkanRuntime::createPushConstantRange(sizeof(int));
+
+    this->shared->estimateEnergyLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->estimateEnergyDescSetLayout}, estimateEnergyRanges);
+    this->shared->estimateEnergyPipeline = VulkanRuntime::createComputePipeline(device, smEstimate, this->shared->estimateEnergyLayout, cache);
 
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMEstimateEnergy::FSIMEstimateEnergy(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMEstimateEnergy &other):
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FSIMEstimateEnergy::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layouts = {
-        *this->estimateEnergyDescSetLayout,
-        *this->sumDescSetLayout,
+        *this->shared->estimateEnergyDescSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -42,22 +49,12 @@ IQM::FSIMEstimateEnergy::FSIMEstimateEnergy(const vk::raii::Device &device, cons
 
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->estimateEnergyDescSet = std::move(sets[0]);
-    this->sumDescSet = std::move(sets[1]);
-
-    const auto estimateEnergyRanges = VulkanRuntime::createPushConstantRange(sizeof(int));
-    const auto sumRanges = VulkanRuntime::createPushConstantRange(2 * sizeof(int));
-
-    this->estimateEnergyLayout = VulkanRuntime::createPipelineLayout(device, {this->estimateEnergyDescSetLayout}, estimateEnergyRanges);
-    this->estimateEnergyPipeline = VulkanRuntime::createComputePipeline(device, smEstimate, this->estimateEnergyLayout);
-
-    this->sumLayout = VulkanRuntime::createPipelineLayout(device, {this->sumDescSetLayout}, sumRanges);
-    this->sumPipeline = VulkanRuntime::createComputePipeline(device, smSum, this->sumLayout);
 }
 
 void IQM::FSIMEstimateEnergy::estimateEnergy(const FSIMInput& input, const unsigned width, const unsigned height) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->estimateEnergyPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->estimateEnergyLayout, 0, {this->estimateEnergyDescSet}, {});
-    input.cmdBuf->pushConstants<unsigned>(this->estimateEnergyLayout, vk::ShaderStageFlagBits::eCompute, 0, width * height);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->estimateEnergyPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->estimateEnergyLayout, 0, {this->estimateEnergyDescSet}, {});
+    input.cmdBuf->pushConstants<unsigned>(this->shared->estimateEnergyLayout, vk::ShaderStageFlagBits::eCompute, 0, width * height);
 
     //shader works in groups of 128 threads
     auto groupsX = ((width * height) / 128) + 1;
@@ -77,42 +74,16 @@ void IQM::FSIMEstimateEnergy::estimateEnergy(const FSIMInput& input, const unsig
         {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->sumPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->sumLayout, 0, {this->sumDescSet}, {});
-
-    uint32_t bufferSize = width * height;
-    // now sum
-    for (int o = 0; o < FSIM_ORIENTATIONS * 2; o++) {
-        uint64_t groups = (bufferSize / 1024) + 1;
-        uint32_t size = bufferSize;
-
-        for (;;) {
-            input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, size);
-            input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, sizeof(unsigned), o);
-            input.cmdBuf->dispatch(groups, 1, 1);
-
-            vk::BufferMemoryBarrier barrier = {
-                .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-                .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-                .buffer = *input.bufIfft,
-                .offset = 0,
-                .size = bufferSize * sizeof(float),
-            };
-            input.cmdBuf->pipelineBarrier(
-                vk::PipelineStageFlagBits::eComputeShader,
-                vk::PipelineStageFlagBits::eComputeShader,
-                vk::DependencyFlagBits::eDeviceGroup,
-                {},
-                {barrier},
-                {}
-            );
-            if (groups == 1) {
-                break;
-            }
-            size = groups;
-            groups = (groups / 1024) + 1;
-        }
-    }
+    // now sum all energy buffers at once, they directly follow each other
+    const uint32_t bufferSize = width * height;
+    this->reduce.reduce(ReduceInput{
+        .cmdBuf = input.cmdBuf,
+        .op = ReduceOp::Sum,
+        .size = bufferSize,
+        .offset = bufferSize * 2 * FSIM_ORIENTATIONS * FSIM_SCALES,
+        .count = FSIM_ORIENTATIONS * 2,
+        .stride = bufferSize,
+    });
 }
 
 void IQM::FSIMEstimateEnergy::setUpDescriptors(const FSIMInput& input, const unsigned width, const unsigned height) {
@@ -147,15 +118,11 @@ void IQM::FSIMEstimateEnergy::setUpDescriptors(const FSIMInput& input, const uns
         outBuffers
     );
 
-    const auto writeSetSum = VulkanRuntime::createWriteSet(
-        this->sumDescSet,
-        0,
-        outBuffers
-    );
-
     const std::vector writes = {
-        writeSetIn, writeSetBuf, writeSetSum
+        writeSetIn, writeSetBuf
     };
 
     input.device->updateDescriptorSets(writes, nullptr);
+
+    this->reduce.setUpDescriptors(*input.device, *input.bufIfft, baseOffset + 2 * FSIM_ORIENTATIONS * bufferSize);
 }
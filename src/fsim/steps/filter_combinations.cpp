@@ -10,30 +10,35 @@ static std::vector<uint32_t> srcMultPack =
 #include <fsim/fsim_filter_combinations.inc>
 ;
 
-static std::vector<uint32_t> srcSum =
-#include <fsim/fsim_filter_noise.inc>
-;
-
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMFilterCombinations::FSIMFilterCombinations(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMFilterCombinations::FSIMFilterCombinations(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
     const auto smMultPack = VulkanRuntime::createShaderModule(device, srcMultPack);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcSum);
 
-    this->multPackDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->multPackDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, FSIM_SCALES},
         {vk::DescriptorType::eStorageImage, FSIM_ORIENTATIONS},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->sumDescSetLayout = VulkanRuntime::createDescLayout(device, {
-        {vk::DescriptorType::eStorageBuffer, 1},
-    });
+    this->shared->multPackLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->multPackDescSetLayout}, {});
+    this->shared->multPackPipeline = VulkanRuntime::createComputePipeline(device, smMultPack, this->shared->multPackLayout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMFilterCombinations::FSIMFilterCombinations(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMFilterCombinations &other):
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device, descPool);
+}
 
+void IQM::FSIMFilterCombinations::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layouts = {
-        *this->multPackDescSetLayout,
-        *this->sumDescSetLayout,
+        *this->shared->multPackDescSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -44,21 +49,11 @@ IQM::FSIMFilterCombinations::FSIMFilterCombinations(const vk::raii::Device &devi
 
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->multPackDescSet = std::move(sets[0]);
-    this->sumDescSet = std::move(sets[1]);
-
-    // 3x int - buffer size, index of current execution, bool
-    const auto sumRanges = VulkanRuntime::createPushConstantRange(3 * sizeof(int));
-
-    this->multPackLayout = VulkanRuntime::createPipelineLayout(device, {this->multPackDescSetLayout}, {});
-    this->multPackPipeline = VulkanRuntime::createComputePipeline(device, smMultPack, this->multPackLayout);
-
-    this->sumLayout = VulkanRuntime::createPipelineLayout(device, {this->sumDescSetLayout}, sumRanges);
-    this->sumPipeline = VulkanRuntime::createComputePipeline(device, smSum, this->sumLayout);
 }
 
 void IQM::FSIMFilterCombinations::combineFilters(const FSIMInput &input, const unsigned width, const unsigned height, const FftBufferPartitions& partitions) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->multPackPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->multPackLayout, 0, {this->multPackDescSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->multPackPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->multPackLayout, 0, {this->multPackDescSet}, {});
 
     //shader works in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 16);
@@ -71,16 +66,10 @@ void IQM::FSIMFilterCombinations::combineFilters(const FSIMInput &input, const u
     };
     input.cmdBuf->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eDeviceGroup, {barrier}, {}, {});
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->sumPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->sumLayout, 0, {this->sumDescSet}, {});
-
     uint64_t bufferSize = width * height * 2;
-    input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, bufferSize);
 
-    // parallel sum
+    // parallel sum, each copy starts right after the results of previous orientations
     for (unsigned n = 0; n < FSIM_ORIENTATIONS; n++) {
-        input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, sizeof(unsigned), n);
-
         vk::BufferCopy region {
             .srcOffset = FSIM_ORIENTATIONS * n * bufferSize * sizeof(float),
             .dstOffset = n * sizeof(float),
@@ -100,35 +89,13 @@ void IQM::FSIMFilterCombinations::combineFilters(const FSIMInput &input, const u
             {},
             {}
         );
-        uint64_t groups = (bufferSize / 1024) + 1;
-        uint32_t size = bufferSize;
-        bool doPower = true;
-
-        for (;;) {
-            input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, size);
-            input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 2 * sizeof(unsigned), doPower);
-
-            input.cmdBuf->dispatch(groups, 1, 1);
-
-            barrier = {
-                .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-                .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
-            };
-            input.cmdBuf->pipelineBarrier(
-                vk::PipelineStageFlagBits::eComputeShader,
-                vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
-                vk::DependencyFlagBits::eDeviceGroup,
-                {barrier},
-                {},
-                {}
-            );
-            if (groups == 1) {
-                break;
-            }
-            size = groups;
-            groups = (groups / 1024) + 1;
-            doPower = false;
-        }
+
+        this->reduce.reduce(ReduceInput{
+            .cmdBuf = input.cmdBuf,
+            .op = ReduceOp::SumOfSquares,
+            .size = static_cast<unsigned>(bufferSize),
+            .offset = n,
+        });
     }
 
     // copy the summed values into expected position
@@ -203,24 +170,12 @@ void IQM::FSIMFilterCombinations::setUpDescriptors(const FSIMInput &input, const
         bufferInfo
     );
 
-    // can be reused at this moment
-    auto bufferInfoSum = std::vector{
-        vk::DescriptorBufferInfo{
-            .buffer = **input.bufFft,
-            .offset = 0,
-            .range = noiseLevelsBufferSize,
-        }
-    };
-
-    const auto writeSetNoise = VulkanRuntime::createWriteSet(
-        this->sumDescSet,
-        0,
-        bufferInfoSum
-    );
-
     const std::vector writes = {
-        writeSetBuf, writeSetAngular, writeSetLogGabor, writeSetNoise, writeSetFftIn
+        writeSetBuf, writeSetAngular, writeSetLogGabor, writeSetFftIn
     };
 
     input.device->updateDescriptorSets(writes, nullptr);
+
+    // can be reused at this moment
+    this->reduce.setUpDescriptors(*input.device, *input.bufFft, noiseLevelsBufferSize);
 }
@@ -10,30 +10,35 @@ static std::vector<uint32_t> src =
 #include <fsim/fsim_final_multiply.inc>
 ;
 
-static std::vector<uint32_t> srcSum =
-#include <fsim/fsim_final_sum.inc>
-;
-
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMFinalMultiply::FSIMFinalMultiply(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMFinalMultiply::FSIMFinalMultiply(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
     const auto smMul = VulkanRuntime::createShaderModule(device, src);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcSum);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageImage, 3},
     });
 
-    this->sumDescSetLayout = VulkanRuntime::createDescLayout(device, {
-        {vk::DescriptorType::eStorageBuffer, 1},
-    });
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, {});
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, smMul, this->shared->layout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMFinalMultiply::FSIMFinalMultiply(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMFinalMultiply &other):
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device, descPool);
+}
 
+void IQM::FSIMFinalMultiply::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layouts = {
-        *this->descSetLayout,
-        *this->sumDescSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -44,16 +49,6 @@ IQM::FSIMFinalMultiply::FSIMFinalMultiply(const vk::raii::Device &device, const
 
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->descSet = std::move(sets[0]);
-    this->sumDescSet = std::move(sets[1]);
-
-    // 1x int - buffer size
-    const auto sumRanges = VulkanRuntime::createPushConstantRange(sizeof(int));
-
-    this->layout = VulkanRuntime::createPipelineLayout(device, {this->descSetLayout}, {});
-    this->pipeline = VulkanRuntime::createComputePipeline(device, smMul, this->layout);
-
-    this->sumLayout = VulkanRuntime::createPipelineLayout(device, {this->sumDescSetLayout}, {sumRanges});
-    this->sumPipeline = VulkanRuntime::createComputePipeline(device, smSum, this->sumLayout);
 }
 
 void IQM::FSIMFinalMultiply::computeMetrics(const FSIMInput &input, unsigned width, unsigned height) {
@@ -70,12 +65,12 @@ void IQM::FSIMFinalMultiply::computeMetrics(const FSIMInput &input, unsigned wid
         {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
 
     //shader works in 8x8 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 8);
 
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
 
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
@@ -112,26 +107,19 @@ void IQM::FSIMFinalMultiply::setUpDescriptors(const FSIMInput &input, const unsi
         outImageInfos
     );
 
-    // reuse iFFT buffer, since it's big enough
-    auto bufInfo = std::vector{
-        vk::DescriptorBufferInfo {
-            .buffer = **input.bufIfft,
-            .offset = 0,
-            .range = width * height * sizeof(float),
-        }
-    };
-
-    const auto writeSetSum = VulkanRuntime::createWriteSet(
-        this->sumDescSet,
-        0,
-        bufInfo
-    );
-
     const std::vector writes = {
-        writeSetIn, writeSetGrad, writeSetPc, writeSetOut, writeSetSum
+        writeSetIn, writeSetGrad, writeSetPc, writeSetOut
     };
 
     input.device->updateDescriptorSets(writes, nullptr);
+
+    // reuse iFFT buffer, since it's big enough
+    const auto range = width * height * sizeof(float);
+    if (input.mask.enabled()) {
+        this->reduce.setUpDescriptors(*input.device, *input.bufIfft, range, *input.mask.buffer, range);
+    } else {
+        this->reduce.setUpDescriptors(*input.device, *input.bufIfft, range);
+    }
 }
 
 void IQM::FSIMFinalMultiply::sumImages(const FSIMInput &input, const unsigned width, const unsigned height) {
@@ -148,14 +136,8 @@ void IQM::FSIMFinalMultiply::sumImages(const FSIMInput &input, const unsigned wi
         {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->sumPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->sumLayout, 0, {this->sumDescSet}, {});
-
     uint32_t bufferSize = width * height;
     for (unsigned i = 0; i < 3; i++) {
-        uint64_t groups = (bufferSize / 1024) + 1;
-        uint32_t size = bufferSize;
-
         const vk::BufferImageCopy regionTo {
             .bufferOffset = 0,
             .bufferRowLength = static_cast<unsigned>(width),
@@ -183,31 +165,12 @@ void IQM::FSIMFinalMultiply::sumImages(const FSIMInput &input, const unsigned wi
             {}
         );
 
-        for (;;) {
-            input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, size);
-            input.cmdBuf->dispatch(groups, 1, 1);
-
-            vk::BufferMemoryBarrier barrier = {
-                .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-                .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eTransferRead,
-                .buffer = **input.bufIfft,
-                .offset = 0,
-                .size = bufferSize * sizeof(float),
-            };
-            input.cmdBuf->pipelineBarrier(
-                vk::PipelineStageFlagBits::eComputeShader,
-                vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
-                vk::DependencyFlagBits::eDeviceGroup,
-                {},
-                {barrier},
-                {}
-            );
-            if (groups == 1) {
-                break;
-            }
-            size = groups;
-            groups = (groups / 1024) + 1;
-        }
+        this->reduce.reduce(ReduceInput{
+            .cmdBuf = input.cmdBuf,
+            // all three values share the weights, so their ratios stay the same as for sums
+            .op = input.mask.enabled() ? ReduceOp::WeightedMean : ReduceOp::Sum,
+            .size = bufferSize,
+        });
 
         const vk::BufferCopy regionFrom = {
             .srcOffset = 0,
@@ -12,15 +12,28 @@ static std::vector<uint32_t> src =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMLogGabor::FSIMLogGabor(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMLogGabor::FSIMLogGabor(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
     const auto smLogGabor = VulkanRuntime::createShaderModule(device, src);
 
-    this->descSetLayout = std::move(VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = std::move(VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, FSIM_ORIENTATIONS},
     }));
 
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayout}, {});
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, smLogGabor, this->shared->layout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMLogGabor::FSIMLogGabor(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMLogGabor &other):
+shared(other.shared) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FSIMLogGabor::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layout = {
-        *this->descSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -30,9 +43,6 @@ IQM::FSIMLogGabor::FSIMLogGabor(const vk::raii::Device &device, const vk::raii::
     };
 
     this->descSet = std::move(vk::raii::DescriptorSets{device, descriptorSetAllocateInfo}.front());
-
-    this->layout = VulkanRuntime::createPipelineLayout(device, layout, {});
-    this->pipeline = VulkanRuntime::createComputePipeline(device, smLogGabor, this->layout);
 }
 
 void IQM::FSIMLogGabor::setUpDescriptors(const FSIMInput &input) const {
@@ -50,8 +60,8 @@ void IQM::FSIMLogGabor::setUpDescriptors(const FSIMInput &input) const {
 }
 
 void IQM::FSIMLogGabor::constructFilter(const FSIMInput &input, int width, int height) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
 
     //shader works in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 16);
@@ -24,30 +24,54 @@ static std::vector<uint32_t> srcOut =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMNoisePower::FSIMNoisePower(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMNoisePower::FSIMNoisePower(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
     const auto smPack = VulkanRuntime::createShaderModule(device, src);
     const auto smSort = VulkanRuntime::createShaderModule(device, srcSort);
     const auto smSortHistogram = VulkanRuntime::createShaderModule(device, srcSortHistogram);
     const auto smNoisePower = VulkanRuntime::createShaderModule(device, srcOut);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->descSetLayoutSort = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutSort = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
+    // 2x uint - buffer size, index
+    const auto ranges = VulkanRuntime::createPushConstantRange(2 * sizeof(uint32_t));
+    const auto rangesSort = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
+
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, {ranges});
+    this->shared->layoutSort = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutSort}, {rangesSort});
+    this->shared->layoutSortHistogram = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayout}, {rangesSort});
+    this->shared->layoutNoisePower = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutSort}, {ranges});
+
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, smPack, this->shared->layout, cache);
+    this->shared->pipelineSort = VulkanRuntime::createComputePipeline(device, smSort, this->shared->layoutSort, cache);
+    this->shared->pipelineSortHistogram = VulkanRuntime::createComputePipeline(device, smSortHistogram, this->shared->layoutSortHistogram, cache);
+    this->shared->pipelineNoisePower = VulkanRuntime::createComputePipeline(device, smNoisePower, this->shared->layoutNoisePower, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMNoisePower::FSIMNoisePower(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMNoisePower &other):
+shared(other.shared) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FSIMNoisePower::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layouts = {
-        *this->descSetLayout,
-        *this->descSetLayoutSort,
-        *this->descSetLayoutSort,
-        *this->descSetLayout,
-        *this->descSetLayout,
-        *this->descSetLayoutSort,
+        *this->shared->descSetLayout,
+        *this->shared->descSetLayoutSort,
+        *this->shared->descSetLayoutSort,
+        *this->shared->descSetLayout,
+        *this->shared->descSetLayout,
+        *this->shared->descSetLayoutSort,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -63,20 +87,6 @@ IQM::FSIMNoisePower::FSIMNoisePower(const vk::raii::Device &device, const vk::ra
     this->descSetSortHistogramEven = std::move(createdLayouts[3]);
     this->descSetSortHistogramOdd = std::move(createdLayouts[4]);
     this->descSetNoisePower = std::move(createdLayouts[5]);
-
-    // 2x uint - buffer size, index
-    const auto ranges = VulkanRuntime::createPushConstantRange(2 * sizeof(uint32_t));
-    const auto rangesSort = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
-
-    this->layout = VulkanRuntime::createPipelineLayout(device, {this->descSetLayout}, {ranges});
-    this->layoutSort = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutSort}, {rangesSort});
-    this->layoutSortHistogram = VulkanRuntime::createPipelineLayout(device, {this->descSetLayout}, {rangesSort});
-    this->layoutNoisePower = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutSort}, {ranges});
-
-    this->pipeline = VulkanRuntime::createComputePipeline(device, smPack, this->layout);
-    this->pipelineSort = VulkanRuntime::createComputePipeline(device, smSort, this->layoutSort);
-    this->pipelineSortHistogram = VulkanRuntime::createComputePipeline(device, smSortHistogram, this->layoutSortHistogram);
-    this->pipelineNoisePower = VulkanRuntime::createComputePipeline(device, smNoisePower, this->layoutNoisePower);
 }
 
 void IQM::FSIMNoisePower::computeNoisePower(const FSIMInput &input, const unsigned width, const unsigned height) {
@@ -93,11 +103,11 @@ void IQM::FSIMNoisePower::computeNoisePower(const FSIMInput &input, const unsign
     };
 
     for (int i = 0; i < FSIM_ORIENTATIONS * 2; i++) {
-        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
-        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
 
-        input.cmdBuf->pushConstants<unsigned>(this->layout, vk::ShaderStageFlagBits::eCompute, 0, width * height);
-        input.cmdBuf->pushConstants<unsigned>(this->layout, vk::ShaderStageFlagBits::eCompute, sizeof(uint32_t),i);
+        input.cmdBuf->pushConstants<unsigned>(this->shared->layout, vk::ShaderStageFlagBits::eCompute, 0, width * height);
+        input.cmdBuf->pushConstants<unsigned>(this->shared->layout, vk::ShaderStageFlagBits::eCompute, sizeof(uint32_t),i);
 
         auto groups = (width * height) / 256 + 1;
 
@@ -114,8 +124,8 @@ void IQM::FSIMNoisePower::computeNoisePower(const FSIMInput &input, const unsign
 
         for (unsigned j = 0; j < 4; j++) {
             auto activeSet = j % 2 == 0 ? &this->descSetSortHistogramEven : &this->descSetSortHistogramOdd;
-            input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSortHistogram);
-            input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSortHistogram, 0, {*activeSet}, {});
+            input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineSortHistogram);
+            input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSortHistogram, 0, {*activeSet}, {});
 
             std::array values = {
                 static_cast<unsigned>(width * height),
@@ -123,7 +133,7 @@ void IQM::FSIMNoisePower::computeNoisePower(const FSIMInput &input, const unsign
                 nSortWorkgroups,
                 nBlocksPerWorkgroup,
             };
-            input.cmdBuf->pushConstants<unsigned>(this->layoutSortHistogram, vk::ShaderStageFlagBits::eCompute, 0, values);
+            input.cmdBuf->pushConstants<unsigned>(this->shared->layoutSortHistogram, vk::ShaderStageFlagBits::eCompute, 0, values);
 
             input.cmdBuf->dispatch(sortGlobalInvocationSize, 1, 1);
 
@@ -137,10 +147,10 @@ void IQM::FSIMNoisePower::computeNoisePower(const FSIMInput &input, const unsign
             );
 
             activeSet = j % 2 == 0 ? &this->descSetSortEven : &this->descSetSortOdd;
-            input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSort);
-            input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSort, 0, {*activeSet}, {});
+            input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineSort);
+            input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSort, 0, {*activeSet}, {});
 
-            input.cmdBuf->pushConstants<unsigned>(this->layoutSort, vk::ShaderStageFlagBits::eCompute, 0, values);
+            input.cmdBuf->pushConstants<unsigned>(this->shared->layoutSort, vk::ShaderStageFlagBits::eCompute, 0, values);
 
             input.cmdBuf->dispatch(sortGlobalInvocationSize, 1, 1);
 
@@ -154,11 +164,11 @@ void IQM::FSIMNoisePower::computeNoisePower(const FSIMInput &input, const unsign
             );
         }
 
-        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineNoisePower);
-        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutNoisePower, 0, {this->descSetNoisePower}, {});
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineNoisePower);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutNoisePower, 0, {this->descSetNoisePower}, {});
 
-        input.cmdBuf->pushConstants<unsigned>(this->layoutNoisePower, vk::ShaderStageFlagBits::eCompute, 0, width * height);
-        input.cmdBuf->pushConstants<unsigned>(this->layoutNoisePower, vk::ShaderStageFlagBits::eCompute, sizeof(uint32_t),i);
+        input.cmdBuf->pushConstants<unsigned>(this->shared->layoutNoisePower, vk::ShaderStageFlagBits::eCompute, 0, width * height);
+        input.cmdBuf->pushConstants<unsigned>(this->shared->layoutNoisePower, vk::ShaderStageFlagBits::eCompute, sizeof(uint32_t),i);
 
         input.cmdBuf->dispatch(1, 1, 1);
 
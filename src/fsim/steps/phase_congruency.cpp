@@ -12,18 +12,31 @@ static std::vector<uint32_t> src =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMPhaseCongruency::FSIMPhaseCongruency(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMPhaseCongruency::FSIMPhaseCongruency(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
     const auto smPc = VulkanRuntime::createShaderModule(device, src);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, FSIM_ORIENTATIONS * 2},
         {vk::DescriptorType::eStorageImage, FSIM_ORIENTATIONS * 2},
     });
 
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayout}, {});
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, smPc, this->shared->layout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMPhaseCongruency::FSIMPhaseCongruency(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMPhaseCongruency &other):
+shared(other.shared) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FSIMPhaseCongruency::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layouts = {
-        *this->descSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -34,14 +47,11 @@ IQM::FSIMPhaseCongruency::FSIMPhaseCongruency(const vk::raii::Device &device, co
 
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->descSet = std::move(sets[0]);
-
-    this->layout = VulkanRuntime::createPipelineLayout(device, layouts, {});
-    this->pipeline = VulkanRuntime::createComputePipeline(device, smPc, this->layout);
 }
 
 void IQM::FSIMPhaseCongruency::compute(const FSIMInput &input, const unsigned width, const unsigned height) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
 
     //shader works in 8x8 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 8);
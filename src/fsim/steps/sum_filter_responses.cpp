@@ -12,17 +12,30 @@ static std::vector<uint32_t> src =
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::FSIMSumFilterResponses::FSIMSumFilterResponses(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
+IQM::FSIMSumFilterResponses::FSIMSumFilterResponses(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()) {
     const auto smSum = VulkanRuntime::createShaderModule(device, src);
 
-    this->descSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, FSIM_ORIENTATIONS},
         {vk::DescriptorType::eStorageImage, FSIM_ORIENTATIONS},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
+    this->shared->layout = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayout}, {});
+    this->shared->pipeline = VulkanRuntime::createComputePipeline(device, smSum, this->shared->layout, cache);
+
+    this->allocateDescriptors(device, descPool);
+}
+
+IQM::FSIMSumFilterResponses::FSIMSumFilterResponses(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool, const FSIMSumFilterResponses &other):
+shared(other.shared) {
+    this->allocateDescriptors(device, descPool);
+}
+
+void IQM::FSIMSumFilterResponses::allocateDescriptors(const vk::raii::Device &device, const vk::raii::DescriptorPool& descPool) {
     const std::vector layouts = {
-        *this->descSetLayout,
+        *this->shared->descSetLayout,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -33,15 +46,12 @@ IQM::FSIMSumFilterResponses::FSIMSumFilterResponses(const vk::raii::Device &devi
 
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->descSet = std::move(sets[0]);
-
-    this->layout = VulkanRuntime::createPipelineLayout(device, layouts, {});
-    this->pipeline = VulkanRuntime::createComputePipeline(device, smSum, this->layout);
 }
 
 void IQM::FSIMSumFilterResponses::computeSums(const FSIMInput& input, const unsigned width, const unsigned height) {
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layout, 0, {this->descSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layout, 0, {this->descSet}, {});
 
     //shader works in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(width, height, 16);
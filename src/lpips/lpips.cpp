@@ -29,79 +29,95 @@ static std::vector<uint32_t> srcReconstruct =
 #include <lpips/reconstruct.inc>
 ;
 
-static std::vector<uint32_t> srcSum =
-#include <lpips/sum.inc>
-;
-
-static std::vector<uint32_t> srcPostprocess =
-#include <lpips/postprocess.inc>
-;
-
 using IQM::GPU::VulkanRuntime;
 
 unsigned dimensionFn(const unsigned size, const unsigned padding, const unsigned kernelSize, const unsigned stride) {
     return (size + 2 * padding - kernelSize) / stride + 1;
 }
 
-IQM::LPIPS::LPIPS(const vk::raii::Device &device) {
+IQM::LPIPS::LPIPS(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
     const auto smPreprocess = VulkanRuntime::createShaderModule(device, srcPreprocess);
     const auto smConv = VulkanRuntime::createShaderModule(device, srcConv);
     const auto smConvBig = VulkanRuntime::createShaderModule(device, srcConvBig);
     const auto smCompare = VulkanRuntime::createShaderModule(device, srcComapreRelu);
     const auto smMaxpool = VulkanRuntime::createShaderModule(device, srcMaxpool);
     const auto smReconstruct = VulkanRuntime::createShaderModule(device, srcReconstruct);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcSum);
-    const auto smPostprocess = VulkanRuntime::createShaderModule(device, srcPostprocess);
-
-    this->descPool = VulkanRuntime::createDescPool(device, 32, {
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 80},
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 24}
-    });
 
-    this->preprocessDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->preprocessDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageBuffer, 2},
     });
 
-    this->compareDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->compareDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->convDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->convDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageBuffer, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->maxPoolDescSetLayout = VulkanRuntime::createDescLayout(device, {
+    this->shared->maxPoolDescSetLayout = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->sumDescSetLayout = VulkanRuntime::createDescLayout(device, {
-        {vk::DescriptorType::eStorageBuffer, 1},
+    this->shared->preprocessLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->preprocessDescSetLayout}, {});
+    this->shared->preprocessPipeline = VulkanRuntime::createComputePipeline(device, smPreprocess, this->shared->preprocessLayout, cache);
+
+    const auto convRange = VulkanRuntime::createPushConstantRange(8 * sizeof(uint32_t));
+    this->shared->convLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->convDescSetLayout}, {convRange});
+    this->createConvPipelines(device, smConv, smConvBig, this->shared->convLayout, cache);
+
+    const auto maxPoolRange = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
+    this->shared->maxPoolLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->maxPoolDescSetLayout}, {maxPoolRange});
+    this->shared->maxPoolPipeline = VulkanRuntime::createComputePipeline(device, smMaxpool, this->shared->maxPoolLayout, cache);
+
+    const auto compareRange = VulkanRuntime::createPushConstantRange(3 * sizeof(uint32_t));
+    this->shared->compareLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->compareDescSetLayout}, {compareRange});
+    this->shared->comparePipeline = VulkanRuntime::createComputePipeline(device, smCompare, this->shared->compareLayout, cache);
+
+    const auto reconstructRange = VulkanRuntime::createPushConstantRange(8 * sizeof(uint32_t));
+    this->shared->reconstructLayout = VulkanRuntime::createPipelineLayout(device, {this->shared->maxPoolDescSetLayout}, {reconstructRange});
+    this->shared->reconstructPipeline = VulkanRuntime::createComputePipeline(device, smReconstruct, this->shared->reconstructLayout, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::LPIPS::LPIPS(const vk::raii::Device &device, const LPIPS &other):
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::LPIPS::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, 32, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 80},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 24}
     });
 
     std::vector allDescLayouts = {
-        *this->preprocessDescSetLayout,
-        *this->maxPoolDescSetLayout,
-        *this->sumDescSetLayout,
+        *this->shared->preprocessDescSetLayout,
+        *this->shared->maxPoolDescSetLayout,
     };
 
     for (int i = 0; i < 4; i++) {
-        allDescLayouts.push_back(*this->maxPoolDescSetLayout);
+        allDescLayouts.push_back(*this->shared->maxPoolDescSetLayout);
     }
 
     for (int i = 0; i < 5; i++) {
-        allDescLayouts.push_back(*this->convDescSetLayout);
+        allDescLayouts.push_back(*this->shared->convDescSetLayout);
     }
 
     for (int i = 0; i < 5; i++) {
-        allDescLayouts.push_back(*this->compareDescSetLayout);
+        allDescLayouts.push_back(*this->shared->compareDescSetLayout);
     }
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -113,44 +129,19 @@ IQM::LPIPS::LPIPS(const vk::raii::Device &device) {
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->preprocessDescSet = std::move(sets[0]);
     this->reconstructDescSet = std::move(sets[1]);
-    this->sumDescSet = std::move(sets[2]);
 
-    for (int i = 3; i < 7; i++) {
+    for (int i = 2; i < 6; i++) {
         this->maxPoolDescSets.push_back(std::move(sets[i]));
     }
-    for (int i = 7; i < 12; i++) {
+    for (int i = 6; i < 11; i++) {
         this->convDescSets.push_back(std::move(sets[i]));
     }
-    for (int i = 12; i < 17; i++) {
+    for (int i = 11; i < 16; i++) {
         this->compareDescSets.push_back(std::move(sets[i]));
     }
-
-    this->preprocessLayout = VulkanRuntime::createPipelineLayout(device, {this->preprocessDescSetLayout}, {});
-    this->preprocessPipeline = VulkanRuntime::createComputePipeline(device, smPreprocess, this->preprocessLayout);
-
-    const auto convRange = VulkanRuntime::createPushConstantRange(8 * sizeof(uint32_t));
-    this->convLayout = VulkanRuntime::createPipelineLayout(device, {this->convDescSetLayout}, {convRange});
-    this->createConvPipelines(device, smConv, smConvBig, this->convLayout);
-
-    const auto maxPoolRange = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
-    this->maxPoolLayout = VulkanRuntime::createPipelineLayout(device, {this->maxPoolDescSetLayout}, {maxPoolRange});
-    this->maxPoolPipeline = VulkanRuntime::createComputePipeline(device, smMaxpool, this->maxPoolLayout);
-
-    const auto compareRange = VulkanRuntime::createPushConstantRange(3 * sizeof(uint32_t));
-    this->compareLayout = VulkanRuntime::createPipelineLayout(device, {this->compareDescSetLayout}, {compareRange});
-    this->comparePipeline = VulkanRuntime::createComputePipeline(device, smCompare, this->compareLayout);
-
-    const auto reconstructRange = VulkanRuntime::createPushConstantRange(8 * sizeof(uint32_t));
-    this->reconstructLayout = VulkanRuntime::createPipelineLayout(device, {this->maxPoolDescSetLayout}, {reconstructRange});
-    this->reconstructPipeline = VulkanRuntime::createComputePipeline(device, smReconstruct, this->reconstructLayout);
-
-    const auto sumRange = VulkanRuntime::createPushConstantRange(1 * sizeof(uint32_t));
-    this->sumLayout = VulkanRuntime::createPipelineLayout(device, {this->sumDescSetLayout}, {sumRange});
-    this->sumPipeline = VulkanRuntime::createComputePipeline(device, smSum, this->sumLayout);
-    this->postprocessPipeline = VulkanRuntime::createComputePipeline(device, smPostprocess, this->sumLayout);
 }
 
-void IQM::LPIPS::createConvPipelines(const vk::raii::Device &device, const vk::raii::ShaderModule &sm, const vk::raii::ShaderModule &smBig, const vk::raii::PipelineLayout &layout) {
+void IQM::LPIPS::createConvPipelines(const vk::raii::Device &device, const vk::raii::ShaderModule &sm, const vk::raii::ShaderModule &smBig, const vk::raii::PipelineLayout &layout, const vk::raii::PipelineCache *cache) {
     unsigned big = this->blocks[0].kernelSize;
     unsigned medium = this->blocks[1].kernelSize;
     unsigned small = this->blocks[2].kernelSize;
@@ -210,10 +201,10 @@ void IQM::LPIPS::createConvPipelines(const vk::raii::Device &device, const vk::r
         }
     };
 
-    auto pipelines = vk::raii::Pipelines{device, nullptr, createInfos};
-    this->convPipelineBig = std::move(pipelines[0]);
-    this->convPipelineMedium = std::move(pipelines[1]);
-    this->convPipelineSmall = std::move(pipelines[2]);
+    auto pipelines = vk::raii::Pipelines{device, cache, createInfos};
+    this->shared->convPipelineBig = std::move(pipelines[0]);
+    this->shared->convPipelineMedium = std::move(pipelines[1]);
+    this->shared->convPipelineSmall = std::move(pipelines[2]);
 }
 
 
@@ -231,8 +222,8 @@ void IQM::LPIPS::computeMetric(const LPIPSInput &input) {
 }
 
 void IQM::LPIPS::preprocess(const LPIPSInput &input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->preprocessPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->preprocessLayout, 0, {this->preprocessDescSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->preprocessPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->preprocessLayout, 0, {this->preprocessDescSet}, {});
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
@@ -252,8 +243,8 @@ void IQM::LPIPS::preprocess(const LPIPSInput &input) {
 }
 
 void IQM::LPIPS::conv0(const LPIPSInput &input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->convPipelineBig);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->convLayout, 0, {this->convDescSets[0]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->convPipelineBig);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->convLayout, 0, {this->convDescSets[0]}, {});
     const auto widthPass = dimensionFn(input.width, this->blocks[0].padding, this->blocks[0].kernelSize, this->blocks[0].stride);
     const auto heightPass = dimensionFn(input.height, this->blocks[0].padding, this->blocks[0].kernelSize, this->blocks[0].stride);
     const std::array pc = {
@@ -266,7 +257,7 @@ void IQM::LPIPS::conv0(const LPIPSInput &input) {
         this->blocks[0].padding,
         this->blocks[0].stride,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(widthPass, heightPass, 16);
@@ -284,8 +275,8 @@ void IQM::LPIPS::conv0(const LPIPSInput &input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->maxPoolPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->maxPoolLayout, 0, {this->maxPoolDescSets[0]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->maxPoolPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->maxPoolLayout, 0, {this->maxPoolDescSets[0]}, {});
     const auto widthMaxPass = dimensionFn(widthPass, 0, 3, 2);
     const auto heightMaxPass = dimensionFn(heightPass, 0, 3, 2);
     const std::array pcMax = {
@@ -294,24 +285,24 @@ void IQM::LPIPS::conv0(const LPIPSInput &input) {
         widthMaxPass,
         heightMaxPass,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->maxPoolLayout, vk::ShaderStageFlagBits::eCompute, 0, pcMax);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->maxPoolLayout, vk::ShaderStageFlagBits::eCompute, 0, pcMax);
 
     auto [groupsMaxX, groupsMaxY] = VulkanRuntime::compute2DGroupCounts(widthMaxPass, heightMaxPass, 16);
 
     input.cmdBuf->dispatch(groupsMaxX, groupsMaxY, this->blocks[0].outChannels);
 
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->maxPoolLayout, 0, {this->maxPoolDescSets[1]}, {});
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->maxPoolLayout, 0, {this->maxPoolDescSets[1]}, {});
 
     input.cmdBuf->dispatch(groupsMaxX, groupsMaxY, this->blocks[0].outChannels);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->comparePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->compareLayout, 0, {this->compareDescSets[0]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->comparePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->compareLayout, 0, {this->compareDescSets[0]}, {});
     const std::array pcCompare = {
         widthPass,
         heightPass,
         this->blocks[0].outChannels,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
 
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
@@ -332,8 +323,8 @@ void IQM::LPIPS::conv1(const LPIPSInput &input) {
     const auto widthPass3 = dimensionFn(widthPass2, 0, 3, 2);
     const auto heightPass3 = dimensionFn(heightPass2, 0, 3, 2);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->convPipelineMedium);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->convLayout, 0, {this->convDescSets[1]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->convPipelineMedium);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->convLayout, 0, {this->convDescSets[1]}, {});
 
     const std::array pc = {
         widthPass2,
@@ -345,7 +336,7 @@ void IQM::LPIPS::conv1(const LPIPSInput &input) {
         this->blocks[1].padding,
         this->blocks[1].stride,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
 
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(widthPass2, heightPass2, 4);
     auto [groupsCompareX, groupsCompareY] = VulkanRuntime::compute2DGroupCounts(widthPass2, heightPass2, 16);
@@ -363,32 +354,32 @@ void IQM::LPIPS::conv1(const LPIPSInput &input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->maxPoolPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->maxPoolLayout, 0, {this->maxPoolDescSets[2]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->maxPoolPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->maxPoolLayout, 0, {this->maxPoolDescSets[2]}, {});
     const std::array pcMax = {
         widthPass2,
         heightPass2,
         widthPass3,
         heightPass3,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->maxPoolLayout, vk::ShaderStageFlagBits::eCompute, 0, pcMax);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->maxPoolLayout, vk::ShaderStageFlagBits::eCompute, 0, pcMax);
 
     auto [groupsMaxX, groupsMaxY] = VulkanRuntime::compute2DGroupCounts(widthPass3, heightPass3, 16);
 
     input.cmdBuf->dispatch(groupsMaxX, groupsMaxY, this->blocks[1].outChannels);
 
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->maxPoolLayout, 0, {this->maxPoolDescSets[3]}, {});
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->maxPoolLayout, 0, {this->maxPoolDescSets[3]}, {});
 
     input.cmdBuf->dispatch(groupsMaxX, groupsMaxY, this->blocks[1].outChannels);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->comparePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->compareLayout, 0, {this->compareDescSets[1]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->comparePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->compareLayout, 0, {this->compareDescSets[1]}, {});
     const std::array pcCompare = {
         widthPass2,
         heightPass2,
         this->blocks[1].outChannels,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
 
     input.cmdBuf->dispatch(groupsCompareX, groupsCompareY, 1);
 
@@ -409,8 +400,8 @@ void IQM::LPIPS::conv2(const LPIPSInput &input) {
     const auto widthPass3 = dimensionFn(widthPass2, 0, 3, 2);
     const auto heightPass3 = dimensionFn(heightPass2, 0, 3, 2);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->convPipelineSmall);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->convLayout, 0, {this->convDescSets[2]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->convPipelineSmall);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->convLayout, 0, {this->convDescSets[2]}, {});
 
     const std::array pc = {
         widthPass3,
@@ -422,7 +413,7 @@ void IQM::LPIPS::conv2(const LPIPSInput &input) {
         this->blocks[2].padding,
         this->blocks[2].stride,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(widthPass3, heightPass3, 4);
@@ -451,8 +442,8 @@ void IQM::LPIPS::conv3(const LPIPSInput &input) {
     const auto widthPass3 = dimensionFn(widthPass2, 0, 3, 2);
     const auto heightPass3 = dimensionFn(heightPass2, 0, 3, 2);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->convPipelineSmall);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->convLayout, 0, {this->convDescSets[3]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->convPipelineSmall);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->convLayout, 0, {this->convDescSets[3]}, {});
 
     const std::array pc = {
         widthPass3,
@@ -464,21 +455,21 @@ void IQM::LPIPS::conv3(const LPIPSInput &input) {
         this->blocks[3].padding,
         this->blocks[3].stride,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
 
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(widthPass3, heightPass3, 4);
     auto [groupsCompareX, groupsCompareY] = VulkanRuntime::compute2DGroupCounts(widthPass3, heightPass3, 16);
 
     input.cmdBuf->dispatch(groupsX, groupsY, this->blocks[3].outChannels / 64);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->comparePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->compareLayout, 0, {this->compareDescSets[2]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->comparePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->compareLayout, 0, {this->compareDescSets[2]}, {});
     const std::array pcCompare = {
         widthPass3,
         heightPass3,
         this->blocks[2].outChannels,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
 
     input.cmdBuf->dispatch(groupsCompareX, groupsCompareY, 1);
 
@@ -504,8 +495,8 @@ void IQM::LPIPS::conv4(const LPIPSInput &input) {
     const auto widthPass3 = dimensionFn(widthPass2, 0, 3, 2);
     const auto heightPass3 = dimensionFn(heightPass2, 0, 3, 2);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->convPipelineSmall);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->convLayout, 0, {this->convDescSets[4]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->convPipelineSmall);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->convLayout, 0, {this->convDescSets[4]}, {});
 
     const std::array pc = {
         widthPass3,
@@ -517,21 +508,21 @@ void IQM::LPIPS::conv4(const LPIPSInput &input) {
         this->blocks[4].padding,
         this->blocks[4].stride,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->convLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
 
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(widthPass3, heightPass3, 4);
     auto [groupsCompareX, groupsCompareY] = VulkanRuntime::compute2DGroupCounts(widthPass3, heightPass3, 16);
 
     input.cmdBuf->dispatch(groupsX, groupsY, this->blocks[4].outChannels / 64);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->comparePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->compareLayout, 0, {this->compareDescSets[3]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->comparePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->compareLayout, 0, {this->compareDescSets[3]}, {});
     std::array pcCompare = {
         widthPass3,
         heightPass3,
         this->blocks[3].outChannels,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->compareLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
 
     input.cmdBuf->dispatch(groupsCompareX, groupsCompareY, 1);
 
@@ -546,14 +537,14 @@ void IQM::LPIPS::conv4(const LPIPSInput &input) {
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->comparePipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->compareLayout, 0, {this->compareDescSets[4]}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->comparePipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->compareLayout, 0, {this->compareDescSets[4]}, {});
     pcCompare = {
         widthPass3,
         heightPass3,
         this->blocks[4].outChannels,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->maxPoolLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->maxPoolLayout, vk::ShaderStageFlagBits::eCompute, 0, pcCompare);
 
     input.cmdBuf->dispatch(groupsCompareX, groupsCompareY, 1);
 
@@ -574,8 +565,8 @@ void IQM::LPIPS::reconstruct(const LPIPSInput &input) {
     const auto widthPass3 = dimensionFn(widthPass2, 0, 3, 2);
     const auto heightPass3 = dimensionFn(heightPass2, 0, 3, 2);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->reconstructPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->reconstructLayout, 0, {this->reconstructDescSet}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->reconstructPipeline);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->reconstructLayout, 0, {this->reconstructDescSet}, {});
     const std::array pc = {
         input.width,
         input.height,
@@ -586,7 +577,7 @@ void IQM::LPIPS::reconstruct(const LPIPSInput &input) {
         widthPass3,
         heightPass3,
     };
-    input.cmdBuf->pushConstants<unsigned>(this->reconstructLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
+    input.cmdBuf->pushConstants<unsigned>(this->shared->reconstructLayout, vk::ShaderStageFlagBits::eCompute, 0, pc);
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
@@ -630,56 +621,21 @@ void IQM::LPIPS::reconstruct(const LPIPSInput &input) {
 }
 
 void IQM::LPIPS::average(const LPIPSInput &input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->sumPipeline);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->sumLayout, 0, {this->sumDescSet}, {});
-
-    const auto sumSize = 1024;
-
-    uint32_t bufferSize = (input.width) * (input.height);
-    uint64_t groups = (bufferSize / sumSize) + 1;
-    uint32_t size = bufferSize;
-
-    for (;;) {
-        input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, size);
-        input.cmdBuf->dispatch(groups, 1, 1);
-
-        vk::BufferMemoryBarrier barrier = {
-            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-            .buffer = *input.bufTest,
-            .offset = 0,
-            .size = bufferSize * sizeof(float),
-        };
-        input.cmdBuf->pipelineBarrier(
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::DependencyFlagBits::eDeviceGroup,
-            {},
-            {barrier},
-            {}
-        );
-        if (groups == 1) {
-            break;
-        }
-        size = groups;
-        groups = (groups / sumSize) + 1;
+    if (input.bufGrid != nullptr) {
+        this->reduce.grid(ReduceGridInput{
+            .cmdBuf = input.cmdBuf,
+            .width = input.width,
+            .height = input.height,
+            .cell = input.gridCell,
+            .weights = input.mask.enabled() ? GridWeights::Buffer : GridWeights::None,
+        });
     }
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->postprocessPipeline);
-    input.cmdBuf->pushConstants<unsigned>(this->sumLayout, vk::ShaderStageFlagBits::eCompute, 0, bufferSize);
-
-    input.cmdBuf->dispatch(1, 1, 1);
-
-    vk::MemoryBarrier memoryBarrier = {
-        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-    };
-
-    input.cmdBuf->pipelineBarrier(
-        vk::PipelineStageFlagBits::eComputeShader,
-        vk::PipelineStageFlagBits::eComputeShader,
-        vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
-    );
+    this->reduce.reduce(ReduceInput{
+        .cmdBuf = input.cmdBuf,
+        .op = input.mask.enabled() ? ReduceOp::WeightedMean : ReduceOp::Mean,
+        .size = input.width * input.height,
+    });
 }
 
 void IQM::LPIPS::setUpDescriptors(const LPIPSInput &input) const {
@@ -1038,10 +994,18 @@ void IQM::LPIPS::setUpDescriptors(const LPIPSInput &input) const {
     writes.push_back(VulkanRuntime::createWriteSet(this->reconstructDescSet, 0, compTotalInfo));
     writes.push_back(VulkanRuntime::createWriteSet(this->reconstructDescSet, 1, convFlipTestBufInfo));
 
-    //sum + postprocess
-    writes.push_back(VulkanRuntime::createWriteSet(this->sumDescSet, 0, convFlipTestBufInfo));
-
     input.device->updateDescriptorSets({writes}, nullptr);
+
+    // average
+    if (input.mask.enabled()) {
+        this->reduce.setUpDescriptors(*input.device, *input.bufTest, bufferHalves.input, *input.mask.buffer, input.width * input.height * sizeof(float));
+    } else {
+        this->reduce.setUpDescriptors(*input.device, *input.bufTest, bufferHalves.input);
+    }
+    if (input.bufGrid != nullptr) {
+        const auto grid = Reduce::gridExtent(input.width, input.height, input.gridCell);
+        this->reduce.setUpGrid(*input.device, *input.bufGrid, grid.width * grid.height * sizeof(float));
+    }
 }
 
 IQM::ConvBufferHalves IQM::LPIPS::bufferHalves(unsigned width, unsigned height) const {
@@ -9,38 +9,56 @@ static std::vector<uint32_t> srcPack =
 #include <psnr/pack.inc>
 ;
 
-static std::vector<uint32_t> srcSum =
-#include <psnr/sum.inc>
-;
-
 static std::vector<uint32_t> srcPost =
 #include <psnr/postprocess.inc>
 ;
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::PSNR::PSNR(const vk::raii::Device &device) {
+IQM::PSNR::PSNR(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
     const auto smPack = VulkanRuntime::createShaderModule(device, srcPack);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcSum);
     const auto smPost = VulkanRuntime::createShaderModule(device, srcPost);
 
-    this->descPool = VulkanRuntime::createDescPool(device, 4, {
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 16},
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 16}
-    });
-
-    this->descSetLayoutPack = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutPack = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->descSetLayoutSum = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutSum = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
     });
 
+    // 1x int - data size
+    const auto rangeSum = VulkanRuntime::createPushConstantRange( sizeof(int));
+    // 3x int - variant, origin
+    const auto rangePack = VulkanRuntime::createPushConstantRange(3 * sizeof(int));
+
+    this->shared->layoutPack = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutPack}, rangePack);
+    this->shared->layoutSum = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutSum}, rangeSum);
+
+    this->shared->pipelinePack = VulkanRuntime::createComputePipeline(device, smPack, this->shared->layoutPack, cache);
+    this->shared->pipelinePost = VulkanRuntime::createComputePipeline(device, smPost, this->shared->layoutSum, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::PSNR::PSNR(const vk::raii::Device &device, const PSNR &other):
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::PSNR::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, 4, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 16},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 16}
+    });
+
     const std::vector allocateLayouts = {
-        *this->descSetLayoutPack,
-        *this->descSetLayoutSum,
+        *this->shared->descSetLayoutPack,
+        *this->shared->descSetLayoutSum,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -52,38 +70,45 @@ IQM::PSNR::PSNR(const vk::raii::Device &device) {
     auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
     this->descSetPack = std::move(sets[0]);
     this->descSetSum = std::move(sets[1]);
-
-    // 1x int - data size
-    const auto rangeSum = VulkanRuntime::createPushConstantRange( sizeof(int));
-
-    this->layoutPack = VulkanRuntime::createPipelineLayout(device, {*this->descSetLayoutPack}, rangeSum);
-    this->layoutSum = VulkanRuntime::createPipelineLayout(device, {*this->descSetLayoutSum}, rangeSum);
-
-    this->pipelinePack = VulkanRuntime::createComputePipeline(device, smPack, this->layoutPack);
-    this->pipelineSum = VulkanRuntime::createComputePipeline(device, smSum, this->layoutSum);
-    this->pipelinePost = VulkanRuntime::createComputePipeline(device, smPost, this->layoutSum);
 }
 
 void IQM::PSNR::computeMetric(const PSNRInput &input) {
     this->initDescriptors(input);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelinePack);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutPack, 0, {this->descSetPack}, {});
-    input.cmdBuf->pushConstants<int>(this->layoutPack, vk::ShaderStageFlagBits::eCompute, 0, static_cast<int>(input.variant));
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelinePack);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutPack, 0, {this->descSetPack}, {});
+
+    // errors outside of the mask are never read, unless they are written to the output
+    auto area = vk::Rect2D{.extent = vk::Extent2D{input.width, input.height}};
+    if (input.mask.enabled() && input.imgOut == nullptr) {
+        // shaders work in 16x16 tiles, so the area starts at a tile boundary
+        area.offset = vk::Offset2D{input.mask.bounds.offset.x / 16 * 16, input.mask.bounds.offset.y / 16 * 16};
+        area.extent = vk::Extent2D{
+            input.mask.bounds.offset.x + input.mask.bounds.extent.width - area.offset.x,
+            input.mask.bounds.offset.y + input.mask.bounds.extent.height - area.offset.y,
+        };
+    }
+
+    const std::array values = {
+        static_cast<int>(input.variant),
+        area.offset.x,
+        area.offset.y,
+    };
+    input.cmdBuf->pushConstants<int>(this->shared->layoutPack, vk::ShaderStageFlagBits::eCompute, 0, values);
 
     //shaders work in 16x16 tiles
-    auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
+    auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(area.extent.width, area.extent.height, 16);
 
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
     vk::MemoryBarrier memoryBarrier = {
         .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eShaderRead,
     };
 
     input.cmdBuf->pipelineBarrier(
         vk::PipelineStageFlagBits::eComputeShader,
-        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
         vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
     );
 
@@ -111,43 +136,29 @@ void IQM::PSNR::computeMetric(const PSNRInput &input) {
         );
     }
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSum);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSum, 0, {this->descSetSum}, {});
+    if (input.bufGrid != nullptr) {
+        this->reduce.grid(ReduceGridInput{
+            .cmdBuf = input.cmdBuf,
+            .width = input.width,
+            .height = input.height,
+            .cell = input.gridCell,
+            .weights = input.mask.enabled() ? GridWeights::Buffer : GridWeights::None,
+        });
+    }
 
-    const auto sumSize = 1024;
+    const uint32_t bufferSize = input.width * input.height;
+    this->reduce.reduce(ReduceInput{
+        .cmdBuf = input.cmdBuf,
+        .op = input.mask.enabled() ? ReduceOp::WeightedMean : ReduceOp::Sum,
+        .size = bufferSize,
+    });
 
-    uint32_t bufferSize = (input.width) * (input.height);
-    uint64_t groups = (bufferSize / sumSize) + 1;
-    uint32_t size = bufferSize;
+    // weighted mean is already divided by the sum of weights
+    const uint32_t divisor = input.mask.enabled() ? 1 : bufferSize;
 
-    for (;;) {
-        input.cmdBuf->pushConstants<unsigned>(this->layoutSum, vk::ShaderStageFlagBits::eCompute, 0, size);
-        input.cmdBuf->dispatch(groups, 1, 1);
-
-        vk::BufferMemoryBarrier barrier = {
-            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-            .buffer = *input.bufSum,
-            .offset = 0,
-            .size = bufferSize * sizeof(float),
-        };
-        input.cmdBuf->pipelineBarrier(
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::DependencyFlagBits::eDeviceGroup,
-            {},
-            {barrier},
-            {}
-        );
-        if (groups == 1) {
-            break;
-        }
-        size = groups;
-        groups = (groups / sumSize) + 1;
-    }
-
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelinePost);
-    input.cmdBuf->pushConstants<unsigned>(this->layoutSum, vk::ShaderStageFlagBits::eCompute, 0, bufferSize);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelinePost);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSum, 0, {this->descSetSum}, {});
+    input.cmdBuf->pushConstants<unsigned>(this->shared->layoutSum, vk::ShaderStageFlagBits::eCompute, 0, divisor);
 
     input.cmdBuf->dispatch(1, 1, 1);
 
@@ -192,7 +203,7 @@ void IQM::PSNR::initDescriptors(const PSNRInput &input) {
         bufInfos
     );
 
-    // sum
+    // postprocess
     auto writeSetSum = VulkanRuntime::createWriteSet(
         this->descSetSum,
         0,
@@ -200,4 +211,15 @@ void IQM::PSNR::initDescriptors(const PSNRInput &input) {
     );
 
     input.device->updateDescriptorSets({writeSetPackIn, writeSetPackOut, writeSetSum}, nullptr);
+
+    if (input.mask.enabled()) {
+        this->reduce.setUpDescriptors(*input.device, *input.bufSum, size, *input.mask.buffer, size);
+    } else {
+        this->reduce.setUpDescriptors(*input.device, *input.bufSum, size);
+    }
+
+    if (input.bufGrid != nullptr) {
+        const auto grid = Reduce::gridExtent(input.width, input.height, input.gridCell);
+        this->reduce.setUpGrid(*input.device, *input.bufGrid, grid.width * grid.height * sizeof(float));
+    }
 }
@@ -0,0 +1,36 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <IQM/ssim/gauss_kernel.h>
+#include <cmath>
+
+IQM::GaussKernel::GaussKernel(const int kernelSize, const float sigma) : constants{
+    .kernelSize = kernelSize,
+    .sigma = sigma,
+    .weights = {},
+} {
+    for (unsigned i = 0; i < this->constants.weights.size(); i++) {
+        this->constants.weights[i] = std::exp(-static_cast<float>(i * i) / (2.0f * sigma * sigma));
+    }
+
+    this->entries = {
+        vk::SpecializationMapEntry{0, offsetof(decltype(constants), kernelSize), sizeof(int32_t)},
+        vk::SpecializationMapEntry{1, offsetof(decltype(constants), sigma), sizeof(float)},
+    };
+    for (unsigned i = 0; i < this->constants.weights.size(); i++) {
+        this->entries.push_back(vk::SpecializationMapEntry{2 + i, static_cast<uint32_t>(offsetof(decltype(constants), weights) + i * sizeof(float)), sizeof(float)});
+    }
+
+    this->info = vk::SpecializationInfo{
+        static_cast<uint32_t>(this->entries.size()),
+        this->entries.data(),
+        sizeof(this->constants),
+        &this->constants,
+    };
+}
+
+const vk::SpecializationInfo& IQM::GaussKernel::specializationInfo() const {
+    return this->info;
+}
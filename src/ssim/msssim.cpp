@@ -0,0 +1,262 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include <IQM/msssim.h>
+#include <algorithm>
+#include <string>
+
+static std::vector<uint32_t> srcLuma =
+#include <ssim/msssim_luma.inc>
+;
+
+static std::vector<uint32_t> srcDownsample =
+#include <ssim/msssim_downsample.inc>
+;
+
+static std::vector<uint32_t> srcScale =
+#include <ssim/msssim_scale.inc>
+;
+
+static std::vector<uint32_t> srcCombine =
+#include <ssim/msssim_combine.inc>
+;
+
+using IQM::GPU::VulkanRuntime;
+
+IQM::MSSSIM::MSSSIM(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
+    this->shared->pipelineCache = cache;
+
+    const auto smLuma = VulkanRuntime::createShaderModule(device, srcLuma);
+    const auto smDownsample = VulkanRuntime::createShaderModule(device, srcDownsample);
+    const auto smCombine = VulkanRuntime::createShaderModule(device, srcCombine);
+
+    this->shared->descSetLayoutPyramid = VulkanRuntime::createDescLayout(device, {
+        {vk::DescriptorType::eStorageImage, 2},
+        {vk::DescriptorType::eStorageImage, 2},
+    });
+
+    this->shared->descSetLayoutScale = VulkanRuntime::createDescLayout(device, {
+        {vk::DescriptorType::eStorageImage, 2},
+        {vk::DescriptorType::eStorageBuffer, 1},
+    });
+
+    this->shared->descSetLayoutCombine = VulkanRuntime::createDescLayout(device, {
+        {vk::DescriptorType::eStorageBuffer, 1},
+    });
+
+    // 2x float - K_1, K_2
+    // 2x uint - buffer offset, last scale flag
+    const auto rangesScale = VulkanRuntime::createPushConstantRange(2 * sizeof(float) + 2 * sizeof(uint32_t));
+
+    // offsets of scale means
+    const auto rangesCombine = VulkanRuntime::createPushConstantRange(MSSSIM_LEVELS * sizeof(uint32_t));
+
+    this->shared->layoutPyramid = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutPyramid}, {});
+    this->shared->layoutScale = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutScale}, rangesScale);
+    this->shared->layoutCombine = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutCombine}, rangesCombine);
+
+    this->shared->pipelineLuma = VulkanRuntime::createComputePipeline(device, smLuma, this->shared->layoutPyramid, cache);
+    this->shared->pipelineDownsample = VulkanRuntime::createComputePipeline(device, smDownsample, this->shared->layoutPyramid, cache);
+    this->shared->pipelineCombine = VulkanRuntime::createComputePipeline(device, smCombine, this->shared->layoutCombine, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::MSSSIM::MSSSIM(const vk::raii::Device &device, const MSSSIM &other):
+kernelSize(other.kernelSize),
+k_1(other.k_1),
+k_2(other.k_2),
+sigma(other.sigma),
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::MSSSIM::allocateDescriptors(const vk::raii::Device &device) {
+    // luma, downsampling between all levels, all scales and combine
+    const uint32_t setCount = 1 + (MSSSIM_LEVELS - 1) + MSSSIM_LEVELS + 1;
+    this->descPool = VulkanRuntime::createDescPool(device, setCount, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = MSSSIM_LEVELS + 1},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 4 * MSSSIM_LEVELS + 2 * MSSSIM_LEVELS},
+    });
+
+    std::vector allocateLayouts = {
+        *this->shared->descSetLayoutPyramid,
+        *this->shared->descSetLayoutCombine,
+    };
+    allocateLayouts.insert(allocateLayouts.end(), MSSSIM_LEVELS - 1, *this->shared->descSetLayoutPyramid);
+    allocateLayouts.insert(allocateLayouts.end(), MSSSIM_LEVELS, *this->shared->descSetLayoutScale);
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .descriptorPool = this->descPool,
+        .descriptorSetCount = static_cast<uint32_t>(allocateLayouts.size()),
+        .pSetLayouts = allocateLayouts.data()
+    };
+
+    auto sets = vk::raii::DescriptorSets{device, descriptorSetAllocateInfo};
+    this->descSetLuma = std::move(sets[0]);
+    this->descSetCombine = std::move(sets[1]);
+    for (unsigned i = 0; i < MSSSIM_LEVELS - 1; i++) {
+        this->descSetsDownsample.push_back(std::move(sets[2 + i]));
+    }
+    for (unsigned i = 0; i < MSSSIM_LEVELS; i++) {
+        this->descSetsScale.push_back(std::move(sets[1 + MSSSIM_LEVELS + i]));
+    }
+}
+
+std::array<unsigned, IQM::MSSSIM_LEVELS> IQM::MSSSIM::scaleOffsets(const unsigned width, const unsigned height) const {
+    if (this->kernelSize > MAX_KERNEL_SIZE) {
+        throw std::runtime_error("MS-SSIM supports kernels up to " + std::to_string(MAX_KERNEL_SIZE) + "x" + std::to_string(MAX_KERNEL_SIZE));
+    }
+    // the coarsest scale must still contain the whole kernel
+    if (static_cast<int>(std::min(width, height) >> (MSSSIM_LEVELS - 1)) < this->kernelSize) {
+        throw std::runtime_error("Images are too small for MS-SSIM, both dimensions must be at least " + std::to_string(this->kernelSize << (MSSSIM_LEVELS - 1)) + " pixels");
+    }
+
+    const unsigned border = this->kernelSize - 1;
+    std::array<unsigned, MSSSIM_LEVELS> offsets{};
+    unsigned offset = 0;
+    for (unsigned i = 0; i < MSSSIM_LEVELS; i++) {
+        offsets[i] = offset;
+        offset += ((width >> i) - border) * ((height >> i) - border);
+    }
+    return offsets;
+}
+
+unsigned long IQM::MSSSIM::bufferSize(const unsigned width, const unsigned height) const {
+    const unsigned border = this->kernelSize - 1;
+    const unsigned last = MSSSIM_LEVELS - 1;
+    const auto offsets = this->scaleOffsets(width, height);
+    return (offsets[last] + ((width >> last) - border) * ((height >> last) - border)) * sizeof(float);
+}
+
+const vk::raii::Pipeline& IQM::MSSSIM::specializedPipeline(const vk::raii::Device &device) {
+    const auto key = std::make_pair(this->kernelSize, this->sigma);
+    if (const auto it = this->shared->scalePipelines.find(key); it != this->shared->scalePipelines.end()) {
+        return it->second;
+    }
+
+    const GaussKernel kernel(this->kernelSize, this->sigma);
+    const auto smScale = VulkanRuntime::createShaderModule(device, srcScale);
+    auto pipeline = VulkanRuntime::createComputePipeline(device, smScale, this->shared->layoutScale, kernel.specializationInfo(), this->shared->pipelineCache);
+
+    return this->shared->scalePipelines.emplace(key, std::move(pipeline)).first->second;
+}
+
+void IQM::MSSSIM::computeMetric(const MSSSIMInput &input) {
+    const auto offsets = this->scaleOffsets(input.width, input.height);
+    this->initDescriptors(input);
+    const auto &pipelineScale = this->specializedPipeline(*input.device);
+
+    vk::MemoryBarrier memoryBarrier = {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    //shaders work in 16x16 tiles
+    const auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineLuma);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutPyramid, 0, {this->descSetLuma}, {});
+    input.cmdBuf->dispatch(groupsX, groupsY, 1);
+
+    // scale of each level is independent of downsampling it to the next one, so both share a barrier
+    for (unsigned i = 0; i < MSSSIM_LEVELS; i++) {
+        input.cmdBuf->pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+        );
+
+        const auto levelWidth = input.width >> i;
+        const auto levelHeight = input.height >> i;
+
+        const auto [scaleGroupsX, scaleGroupsY] = VulkanRuntime::compute2DGroupCounts(levelWidth, levelHeight, 16);
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelineScale);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutScale, 0, {this->descSetsScale[i]}, {});
+        std::array values = {
+            *reinterpret_cast<uint32_t *>(&this->k_1),
+            *reinterpret_cast<uint32_t *>(&this->k_2),
+            offsets[i],
+            static_cast<uint32_t>(i == MSSSIM_LEVELS - 1),
+        };
+        input.cmdBuf->pushConstants<uint32_t>(this->shared->layoutScale, vk::ShaderStageFlagBits::eCompute, 0, values);
+        input.cmdBuf->dispatch(scaleGroupsX, scaleGroupsY, 1);
+
+        if (i + 1 < MSSSIM_LEVELS) {
+            const auto [downGroupsX, downGroupsY] = VulkanRuntime::compute2DGroupCounts(levelWidth / 2, levelHeight / 2, 16);
+            input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineDownsample);
+            input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutPyramid, 0, {this->descSetsDownsample[i]}, {});
+            input.cmdBuf->dispatch(downGroupsX, downGroupsY, 1);
+        }
+    }
+
+    input.cmdBuf->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+    );
+
+    const unsigned border = this->kernelSize - 1;
+    for (unsigned i = 0; i < MSSSIM_LEVELS; i++) {
+        this->reduce.reduce(ReduceInput{
+            .cmdBuf = input.cmdBuf,
+            .op = ReduceOp::Mean,
+            .size = ((input.width >> i) - border) * ((input.height >> i) - border),
+            .offset = offsets[i],
+        });
+    }
+
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineCombine);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutCombine, 0, {this->descSetCombine}, {});
+    input.cmdBuf->pushConstants<std::array<unsigned, MSSSIM_LEVELS>>(this->shared->layoutCombine, vk::ShaderStageFlagBits::eCompute, 0, offsets);
+    input.cmdBuf->dispatch(1, 1, 1);
+
+    memoryBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    input.cmdBuf->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+    );
+}
+
+void IQM::MSSSIM::initDescriptors(const MSSSIMInput &input) {
+    const auto bufferSize = this->bufferSize(input.width, input.height);
+    this->reduce.setUpDescriptors(*input.device, *input.bufScales, bufferSize);
+
+    const std::vector bufInfos = {
+        vk::DescriptorBufferInfo{
+            .buffer = *input.bufScales,
+            .offset = 0,
+            .range = bufferSize,
+        }
+    };
+
+    // write sets point into these, so all of them have to outlive the update
+    const auto inputImageInfos = VulkanRuntime::createImageInfos({input.ivTest, input.ivRef});
+    std::vector<std::vector<vk::DescriptorImageInfo>> levelImageInfos;
+    for (unsigned i = 0; i < MSSSIM_LEVELS; i++) {
+        levelImageInfos.push_back(VulkanRuntime::createImageInfos({input.ivLumaTest[i], input.ivLumaRef[i]}));
+    }
+
+    std::vector writeSets = {
+        VulkanRuntime::createWriteSet(this->descSetLuma, 0, inputImageInfos),
+        VulkanRuntime::createWriteSet(this->descSetLuma, 1, levelImageInfos[0]),
+        VulkanRuntime::createWriteSet(this->descSetCombine, 0, bufInfos),
+    };
+
+    for (unsigned i = 0; i < MSSSIM_LEVELS; i++) {
+        writeSets.push_back(VulkanRuntime::createWriteSet(this->descSetsScale[i], 0, levelImageInfos[i]));
+        writeSets.push_back(VulkanRuntime::createWriteSet(this->descSetsScale[i], 1, bufInfos));
+
+        if (i + 1 < MSSSIM_LEVELS) {
+            writeSets.push_back(VulkanRuntime::createWriteSet(this->descSetsDownsample[i], 0, levelImageInfos[i]));
+            writeSets.push_back(VulkanRuntime::createWriteSet(this->descSetsDownsample[i], 1, levelImageInfos[i + 1]));
+        }
+    }
+
+    input.device->updateDescriptorSets(writeSets, nullptr);
+}
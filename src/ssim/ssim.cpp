@@ -5,6 +5,9 @@
 
 #include <IQM/ssim.h>
 
+#include <algorithm>
+#include <stdexcept>
+
 static std::vector<uint32_t> src =
 #include <ssim/ssim.inc>
 ;
@@ -13,6 +16,10 @@ static std::vector<uint32_t> srcLumapack =
 #include <ssim/ssim_lumapack.inc>
 ;
 
+static std::vector<uint32_t> srcLumapackTest =
+#include <ssim/ssim_lumapack_test.inc>
+;
+
 static std::vector<uint32_t> srcGaussHorizontal =
 #include <ssim/ssim_gauss_horizontal.inc>
 ;
@@ -21,43 +28,97 @@ static std::vector<uint32_t> srcGauss =
 #include <ssim/ssim_gauss.inc>
 ;
 
-static std::vector<uint32_t> srcMssim =
-#include <ssim/mssim_sum.inc>
+static std::vector<uint32_t> srcFused =
+#include <ssim/ssim_fused.inc>
+;
+
+static std::vector<uint32_t> srcFusedSum =
+#include <ssim/ssim_fused_sum.inc>
+;
+
+// variant writing the map in R f16
+static std::vector<uint32_t> srcFusedHalf =
+#include <ssim/ssim_fused_fp16.inc>
 ;
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::SSIM::SSIM(const vk::raii::Device &device) {
-    const auto smSsim = VulkanRuntime::createShaderModule(device, src);
-    const auto smLumapack = VulkanRuntime::createShaderModule(device,srcLumapack);
-    const auto smGaussHorizontal = VulkanRuntime::createShaderModule(device, srcGaussHorizontal);
-    const auto smGauss = VulkanRuntime::createShaderModule(device, srcGauss);
-    const auto smMssim = VulkanRuntime::createShaderModule(device, srcMssim);
+IQM::SSIM::SSIM(const vk::raii::Device &device, const vk::raii::PipelineCache *cache, const bool halfPrecision):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
+    this->shared->halfPrecision = halfPrecision;
+    this->shared->pipelineCache = cache;
 
-    this->descPool = VulkanRuntime::createDescPool(device, 4, {
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 20},
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 20}
-    });
+    const auto smSsim = VulkanRuntime::createShaderModule(device, src);
+    const auto smLumapack = VulkanRuntime::createShaderModule(device, srcLumapack);
 
-    this->descSetLayoutLumapack = VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutLumapack = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageImage, 5},
     });
 
-    this->descSetLayoutSsim = VulkanRuntime::createDescLayout(device, {
+    // partial sums and the mask are only bound to the final SSIM pass, gauss passes leave them unused
+    this->shared->descSetLayoutSsim = VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 5},
         {vk::DescriptorType::eStorageImage, 1},
+        {vk::DescriptorType::eStorageBuffer, 1},
+        {vk::DescriptorType::eStorageBuffer, 1},
     });
 
-    this->descSetLayoutMssim = VulkanRuntime::createDescLayout(device, {
+    // output image is only bound when the map is written
+    this->shared->descSetLayoutFused = VulkanRuntime::createDescLayout(device, {
+        {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
+        {vk::DescriptorType::eStorageImage, 1},
+        {vk::DescriptorType::eStorageBuffer, 1},
+    });
+
+    // 1x int - kernel size
+    // 3x float - K_1, K_2, sigma
+    // 4x int - summed region
+    // 1x int - mask flag
+    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(int) * 1 + sizeof(float) * 3 + sizeof(int) * 5);
+
+    // 2x float - K_1, K_2
+    // 4x int - summed region
+    // 1x int - mask flag
+    const auto rangesFused = VulkanRuntime::createPushConstantRange(2 * sizeof(float) + 5 * sizeof(int));
+
+    // 1x int - index of the blurred image
+    const auto rangesGauss = VulkanRuntime::createPushConstantRange(sizeof(int));
+
+    this->shared->layoutLumapack = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutLumapack}, {});
+    this->shared->layoutGauss = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutSsim}, rangesGauss);
+    this->shared->layoutSsim = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutSsim}, ranges);
+    this->shared->layoutFused = VulkanRuntime::createPipelineLayout(device, {*this->shared->descSetLayoutFused}, rangesFused);
+
+    this->shared->pipelineLumapack = VulkanRuntime::createComputePipeline(device, smLumapack, this->shared->layoutLumapack, cache);
+    this->shared->pipelineSsim = VulkanRuntime::createComputePipeline(device, smSsim, this->shared->layoutSsim, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::SSIM::SSIM(const vk::raii::Device &device, const SSIM &other):
+kernelSize(other.kernelSize),
+k_1(other.k_1),
+k_2(other.k_2),
+sigma(other.sigma),
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::SSIM::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, 4, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 20},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 24}
     });
 
     const std::vector allocateLayouts = {
-        *this->descSetLayoutLumapack,
-        *this->descSetLayoutSsim,
-        *this->descSetLayoutSsim,
-        *this->descSetLayoutMssim
+        *this->shared->descSetLayoutLumapack,
+        *this->shared->descSetLayoutSsim,
+        *this->shared->descSetLayoutSsim,
+        *this->shared->descSetLayoutFused,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -70,40 +131,143 @@ IQM::SSIM::SSIM(const vk::raii::Device &device) {
     this->descSetLumapack = std::move(sets[0]);
     this->descSetGauss = std::move(sets[1]);
     this->descSetSsim = std::move(sets[2]);
-    this->descSetMssim = std::move(sets[3]);
+    this->descSetFused = std::move(sets[3]);
+}
 
-    // 1x int - kernel size
-    // 3x float - K_1, K_2, sigma
-    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(int) * 1 + sizeof(float) * 3);
+bool IQM::SSIM::usesIntermediates() const {
+    return this->kernelSize > MAX_FUSED_KERNEL_SIZE;
+}
 
-    // 2x int - kernel size, kernel direction
-    // 1x float - sigma
-    const auto rangesGauss = VulkanRuntime::createPushConstantRange(2 * sizeof(int) + sizeof(float));
+const IQM::SSIM::KernelPipelines& IQM::SSIM::specializedPipelines(const vk::raii::Device &device, const bool writeMap) {
+    auto &pipelines = this->shared->kernelPipelines[std::make_pair(this->kernelSize, this->sigma)];
 
-    // 1x int - data size
-    const auto rangeMssim = VulkanRuntime::createPushConstantRange( sizeof(int));
+    const GaussKernel kernel(this->kernelSize, this->sigma);
+    const auto &specInfo = kernel.specializationInfo();
 
-    this->layoutLumapack = VulkanRuntime::createPipelineLayout(device, {*this->descSetLayoutLumapack}, {});
-    this->layoutGauss = VulkanRuntime::createPipelineLayout(device, {*this->descSetLayoutSsim}, rangesGauss);
-    this->layoutSsim = VulkanRuntime::createPipelineLayout(device, {*this->descSetLayoutSsim}, ranges);
-    this->layoutMssim = VulkanRuntime::createPipelineLayout(device, {*this->descSetLayoutMssim}, rangeMssim);
+    if (this->usesIntermediates()) {
+        if (*pipelines.gauss == nullptr) {
+            const auto smGaussHorizontal = VulkanRuntime::createShaderModule(device, srcGaussHorizontal);
+            const auto smGauss = VulkanRuntime::createShaderModule(device, srcGauss);
+            pipelines.gaussHorizontal = VulkanRuntime::createComputePipeline(device, smGaussHorizontal, this->shared->layoutGauss, specInfo, this->shared->pipelineCache);
+            pipelines.gauss = VulkanRuntime::createComputePipeline(device, smGauss, this->shared->layoutGauss, specInfo, this->shared->pipelineCache);
+        }
+    } else if (writeMap) {
+        if (*pipelines.fused == nullptr) {
+            const auto smFused = VulkanRuntime::createShaderModule(device, this->shared->halfPrecision ? srcFusedHalf : srcFused);
+            pipelines.fused = VulkanRuntime::createComputePipeline(device, smFused, this->shared->layoutFused, specInfo, this->shared->pipelineCache);
+        }
+    } else if (*pipelines.fusedSum == nullptr) {
+        const auto smFusedSum = VulkanRuntime::createShaderModule(device, srcFusedSum);
+        pipelines.fusedSum = VulkanRuntime::createComputePipeline(device, smFusedSum, this->shared->layoutFused, specInfo, this->shared->pipelineCache);
+    }
 
-    this->pipelineLumapack = VulkanRuntime::createComputePipeline(device, smLumapack, this->layoutLumapack);
-    this->pipelineGauss = VulkanRuntime::createComputePipeline(device, smGauss, this->layoutGauss);
-    this->pipelineGaussHorizontal = VulkanRuntime::createComputePipeline(device, smGaussHorizontal, this->layoutGauss);
-    this->pipelineSsim = VulkanRuntime::createComputePipeline(device, smSsim, this->layoutSsim);
-    this->pipelineMssim = VulkanRuntime::createComputePipeline(device, smMssim, this->layoutMssim);
+    return pipelines;
 }
 
 void IQM::SSIM::computeMetric(const SSIMInput &input) {
+    if (input.bufGrid != nullptr && (input.gridCell == 0 || input.gridCell % 16 != 0)) {
+        throw std::runtime_error("SSIM grid cells must be a multiple of 16 pixels");
+    }
     this->initDescriptors(input);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineLumapack);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutLumapack, 0, {this->descSetLumapack}, {});
+    const auto &pipelines = this->specializedPipelines(*input.device, input.ivOut != nullptr);
+
+    const auto halfOffset = (this->kernelSize - 1) / 2;
+    const auto offset = this->kernelSize - 1;
+
+    auto region = vk::Rect2D{
+        .offset = vk::Offset2D{halfOffset, halfOffset},
+        .extent = vk::Extent2D{input.width - offset, input.height - offset},
+    };
+    if (input.sumRegion.extent.width != 0 && input.sumRegion.extent.height != 0) {
+        region = input.sumRegion;
+    }
+    if (input.mask.enabled()) {
+        // pixels outside of the bounds have zero weight, tiles outside of the region can be skipped
+        const auto &bounds = input.mask.bounds;
+        const auto left = std::max(region.offset.x, bounds.offset.x);
+        const auto top = std::max(region.offset.y, bounds.offset.y);
+        const auto right = std::max(left, std::min<int>(region.offset.x + region.extent.width, bounds.offset.x + bounds.extent.width));
+        const auto bottom = std::max(top, std::min<int>(region.offset.y + region.extent.height, bounds.offset.y + bounds.extent.height));
+        region = vk::Rect2D{
+            .offset = vk::Offset2D{left, top},
+            .extent = vk::Extent2D{static_cast<unsigned>(right - left), static_cast<unsigned>(bottom - top)},
+        };
+    }
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
 
+    // final pass stores sum of the region in each tile
+    if (this->usesIntermediates()) {
+        this->computeSeparable(input, pipelines, region, groupsX, groupsY);
+    } else {
+        this->computeFused(input, pipelines, region, groupsX, groupsY);
+    }
+
+    vk::MemoryBarrier memBarrier = {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+    input.cmdBuf->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits::eDeviceGroup,
+        {memBarrier},
+        {},
+        {}
+    );
+
+    if (input.bufGrid != nullptr) {
+        // tile sums are already weighted, cells only add them up
+        this->reduce.grid(ReduceGridInput{
+            .cmdBuf = input.cmdBuf,
+            .width = groupsX,
+            .height = groupsY,
+            .cell = input.gridCell / 16,
+            .weights = GridWeights::Sums,
+            .weightOffset = groupsX * groupsY,
+        });
+    }
+
+    // sums of weights follow the sums of values
+    this->reduce.reduce(ReduceInput{
+        .cmdBuf = input.cmdBuf,
+        .op = ReduceOp::Sum,
+        .size = groupsX * groupsY,
+        .count = 2,
+        .stride = groupsX * groupsY,
+    });
+}
+
+void IQM::SSIM::computeFused(const SSIMInput &input, const KernelPipelines &pipelines, const vk::Rect2D &region, const unsigned groupsX, const unsigned groupsY) {
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, input.ivOut != nullptr ? pipelines.fused : pipelines.fusedSum);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutFused, 0, {this->descSetFused}, {});
+
+    std::array values = {
+        *reinterpret_cast<int *>(&this->k_1),
+        *reinterpret_cast<int *>(&this->k_2),
+        region.offset.x,
+        region.offset.y,
+        static_cast<int>(region.extent.width),
+        static_cast<int>(region.extent.height),
+        static_cast<int>(input.mask.enabled()),
+    };
+    input.cmdBuf->pushConstants<int>(this->shared->layoutFused, vk::ShaderStageFlagBits::eCompute, 0, values);
+
+    input.cmdBuf->dispatch(groupsX, groupsY, 1);
+}
+
+void IQM::SSIM::computeSeparable(const SSIMInput &input, const KernelPipelines &pipelines, const vk::Rect2D &region, const unsigned groupsX, const unsigned groupsY) {
+    if (input.cachedReference && *this->shared->pipelineLumapackTest == nullptr) {
+        const auto smLumapackTest = VulkanRuntime::createShaderModule(*input.device, srcLumapackTest);
+        this->shared->pipelineLumapackTest = VulkanRuntime::createComputePipeline(*input.device, smLumapackTest, this->shared->layoutLumapack, this->shared->pipelineCache);
+    }
+
+    // with cached reference, only test luma, its square and covariance term are written
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, input.cachedReference ? this->shared->pipelineLumapackTest : this->shared->pipelineLumapack);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutLumapack, 0, {this->descSetLumapack}, {});
+
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
     vk::MemoryBarrier memoryBarrier = {
@@ -118,15 +282,14 @@ void IQM::SSIM::computeMetric(const SSIMInput &input) {
     );
 
     for (int i = 0; i < 5; i++) {
-        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineGaussHorizontal);
-        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutGauss, 0, {this->descSetGauss}, {});
+        // reference mean and squared mean
+        if (input.cachedReference && (i == 1 || i == 3)) {
+            continue;
+        }
 
-        std::array valuesGauss = {
-            this->kernelSize,
-            *reinterpret_cast<int *>(&this->sigma),
-            i,
-        };
-        input.cmdBuf->pushConstants<int>(this->layoutGauss, vk::ShaderStageFlagBits::eCompute, 0, valuesGauss);
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.gaussHorizontal);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutGauss, 0, {this->descSetGauss}, {});
+        input.cmdBuf->pushConstants<int>(this->shared->layoutGauss, vk::ShaderStageFlagBits::eCompute, 0, i);
 
         input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
@@ -136,14 +299,8 @@ void IQM::SSIM::computeMetric(const SSIMInput &input) {
             vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
         );
 
-        valuesGauss = {
-            this->kernelSize,
-            *reinterpret_cast<int *>(&this->sigma),
-            i,
-        };
-
-        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineGauss);
-        input.cmdBuf->pushConstants<int>(this->layoutGauss, vk::ShaderStageFlagBits::eCompute, 0, valuesGauss);
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.gauss);
+        input.cmdBuf->pushConstants<int>(this->shared->layoutGauss, vk::ShaderStageFlagBits::eCompute, 0, i);
 
         input.cmdBuf->dispatch(groupsX, groupsY, 1);
 
@@ -154,94 +311,93 @@ void IQM::SSIM::computeMetric(const SSIMInput &input) {
         );
     }
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSsim);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSsim, 0, {this->descSetSsim}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineSsim);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSsim, 0, {this->descSetSsim}, {});
 
     std::array values = {
         this->kernelSize,
         *reinterpret_cast<int *>(&this->k_1),
         *reinterpret_cast<int *>(&this->k_2),
-        *reinterpret_cast<int *>(&this->sigma)
+        *reinterpret_cast<int *>(&this->sigma),
+        region.offset.x,
+        region.offset.y,
+        static_cast<int>(region.extent.width),
+        static_cast<int>(region.extent.height),
+        static_cast<int>(input.mask.enabled()),
     };
-    input.cmdBuf->pushConstants<int>(this->layoutSsim, vk::ShaderStageFlagBits::eCompute, 0, values);
+    input.cmdBuf->pushConstants<int>(this->shared->layoutSsim, vk::ShaderStageFlagBits::eCompute, 0, values);
 
     input.cmdBuf->dispatch(groupsX, groupsY, 1);
+}
 
-    vk::MemoryBarrier memBarrier = {
-        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
-    };
-    input.cmdBuf->pipelineBarrier(
-        vk::PipelineStageFlagBits::eComputeShader,
-        vk::PipelineStageFlagBits::eTransfer,
-        vk::DependencyFlagBits::eDeviceGroup,
-        {memBarrier},
-        {},
-        {}
-    );
+void IQM::SSIM::initDescriptors(const SSIMInput &input) {
+    // one partial sum per 16x16 tile, followed by one sum of weights per tile
+    const auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
+    const vk::DeviceSize sumsSize = 2 * groupsX * groupsY * sizeof(float);
+    this->reduce.setUpDescriptors(*input.device, *input.bufMssim, sumsSize);
+    if (input.bufGrid != nullptr) {
+        const auto grid = Reduce::gridExtent(input.width, input.height, input.gridCell);
+        this->reduce.setUpGrid(*input.device, *input.bufGrid, grid.width * grid.height * sizeof(float));
+    }
 
-    const auto halfOffset = (this->kernelSize - 1) / 2;
-    const auto offset = this->kernelSize - 1;
+    const std::vector sumBufInfos = {
+        vk::DescriptorBufferInfo{
+            .buffer = *input.bufMssim,
+            .offset = 0,
+            .range = sumsSize,
+        }
+    };
 
-    vk::BufferImageCopy copyMssimRegion{
-        .bufferOffset = 0,
-        .bufferRowLength = input.width - offset,
-        .bufferImageHeight = input.height - offset,
-        .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
-        .imageOffset = vk::Offset3D{halfOffset, halfOffset, 0},
-        .imageExtent = vk::Extent3D{input.width - offset, input.height - offset, 1}
+    // shaders only read the mask if it's set
+    const std::vector maskBufInfos = {
+        vk::DescriptorBufferInfo{
+            .buffer = input.mask.enabled() ? **input.mask.buffer : **input.bufMssim,
+            .offset = 0,
+            .range = input.mask.enabled() ? input.width * input.height * sizeof(float) : sumsSize,
+        }
     };
-    input.cmdBuf->copyImageToBuffer(*input.imgOut,  vk::ImageLayout::eGeneral, *input.bufMssim, copyMssimRegion);
 
-    memBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-    memBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-    input.cmdBuf->pipelineBarrier(
-        vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eComputeShader,
-        vk::DependencyFlagBits::eDeviceGroup,
-        {memBarrier},
-        {},
-        {}
-    );
+    const auto inputImageInfos = VulkanRuntime::createImageInfos({
+        input.ivTest,
+        input.ivRef,
+    });
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineMssim);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutMssim, 0, {this->descSetMssim}, {});
+    if (!this->usesIntermediates()) {
+        auto writeSetFusedIn = VulkanRuntime::createWriteSet(
+            this->descSetFused,
+            0,
+            inputImageInfos
+        );
 
-    const auto sumSize = 1024;
+        auto writeSetFusedSums = VulkanRuntime::createWriteSet(
+            this->descSetFused,
+            1,
+            sumBufInfos
+        );
 
-    uint32_t bufferSize = (input.width - offset) * (input.height - offset);
-    uint64_t groups = (bufferSize / sumSize) + 1;
-    uint32_t size = bufferSize;
+        auto writeSetFusedMask = VulkanRuntime::createWriteSet(
+            this->descSetFused,
+            3,
+            maskBufInfos
+        );
 
-    for (;;) {
-        input.cmdBuf->pushConstants<unsigned>(this->layoutMssim, vk::ShaderStageFlagBits::eCompute, 0, size);
-        input.cmdBuf->dispatch(groups, 1, 1);
+        if (input.ivOut == nullptr) {
+            input.device->updateDescriptorSets({writeSetFusedIn, writeSetFusedSums, writeSetFusedMask}, nullptr);
+            return;
+        }
 
-        vk::BufferMemoryBarrier barrier = {
-            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-            .buffer = *input.bufMssim,
-            .offset = 0,
-            .size = bufferSize * sizeof(float),
-        };
-        input.cmdBuf->pipelineBarrier(
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::DependencyFlagBits::eDeviceGroup,
-            {},
-            {barrier},
-            {}
+        const auto outImageInfos = VulkanRuntime::createImageInfos({input.ivOut});
+        auto writeSetFusedOut = VulkanRuntime::createWriteSet(
+            this->descSetFused,
+            2,
+            outImageInfos
         );
-        if (groups == 1) {
-            break;
-        }
-        size = groups;
-        groups = (groups / sumSize) + 1;
+
+        input.device->updateDescriptorSets({writeSetFusedIn, writeSetFusedSums, writeSetFusedOut, writeSetFusedMask}, nullptr);
+        return;
     }
-}
 
-void IQM::SSIM::initDescriptors(const SSIMInput &input) {
-    const unsigned sizeTrimmed = (input.width - this->kernelSize + 1) * (input.height - this->kernelSize + 1) * sizeof(float);
+    const auto outImageInfos = VulkanRuntime::createImageInfos({input.ivOut});
 
     const auto imageInfosIntermediate = VulkanRuntime::createImageInfos({
         input.ivMeanTest,
@@ -250,20 +406,6 @@ void IQM::SSIM::initDescriptors(const SSIMInput &input) {
         input.ivVarRef,
         input.ivCovar,
     });
-    const auto outImageInfos = VulkanRuntime::createImageInfos({input.ivOut});
-
-    const auto inputImageInfos = VulkanRuntime::createImageInfos({
-        input.ivTest,
-        input.ivRef,
-    });
-
-    std::vector bufInfos = {
-        vk::DescriptorBufferInfo{
-            .buffer = *input.bufMssim,
-            .offset = 0,
-            .range = sizeTrimmed,
-        }
-    };
 
     // input
     auto writeSetLumapackIn = VulkanRuntime::createWriteSet(
@@ -304,12 +446,17 @@ void IQM::SSIM::initDescriptors(const SSIMInput &input) {
         outImageInfos
     );
 
-    // mssim
-    auto writeSetSum = VulkanRuntime::createWriteSet(
-        this->descSetMssim,
-        0,
-        bufInfos
+    auto writeSetSsimSums = VulkanRuntime::createWriteSet(
+        this->descSetSsim,
+        2,
+        sumBufInfos
+    );
+
+    auto writeSetSsimMask = VulkanRuntime::createWriteSet(
+        this->descSetSsim,
+        3,
+        maskBufInfos
     );
 
-    input.device->updateDescriptorSets({writeSetLumapackIn, writeSetLumapackOut, writeSetGaussFlip, writeSetGaussFlop, writeSetSsimIn, writeSetSsimOut, writeSetSum}, nullptr);
+    input.device->updateDescriptorSets({writeSetLumapackIn, writeSetLumapackOut, writeSetGaussFlip, writeSetGaussFlop, writeSetSsimIn, writeSetSsimOut, writeSetSsimSums, writeSetSsimMask}, nullptr);
 }
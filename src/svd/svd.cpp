@@ -25,55 +25,85 @@ static std::vector<uint32_t> srcSortHistogram =
 #include <lib/multi_radixsort_histograms.inc>
 ;
 
-static std::vector<uint32_t> srcSum =
-#include <svd/msvd_sum.inc>
+static std::vector<uint32_t> srcDiff =
+#include <svd/msvd_diff.inc>
 ;
 
 using IQM::GPU::VulkanRuntime;
 
-IQM::SVD::SVD(const vk::raii::Device &device) {
+IQM::SVD::SVD(const vk::raii::Device &device, const vk::raii::PipelineCache *cache):
+shared(std::make_shared<Pipelines>()),
+reduce(device, cache) {
     const auto smConvert = VulkanRuntime::createShaderModule(device, srcConvert);
     const auto smSvd = VulkanRuntime::createShaderModule(device, srcSvd);
     const auto smReduce = VulkanRuntime::createShaderModule(device, srcReduce);
     const auto smSort = VulkanRuntime::createShaderModule(device, srcSort);
     const auto smSortHistogram = VulkanRuntime::createShaderModule(device, srcSortHistogram);
-    const auto smSum = VulkanRuntime::createShaderModule(device, srcSum);
+    const auto smDiff = VulkanRuntime::createShaderModule(device, srcDiff);
 
-    this->descPool = VulkanRuntime::createDescPool(device, 8, {
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 24},
-        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 4},
-    });
-
-    this->descSetLayoutConvert = std::move(VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutConvert = std::move(VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageImage, 2},
     }));
 
-    this->descSetLayoutSvd = std::move(VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutSvd = std::move(VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageImage, 2},
         {vk::DescriptorType::eStorageBuffer, 1},
     }));
 
-    this->descSetLayoutReduce = std::move(VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutReduce = std::move(VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     }));
 
-    this->descSetLayoutSort = std::move(VulkanRuntime::createDescLayout(device, {
+    this->shared->descSetLayoutSort = std::move(VulkanRuntime::createDescLayout(device, {
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
         {vk::DescriptorType::eStorageBuffer, 1},
     }));
 
+    // 1x int - buffer size
+    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(int) * 1);
+    const auto rangesSort = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
+
+    this->shared->layoutConvert = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutConvert}, {});
+    this->shared->layoutSvd = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutSvd}, {});
+    this->shared->layoutReduce = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutReduce}, ranges);
+    this->shared->layoutSort = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutSort}, {rangesSort});
+    this->shared->layoutSortHistogram = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutReduce}, {rangesSort});
+    this->shared->layoutDiff = VulkanRuntime::createPipelineLayout(device, {this->shared->descSetLayoutReduce}, ranges);
+
+    this->shared->pipelineConvert = VulkanRuntime::createComputePipeline(device, smConvert, this->shared->layoutConvert, cache);
+    this->shared->pipelineSvd = VulkanRuntime::createComputePipeline(device, smSvd, this->shared->layoutSvd, cache);
+    this->shared->pipelineReduce = VulkanRuntime::createComputePipeline(device, smReduce, this->shared->layoutReduce, cache);
+    this->shared->pipelineSort = VulkanRuntime::createComputePipeline(device, smSort, this->shared->layoutSort, cache);
+    this->shared->pipelineSortHistogram = VulkanRuntime::createComputePipeline(device, smSortHistogram, this->shared->layoutSortHistogram, cache);
+    this->shared->pipelineDiff = VulkanRuntime::createComputePipeline(device, smDiff, this->shared->layoutDiff, cache);
+
+    this->allocateDescriptors(device);
+}
+
+IQM::SVD::SVD(const vk::raii::Device &device, const SVD &other):
+shared(other.shared),
+reduce(device, other.reduce) {
+    this->allocateDescriptors(device);
+}
+
+void IQM::SVD::allocateDescriptors(const vk::raii::Device &device) {
+    this->descPool = VulkanRuntime::createDescPool(device, 8, {
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 24},
+        vk::DescriptorPoolSize{.type = vk::DescriptorType::eStorageImage, .descriptorCount = 4},
+    });
+
     const std::vector layouts = {
-        *this->descSetLayoutConvert,
-        *this->descSetLayoutSvd,
-        *this->descSetLayoutReduce,
-        *this->descSetLayoutSort,
-        *this->descSetLayoutSort,
-        *this->descSetLayoutReduce,
-        *this->descSetLayoutReduce,
-        *this->descSetLayoutReduce,
+        *this->shared->descSetLayoutConvert,
+        *this->shared->descSetLayoutSvd,
+        *this->shared->descSetLayoutReduce,
+        *this->shared->descSetLayoutSort,
+        *this->shared->descSetLayoutSort,
+        *this->shared->descSetLayoutReduce,
+        *this->shared->descSetLayoutReduce,
+        *this->shared->descSetLayoutReduce,
     };
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo = {
@@ -90,26 +120,7 @@ IQM::SVD::SVD(const vk::raii::Device &device) {
     this->descSetSortOdd = std::move(createdLayouts[4]);
     this->descSetSortHistogramEven = std::move(createdLayouts[5]);
     this->descSetSortHistogramOdd = std::move(createdLayouts[6]);
-    this->descSetSum = std::move(createdLayouts[7]);
-
-    // 1x int - buffer size
-    const auto ranges = VulkanRuntime::createPushConstantRange(sizeof(int) * 1);
-    const auto rangesSum = VulkanRuntime::createPushConstantRange(2 * sizeof(uint32_t));
-    const auto rangesSort = VulkanRuntime::createPushConstantRange(4 * sizeof(uint32_t));
-
-    this->layoutConvert = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutConvert}, {});
-    this->layoutSvd = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutSvd}, {});
-    this->layoutReduce = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutReduce}, ranges);
-    this->layoutSort = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutSort}, {rangesSort});
-    this->layoutSortHistogram = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutReduce}, {rangesSort});
-    this->layoutSum = VulkanRuntime::createPipelineLayout(device, {this->descSetLayoutReduce}, {rangesSum});
-
-    this->pipelineConvert = VulkanRuntime::createComputePipeline(device, smConvert, this->layoutConvert);
-    this->pipelineSvd = VulkanRuntime::createComputePipeline(device, smSvd, this->layoutSvd);
-    this->pipelineReduce = VulkanRuntime::createComputePipeline(device, smReduce, this->layoutReduce);
-    this->pipelineSort = VulkanRuntime::createComputePipeline(device, smSort, this->layoutSort);
-    this->pipelineSortHistogram = VulkanRuntime::createComputePipeline(device, smSortHistogram, this->layoutSortHistogram);
-    this->pipelineSum = VulkanRuntime::createComputePipeline(device, smSum, this->layoutSum);
+    this->descSetDiff = std::move(createdLayouts[7]);
 }
 
 void IQM::SVD::computeMetric(const SVDInput &input) {
@@ -174,8 +185,8 @@ void IQM::SVD::computeMetric(const SVDInput &input) {
 }
 
 void IQM::SVD::convertColorSpace(const SVDInput &input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineConvert);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutConvert, 0, {this->descSetConvert}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineConvert);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutConvert, 0, {this->descSetConvert}, {});
 
     //shaders work in 16x16 tiles
     auto [groupsX, groupsY] = VulkanRuntime::compute2DGroupCounts(input.width, input.height, 16);
@@ -195,8 +206,8 @@ void IQM::SVD::convertColorSpace(const SVDInput &input) {
 }
 
 void IQM::SVD::computeSvd(const SVDInput &input) {
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSvd);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSvd, 0, {this->descSetSvd}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineSvd);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSvd, 0, {this->descSetSvd}, {});
 
     input.cmdBuf->dispatch(input.width/8, input.height/8, 2);
 
@@ -215,9 +226,9 @@ void IQM::SVD::computeSvd(const SVDInput &input) {
 void IQM::SVD::reduceSingularValues(const SVDInput &input) {
     auto valueCount = (input.width / 8) * (input.height / 8);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineReduce);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutReduce, 0, {this->descSetReduce}, {});
-    input.cmdBuf->pushConstants<unsigned>(this->layoutReduce, vk::ShaderStageFlagBits::eCompute, 0, valueCount);
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineReduce);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutReduce, 0, {this->descSetReduce}, {});
+    input.cmdBuf->pushConstants<unsigned>(this->shared->layoutReduce, vk::ShaderStageFlagBits::eCompute, 0, valueCount);
 
     // group takes 128 values, reduces to 8 values
     auto groupsX = (valueCount / 128) + 1;
@@ -254,8 +265,8 @@ void IQM::SVD::sortBlocks(const SVDInput &input) {
 
     for (unsigned j = 0; j < 4; j++) {
         auto activeSet = j % 2 == 0 ? &this->descSetSortHistogramEven : &this->descSetSortHistogramOdd;
-        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSortHistogram);
-        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSortHistogram, 0, {*activeSet}, {});
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineSortHistogram);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSortHistogram, 0, {*activeSet}, {});
 
         std::array values = {
             valueCount,
@@ -263,7 +274,7 @@ void IQM::SVD::sortBlocks(const SVDInput &input) {
             nSortWorkgroups,
             nBlocksPerWorkgroup,
         };
-        input.cmdBuf->pushConstants<unsigned>(this->layoutSortHistogram, vk::ShaderStageFlagBits::eCompute, 0, values);
+        input.cmdBuf->pushConstants<unsigned>(this->shared->layoutSortHistogram, vk::ShaderStageFlagBits::eCompute, 0, values);
 
         input.cmdBuf->dispatch(sortGlobalInvocationSize, 1, 1);
 
@@ -277,10 +288,10 @@ void IQM::SVD::sortBlocks(const SVDInput &input) {
         );
 
         activeSet = j % 2 == 0 ? &this->descSetSortEven : &this->descSetSortOdd;
-        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSort);
-        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSort, 0, {*activeSet}, {});
+        input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineSort);
+        input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutSort, 0, {*activeSet}, {});
 
-        input.cmdBuf->pushConstants<unsigned>(this->layoutSort, vk::ShaderStageFlagBits::eCompute, 0, values);
+        input.cmdBuf->pushConstants<unsigned>(this->shared->layoutSort, vk::ShaderStageFlagBits::eCompute, 0, values);
 
         input.cmdBuf->dispatch(sortGlobalInvocationSize, 1, 1);
 
@@ -298,43 +309,29 @@ void IQM::SVD::sortBlocks(const SVDInput &input) {
 void IQM::SVD::computeMsvd(const SVDInput &input) {
     auto valueCount = (input.width / 8) * (input.height / 8);
 
-    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->pipelineSum);
-    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->layoutSum, 0, {this->descSetSum}, {});
+    input.cmdBuf->bindPipeline(vk::PipelineBindPoint::eCompute, this->shared->pipelineDiff);
+    input.cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->shared->layoutDiff, 0, {this->descSetDiff}, {});
+    input.cmdBuf->pushConstants<unsigned>(this->shared->layoutDiff, vk::ShaderStageFlagBits::eCompute, 0, valueCount);
 
-    const auto sumSize = 1024;
+    // absolute differences from the median are computed in place and then summed
+    input.cmdBuf->dispatch((valueCount + 255) / 256, 1, 1);
 
-    uint32_t bufferSize = valueCount;
-    uint64_t groups = (bufferSize / sumSize) + 1;
-    uint32_t size = bufferSize;
-    uint32_t doDiff = 1;
+    vk::MemoryBarrier memoryBarrier = {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
 
-    for (;;) {
-        input.cmdBuf->pushConstants<unsigned>(this->layoutSum, vk::ShaderStageFlagBits::eCompute, 0, size);
-        input.cmdBuf->pushConstants<unsigned>(this->layoutSum, vk::ShaderStageFlagBits::eCompute, sizeof(uint32_t), doDiff);
-        input.cmdBuf->dispatch(groups, 1, 1);
+    input.cmdBuf->pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits::eDeviceGroup, {memoryBarrier}, {}, {}
+    );
 
-        vk::BufferMemoryBarrier barrier = {
-            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
-            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
-            .buffer = *input.bufSortTemp,
-            .offset = 0,
-            .size = bufferSize * sizeof(float),
-        };
-        input.cmdBuf->pipelineBarrier(
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::DependencyFlagBits::eDeviceGroup,
-            {},
-            {barrier},
-            {}
-        );
-        if (groups == 1) {
-            break;
-        }
-        size = groups;
-        groups = (groups / sumSize) + 1;
-        doDiff = 0;
-    }
+    this->reduce.reduce(ReduceInput{
+        .cmdBuf = input.cmdBuf,
+        .op = ReduceOp::Sum,
+        .size = valueCount,
+    });
 }
 
 void IQM::SVD::initDescriptors(const SVDInput &input) {
@@ -479,18 +476,20 @@ void IQM::SVD::initDescriptors(const SVDInput &input) {
             1,
             bufInfoSortHist
         ),
-        // sum
+        // median differences
         VulkanRuntime::createWriteSet(
-            this->descSetSum,
+            this->descSetDiff,
             0,
             bufInfoSortTemp
         ),
         VulkanRuntime::createWriteSet(
-            this->descSetSum,
+            this->descSetDiff,
             1,
             bufInfoSort
         ),
     };
 
     input.device->updateDescriptorSets(writes, nullptr);
+
+    this->reduce.setUpDescriptors(*input.device, *input.bufSortTemp, outBufSize * sizeof(float));
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#ifndef IQM_TESTS_CHECK_H
+#define IQM_TESTS_CHECK_H
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace IQM::Test {
+    // failed checks of the test executable, it exits with failure if there are any
+    inline unsigned failures = 0;
+
+    inline void check(const bool passed, const char *expression, const char *file, const int line) {
+        if (!passed) {
+            std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+            failures++;
+        }
+    }
+
+    inline int result() {
+        if (failures != 0) {
+            std::cerr << failures << " checks failed" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // fresh directory under the system temp directory, removed with its contents
+    class TempDirectory {
+    public:
+        TempDirectory() {
+            std::random_device random;
+            this->path = std::filesystem::temp_directory_path() / ("iqm-test-" + std::to_string(random()));
+            std::filesystem::create_directories(this->path);
+        }
+        ~TempDirectory() {
+            std::error_code error;
+            std::filesystem::remove_all(this->path, error);
+        }
+        TempDirectory(const TempDirectory&) = delete;
+        TempDirectory& operator=(const TempDirectory&) = delete;
+
+        // creates the file with its parent directories
+        std::filesystem::path file(const std::string &name, const std::string &contents = "") const {
+            const auto filePath = this->path / name;
+            std::filesystem::create_directories(filePath.parent_path());
+            std::ofstream(filePath, std::ios::binary) << contents;
+            return filePath;
+        }
+
+        std::filesystem::path path;
+    };
+}
+
+#define CHECK(expression) IQM::Test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expression) do { \
+        bool thrown = false; \
+        try { \
+            expression; \
+        } catch (const std::exception &) { \
+            thrown = true; \
+        } \
+        IQM::Test::check(thrown, "throws: " #expression, __FILE__, __LINE__); \
+    } while (false)
+
+#endif //IQM_TESTS_CHECK_H
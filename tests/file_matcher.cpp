@@ -0,0 +1,194 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "check.h"
+#include "../bin/IQM/file_matcher.h"
+
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using IQM::Bin::FileMatcher;
+
+static IQM::Bin::Args parse(const std::vector<std::string> &values) {
+    std::vector<const char*> argv = {"IQM", "--method", "SSIM"};
+    for (const auto &value : values) {
+        argv.push_back(value.c_str());
+    }
+    return {static_cast<unsigned>(argv.size()), argv.data()};
+}
+
+static std::vector<IQM::Bin::Match> match(const std::vector<std::string> &values) {
+    FileMatcher matcher;
+    return matcher.match(parse(values));
+}
+
+static void test_directories(const IQM::Test::TempDirectory &dir) {
+    dir.file("test/a.png");
+    dir.file("test/b.jpg");
+    dir.file("test/notes.txt");
+    dir.file("ref/a.png");
+    dir.file("ref/b.png");
+    dir.file("ref/c.png");
+    const auto test = dir.path / "test";
+    const auto ref = dir.path / "ref";
+    const auto out = dir.path / "out";
+
+    // non-image files are skipped, images are paired by stem and sorted
+    const auto matches = match({"--input", test.string(), "--ref", ref.string(), "--output", out.string()});
+    CHECK(matches.size() == 2);
+    CHECK(fs::path(matches[0].testPath) == test / "a.png");
+    CHECK(fs::path(matches[0].refPath) == ref / "a.png");
+    CHECK(fs::path(matches[0].outPath.value()) == out / "a.png");
+    CHECK(fs::path(matches[1].testPath) == test / "b.jpg");
+    CHECK(fs::path(matches[1].refPath) == ref / "b.png");
+    CHECK(fs::path(matches[1].outPath.value()) == out / "b.png");
+
+    // with full names, `b.jpg` has no reference
+    const auto byName = match({"--input", test.string(), "--ref", ref.string(), "--pair-by", "name"});
+    CHECK(byName.size() == 1);
+    CHECK(fs::path(byName[0].refPath) == ref / "a.png");
+    CHECK(!byName[0].outPath.has_value());
+
+    CHECK_THROWS(match({"--input", test.string(), "--ref", ref.string(), "--pair-by", "path"}));
+    CHECK_THROWS(match({"--input", (dir.path / "missing").string(), "--ref", ref.string()}));
+}
+
+static void test_globs(const IQM::Test::TempDirectory &dir) {
+    dir.file("glob/a.png");
+    dir.file("glob/a.jpg");
+    dir.file("glob/b.png");
+    dir.file("glob-ref/a.png");
+    dir.file("glob-ref/b.png");
+    const auto test = dir.path / "glob";
+    const auto ref = dir.path / "glob-ref";
+
+    const auto pngs = match({"--input", (test / "*.png").string(), "--ref", ref.string()});
+    CHECK(pngs.size() == 2);
+    CHECK(fs::path(pngs[0].testPath) == test / "a.png");
+    CHECK(fs::path(pngs[1].testPath) == test / "b.png");
+
+    const auto single = match({"--input", (test / "a.[jJ]pg").string(), "--ref", ref.string()});
+    CHECK(single.size() == 1);
+    CHECK(fs::path(single[0].testPath) == test / "a.jpg");
+    CHECK(fs::path(single[0].refPath) == ref / "a.png");
+
+    // wildcards are only allowed in file names
+    CHECK_THROWS(match({"--input", (dir.path / "gl*" / "a.png").string(), "--ref", ref.string()}));
+    CHECK_THROWS(match({"--input", (test / "*.bmp").string(), "--ref", ref.string()}));
+    CHECK_THROWS(match({"--input", (dir.path / "missing" / "*.png").string(), "--ref", ref.string()}));
+}
+
+static void test_references(const IQM::Test::TempDirectory &dir) {
+    dir.file("single/a.png");
+    dir.file("single/b.png");
+    const auto ref = dir.file("single-ref.png");
+    const auto test = dir.path / "single";
+
+    // single reference file is shared by all tested images
+    const auto shared = match({"--input", test.string(), "--ref", ref.string()});
+    CHECK(shared.size() == 2);
+    CHECK(fs::path(shared[0].refPath) == ref);
+    CHECK(fs::path(shared[1].refPath) == ref);
+
+    // single pair keeps the output as a file path
+    const auto pair = match({"--input", (test / "a.png").string(), "--ref", ref.string(), "--output", "map.png"});
+    CHECK(pair.size() == 1);
+    CHECK(pair[0].outPath == "map.png");
+
+    CHECK_THROWS(match({"--input", test.string(), "--ref", (dir.path / "missing.png").string()}));
+
+    // two references with the same stem
+    dir.file("ambiguous/c.png");
+    dir.file("ambiguous-ref/c.png");
+    dir.file("ambiguous-ref/c.jpg");
+    CHECK_THROWS(match({"--input", (dir.path / "ambiguous").string(), "--ref", (dir.path / "ambiguous-ref").string()}));
+
+    // tested images differing only in extension would share the output map
+    dir.file("same-stem/d.png");
+    dir.file("same-stem/d.jpg");
+    const auto sameStem = (dir.path / "same-stem").string();
+    CHECK(match({"--input", sameStem, "--ref", ref.string()}).size() == 2);
+    CHECK_THROWS(match({"--input", sameStem, "--ref", ref.string(), "--output", (dir.path / "out").string()}));
+}
+
+static void test_csv_manifest(const IQM::Test::TempDirectory &dir) {
+    const auto manifest = dir.file("csv/list.csv",
+        "test,ref,out,dirty\r\n"
+        "\"x,1.png\",r.png,,\r\n"
+        "\r\n"
+        "y.png,/abs/r.png,maps/y.png,\"0,0,4,4\"\r\n"
+    );
+    const auto base = manifest.parent_path();
+    const auto out = dir.path / "csv-out";
+
+    const auto matches = match({"--input", manifest.string(), "--output", out.string()});
+    CHECK(matches.size() == 2);
+    CHECK(fs::path(matches[0].testPath) == base / "x,1.png");
+    CHECK(fs::path(matches[0].refPath) == base / "r.png");
+    CHECK(fs::path(matches[0].outPath.value()) == out / "x,1.png");
+    CHECK(!matches[0].dirty.has_value());
+    CHECK(fs::path(matches[1].refPath) == "/abs/r.png");
+    CHECK(fs::path(matches[1].outPath.value()) == out / "maps" / "y.png");
+    CHECK(matches[1].dirty == "0,0,4,4");
+
+    // without the reference column, `--ref` is shared by all rows
+    const auto noRef = dir.file("csv/tests.csv", "image\nz.png\n");
+    const auto shared = match({"--input", noRef.string(), "--ref", "shared.png", "--manifest-test", "image"});
+    CHECK(shared.size() == 1);
+    CHECK(fs::path(shared[0].testPath) == base / "z.png");
+    CHECK(shared[0].refPath == "shared.png");
+
+    CHECK_THROWS(match({"--input", noRef.string(), "--manifest-test", "image"}));
+    CHECK_THROWS(match({"--input", noRef.string(), "--ref", "shared.png"}));
+    CHECK_THROWS(match({"--input", dir.file("csv/empty.csv", "test,ref\n").string()}));
+}
+
+static void test_jsonl_manifest(const IQM::Test::TempDirectory &dir) {
+    const auto manifest = dir.file("jsonl/list.jsonl",
+        "{\"test\": \"a\\\"b.png\", \"ref\": \"r.png\"}\n"
+        "   \n"
+        "{ \"test\" : \"c.png\" , \"ref\":\"r.png\", \"out\": \"o.png\" }\n"
+    );
+    const auto base = manifest.parent_path();
+
+    const auto matches = match({"--input", manifest.string()});
+    CHECK(matches.size() == 2);
+    CHECK(fs::path(matches[0].testPath) == base / "a\"b.png");
+    CHECK(!matches[0].outPath.has_value());
+    CHECK(fs::path(matches[1].testPath) == base / "c.png");
+    // outputs of the manifest are relative to it without `--output`
+    CHECK(fs::path(matches[1].outPath.value()) == base / "o.png");
+
+    const auto malformed = dir.file("jsonl/malformed.jsonl", "{\"test\": \"a.png\", \"ref\": \"r.png\"}\n{\"test\" \"b.png\"}\n");
+    CHECK_THROWS(match({"--input", malformed.string()}));
+}
+
+static void test_json_object() {
+    const auto object = FileMatcher::parseJsonObject(" {\"id\": 5, \"flag\" : true ,\"text\":\"x\\ny\\\\\"}");
+    CHECK(object.size() == 3);
+    CHECK(object.at("id") == "5");
+    CHECK(object.at("flag") == "true");
+    CHECK(object.at("text") == "x\ny\\");
+
+    CHECK(FileMatcher::parseJsonObject("{}").empty());
+    CHECK_THROWS(FileMatcher::parseJsonObject("[1]"));
+    CHECK_THROWS(FileMatcher::parseJsonObject("{\"a\" 1}"));
+    CHECK_THROWS(FileMatcher::parseJsonObject("{\"a\": \"unterminated"));
+    CHECK_THROWS(FileMatcher::parseJsonObject("{\"a\": 1"));
+}
+
+int main() {
+    const IQM::Test::TempDirectory dir;
+
+    test_directories(dir);
+    test_globs(dir);
+    test_references(dir);
+    test_csv_manifest(dir);
+    test_jsonl_manifest(dir);
+    test_json_object();
+
+    return IQM::Test::result();
+}
@@ -0,0 +1,43 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "check.h"
+#include "../bin/IQM/output_root.h"
+
+namespace fs = std::filesystem;
+
+using IQM::Bin::inside_output_root;
+
+int main() {
+    const IQM::Test::TempDirectory dir;
+    fs::create_directories(dir.path / "out" / "sub");
+    fs::create_directories(dir.path / "elsewhere");
+
+    // trailing separator and `.` don't change the root
+    const auto root = IQM::Bin::output_root((dir.path / "out").string() + "/");
+    CHECK(root == fs::weakly_canonical(dir.path / "out"));
+    CHECK(IQM::Bin::output_root((dir.path / "out" / ".").string()) == root);
+
+    CHECK(inside_output_root(root, (root / "a.png").string()));
+    CHECK(inside_output_root(root, (root / "sub" / "b.png").string()));
+    // missing directories are created when the map is saved
+    CHECK(inside_output_root(root, (root / "new" / "c.png").string()));
+    CHECK(inside_output_root(root, (root / "sub" / ".." / "d.png").string()));
+
+    CHECK(!inside_output_root(root, (root / ".." / "a.png").string()));
+    CHECK(!inside_output_root(root, (root / "sub" / ".." / ".." / "a.png").string()));
+    CHECK(!inside_output_root(root, (dir.path / "elsewhere" / "a.png").string()));
+    // a sibling sharing the name prefix is not inside
+    CHECK(!inside_output_root(root, (dir.path / "out2" / "a.png").string()));
+    CHECK(!inside_output_root(root, "/a.png"));
+
+    // symlinks are followed before the check
+    fs::create_directory_symlink(dir.path / "elsewhere", root / "link");
+    CHECK(!inside_output_root(root, (root / "link" / "a.png").string()));
+    fs::create_directory_symlink(root / "sub", dir.path / "inside");
+    CHECK(inside_output_root(root, (dir.path / "inside" / "a.png").string()));
+
+    return IQM::Test::result();
+}
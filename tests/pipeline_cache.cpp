@@ -0,0 +1,91 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "check.h"
+#include "../bin/IQM/pipeline_cache.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+using IQM::Bin::pipeline_cache_header_matches;
+
+static vk::PhysicalDeviceProperties device_properties() {
+    vk::PhysicalDeviceProperties properties{
+        .vendorID = 0x10de,
+        .deviceID = 0x2684,
+    };
+    for (unsigned i = 0; i < VK_UUID_SIZE; i++) {
+        properties.pipelineCacheUUID[i] = i;
+    }
+    return properties;
+}
+
+// header as a driver writes it, followed by `payload` bytes of cache data
+static std::vector<char> cache_data(const vk::PhysicalDeviceProperties &properties, const size_t payload) {
+    VkPipelineCacheHeaderVersionOne header{
+        .headerSize = sizeof(VkPipelineCacheHeaderVersionOne),
+        .headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE,
+        .vendorID = properties.vendorID,
+        .deviceID = properties.deviceID,
+    };
+    std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+
+    std::vector<char> data(sizeof(header) + payload, 7);
+    std::memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+static void test_header() {
+    const auto properties = device_properties();
+
+    CHECK(pipeline_cache_header_matches(cache_data(properties, 64), properties));
+    CHECK(pipeline_cache_header_matches(cache_data(properties, 0), properties));
+
+    CHECK(!pipeline_cache_header_matches({}, properties));
+    auto truncated = cache_data(properties, 0);
+    truncated.pop_back();
+    CHECK(!pipeline_cache_header_matches(truncated, properties));
+
+    auto otherVendor = properties;
+    otherVendor.vendorID = 0x1002;
+    CHECK(!pipeline_cache_header_matches(cache_data(otherVendor, 64), properties));
+
+    auto otherDevice = properties;
+    otherDevice.deviceID = 0x2685;
+    CHECK(!pipeline_cache_header_matches(cache_data(otherDevice, 64), properties));
+
+    // driver update changes only the UUID
+    auto otherDriver = properties;
+    otherDriver.pipelineCacheUUID[VK_UUID_SIZE - 1] ^= 1;
+    CHECK(!pipeline_cache_header_matches(cache_data(otherDriver, 64), properties));
+
+    auto otherVersion = cache_data(properties, 64);
+    const auto version = static_cast<uint32_t>(VK_PIPELINE_CACHE_HEADER_VERSION_ONE) + 1;
+    std::memcpy(otherVersion.data() + offsetof(VkPipelineCacheHeaderVersionOne, headerVersion), &version, sizeof(version));
+    CHECK(!pipeline_cache_header_matches(otherVersion, properties));
+}
+
+static void test_directory() {
+    setenv("XDG_CACHE_HOME", "/xdg", 1);
+    setenv("HOME", "/home/user", 1);
+    CHECK(IQM::Bin::cache_directory() == std::filesystem::path("/xdg/IQM"));
+
+    setenv("XDG_CACHE_HOME", "", 1);
+    CHECK(IQM::Bin::cache_directory() == std::filesystem::path("/home/user/.cache/IQM"));
+
+    unsetenv("XDG_CACHE_HOME");
+    CHECK(IQM::Bin::cache_directory() == std::filesystem::path("/home/user/.cache/IQM"));
+
+    unsetenv("HOME");
+    CHECK(!IQM::Bin::cache_directory().has_value());
+}
+
+int main() {
+    test_header();
+    test_directory();
+
+    return IQM::Test::result();
+}
@@ -0,0 +1,143 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "check.h"
+#include "../bin/shared/tiling.h"
+
+#include <algorithm>
+
+using IQM::Bin::AxisTile;
+using IQM::Bin::TileGrid;
+
+static bool same_tiles(const std::vector<AxisTile> &tiles, const std::vector<AxisTile> &expected) {
+    return std::ranges::equal(tiles, expected, [](const AxisTile &a, const AxisTile &b) {
+        return a.start == b.start && a.coreStart == b.coreStart && a.coreEnd == b.coreEnd;
+    });
+}
+
+// cores cover the axis without gaps or overlaps, and each sees `halo` pixels of the tile around it, except at the border
+static bool valid_split(const std::vector<AxisTile> &tiles, const unsigned length, const unsigned tileLength, const unsigned halo) {
+    const auto size = std::min(length, tileLength);
+    unsigned covered = 0;
+    for (const auto &tile : tiles) {
+        if (tile.coreStart != covered || tile.coreEnd <= tile.coreStart || tile.start + size > length) {
+            return false;
+        }
+        if (tile.coreStart != 0 && tile.coreStart < tile.start + halo) {
+            return false;
+        }
+        if (tile.coreEnd != length && tile.coreEnd + halo > tile.start + size) {
+            return false;
+        }
+        covered = tile.coreEnd;
+    }
+    return covered == length;
+}
+
+static void test_split_axis() {
+    CHECK(same_tiles(IQM::Bin::split_axis(100, 200, 5), {{0, 0, 100}}));
+    CHECK(same_tiles(IQM::Bin::split_axis(100, 100, 5), {{0, 0, 100}}));
+    CHECK(same_tiles(IQM::Bin::split_axis(100, 40, 5), {{0, 0, 35}, {30, 35, 65}, {60, 65, 100}}));
+    // last tile is shifted inwards, so its core is narrower
+    CHECK(same_tiles(IQM::Bin::split_axis(80, 40, 5), {{0, 0, 35}, {30, 35, 45}, {40, 45, 80}}));
+    CHECK(same_tiles(IQM::Bin::split_axis(64, 32, 0), {{0, 0, 32}, {32, 32, 64}}));
+
+    for (unsigned length = 1; length <= 300; length += 7) {
+        for (const unsigned tileLength : {16u, 32u, 48u, 112u}) {
+            for (const unsigned halo : {0u, 1u, 5u, 7u}) {
+                CHECK(valid_split(IQM::Bin::split_axis(length, tileLength, halo), length, tileLength, halo));
+            }
+        }
+    }
+}
+
+static void test_grid() {
+    const TileGrid grid(100, 60, 40, 5);
+    CHECK(grid.tileWidth == 40);
+    CHECK(grid.tileHeight == 40);
+    CHECK(grid.tiles.size() == 6);
+
+    // row by row
+    CHECK(grid.tiles[1].x == 30 && grid.tiles[1].y == 0);
+    CHECK(grid.tiles[3].x == 0 && grid.tiles[3].y == 20);
+    CHECK(grid.tiles[4].coreX == 35 && grid.tiles[4].coreY == 25);
+    CHECK(grid.tiles[4].coreWidth == 30 && grid.tiles[4].coreHeight == 35);
+
+    unsigned long area = 0;
+    for (const auto &tile : grid.tiles) {
+        area += static_cast<unsigned long>(tile.coreWidth) * tile.coreHeight;
+    }
+    CHECK(area == 100 * 60);
+
+    // images smaller than the tile are a single tile of their size
+    const TileGrid small(30, 20, 64, 5);
+    CHECK(small.tileWidth == 30 && small.tileHeight == 20);
+    CHECK(small.tiles.size() == 1);
+    CHECK(small.tiles[0].coreWidth == 30 && small.tiles[0].coreHeight == 20);
+
+    CHECK_THROWS(TileGrid(100, 100, 10, 5));
+}
+
+static void test_crop_stitch() {
+    const unsigned width = 100;
+    const unsigned height = 60;
+    IQM::Bin::InputImage image{
+        .width = width,
+        .height = height,
+        .data = std::vector<unsigned char>(width * height * 4),
+    };
+    for (unsigned i = 0; i < image.data.size(); i++) {
+        image.data[i] = static_cast<unsigned char>(i * 7 + i / 251);
+    }
+
+    // cropped tiles stitched by their cores give back the whole image
+    const TileGrid grid(width, height, 48, 7);
+    std::vector<unsigned char> map(image.data.size());
+    for (const auto &tile : grid.tiles) {
+        const auto cropped = IQM::Bin::crop_tile(image, grid, tile);
+        CHECK(cropped.width == grid.tileWidth && cropped.height == grid.tileHeight);
+        CHECK(cropped.pixels()[0] == image.data[(tile.y * width + tile.x) * 4]);
+        IQM::Bin::stitch_tile(map, cropped.data, 4, grid, tile);
+    }
+    CHECK(map == image.data);
+}
+
+// memory of a single R f32 image of the tile
+static unsigned long float_image(const unsigned width, const unsigned height) {
+    return 4ul * width * height;
+}
+
+static void test_budget() {
+    CHECK(!IQM::Bin::tile_budget({}).has_value());
+    CHECK(IQM::Bin::tile_budget({{"--tile-vram", "3"}}) == 3ul * 1024 * 1024);
+
+    // sides are multiples of 16
+    CHECK(IQM::Bin::tile_size(float_image(256, 256), float_image, 5) == 256);
+    CHECK(IQM::Bin::tile_size(float_image(250, 250), float_image, 5) == 240);
+    CHECK(IQM::Bin::tile_size(float_image(250, 250) - 1, float_image, 5) == 240);
+    // bounded even if everything fits
+    CHECK(IQM::Bin::tile_size(~0ul, float_image, 5) == 65536);
+
+    CHECK_THROWS(IQM::Bin::tile_size(100, float_image, 5));
+    CHECK_THROWS(IQM::Bin::tile_size(float_image(16, 16), float_image, 8));
+
+    const std::optional<unsigned long> none;
+    CHECK(IQM::Bin::pair_tile_budget(1000, none, 4000, 4000, float_image) == 1000ul);
+    CHECK(!IQM::Bin::pair_tile_budget(none, none, 4000, 4000, float_image).has_value());
+    CHECK(!IQM::Bin::pair_tile_budget(none, float_image(4000, 4000), 4000, 4000, float_image).has_value());
+    CHECK(IQM::Bin::pair_tile_budget(none, float_image(4000, 4000) - 1, 4000, 4000, float_image) == float_image(4000, 4000) - 1);
+
+    CHECK(IQM::Bin::pair_memory(1000, 100, float_image, 5, none) == float_image(1000, 100));
+    CHECK(IQM::Bin::pair_memory(1000, 100, float_image, 5, float_image(256, 256)) == float_image(256, 100));
+}
+
+int main() {
+    test_split_axis();
+    test_grid();
+    test_crop_stitch();
+    test_budget();
+
+    return IQM::Test::result();
+}
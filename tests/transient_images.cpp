@@ -0,0 +1,141 @@
+/*
+ * Image Quality Metrics
+ * Petr Volf - 2025
+ */
+
+#include "check.h"
+#include "../bin/shared/transient_images.h"
+
+#include <random>
+
+using IQM::Bin::TransientSlot;
+using IQM::Bin::place_transient;
+
+static bool alive_together(const TransientSlot &a, const TransientSlot &b) {
+    return !(a.lastStep < b.firstStep || b.lastStep < a.firstStep);
+}
+
+// slots alive at the same step must not share memory, and all are aligned and inside the placement
+static bool valid_placement(const std::vector<TransientSlot> &slots, const IQM::Bin::TransientPlacement &placement) {
+    if (placement.offsets.size() != slots.size()) {
+        return false;
+    }
+    for (unsigned i = 0; i < slots.size(); i++) {
+        const auto offset = placement.offsets[i];
+        if (offset % slots[i].alignment != 0 || offset + slots[i].size > placement.size) {
+            return false;
+        }
+        for (unsigned j = i + 1; j < slots.size(); j++) {
+            const auto other = placement.offsets[j];
+            const bool disjoint = offset + slots[i].size <= other || other + slots[j].size <= offset;
+            if (alive_together(slots[i], slots[j]) && !disjoint) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_placement() {
+    const auto empty = place_transient({});
+    CHECK(empty.offsets.empty());
+    CHECK(empty.size == 0);
+
+    // images of separate steps share memory
+    const std::vector<TransientSlot> separate = {
+        {.size = 100, .alignment = 1, .firstStep = 0, .lastStep = 1},
+        {.size = 80, .alignment = 1, .firstStep = 2, .lastStep = 3},
+    };
+    const auto shared = place_transient(separate);
+    CHECK(shared.offsets == std::vector<unsigned long>({0, 0}));
+    CHECK(shared.size == 100);
+
+    // steps are inclusive, so images used in the same step don't
+    const std::vector<TransientSlot> touching = {
+        {.size = 100, .alignment = 1, .firstStep = 0, .lastStep = 2},
+        {.size = 50, .alignment = 1, .firstStep = 2, .lastStep = 3},
+    };
+    const auto stacked = place_transient(touching);
+    CHECK(stacked.offsets == std::vector<unsigned long>({0, 100}));
+    CHECK(stacked.size == 150);
+
+    // offsets are rounded up to the alignment of the placed image
+    const std::vector<TransientSlot> aligned = {
+        {.size = 100, .alignment = 1, .firstStep = 0, .lastStep = 1},
+        {.size = 60, .alignment = 64, .firstStep = 0, .lastStep = 1},
+    };
+    const auto alignedPlacement = place_transient(aligned);
+    CHECK(alignedPlacement.offsets == std::vector<unsigned long>({0, 128}));
+    CHECK(alignedPlacement.size == 188);
+
+    // largest image is placed first, smaller ones reuse memory of images that are no longer alive
+    const std::vector<TransientSlot> reused = {
+        {.size = 100, .alignment = 1, .firstStep = 0, .lastStep = 1},
+        {.size = 50, .alignment = 1, .firstStep = 2, .lastStep = 2},
+        {.size = 100, .alignment = 1, .firstStep = 1, .lastStep = 2},
+        {.size = 100, .alignment = 1, .firstStep = 0, .lastStep = 0},
+        {.size = 200, .alignment = 1, .firstStep = 3, .lastStep = 3},
+    };
+    const auto reusedPlacement = place_transient(reused);
+    CHECK(reusedPlacement.offsets == std::vector<unsigned long>({0, 0, 100, 100, 0}));
+    CHECK(reusedPlacement.size == 200);
+    CHECK(valid_placement(reused, reusedPlacement));
+}
+
+static void test_random_placements() {
+    std::mt19937 random(42);
+    for (unsigned round = 0; round < 200; round++) {
+        std::vector<TransientSlot> slots(1 + random() % 12);
+        unsigned long sum = 0;
+        for (auto &slot : slots) {
+            const auto first = static_cast<unsigned>(random() % 8);
+            slot = TransientSlot{
+                .size = 1 + random() % 1000,
+                .alignment = 1ul << (random() % 8),
+                .firstStep = first,
+                .lastStep = first + static_cast<unsigned>(random() % 4),
+            };
+            sum += slot.size + slot.alignment;
+        }
+
+        const auto placement = place_transient(slots);
+        CHECK(valid_placement(slots, placement));
+        // never worse than giving every image its own memory
+        CHECK(placement.size <= sum);
+    }
+}
+
+static vk::ImageCreateInfo image_info(const vk::Format format, const unsigned width, const unsigned height, const unsigned layers = 1) {
+    return vk::ImageCreateInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = format,
+        .extent = vk::Extent3D{width, height, 1},
+        .mipLevels = 1,
+        .arrayLayers = layers,
+    };
+}
+
+static void test_estimate() {
+    IQM::Bin::TransientImages images;
+    CHECK(images.empty());
+    CHECK(images.estimateSize() == 0);
+
+    // 16 kB each, the first and last aren't alive together
+    CHECK(images.add(image_info(vk::Format::eR32Sfloat, 64, 64), 0, 1) == 0);
+    CHECK(images.add(image_info(vk::Format::eR32Sfloat, 64, 64), 1, 2) == 1);
+    CHECK(images.add(image_info(vk::Format::eR8G8B8A8Unorm, 64, 64), 2, 3) == 2);
+    CHECK(!images.empty());
+    CHECK(images.estimateSize() == 2 * 16384);
+
+    // layers of an array image take memory as well
+    images.add(image_info(vk::Format::eR16Sfloat, 64, 64, 6), 4, 4);
+    CHECK(images.estimateSize() == 6 * 8192);
+}
+
+int main() {
+    test_placement();
+    test_random_placements();
+    test_estimate();
+
+    return IQM::Test::result();
+}